@@ -0,0 +1,553 @@
+// AnalysisCoordinator.cpp : Spreads a batch of positions over several analysis_server processes and
+// merges their answers, one machine standing in for a cluster.
+//
+//   analysis_coordinator --workers 4 --depth 8 positions.epd > results.jsonl
+//   analysis_coordinator --workers 4 --depth 10 --split-root positions.epd
+//   analysis_coordinator --scaling --workers 8 --depth 6 positions.epd
+//
+// Each worker is an analysis_server started with one search thread on a socket of its own. Positions
+// (FEN or EPD lines) are handed out a few at a time per worker as answers come back, so a fast worker
+// takes more of them. --split-root instead shards every position by root move: each worker searches
+// the position after one move a ply shallower, and the best move is the child with the lowest score
+// for the opponent, its line prefixed with the move. A root move's own check extension cannot be
+// handed to the worker along with the position after it, so split-root children are searched with
+// ExtensionBudget=0 whatever --option says; the result is the whole search without extensions.
+//
+// A worker that closes its connection, exits, or holds a request longer than --timeout seconds is
+// killed and replaced; what it had in hand is queued again, up to --retries times per request.
+// --kill-after N kills one worker after N answers, to exercise that path.
+//
+// Results go to stdout as reply lines (see AnalysisService.h), one per input position in input order,
+// with the position's FEN as the id. --scaling runs the whole batch with 1, 2, 4 ... up to --workers
+// workers and prints the throughput of each instead.
+
+#include "../chessnative2/AnalysisService.h"
+#include "../chessnative2/EngineRegistry.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Used when no position file is given; the bench positions of uci_engine.
+const char* const kDefaultFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "4r1k1/p1pb1ppp/Qbp1r3/8/1P6/2Pq1B2/R2P1PPP/2B2RK1 b - - 0 1",
+    "r1bq1rk1/pp4bp/2np4/2p1p1p1/P1N1P3/1P1P1NP1/1BP1QPKP/1R3R2 b - - 0 1",
+    "8/2p5/7p/pP2k1pP/5pP1/8/1P2PPK1/8 w - - 0 1",
+    "8/2kPR3/5q2/5N2/8/1p1P4/1p6/1K6 w - - 0 1",
+};
+
+struct Settings
+{
+    std::string server;   // analysis_server binary
+    std::string engine;   // empty: the server's default
+    std::vector< std::string > options;
+    int workers = 2;
+    int depth = 6;
+    int multipv = 1;
+    int window = 2;       // requests in hand per worker
+    int retries = 2;      // per request, after the first attempt
+    double timeout = 120; // seconds one request may take before its worker is presumed hung
+    int kill_after = 0;   // answers before one worker is killed; 0 = never
+    bool split_root = false;
+    bool verbose = false; // keep the workers' stderr
+};
+
+// One request to a worker: a whole position, or in split-root mode the position after one root move.
+struct Task
+{
+    size_t position;
+    std::string move; // split-root only
+    std::string fen;
+    int depth;
+    int attempts = 0;
+    bool done = false;
+    engine::AnalysisReply reply;
+};
+
+struct Worker
+{
+    pid_t pid = -1;
+    int fd = -1;
+    std::string socket;
+    std::string pending;
+    std::map< std::string, std::pair< size_t, Clock::time_point > > outstanding; // request id -> task, sent at
+};
+
+struct RunStats
+{
+    double seconds = 0;
+    int spawned = 0;
+    int lost = 0;
+    int retried = 0;
+    int failed = 0;
+};
+
+int connect_to( const std::string& path )
+{
+    sockaddr_un addr;
+    std::memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof( addr.sun_path ) )
+        return -1;
+    std::strcpy( addr.sun_path, path.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd >= 0 && connect( fd, ( sockaddr* )&addr, sizeof( addr ) ) != 0 )
+    {
+        close( fd );
+        fd = -1;
+    }
+    return fd;
+}
+
+bool send_all( int fd, const std::string& text )
+{
+    size_t sent = 0;
+    while ( sent < text.size() )
+    {
+        ssize_t n = send( fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        sent += ( size_t )n;
+    }
+    return true;
+}
+
+// Starts analysis_server on a fresh socket and connects to it; false if it did not come up.
+bool spawn( const Settings& s, int slot, int serial, Worker& w )
+{
+    w = Worker();
+    w.socket = "/tmp/chess-coord-" + std::to_string( getpid() ) + "-" + std::to_string( slot ) + "-" + std::to_string( serial ) + ".sock";
+    std::vector< std::string > args = { s.server, "--socket", w.socket, "--workers", "1" };
+    if ( !s.engine.empty() )
+        args.insert( args.end(), { "--engine", s.engine } );
+    for ( const auto& o : s.options )
+        args.insert( args.end(), { "--option", o } );
+    w.pid = fork();
+    if ( w.pid < 0 )
+        return false;
+    if ( w.pid == 0 )
+    {
+        if ( !s.verbose )
+        {
+            int null = open( "/dev/null", O_WRONLY );
+            dup2( null, 2 );
+        }
+        std::vector< char* > argv;
+        for ( auto& a : args )
+            argv.push_back( &a[ 0 ] );
+        argv.push_back( nullptr );
+        execv( argv[ 0 ], argv.data() );
+        _exit( 127 );
+    }
+    for ( int tries = 0; tries < 200; ++tries )
+    {
+        if ( ( w.fd = connect_to( w.socket ) ) >= 0 )
+            return true;
+        if ( waitpid( w.pid, nullptr, WNOHANG ) == w.pid )
+            break;
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+    }
+    kill( w.pid, SIGKILL );
+    waitpid( w.pid, nullptr, 0 );
+    w.pid = -1;
+    return false;
+}
+
+void stop( Worker& w, int signal )
+{
+    if ( w.fd >= 0 )
+        close( w.fd );
+    if ( w.pid > 0 )
+    {
+        kill( w.pid, signal );
+        waitpid( w.pid, nullptr, 0 );
+    }
+    unlink( w.socket.c_str() );
+    w.fd = -1;
+    w.pid = -1;
+}
+
+std::vector< std::string > read_positions( const std::string& path )
+{
+    std::vector< std::string > out;
+    if ( path.empty() )
+    {
+        out.assign( std::begin( kDefaultFens ), std::end( kDefaultFens ) );
+        return out;
+    }
+    std::ifstream in( path );
+    std::string line;
+    while ( std::getline( in, line ) )
+    {
+        std::istringstream fields( line );
+        std::string f[ 6 ];
+        int n = 0;
+        while ( n < 6 && fields >> f[ n ] )
+            ++n;
+        if ( n < 4 || f[ 0 ][ 0 ] == '#' )
+            continue;
+        // EPD has opcodes where a FEN has its two counters.
+        bool counters = n == 6 && std::isdigit( ( unsigned char )f[ 4 ][ 0 ] ) && std::isdigit( ( unsigned char )f[ 5 ][ 0 ] );
+        out.push_back( f[ 0 ] + " " + f[ 1 ] + " " + f[ 2 ] + " " + f[ 3 ] + ( counters ? " " + f[ 4 ] + " " + f[ 5 ] : " 0 1" ) );
+    }
+    return out;
+}
+
+// Runs every task on `count` workers. Tasks come back done, with an error reply if they failed.
+RunStats run_tasks( const Settings& s, int count, std::vector< Task >& tasks )
+{
+    RunStats stats;
+    std::deque< size_t > queue;
+    for ( size_t t = 0; t < tasks.size(); ++t )
+        queue.push_back( t );
+    size_t remaining = tasks.size();
+    int answers = 0, serial = 0;
+    bool killed = false;
+    std::vector< Worker > workers( count );
+    for ( int k = 0; k < count; ++k )
+        stats.spawned += spawn( s, k, serial++, workers[ k ] );
+    Clock::time_point start = Clock::now(); // timed from warm workers, as a cluster would be
+
+    auto finish = [ & ]( size_t t, const engine::AnalysisReply& reply ) {
+        tasks[ t ].reply = reply;
+        tasks[ t ].done = true;
+        --remaining;
+    };
+    // Puts back what a lost worker had in hand, or gives up on it after too many attempts.
+    auto lose = [ & ]( Worker& w ) {
+        ++stats.lost;
+        for ( const auto& o : w.outstanding )
+        {
+            size_t t = o.second.first;
+            if ( tasks[ t ].attempts > s.retries )
+            {
+                engine::AnalysisReply reply;
+                reply.error = "worker lost " + std::to_string( tasks[ t ].attempts ) + " times";
+                finish( t, reply );
+                ++stats.failed;
+            }
+            else
+            {
+                queue.push_front( t );
+                ++stats.retried;
+            }
+        }
+        w.outstanding.clear();
+        stop( w, SIGKILL );
+    };
+
+    int respawns = 4 * count;
+    while ( remaining )
+    {
+        for ( int k = 0; k < count; ++k )
+        {
+            Worker& w = workers[ k ];
+            if ( w.fd < 0 && !queue.empty() && respawns > 0 )
+            {
+                --respawns;
+                stats.spawned += spawn( s, k, serial++, w );
+            }
+            while ( w.fd >= 0 && !queue.empty() && ( int )w.outstanding.size() < s.window )
+            {
+                size_t t = queue.front();
+                queue.pop_front();
+                Task& task = tasks[ t ];
+                engine::AnalysisRequest request;
+                request.id = std::to_string( t ) + "." + std::to_string( task.attempts++ );
+                request.fen = task.fen;
+                request.depth = task.depth;
+                request.multipv = task.move.empty() ? s.multipv : 1;
+                w.outstanding[ request.id ] = { t, Clock::now() };
+                if ( !send_all( w.fd, engine::format_request( request ) + "\n" ) )
+                {
+                    lose( w );
+                    break;
+                }
+            }
+        }
+        std::vector< pollfd > fds;
+        std::vector< int > owner;
+        for ( int k = 0; k < count; ++k )
+            if ( workers[ k ].fd >= 0 )
+            {
+                fds.push_back( { workers[ k ].fd, POLLIN, 0 } );
+                owner.push_back( k );
+            }
+        if ( fds.empty() )
+        {
+            if ( respawns > 0 )
+                continue;
+            // No worker left and none can be started: fail what is left.
+            for ( size_t t : queue )
+            {
+                engine::AnalysisReply reply;
+                reply.error = "no workers";
+                finish( t, reply );
+                ++stats.failed;
+            }
+            queue.clear();
+            break;
+        }
+        poll( fds.data(), fds.size(), 100 );
+        for ( size_t i = 0; i < fds.size(); ++i )
+        {
+            Worker& w = workers[ owner[ i ] ];
+            if ( fds[ i ].revents )
+            {
+                char buf[ 65536 ];
+                ssize_t n = recv( w.fd, buf, sizeof( buf ), 0 );
+                if ( n <= 0 && !( n < 0 && errno == EINTR ) )
+                {
+                    lose( w );
+                    continue;
+                }
+                if ( n > 0 )
+                    w.pending.append( buf, ( size_t )n );
+                size_t nl;
+                while ( ( nl = w.pending.find( '\n' ) ) != std::string::npos )
+                {
+                    engine::AnalysisReply reply;
+                    bool parsed = engine::parse_reply( w.pending.substr( 0, nl ), reply );
+                    w.pending.erase( 0, nl + 1 );
+                    auto it = parsed ? w.outstanding.find( reply.id ) : w.outstanding.end();
+                    if ( it == w.outstanding.end() )
+                        continue;
+                    size_t t = it->second.first;
+                    w.outstanding.erase( it );
+                    finish( t, reply );
+                    stats.failed += !reply.error.empty() && reply.error != "no legal moves";
+                    ++answers;
+                }
+            }
+            if ( w.fd < 0 )
+                continue;
+            for ( const auto& o : w.outstanding )
+                if ( std::chrono::duration< double >( Clock::now() - o.second.second ).count() > s.timeout )
+                {
+                    lose( w );
+                    break;
+                }
+            if ( w.fd >= 0 && s.kill_after && !killed && answers >= s.kill_after )
+            {
+                killed = true;
+                kill( w.pid, SIGKILL ); // noticed as a closed connection on the next poll
+            }
+        }
+    }
+    for ( Worker& w : workers )
+        stop( w, SIGTERM );
+    stats.seconds = std::chrono::duration< double >( Clock::now() - start ).count();
+    return stats;
+}
+
+// One task per position, or in split-root mode one per legal root move.
+std::vector< Task > make_tasks( const Settings& s, const std::vector< std::string >& positions, engine::EngineBase& local )
+{
+    std::vector< Task > tasks;
+    for ( size_t p = 0; p < positions.size(); ++p )
+    {
+        std::vector< std::string > moves = s.split_root && s.depth > 1 ? local.legal_moves_uci( positions[ p ] ) : std::vector< std::string >();
+        if ( moves.empty() )
+        {
+            tasks.push_back( { p, std::string(), positions[ p ], s.depth } );
+            continue;
+        }
+        for ( const auto& m : moves )
+            tasks.push_back( { p, m, local.apply_move( positions[ p ], m ), s.depth - 1 } );
+    }
+    return tasks;
+}
+
+// The reply for each position. In split-root mode a child with no legal moves is mate or stalemate;
+// the local engine's one-ply search scores it.
+std::vector< engine::AnalysisReply > merge( const Settings& s, const std::vector< std::string >& positions, const std::vector< Task >& tasks,
+                                            engine::EngineBase& local )
+{
+    std::vector< engine::AnalysisReply > out( positions.size() );
+    std::vector< std::vector< const Task* > > children( positions.size() );
+    for ( const Task& t : tasks )
+    {
+        if ( t.move.empty() )
+            out[ t.position ] = t.reply;
+        else
+            children[ t.position ].push_back( &t );
+    }
+    for ( size_t p = 0; p < positions.size(); ++p )
+    {
+        out[ p ].id = positions[ p ];
+        if ( children[ p ].empty() )
+            continue;
+        std::vector< std::pair< std::string, int > > terminal;
+        double search_ms = 0;
+        for ( const Task* t : children[ p ] )
+        {
+            engine::PvLine line;
+            line.depth = s.depth;
+            line.pv.push_back( t->move );
+            search_ms += t->reply.search_ms;
+            if ( t->reply.error == "no legal moves" )
+            {
+                if ( terminal.empty() )
+                    terminal = local.root_search_scores( positions[ p ], 1 );
+                for ( const auto& ms : terminal )
+                    if ( ms.first == t->move )
+                        line.score = ms.second;
+            }
+            else if ( !t->reply.error.empty() )
+            {
+                out[ p ].error = t->move + ": " + t->reply.error;
+                break;
+            }
+            else
+            {
+                line.score = -t->reply.lines[ 0 ].score;
+                line.pv.insert( line.pv.end(), t->reply.lines[ 0 ].pv.begin(), t->reply.lines[ 0 ].pv.end() );
+            }
+            out[ p ].lines.push_back( line );
+        }
+        if ( !out[ p ].error.empty() )
+        {
+            out[ p ].lines.clear();
+            continue;
+        }
+        std::stable_sort( out[ p ].lines.begin(), out[ p ].lines.end(),
+                          []( const engine::PvLine& a, const engine::PvLine& b ) { return a.score > b.score; } );
+        if ( ( int )out[ p ].lines.size() > s.multipv )
+            out[ p ].lines.resize( s.multipv );
+        out[ p ].search_ms = search_ms; // CPU time summed over the children
+    }
+    return out;
+}
+
+void report( const char* label, int workers, size_t positions, size_t tasks, const RunStats& r, double base )
+{
+    std::fprintf( stderr, "%-8s %3d workers  %6.2f s  %7.2f pos/s  %7.2f req/s  speedup %5.2f  lost %d  retried %d  failed %d\n", label, workers,
+                  r.seconds, positions / r.seconds, tasks / r.seconds, base / r.seconds, r.lost, r.retried, r.failed );
+}
+
+void usage()
+{
+    std::printf( "usage: analysis_coordinator [--workers N] [--depth N] [--multipv N] [--split-root] [--window N] [--retries N]\n"
+                 "                            [--timeout SEC] [--kill-after N] [--scaling] [--server PATH] [--engine NAME]\n"
+                 "                            [--option NAME=VALUE]... [--verbose] [FILE]\n" );
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    Settings s;
+    std::string input;
+    bool scaling = false;
+    std::string self = argv[ 0 ];
+    s.server = ( self.find( '/' ) == std::string::npos ? std::string( "." ) : self.substr( 0, self.rfind( '/' ) ) ) + "/analysis_server";
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        bool value = i + 1 < argc;
+        if ( a == "--workers" && value )
+            s.workers = std::max( 1, std::atoi( argv[ ++i ] ) );
+        else if ( a == "--depth" && value )
+            s.depth = std::atoi( argv[ ++i ] );
+        else if ( a == "--multipv" && value )
+            s.multipv = std::max( 1, std::atoi( argv[ ++i ] ) );
+        else if ( a == "--window" && value )
+            s.window = std::max( 1, std::atoi( argv[ ++i ] ) );
+        else if ( a == "--retries" && value )
+            s.retries = std::max( 0, std::atoi( argv[ ++i ] ) );
+        else if ( a == "--timeout" && value )
+            s.timeout = std::atof( argv[ ++i ] );
+        else if ( a == "--kill-after" && value )
+            s.kill_after = std::atoi( argv[ ++i ] );
+        else if ( a == "--server" && value )
+            s.server = argv[ ++i ];
+        else if ( a == "--engine" && value )
+            s.engine = argv[ ++i ];
+        else if ( a == "--option" && value )
+            s.options.push_back( argv[ ++i ] );
+        else if ( a == "--split-root" )
+            s.split_root = true;
+        else if ( a == "--scaling" )
+            scaling = true;
+        else if ( a == "--verbose" )
+            s.verbose = true;
+        else if ( a[ 0 ] != '-' && input.empty() )
+            input = a;
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+    if ( s.split_root )
+        s.options.push_back( "ExtensionBudget=0" ); // after any --option, so it wins
+    const engine::EngineInfo* info = s.engine.empty() ? &engine::default_engine() : engine::find_engine( s.engine );
+    if ( !info || access( s.server.c_str(), X_OK ) != 0 )
+    {
+        std::fprintf( stderr, info ? "cannot run %s (use --server)\n" : "unknown engine %s\n", info ? s.server.c_str() : s.engine.c_str() );
+        return 1;
+    }
+    std::vector< std::string > positions = read_positions( input );
+    if ( positions.empty() )
+    {
+        std::fprintf( stderr, "no positions in %s\n", input.c_str() );
+        return 1;
+    }
+    std::signal( SIGPIPE, SIG_IGN );
+    std::unique_ptr< engine::EngineBase > local( info->create() );
+
+    if ( scaling )
+    {
+        double base = 0;
+        for ( int n = 1;; n = std::min( n * 2, s.workers ) )
+        {
+            std::vector< Task > tasks = make_tasks( s, positions, *local );
+            RunStats r = run_tasks( s, n, tasks );
+            if ( n == 1 )
+                base = r.seconds;
+            report( "scaling", n, positions.size(), tasks.size(), r, base );
+            if ( n == s.workers )
+                break;
+        }
+        return 0;
+    }
+
+    std::vector< Task > tasks = make_tasks( s, positions, *local );
+    RunStats r = run_tasks( s, s.workers, tasks );
+    int failed = 0;
+    for ( const auto& reply : merge( s, positions, tasks, *local ) )
+    {
+        failed += !reply.error.empty();
+        std::printf( "%s\n", engine::format_reply( reply ).c_str() );
+    }
+    report( "done", s.workers, positions.size(), tasks.size(), r, r.seconds );
+    return failed ? 1 : 0;
+}
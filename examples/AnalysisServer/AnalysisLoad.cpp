@@ -0,0 +1,279 @@
+// AnalysisLoad.cpp : Load generator for analysis_server. Opens several connections, keeps a window of
+// requests in flight on each, and reports throughput and latency percentiles.
+//
+//   analysis_load --connections 8 --requests 400 --depth 5
+//   analysis_load --duplicates 50 --deadline 200 --priority-spread 3
+//
+// Positions are reached by pseudo-random legal moves from the bench positions, with a fixed seed, so
+// runs are comparable. --duplicates N makes N percent of the requests ask for one of a few hot
+// positions, which the server answers with a shared search; latency is measured from the send of a
+// request to the arrival of its reply.
+
+#include "../chessnative2/AnalysisService.h"
+#include "../chessnative2/ChessEngine2.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const char* const kSeedFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp4bp/2np4/2p1p1p1/P1N1P3/1P1P1NP1/1BP1QPKP/1R3R2 b - - 0 1",
+    "8/2p5/7p/pP2k1pP/5pP1/8/1P2PPK1/8 w - - 0 1",
+};
+
+struct Settings
+{
+    std::string socket = "/tmp/chess-analysis.sock";
+    int connections = 4;
+    int requests = 200; // in total
+    int window = 4;     // in flight per connection
+    int depth = 5;
+    int multipv = 1;
+    int duplicates = 25; // percent
+    int deadline = 0;
+    int priority_spread = 1; // priorities 0..spread-1
+};
+
+struct Result
+{
+    double latency_ms = 0;
+    double queue_ms = 0;
+    double search_ms = 0;
+    bool ok = false;
+    bool coalesced = false;
+    std::string error;
+};
+
+uint32_t next_random( uint32_t& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+std::vector< std::string > make_positions( int count )
+{
+    engine::ChessEngine2 e;
+    std::vector< std::string > out;
+    uint32_t seed = 2024;
+    while ( ( int )out.size() < count )
+    {
+        std::string fen = kSeedFens[ out.size() % ( sizeof( kSeedFens ) / sizeof( kSeedFens[ 0 ] ) ) ];
+        int plies = 2 + ( int )( next_random( seed ) % 10 );
+        for ( int p = 0; p < plies; ++p )
+        {
+            auto legal = e.legal_moves_uci( fen );
+            if ( legal.empty() )
+                break;
+            fen = e.apply_move( fen, legal[ next_random( seed ) % legal.size() ] );
+        }
+        out.push_back( fen );
+    }
+    return out;
+}
+
+int connect_to( const std::string& path )
+{
+    sockaddr_un addr;
+    std::memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof( addr.sun_path ) )
+        return -1;
+    std::strcpy( addr.sun_path, path.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd >= 0 && connect( fd, ( sockaddr* )&addr, sizeof( addr ) ) != 0 )
+    {
+        close( fd );
+        fd = -1;
+    }
+    return fd;
+}
+
+bool send_all( int fd, const std::string& text )
+{
+    size_t sent = 0;
+    while ( sent < text.size() )
+    {
+        ssize_t n = send( fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        sent += ( size_t )n;
+    }
+    return true;
+}
+
+// Sends this connection's share of the requests, at most window outstanding at a time.
+bool drive( const Settings& s, int index, int count, const std::vector< std::string >& positions, std::vector< Result >& out )
+{
+    int fd = connect_to( s.socket );
+    if ( fd < 0 )
+        return false;
+    uint32_t seed = 77u + ( uint32_t )index * 7919u;
+    const size_t hot = std::min< size_t >( 4, positions.size() );
+    std::map< int, Clock::time_point > outstanding;
+    std::string pending;
+    int sent = 0;
+    bool ok = true;
+    while ( ok && ( sent < count || !outstanding.empty() ) )
+    {
+        while ( sent < count && ( int )outstanding.size() < s.window )
+        {
+            const std::string& fen = ( int )( next_random( seed ) % 100 ) < s.duplicates ? positions[ next_random( seed ) % hot ]
+                                                                                            : positions[ hot + next_random( seed ) % ( positions.size() - hot ) ];
+            engine::AnalysisRequest request;
+            request.id = std::to_string( sent );
+            request.fen = fen;
+            request.depth = s.depth;
+            request.multipv = s.multipv;
+            request.priority = ( int )( next_random( seed ) % ( uint32_t )std::max( 1, s.priority_spread ) );
+            request.deadline_ms = s.deadline;
+            outstanding[ sent ] = Clock::now();
+            ++sent;
+            if ( !send_all( fd, engine::format_request( request ) + "\n" ) )
+                ok = false;
+        }
+        size_t nl;
+        while ( ok && ( nl = pending.find( '\n' ) ) == std::string::npos )
+        {
+            char buf[ 4096 ];
+            ssize_t n = recv( fd, buf, sizeof( buf ), 0 );
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n <= 0 )
+                ok = false;
+            else
+                pending.append( buf, ( size_t )n );
+        }
+        if ( !ok )
+            break;
+        std::string line = pending.substr( 0, nl );
+        pending.erase( 0, nl + 1 );
+        engine::AnalysisReply reply;
+        auto it = engine::parse_reply( line, reply ) ? outstanding.find( std::atoi( reply.id.c_str() ) ) : outstanding.end();
+        if ( it == outstanding.end() )
+            continue;
+        Result r;
+        r.latency_ms = std::chrono::duration< double, std::milli >( Clock::now() - it->second ).count();
+        r.ok = reply.error.empty();
+        r.coalesced = reply.coalesced;
+        r.queue_ms = reply.queue_ms;
+        r.search_ms = reply.search_ms;
+        r.error = reply.error;
+        out.push_back( r );
+        outstanding.erase( it );
+    }
+    close( fd );
+    return ok;
+}
+
+double percentile( const std::vector< double >& sorted, double p )
+{
+    if ( sorted.empty() )
+        return 0;
+    size_t i = ( size_t )( p / 100.0 * ( sorted.size() - 1 ) + 0.5 );
+    return sorted[ std::min( i, sorted.size() - 1 ) ];
+}
+
+void usage()
+{
+    std::printf( "usage: analysis_load [--socket PATH] [--connections N] [--requests N] [--window N] [--depth N] [--multipv N]\n"
+                 "                     [--duplicates PERCENT] [--deadline MS] [--priority-spread N]\n" );
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    Settings s;
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        int* target = a == "--connections" ? &s.connections
+                      : a == "--requests"  ? &s.requests
+                      : a == "--window"    ? &s.window
+                      : a == "--depth"     ? &s.depth
+                      : a == "--multipv"   ? &s.multipv
+                      : a == "--duplicates" ? &s.duplicates
+                      : a == "--deadline"  ? &s.deadline
+                      : a == "--priority-spread" ? &s.priority_spread
+                                                 : nullptr;
+        if ( a == "--socket" && i + 1 < argc )
+            s.socket = argv[ ++i ];
+        else if ( target && i + 1 < argc )
+            *target = std::atoi( argv[ ++i ] );
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+    s.connections = std::max( 1, s.connections );
+    s.window = std::max( 1, s.window );
+    s.requests = std::max( 0, s.requests );
+
+    const std::vector< std::string > positions = make_positions( std::max( 16, s.requests ) );
+    std::vector< std::vector< Result > > results( s.connections );
+    std::vector< char > connected( s.connections, 0 );
+    std::vector< std::thread > threads;
+    Clock::time_point start = Clock::now();
+    for ( int c = 0; c < s.connections; ++c )
+    {
+        int count = s.requests / s.connections + ( c < s.requests % s.connections ? 1 : 0 );
+        threads.emplace_back( [ &, c, count ] { connected[ c ] = drive( s, c, count, positions, results[ c ] ); } );
+    }
+    for ( auto& t : threads )
+        t.join();
+    double seconds = std::chrono::duration< double >( Clock::now() - start ).count();
+
+    std::vector< double > latencies;
+    std::map< std::string, int > errors;
+    int ok = 0, coalesced = 0;
+    double queued = 0, searched = 0;
+    for ( const auto& per : results )
+        for ( const Result& r : per )
+        {
+            latencies.push_back( r.latency_ms );
+            if ( r.ok )
+            {
+                ++ok;
+                coalesced += r.coalesced;
+                queued += r.queue_ms;
+                searched += r.search_ms;
+            }
+            else
+                ++errors[ r.error ];
+        }
+    std::sort( latencies.begin(), latencies.end() );
+    if ( std::count( connected.begin(), connected.end(), 0 ) )
+        std::printf( "%d of %d connections failed (is analysis_server listening on %s?)\n", ( int )std::count( connected.begin(), connected.end(), 0 ),
+                     s.connections, s.socket.c_str() );
+    std::printf( "replies %zu of %d  ok %d  coalesced %d  in %.2f s  %.1f req/s\n", latencies.size(), s.requests, ok, coalesced, seconds,
+                 seconds > 0 ? latencies.size() / seconds : 0.0 );
+    std::printf( "latency ms  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f", percentile( latencies, 50 ), percentile( latencies, 90 ),
+                 percentile( latencies, 99 ), latencies.empty() ? 0.0 : latencies.back() );
+    if ( ok )
+        std::printf( "  (mean queue %.1f, search %.1f)", queued / ok, searched / ok );
+    std::printf( "\n" );
+    for ( const auto& e : errors )
+        std::printf( "error \"%s\": %d\n", e.first.c_str(), e.second );
+    return latencies.size() == ( size_t )s.requests ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// AnalysisServer.cpp : Local analysis daemon. Serves JSON-line requests (see AnalysisService.h) over a
+// Unix domain socket from one warm engine, so every client shares its transposition table.
+//
+//   analysis_server --socket /tmp/chess-analysis.sock --workers 4 --option Hash=512
+//   analysis_server --engine Engine1 --option PawnHash=1024
+//
+// Each connection may pipeline any number of requests; replies come back as searches finish, not in
+// request order, so clients match them by id. Identical requests from any connections share one
+// search. SIGINT / SIGTERM stop accepting, answer queued requests with an error, let running
+// searches finish, and remove the socket file.
+
+#include "../chessnative2/AnalysisService.h"
+#include "../chessnative2/EngineRegistry.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+const char* const kDefaultSocket = "/tmp/chess-analysis.sock";
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal( int )
+{
+    g_stop = 1;
+}
+
+// One client. Replies are written by whichever worker finishes a search, so writes are serialised;
+// the descriptor is closed when the reader and every outstanding reply are done with it.
+struct Connection
+{
+    int fd;
+    std::mutex write_lock;
+    std::atomic< bool > finished{ false }; // reader thread returned
+
+    explicit Connection( int f ) : fd( f ) {}
+    ~Connection() { close( fd ); }
+
+    void send_line( std::string line )
+    {
+        line.push_back( '\n' );
+        std::lock_guard< std::mutex > held( write_lock );
+        size_t sent = 0;
+        while ( sent < line.size() )
+        {
+            ssize_t n = send( fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL );
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n <= 0 )
+                return; // client went away; the search result is simply dropped
+            sent += ( size_t )n;
+        }
+    }
+};
+
+void serve( std::shared_ptr< Connection > conn, engine::AnalysisService& service )
+{
+    std::string pending;
+    char buf[ 4096 ];
+    for ( ;; )
+    {
+        ssize_t n = recv( conn->fd, buf, sizeof( buf ), 0 );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            break;
+        pending.append( buf, ( size_t )n );
+        size_t start = 0, nl;
+        while ( ( nl = pending.find( '\n', start ) ) != std::string::npos )
+        {
+            std::string line = pending.substr( start, nl - start );
+            start = nl + 1;
+            if ( line.find_first_not_of( " \t\r" ) == std::string::npos )
+                continue;
+            engine::AnalysisRequest request;
+            std::string error;
+            if ( !engine::parse_request( line, request, error ) )
+            {
+                engine::AnalysisReply reply;
+                reply.id = request.id;
+                reply.error = error;
+                conn->send_line( engine::format_reply( reply ) );
+                continue;
+            }
+            service.submit( request, [ conn ]( const engine::AnalysisReply& reply ) { conn->send_line( engine::format_reply( reply ) ); } );
+        }
+        pending.erase( 0, start );
+        if ( pending.size() > ( 1 << 20 ) )
+            break; // no newline in a megabyte: not a JSON-line client
+    }
+    shutdown( conn->fd, SHUT_RD );
+    conn->finished = true;
+}
+
+void usage()
+{
+    std::printf( "usage: analysis_server [--socket PATH] [--engine NAME] [--workers N] [--option NAME=VALUE]...\n"
+                 "default socket %s, one worker per hardware thread\nengines:",
+                 kDefaultSocket );
+    for ( const auto& e : engine::engine_registry() )
+        std::printf( " %s", e.name );
+    std::printf( "\n" );
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    const engine::EngineInfo* info = &engine::default_engine();
+    std::string path = kDefaultSocket;
+    int workers = ( int )std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector< std::pair< std::string, std::string > > options;
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        if ( a == "--socket" && i + 1 < argc )
+            path = argv[ ++i ];
+        else if ( a == "--engine" && i + 1 < argc && ( info = engine::find_engine( argv[ ++i ] ) ) )
+            continue;
+        else if ( a == "--workers" && i + 1 < argc )
+            workers = std::max( 1, std::atoi( argv[ ++i ] ) );
+        else if ( a == "--option" && i + 1 < argc )
+        {
+            std::string kv = argv[ ++i ];
+            size_t eq = kv.find( '=' );
+            options.emplace_back( kv.substr( 0, eq ), eq == std::string::npos ? std::string() : kv.substr( eq + 1 ) );
+        }
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+
+    std::shared_ptr< engine::EngineBase > eng( info->create() );
+    for ( const auto& kv : options )
+    {
+        if ( !eng->set_option( kv.first, kv.second ) )
+        {
+            std::fprintf( stderr, "cannot set option %s to %s\n", kv.first.c_str(), kv.second.c_str() );
+            return 1;
+        }
+    }
+    // Allocate the transposition table and caches now rather than in the first client's request.
+    eng->multipv( "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 1, 1 );
+
+    sockaddr_un addr;
+    std::memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof( addr.sun_path ) )
+    {
+        std::fprintf( stderr, "socket path too long: %s\n", path.c_str() );
+        return 1;
+    }
+    std::strcpy( addr.sun_path, path.c_str() );
+    int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+    unlink( path.c_str() ); // a socket file left by a server that did not shut down cleanly
+    if ( listener < 0 || bind( listener, ( sockaddr* )&addr, sizeof( addr ) ) != 0 || listen( listener, 64 ) != 0 )
+    {
+        std::fprintf( stderr, "cannot listen on %s: %s\n", path.c_str(), std::strerror( errno ) );
+        return 1;
+    }
+    std::signal( SIGINT, on_signal );
+    std::signal( SIGTERM, on_signal );
+    std::signal( SIGPIPE, SIG_IGN );
+    std::fprintf( stderr, "%s serving %s with %d workers\n", info->name, path.c_str(), workers );
+
+    struct Client
+    {
+        std::shared_ptr< Connection > conn;
+        std::thread reader;
+    };
+    std::vector< Client > clients;
+    {
+        engine::AnalysisService service( eng, workers );
+        while ( !g_stop )
+        {
+            pollfd p = { listener, POLLIN, 0 };
+            if ( poll( &p, 1, 200 ) <= 0 )
+                continue;
+            int fd = accept( listener, nullptr, nullptr );
+            if ( fd < 0 )
+                continue;
+            for ( size_t c = 0; c < clients.size(); )
+            {
+                if ( clients[ c ].conn->finished )
+                {
+                    clients[ c ].reader.join();
+                    if ( c + 1 < clients.size() )
+                        clients[ c ] = std::move( clients.back() );
+                    clients.pop_back();
+                }
+                else
+                    ++c;
+            }
+            auto conn = std::make_shared< Connection >( fd );
+            clients.push_back( { conn, std::thread( serve, conn, std::ref( service ) ) } );
+        }
+        close( listener );
+        unlink( path.c_str() );
+        // Readers stop submitting before the service answers what is still queued.
+        for ( auto& c : clients )
+        {
+            shutdown( c.conn->fd, SHUT_RD );
+            c.reader.join();
+        }
+        engine::AnalysisServiceStats s = service.stats();
+        std::fprintf( stderr, "requests %llu  searches %llu  coalesced %llu  expired %llu  rejected %llu  queued at exit %zu\n",
+                      ( unsigned long long )s.requests, ( unsigned long long )s.searches, ( unsigned long long )s.coalesced,
+                      ( unsigned long long )s.expired, ( unsigned long long )s.rejected, s.queued );
+    }
+    return 0;
+}
@@ -1,6 +1,10 @@
 // This file contains the implementation of the controller for the chess game.
 #include "../chessnative2/EngineBase.h"
+#include "../chessnative2/Pgn.h"
+#include "../chessnative2/Zobrist.h"
 #include "Control.hpp"
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include <algorithm>
@@ -23,21 +27,57 @@ GameController::GameController(engine::EngineBase& _engine) : eng(&_engine){
 }
 
 void GameController::set_engine(engine::EngineBase& _engine){
+    search.reset();
     eng = &_engine; // keep current position, no reset
+    sync_engine_history();
 }
 
 void GameController::reset(){
     const char* startFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    search.reset();
     currentFEN = startFEN;
     parse_board_portion(currentFEN, boardSquares);
     whiteToMove = true;
     fullmoveNumber = 1;
-    fenHistory.clear();
-    fenHistory.push_back(currentFEN);
-    pgnString.clear();
+    gameRecord.reset(currentFEN);
+    keyHistory.clear();
+    keyHistory.push_back(engine::zobrist_hash_fen(currentFEN));
+    pgnString.clear(); pgnStale = false;
+    if(eng) eng->new_game();
+    sync_engine_history();
 }
 
 bool GameController::load_fen(const std::string& fen){
+    if(!set_position(fen)) return false;
+    search.reset();
+    gameRecord.reset(currentFEN);
+    keyHistory.clear(); keyHistory.push_back(engine::zobrist_hash_fen(currentFEN));
+    pgnString.clear(); pgnStale = false;
+    if(eng) eng->new_game();
+    sync_engine_history();
+    return true;
+}
+
+bool GameController::load_record(const std::vector<uint8_t>& bytes){
+    GameRecord rec;
+    if(!eng || !GameRecord::deserialize(bytes.data(), bytes.size(), rec)) return false;
+    std::vector<std::string> fens = rec.fens(*eng);
+    if(fens.size() != rec.size()+1 || fens.back().empty() || !set_position(fens.back())) return false;
+    search.reset();
+    gameRecord = rec;
+    keyHistory.clear(); for(const std::string& f : fens) keyHistory.push_back(engine::zobrist_hash_fen(f));
+    pgnStale = true;
+    eng->new_game();
+    sync_engine_history();
+    return true;
+}
+
+std::vector<std::string> GameController::fen_history() const{
+    return eng? gameRecord.fens(*eng) : std::vector<std::string>(1, gameRecord.start_fen());
+}
+
+// Board, side and move number from a FEN; history is left to the caller.
+bool GameController::set_position(const std::string& fen){
     // Basic token parsing similar to main.cpp
     std::istringstream iss(fen); std::vector<std::string> tokens; std::string tk; while(iss >> tk) tokens.push_back(tk);
     if(tokens.size() < 2) return false;
@@ -48,11 +88,14 @@ bool GameController::load_fen(const std::string& fen){
     for(int i=(int)tokens.size()-1;i>=0;--i){ bool digits = !tokens[i].empty() && std::all_of(tokens[i].begin(), tokens[i].end(), [](char c){ return std::isdigit((unsigned char)c); }); if(digits){ newFull = std::atoi(tokens[i].c_str()); break; } }
     fullmoveNumber = newFull;
     currentFEN = fen;
-    fenHistory.clear(); fenHistory.push_back(currentFEN);
-    pgnString.clear();
     return true;
 }
 
+void GameController::sync_engine_history(){
+    if(!eng || keyHistory.empty()) return;
+    eng->set_game_history(std::vector<uint64_t>(keyHistory.begin(), keyHistory.end() - 1));
+}
+
 std::string GameController::flip_fen(const std::string& fen){
     // Manual FEN flip (ranks reversed, piece colors swapped). TODO: adjust castling rights and en-passant square precisely.
     std::istringstream iss(fen); std::vector<std::string> tokens; std::string t; while(iss >> t) tokens.push_back(t);
@@ -72,28 +115,55 @@ std::string GameController::flip_fen(const std::string& fen){
 }
 
 bool GameController::undo(){
-    if(fenHistory.size() < 2) return false;
-    fenHistory.pop_back();
-    std::string prev = fenHistory.back();
-    return load_fen(prev);
+    if(gameRecord.empty() || !eng) return false;
+    search.reset();
+    gameRecord.pop();
+    if(!keyHistory.empty()) keyHistory.pop_back();
+    pgnStale = true;
+    // Keep the earlier history so repetitions are still seen after taking a move back.
+    bool ok = set_position(gameRecord.fen_at(gameRecord.size(), *eng));
+    sync_engine_history();
+    return ok;
 }
 
 std::vector<std::string> GameController::legal_moves_uci(){ return eng? eng->legal_moves_uci(currentFEN): std::vector<std::string>(); }
 
 std::string GameController::engine_move(int depth){
     if(!whiteToMove || !eng) return std::string(); // _engine only plays white per current design
+    search.reset();
+    auto start = std::chrono::steady_clock::now();
     std::string mv = eng->choose_move(currentFEN, depth);
-    if(!mv.empty()){
-        std::string san = build_san(mv);
-        if(!san.empty()){ if(!pgnString.empty()) pgnString += ' '; pgnString += std::to_string(fullmoveNumber) + '.' + san; }
-        apply_uci_move_to_board(mv);
-        whiteToMove = false; // switch to black
-        // fullmove increments after black move, so not here
-        push_fen();
-    }
+    play_engine_move(mv, start);
     return mv;
 }
 
+bool GameController::start_engine_move(int depth){
+    if(!whiteToMove || !eng) return false;
+    searchStart = std::chrono::steady_clock::now();
+    search = eng->start_search(currentFEN, depth);
+    return true;
+}
+
+bool GameController::step_engine_move(uint64_t max_us, std::string& played, std::vector<std::pair<std::string,int>>* root_scores){
+    if(!search || !search->advance(0, max_us)) return false;
+    std::unique_ptr<engine::SlicedSearch> done = std::move(search);
+    played = done->best_move();
+    if(root_scores) *root_scores = done->root_scores();
+    play_engine_move(played, searchStart);
+    return true;
+}
+
+void GameController::play_engine_move(const std::string& mv, std::chrono::steady_clock::time_point start){
+    if(mv.empty()) return;
+    append_pgn(build_san(mv), true, fullmoveNumber);
+    std::string next = eng->apply_move(currentFEN, mv);
+    apply_uci_move_to_board(mv);
+    whiteToMove = false; // switch to black
+    // fullmove increments after black move, so not here
+    push_move(mv, next);
+    gameRecord.annotate(gameRecord.size()-1, GameRecord::kNoEval, (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count());
+}
+
 bool GameController::apply_human_move(const std::string& uci){
     if(whiteToMove || !eng) return false; // human is black
     // Validate move is in legal list
@@ -101,12 +171,12 @@ bool GameController::apply_human_move(const std::string& uci){
     std::string found;
     for(auto &m: moves){ if(m.rfind(uci,0)==0){ found=m; break; } }
     if(found.empty()) return false;
-    std::string san = build_san(found);
-    if(!san.empty()){ if(!pgnString.empty()) pgnString += ' '; pgnString += san; }
+    append_pgn(build_san(found), false, fullmoveNumber);
+    std::string next = eng->apply_move(currentFEN, found);
     apply_uci_move_to_board(found);
     whiteToMove = true;
     fullmoveNumber++; // after black move
-    push_fen();
+    push_move(found, next);
     return true;
 }
 
@@ -120,15 +190,48 @@ std::string GameController::build_fen() const{
 std::string GameController::index_to_alg(int idx) const{ int f=idx%8; int r=idx/8; return std::string(1,char('a'+f))+char('1'+r); }
 int GameController::algebraic_to_index(const char* s) const{ if(!s||s[0]<'a'||s[0]>'h'||s[1]<'1'||s[1]>'8') return -1; int file=s[0]-'a'; int rank=s[1]-'1'; return rank*8+file; }
 
-void GameController::apply_uci_move_to_board(const std::string& uci){ if(uci.size()<4) return; int from=algebraic_to_index(uci.c_str()); int to=algebraic_to_index(uci.c_str()+2); if(from<0||to<0) return; char piece=boardSquares[from]; if(piece=='.') return; boardSquares[from]='.'; if(uci.size()>=5){ char p=uci[4]; if(piece>='A'&&piece<='Z') p=(char)toupper((unsigned char)p); boardSquares[to]=p; } else { boardSquares[to]=piece; }
-    if(piece=='K'){ if(uci=="e1g1"){ boardSquares[5]='R'; boardSquares[7]='.'; } else if(uci=="e1c1"){ boardSquares[3]='R'; boardSquares[0]='.'; } }
-    else if(piece=='k'){ if(uci=="e8g8"){ boardSquares[61]='r'; boardSquares[63]='.'; } else if(uci=="e8c8"){ boardSquares[59]='r'; boardSquares[56]='.'; } }
+// Castling is either the king moving two files (e1g1) or, for Chess960, the king taking its own rook (e1h1).
+static bool is_castling(const char board[64], int from, int to){ char piece=board[from]; if(piece!='K'&&piece!='k') return false; char rook = piece=='K'? 'R' : 'r'; return board[to]==rook || (from/8==to/8 && std::abs(to-from)==2); }
+
+void GameController::apply_uci_move_to_board(const std::string& uci){ if(uci.size()<4) return; int from=algebraic_to_index(uci.c_str()); int to=algebraic_to_index(uci.c_str()+2); if(from<0||to<0) return; char piece=boardSquares[from]; if(piece=='.') return;
+    if(is_castling(boardSquares, from, to)){ char rook = piece=='K'? 'R' : 'r'; int rank=from/8*8; bool kingside = to>from; int rookFrom = boardSquares[to]==rook ? to : rank + (kingside? 7 : 0); boardSquares[from]='.'; boardSquares[rookFrom]='.'; boardSquares[rank + (kingside? 6 : 2)]=piece; boardSquares[rank + (kingside? 5 : 3)]=rook; return; }
+    boardSquares[from]='.'; if(uci.size()>=5){ char p=uci[4]; if(piece>='A'&&piece<='Z') p=(char)toupper((unsigned char)p); boardSquares[to]=p; } else { boardSquares[to]=piece; }
 }
 
-std::string GameController::build_san(const std::string& uci) const{
-    if(uci.size()<4) return std::string(); int from=algebraic_to_index(uci.c_str()); char piece = (from>=0)? boardSquares[from] : '.'; bool isPawn = (piece=='P'||piece=='p'); std::string toSq = uci.substr(2,2); std::string san; if(!isPawn){ san.push_back((char)toupper((unsigned char)piece)); san += toSq; } else { san += toSq; if(uci.size()==5) san.push_back((char)toupper((unsigned char)uci[4])); } return san; }
+// Full SAN from the engine side (disambiguation, captures, checks); needs the position, not just the board.
+std::string GameController::build_san(const std::string& uci) const{ return engine::to_san(currentFEN, uci); }
 
-void GameController::push_fen(){ currentFEN = build_fen(); fenHistory.push_back(currentFEN); }
+// White moves carry the move number ("12.Nf3"), black moves follow bare.
+void GameController::append_pgn(const std::string& san, bool white, int fullmove) const{
+    if(san.empty()) return;
+    if(!pgnString.empty()) pgnString += ' ';
+    if(white) pgnString += std::to_string(fullmove) + '.';
+    pgnString += san;
+}
+
+const std::string& GameController::pgn() const{
+    if(!pgnStale) return pgnString;
+    // An undo cannot cut the text back, so it is rebuilt by replaying the record once.
+    pgnString.clear(); pgnStale = false;
+    if(!eng) return pgnString;
+    std::vector<std::string> fens = gameRecord.fens(*eng);
+    for(size_t i=0; i<gameRecord.size() && i+1<fens.size(); ++i){
+        std::vector<std::string> tokens = splitStringBySpace(fens[i]);
+        bool white = tokens.size()<2 || tokens[1]=="w";
+        int fullmove = tokens.size()>=6? std::atoi(tokens[5].c_str()) : 1;
+        append_pgn(engine::to_san(fens[i], gameRecord.uci_at(i)), white, fullmove);
+    }
+    return pgnString;
+}
+
+// Prefer the engine's FEN: it carries the castling rights, en-passant square and halfmove clock
+// that repetition detection depends on. build_fen() is only a fallback.
+void GameController::push_move(const std::string& uci, const std::string& next){
+    if(next.empty() || !set_position(next)) currentFEN = build_fen();
+    gameRecord.push(uci, currentFEN);
+    keyHistory.push_back(engine::zobrist_hash_fen(currentFEN));
+    sync_engine_history();
+}
 
 // Implement static utility methods
 std::vector<std::string> GameController::splitStringBySpace(const std::string& s) {
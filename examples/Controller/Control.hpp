@@ -2,7 +2,10 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <chrono>
+#include <memory>
 #include "../chessnative2/EngineBase.h" // use shared abstract base
+#include "GameRecord.hpp"
 
 namespace controller {
 
@@ -12,18 +15,36 @@ class GameController {
 public:
     explicit GameController(engine::EngineBase& engine);
     void set_engine(engine::EngineBase& engine);
+    // reset() and load_fen() start a new game: the engine also drops its search tables (EngineBase::new_game).
     void reset();
     bool load_fen(const std::string& fen);
+    // Replaces the game with a serialized GameRecord and moves to its last position; false if it does not replay.
+    bool load_record(const std::vector<uint8_t>& bytes);
     bool undo();
     const std::string& current_fen() const { return currentFEN; }
     bool white_to_move() const { return whiteToMove; }
     int fullmove_number() const { return fullmoveNumber; }
-    const std::vector<std::string>& fen_history() const { return fenHistory; }
-    const std::string& pgn() const { return pgnString; }
+    // The moves played since reset()/load_fen(), with the engine's thinking time on its moves.
+    const GameRecord& record() const { return gameRecord; }
+    // Every position of the game, replayed from the record (FENs are not stored).
+    std::vector<std::string> fen_history() const;
+    // Zobrist key of every position in fen_history(); all but the last are handed to the engine for repetition checks.
+    const std::vector<uint64_t>& key_history() const { return keyHistory; }
+    // Move text of the game, appended as moves are made and rebuilt from the record after an undo.
+    const std::string& pgn() const;
 
     std::vector<std::string> legal_moves_uci();
     std::vector<std::string> legal_moves() { return legal_moves_uci(); }
     std::string engine_move(int depth);
+    // engine_move a slice at a time, for a frame loop that must not block (the browser build has no
+    // thread to search on). start_engine_move begins the search; each step_engine_move runs at most
+    // max_us microseconds of it and, once it has finished, plays the move as engine_move does and
+    // returns true with it in played (empty if the engine had none) and, when the engine's search
+    // produced them, every root move's score in root_scores. Anything that changes the position or
+    // the engine drops an unfinished search.
+    bool start_engine_move(int depth);
+    bool step_engine_move(uint64_t max_us, std::string& played, std::vector<std::pair<std::string,int>>* root_scores = nullptr);
+    bool engine_thinking() const { return search != nullptr; }
     bool apply_human_move(const std::string& uci);
 
     const char* board() const { return boardSquares; }
@@ -39,16 +60,25 @@ private:
     bool whiteToMove = true;
     int fullmoveNumber = 1;
     std::string currentFEN;
-    std::vector<std::string> fenHistory;
-    std::string pgnString;
+    GameRecord gameRecord;
+    std::vector<uint64_t> keyHistory;
+    mutable std::string pgnString;
+    mutable bool pgnStale = false;
+    std::unique_ptr<engine::SlicedSearch> search; // the engine's move being searched a slice at a time
+    std::chrono::steady_clock::time_point searchStart;
 
     void parse_board_from_fen(const std::string& fen);
+    bool set_position(const std::string& fen);
+    void sync_engine_history();
     std::string build_fen() const;
     std::string index_to_alg(int idx) const;
     int algebraic_to_index(const char* s) const;
     void apply_uci_move_to_board(const std::string& uci);
     std::string build_san(const std::string& uci) const;
-    void push_fen();
+    void append_pgn(const std::string& san, bool white, int fullmove) const;
+    void push_move(const std::string& uci, const std::string& next);
+    // The engine's (white's) move, annotated with the time since start.
+    void play_engine_move(const std::string& uci, std::chrono::steady_clock::time_point start);
 };
 
 } // namespace controller
@@ -0,0 +1,109 @@
+#include "GameRecord.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace controller {
+
+const size_t GameRecord::kKeyframeInterval;
+const int16_t GameRecord::kNoEval;
+const uint32_t GameRecord::kNoTime;
+
+uint16_t GameRecord::encode(const std::string& uci){
+    if(uci.size()<4) return 0;
+    int from=(uci[0]-'a')+8*(uci[1]-'1'); int to=(uci[2]-'a')+8*(uci[3]-'1');
+    int promo=0; if(uci.size()>=5){ const char* p=std::strchr("nbrq", uci[4]); promo = p? int(p-"nbrq")+1 : 0; }
+    return (uint16_t)(from | (to<<6) | (promo<<12));
+}
+
+std::string GameRecord::decode(uint16_t m){
+    int from=m&63, to=(m>>6)&63, promo=(m>>12)&7;
+    std::string s; s.push_back(char('a'+from%8)); s.push_back(char('1'+from/8)); s.push_back(char('a'+to%8)); s.push_back(char('1'+to/8));
+    if(promo>=1 && promo<=4) s.push_back("nbrq"[promo-1]);
+    return s;
+}
+
+void GameRecord::reset(const std::string& start_fen){
+    moves.clear(); evals.clear(); times.clear();
+    keyframes.assign(1, start_fen);
+}
+
+void GameRecord::push(const std::string& uci, const std::string& fen_after){
+    moves.push_back(encode(uci));
+    if(!evals.empty()) evals.push_back(kNoEval);
+    if(!times.empty()) times.push_back(kNoTime);
+    if(moves.size()%kKeyframeInterval==0){ keyframes.resize(moves.size()/kKeyframeInterval+1); keyframes.back()=fen_after; }
+}
+
+void GameRecord::pop(){
+    if(moves.empty()) return;
+    if(moves.size()%kKeyframeInterval==0) keyframes.resize(std::min(keyframes.size(), moves.size()/kKeyframeInterval));
+    moves.pop_back();
+    if(!evals.empty()) evals.pop_back();
+    if(!times.empty()) times.pop_back();
+}
+
+void GameRecord::annotate(size_t ply, int eval_cp, uint32_t time_ms){
+    if(ply>=moves.size()) return;
+    if(eval_cp!=kNoEval){ if(evals.empty()) evals.assign(moves.size(), kNoEval); evals[ply]=(int16_t)std::max(-32767, std::min(32767, eval_cp)); }
+    if(time_ms!=kNoTime){ if(times.empty()) times.assign(moves.size(), kNoTime); times[ply]=time_ms; }
+}
+
+std::string GameRecord::fen_at(size_t ply, engine::EngineBase& rules) const{
+    if(ply>moves.size()) return std::string();
+    size_t k=std::min(ply/kKeyframeInterval, keyframes.size()-1);
+    while(keyframes[k].empty()) --k;
+    std::string fen=keyframes[k];
+    for(size_t i=k*kKeyframeInterval; i<ply && !fen.empty(); ){
+        fen=rules.apply_move(fen, decode(moves[i]));
+        // Keyframes left out by deserialize() are filled in on the way past.
+        if(++i%kKeyframeInterval==0 && !fen.empty()){ size_t slot=i/kKeyframeInterval; if(keyframes.size()<=slot) keyframes.resize(slot+1); keyframes[slot]=fen; }
+    }
+    return fen;
+}
+
+std::vector<std::string> GameRecord::fens(engine::EngineBase& rules) const{
+    std::vector<std::string> out; out.reserve(moves.size()+1);
+    out.push_back(start_fen());
+    for(size_t i=0; i<moves.size() && !out.back().empty(); ++i) out.push_back(rules.apply_move(out.back(), decode(moves[i])));
+    return out;
+}
+
+static void put(std::vector<uint8_t>& out, uint64_t v, int bytes){ for(int i=0;i<bytes;++i) out.push_back(uint8_t(v>>(8*i))); }
+static uint64_t get(const uint8_t* p, int bytes){ uint64_t v=0; for(int i=0;i<bytes;++i) v |= uint64_t(p[i])<<(8*i); return v; }
+
+std::vector<uint8_t> GameRecord::serialize() const{
+    std::vector<uint8_t> out;
+    const std::string& fen=start_fen();
+    out.reserve(4+2+fen.size()+4+1+moves.size()*(2+(evals.empty()?0:2)+(times.empty()?0:4)));
+    out.insert(out.end(), { 'C','G','R','1' });
+    put(out, fen.size(), 2); out.insert(out.end(), fen.begin(), fen.end());
+    put(out, moves.size(), 4);
+    put(out, (evals.empty()?0:1) | (times.empty()?0:2), 1);
+    for(uint16_t m : moves) put(out, m, 2);
+    for(int16_t e : evals) put(out, (uint16_t)e, 2);
+    for(uint32_t t : times) put(out, t, 4);
+    return out;
+}
+
+bool GameRecord::deserialize(const uint8_t* data, size_t size, GameRecord& out){
+    if(size<6 || std::memcmp(data, "CGR1", 4)!=0) return false;
+    size_t pos=4; size_t fenLen=(size_t)get(data+pos, 2); pos+=2;
+    if(size<pos+fenLen+5) return false;
+    std::string fen((const char*)data+pos, fenLen); pos+=fenLen;
+    size_t n=(size_t)get(data+pos, 4); pos+=4; int flags=data[pos++];
+    size_t need=n*(2+((flags&1)?2:0)+((flags&2)?4:0));
+    if(size-pos<need) return false;
+    out.reset(fen);
+    out.moves.resize(n); for(size_t i=0;i<n;++i,pos+=2) out.moves[i]=(uint16_t)get(data+pos, 2);
+    if(flags&1){ out.evals.resize(n); for(size_t i=0;i<n;++i,pos+=2) out.evals[i]=(int16_t)(uint16_t)get(data+pos, 2); }
+    if(flags&2){ out.times.resize(n); for(size_t i=0;i<n;++i,pos+=4) out.times[i]=(uint32_t)get(data+pos, 4); }
+    return true;
+}
+
+size_t GameRecord::memory_bytes() const{
+    size_t bytes=moves.capacity()*sizeof(uint16_t)+evals.capacity()*sizeof(int16_t)+times.capacity()*sizeof(uint32_t)+keyframes.capacity()*sizeof(std::string);
+    for(const std::string& k : keyframes) bytes += k.capacity();
+    return bytes;
+}
+
+} // namespace controller
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../chessnative2/EngineBase.h"
+
+namespace controller {
+
+// A game as its start position plus one 16-bit move per ply, with optional per-move eval and time.
+// Positions are not stored; fen_at() replays moves through the engine's rules from the nearest
+// keyframe, a FEN kept every kKeyframeInterval plies, so seeking costs at most that many moves.
+// Keyframes are a cache: serialize() leaves them out and fen_at() rebuilds them as it goes.
+class GameRecord {
+public:
+    static const size_t kKeyframeInterval = 16;
+    static const int16_t kNoEval = INT16_MIN;
+    static const uint32_t kNoTime = UINT32_MAX;
+
+    // from | to << 6 | promotion << 12 (1..4 = n b r q); castling is kept in the notation given.
+    static uint16_t encode(const std::string& uci);
+    static std::string decode(uint16_t move);
+
+    void reset(const std::string& start_fen);
+    const std::string& start_fen() const { return keyframes.front(); }
+    size_t size() const { return moves.size(); }
+    bool empty() const { return moves.empty(); }
+
+    // fen_after is the position the move leads to; it becomes a keyframe when the ply count calls for one.
+    void push(const std::string& uci, const std::string& fen_after);
+    void pop();
+    uint16_t move_at(size_t ply) const { return moves[ply]; }
+    std::string uci_at(size_t ply) const { return decode(moves[ply]); }
+
+    // Eval in centipawns from the mover's point of view and thinking time; either may be left unset.
+    void annotate(size_t ply, int eval_cp, uint32_t time_ms);
+    int16_t eval_at(size_t ply) const { return evals.empty() ? kNoEval : evals[ply]; }
+    uint32_t time_at(size_t ply) const { return times.empty() ? kNoTime : times[ply]; }
+
+    // Position after the first ply moves (0 = start). Empty if a stored move does not apply.
+    std::string fen_at(size_t ply, engine::EngineBase& rules) const;
+    // Every position from the start to the end, replayed once.
+    std::vector<std::string> fens(engine::EngineBase& rules) const;
+
+    // "CGR1", start FEN, ply count, flags, then the move, eval and time arrays, little-endian.
+    std::vector<uint8_t> serialize() const;
+    static bool deserialize(const uint8_t* data, size_t size, GameRecord& out);
+    // Heap bytes held, keyframes included.
+    size_t memory_bytes() const;
+
+private:
+    std::vector<uint16_t> moves;
+    std::vector<int16_t> evals;  // empty until the first eval is recorded
+    std::vector<uint32_t> times; // empty until the first time is recorded
+    // keyframes[k] is the FEN after k * kKeyframeInterval plies; [0] is the start, "" not yet rebuilt.
+    mutable std::vector<std::string> keyframes{ std::string() };
+};
+
+} // namespace controller
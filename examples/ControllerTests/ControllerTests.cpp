@@ -2,6 +2,7 @@
 #include "../Controller/Control.hpp"
 #include "../chessnative2/ChessEngine1.hpp"
 #include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/Zobrist.h"
 #include <map>
 #include <algorithm>
 #include <sstream>
@@ -147,15 +148,86 @@ namespace ControllerTests
             Assert::IsTrue(f3e5 >= worstNonCapture, L"Knight capture f3e5 should not evaluate worse than retreats");
             Assert::IsTrue(f3e5 - worstNonCapture >= -20, L"Evaluation spread too inverted for knight moves");
         }
+        template<typename EngineT>
+        static void HistoryFeedsEngineGeneric() {
+            EngineT engine; controller::GameController game(engine);
+            std::string mv = game.engine_move(1); Assert::IsFalse(mv.empty(), L"Engine produced no move");
+            auto replies = game.legal_moves_uci(); Assert::IsFalse(replies.empty(), L"Black has no replies");
+            Assert::IsTrue(game.apply_human_move(replies[0]));
+            Assert::AreEqual(game.fen_history().size(), game.key_history().size(), L"Key history out of step with FEN history");
+            Assert::IsTrue(engine.get_game_history() == std::vector<uint64_t>(game.key_history().begin(), game.key_history().end() - 1), L"Engine history not synced");
+            Assert::IsTrue(game.undo());
+            Assert::AreEqual((size_t)2, game.key_history().size(), L"Undo should only drop the last position");
+            Assert::IsTrue(engine::zobrist_hash_fen(game.current_fen()) == game.key_history().back(), L"Key does not match current FEN");
+            Assert::AreEqual((size_t)1, engine.get_game_history().size(), L"Engine history not resynced after undo");
+        }
+        template<typename EngineT>
+        static void GameRecordReplaysHistoryGeneric() {
+            // Long enough to pass several keyframes; positions are replayed, so compare them with the ones seen live.
+            EngineT engine; controller::GameController game(engine);
+            std::vector<std::string> seen(1, game.current_fen()); std::vector<std::string> pgns(1, game.pgn());
+            for(int ply=0; ply<40; ++ply){
+                if(game.white_to_move()) { if(game.engine_move(1).empty()) break; }
+                else { auto replies = game.legal_moves_uci(); if(replies.empty() || !game.apply_human_move(replies[ply % replies.size()])) break; }
+                seen.push_back(game.current_fen()); pgns.push_back(game.pgn());
+            }
+            const controller::GameRecord& rec = game.record();
+            Assert::AreEqual(seen.size() - 1, rec.size());
+            Assert::IsTrue(seen == game.fen_history(), L"Replayed history differs from the positions played");
+            for(size_t i = seen.size(); i-- > 0; ) Assert::AreEqual(seen[i], rec.fen_at(i, engine), L"Seek from keyframe gave the wrong position");
+            Assert::IsTrue(rec.time_at(0) != controller::GameRecord::kNoTime, L"Engine move time not recorded");
+
+            controller::GameController copy(engine);
+            Assert::IsTrue(copy.load_record(rec.serialize()));
+            Assert::AreEqual(game.current_fen(), copy.current_fen());
+            Assert::IsTrue(game.key_history() == copy.key_history(), L"Keys not rebuilt from the record");
+            Assert::AreEqual(game.pgn(), copy.pgn());
+            Assert::IsTrue(copy.record().serialize() == rec.serialize(), L"Record does not round-trip");
+            Assert::IsFalse(copy.load_record(std::vector<uint8_t>{ 'C', 'G', 'R' }), L"Truncated record accepted");
+
+            for(size_t back = 1; back <= 20; ++back){
+                Assert::IsTrue(game.undo());
+                Assert::AreEqual(seen[seen.size() - 1 - back], game.current_fen(), L"Undo did not restore the earlier position");
+                Assert::AreEqual(pgns[pgns.size() - 1 - back], game.pgn(), L"Undo did not cut the move text back");
+            }
+        }
+        template<typename EngineT>
+        static void SlicedEngineMoveGeneric(bool slices) {
+            const std::string fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+            EngineT blocking, sliced; controller::GameController whole(blocking), game(sliced);
+            Assert::IsTrue(whole.load_fen(fen) && game.load_fen(fen));
+            std::string expected = whole.engine_move(3);
+            Assert::IsTrue(game.start_engine_move(3) && game.engine_thinking());
+            std::string played; std::vector<std::pair<std::string,int>> scores; int steps = 1;
+            while(!game.step_engine_move(1, played, &scores)) { Assert::IsTrue(game.white_to_move(), L"Move played before the search finished"); ++steps; }
+            Assert::AreEqual(expected, played);
+            Assert::AreEqual(whole.current_fen(), game.current_fen());
+            Assert::IsFalse(game.engine_thinking());
+            Assert::IsTrue(game.record().time_at(0) != controller::GameRecord::kNoTime, L"Engine move time not recorded");
+            if(slices) Assert::IsTrue(steps > 1 && !scores.empty(), L"Search ran in one slice");
+            else Assert::AreEqual(1, steps);
+            // A new game drops the search under way.
+            Assert::IsTrue(game.load_fen(fen) && game.start_engine_move(3));
+            game.step_engine_move(1, played);
+            game.reset();
+            Assert::IsFalse(game.engine_thinking());
+            Assert::IsFalse(game.step_engine_move(0, played));
+        }
     public:
         TEST_METHOD(QueenShouldAvoidLosingTrade) { QueenShouldAvoidLosingTradeGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(HistoryFeedsEngine) { HistoryFeedsEngineGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(KnightShouldCaptureFreePawnMaterialScoresDepth4) { KnightShouldCaptureFreePawnMaterialScoresDepth4Generic<engine::ChessEngine1>(); }
+        TEST_METHOD(GameRecordReplaysHistory) { GameRecordReplaysHistoryGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(SlicedEngineMove) { SlicedEngineMoveGeneric<engine::ChessEngine1>(false); }
     };
 
     TEST_CLASS(ControllerTests2)
     {
     public:
         TEST_METHOD(QueenShouldAvoidLosingTrade) { ControllerTests1::QueenShouldAvoidLosingTradeGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(HistoryFeedsEngine) { ControllerTests1::HistoryFeedsEngineGeneric<engine::ChessEngine2>(); }
         TEST_METHOD(KnightShouldCaptureFreePawnMaterialScoresDepth4) { ControllerTests1::KnightShouldCaptureFreePawnMaterialScoresDepth4Generic<engine::ChessEngine2>(); }
+        TEST_METHOD(GameRecordReplaysHistory) { ControllerTests1::GameRecordReplaysHistoryGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(SlicedEngineMove) { ControllerTests1::SlicedEngineMoveGeneric<engine::ChessEngine2>(true); }
     };
 }
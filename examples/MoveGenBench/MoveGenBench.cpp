@@ -0,0 +1,489 @@
+// MoveGenBench.cpp : Microbenchmarks for the engines' hot functions over a fixed position corpus.
+//
+// Modelled on Google Benchmark: every benchmark is calibrated until a run lasts at least
+// --min-time seconds, repeated --repetitions times, and the fastest run is reported.
+// --json writes Google-Benchmark-compatible output so results can be diffed across commits
+// (e.g. with benchmark's tools/compare.py).
+
+#include "../chessnative2/ChessEngine1.hpp"
+#include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/BatchEval.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Fixed corpus: opening, middlegame and endgame positions, both sides to move.
+// Changing this list invalidates comparisons with earlier JSON results.
+const char* const kCorpus[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "4r1k1/p1pb1ppp/Qbp1r3/8/1P6/2Pq1B2/R2P1PPP/2B2RK1 b - - 0 1",
+    "r1bq1rk1/pp4bp/2np4/2p1p1p1/P1N1P3/1P1P1NP1/1BP1QPKP/1R3R2 b - - 0 1",
+    "2r1r3/p3bk1p/1pnqpppB/3n4/3P2Q1/PB3N2/1P3PPP/3RR1K1 w - - 0 1",
+    "rnb1kb1r/1p3ppp/p5q1/4p3/3N4/4BB2/PPPQ1P1P/R3K2R w KQkq - 0 1",
+    "r1bqk2r/pppp1Npp/8/2bnP3/8/6K1/PB4PP/RN1Q3R b kq - 0 1",
+    "2kr1b1r/p1p1qp2/2p2n2/3p2pp/1P6/P1PQPP2/6PP/RNB1KB1R w KQkq - 0 12",
+    "8/2p5/7p/pP2k1pP/5pP1/8/1P2PPK1/8 w - - 0 1",
+    "8/8/4b1p1/2Bp3p/5P1P/1pK1Pk2/8/8 b - - 0 1",
+    "8/2kPR3/5q2/5N2/8/1p1P4/1p6/1K6 w - - 0 1",
+};
+const int kCorpusSize = int( sizeof( kCorpus ) / sizeof( kCorpus[ 0 ] ) );
+
+template < typename T >
+inline void do_not_optimize( const T& value )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+} // namespace
+
+namespace engine
+{
+
+// Drives the private hot paths of both engines. One "item" is one corpus position
+// (or one move for apply_move).
+struct BenchProbe
+{
+    using Move1 = ChessEngine1::Move;
+    using Move2 = ChessEngine2::Move;
+
+    struct Case1
+    {
+        std::string fen;
+        ChessEngine1::Position pos;
+        std::vector< Move1 > pseudo, legal;
+        int kingSq = -1;
+    };
+    struct Case2
+    {
+        std::string fen;
+        ChessEngine2::Context eng;
+        ChessEngine2::Snapshot snap{};
+        std::vector< Move2 > pseudo, legal;
+        int kingSq = -1;
+    };
+
+    static bool prepare( const std::string& fen, Case1& c )
+    {
+        c.fen = fen;
+        if ( !ChessEngine1::parse_fen( fen, c.pos ) )
+            return false;
+        ChessEngine1::generate_pseudo_moves( c.pos, c.pseudo );
+        ChessEngine1::filter_legal( c.pos, c.pseudo, c.legal );
+        c.kingSq = ChessEngine1::lsb_index( c.pos.sideToMove == 0 ? c.pos.bb.WK : c.pos.bb.BK );
+        return true;
+    }
+    static bool prepare( const std::string& fen, Case2& c )
+    {
+        c.fen = fen;
+        c.eng.loadFEN( fen );
+        c.snap = c.eng.snapshot();
+        c.eng.generatePseudoMoves( c.pseudo );
+        c.eng.filterLegal( c.pseudo, c.legal );
+        c.kingSq = c.eng.ctz64( c.eng.pieces[ 6 * c.eng.side_to_move + 5 ] );
+        return true;
+    }
+
+    // ChessEngine1
+    static size_t generate_pseudo_moves( Case1& c, std::vector< Move1 >& buf )
+    {
+        ChessEngine1::generate_pseudo_moves( c.pos, buf );
+        return buf.size();
+    }
+    static size_t filter_legal( Case1& c, std::vector< Move1 >& buf )
+    {
+        ChessEngine1::filter_legal( c.pos, c.pseudo, buf );
+        return buf.size();
+    }
+    static ChessEngine1::U64 attackers_to( Case1& c )
+    {
+        return ChessEngine1::attackers_to( c.pos, c.kingSq, c.pos.sideToMove == 0 ? 0 : 1 );
+    }
+    static ChessEngine1::U64 attack_info( Case1& c )
+    {
+        ChessEngine1::AttackInfo ai;
+        ChessEngine1::compute_attack_info( c.pos, ai );
+        return ai.bySide[ 0 ] ^ ai.bySide[ 1 ] ^ ai.pinned;
+    }
+    static ChessEngine1::U64 apply_move( Case1& c, size_t i )
+    {
+        ChessEngine1::Position out;
+        ChessEngine1::apply_move( c.pos, c.legal[ i ], out );
+        return out.bb.occAll;
+    }
+    static int parse_fen( Case1& c )
+    {
+        ChessEngine1::Position p;
+        return ChessEngine1::parse_fen( c.fen, p ) ? p.sideToMove : -1;
+    }
+    static size_t build_fen( Case1& c ) { return ChessEngine1::build_fen( c.pos ).size(); }
+    static int evaluate( Case1& c ) { return ChessEngine1::evaluate( c.pos ); }
+
+    // ChessEngine2 (state lives in its search context; mutating benchmarks restore the snapshot)
+    static size_t generate_pseudo_moves( Case2& c, std::vector< Move2 >& buf )
+    {
+        buf.clear();
+        c.eng.generatePseudoMoves( buf );
+        return buf.size();
+    }
+    static size_t filter_legal( Case2& c, std::vector< Move2 >& buf )
+    {
+        buf.clear();
+        c.eng.filterLegal( c.pseudo, buf );
+        return buf.size();
+    }
+    static bool attackers_to( Case2& c ) { return c.eng.isSquareAttacked( c.kingSq ); }
+    static uint64_t attack_info( Case2& c ) { return c.eng.enemyAttacks(); }
+    static uint64_t apply_move( Case2& c, size_t i )
+    {
+        c.eng.makeMove( c.legal[ i ] );
+        uint64_t r = c.eng.pieces[ 0 ] ^ c.eng.pieces[ 6 ];
+        c.eng.restore( c.snap );
+        return r;
+    }
+    static int parse_fen( Case2& c )
+    {
+        c.eng.loadFEN( c.fen );
+        return c.eng.side_to_move;
+    }
+    static size_t build_fen( Case2& c ) { return BoardState::buildFen( c.eng ).size(); }
+    static int evaluate( Case2& c ) { return c.eng.evaluate(); }
+};
+
+} // namespace engine
+
+namespace
+{
+
+using engine::BenchProbe;
+using engine::EvalKernel;
+using engine::LeafBatch;
+
+struct Benchmark
+{
+    std::string name;
+    // Runs one pass over the corpus and returns the number of items processed.
+    std::function< uint64_t() > pass;
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double realNs = 0; // per iteration
+    double cpuNs = 0;  // per iteration
+    double itemsPerSecond = 0;
+};
+
+struct Options
+{
+    double minTime = 0.5;
+    int repetitions = 3;
+    std::string filter;
+    std::string jsonPath;
+    std::string label;
+};
+
+template < typename CaseT, typename MoveT >
+void register_engine( const char* engineName, std::vector< CaseT >& cases, std::vector< Benchmark >& out )
+{
+    std::string suffix = std::string( "/" ) + engineName;
+    auto buf = std::make_shared< std::vector< MoveT > >();
+    buf->reserve( 256 );
+    out.push_back( { "BM_generate_pseudo_moves" + suffix, [ &cases, buf ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::generate_pseudo_moves( c, *buf ) );
+                ++items;
+            }
+            return items;
+        } } );
+    out.push_back( { "BM_filter_legal" + suffix, [ &cases, buf ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::filter_legal( c, *buf ) );
+                ++items;
+            }
+            return items;
+        } } );
+    out.push_back( { "BM_attackers_to" + suffix, [ &cases ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::attackers_to( c ) );
+                ++items;
+            }
+            return items;
+        } } );
+    out.push_back( { "BM_attack_info" + suffix, [ &cases ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::attack_info( c ) );
+                ++items;
+            }
+            return items;
+        } } );
+    out.push_back( { "BM_apply_move" + suffix, [ &cases ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+                for ( size_t i = 0; i < c.legal.size(); ++i )
+                {
+                    do_not_optimize( BenchProbe::apply_move( c, i ) );
+                    ++items;
+                }
+            return items;
+        } } );
+    out.push_back( { "BM_parse_fen" + suffix, [ &cases ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::parse_fen( c ) );
+                ++items;
+            }
+            return items;
+        } } );
+    out.push_back( { "BM_build_fen" + suffix, [ &cases ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::build_fen( c ) );
+                ++items;
+            }
+            return items;
+        } } );
+    out.push_back( { "BM_evaluate" + suffix, [ &cases ]()
+        {
+            uint64_t items = 0;
+            for ( auto& c : cases )
+            {
+                do_not_optimize( BenchProbe::evaluate( c ) );
+                ++items;
+            }
+            return items;
+        } } );
+}
+
+// Scores the corpus, repeated to fill a LeafBatch, with each batch kernel this CPU supports.
+// One item is one position scored.
+void register_batch_eval( std::vector< BenchProbe::Case2 >& cases, std::vector< Benchmark >& out )
+{
+    auto batch = std::make_shared< LeafBatch >();
+    for ( int i = 0; i < LeafBatch::kCapacity; ++i )
+        batch->add( cases[ i % cases.size() ].snap.pieces );
+    const EvalKernel kernels[] = { EvalKernel::Scalar, EvalKernel::AVX2, EvalKernel::AVX512 };
+    for ( EvalKernel k : kernels )
+    {
+        static const int values[ 6 ] = { 100, 320, 330, 500, 900, 0 };
+        auto scores = std::make_shared< std::vector< int > >( LeafBatch::kCapacity );
+        if ( !evaluate_batch_with( k, *batch, values, scores->data() ) )
+            continue;
+        out.push_back( { std::string( "BM_evaluate_batch/" ) + batch_eval_kernel_name( k ), [ batch, scores, k ]()
+            {
+                evaluate_batch_with( k, *batch, values, scores->data() );
+                do_not_optimize( ( *scores )[ 0 ] );
+                return ( uint64_t )batch->count;
+            } } );
+    }
+}
+
+// Times `iterations` passes over the corpus (wall and process CPU time).
+void time_passes( const Benchmark& b, uint64_t iterations, double& realSec, double& cpuSec, uint64_t& items )
+{
+    items = 0;
+    std::clock_t c0 = std::clock();
+    auto t0 = std::chrono::steady_clock::now();
+    for ( uint64_t i = 0; i < iterations; ++i )
+        items += b.pass();
+    auto t1 = std::chrono::steady_clock::now();
+    std::clock_t c1 = std::clock();
+    realSec = std::chrono::duration< double >( t1 - t0 ).count();
+    cpuSec = double( c1 - c0 ) / CLOCKS_PER_SEC;
+}
+
+Result run_benchmark( const Benchmark& b, const Options& opt )
+{
+    // Calibrate the iteration count the way Google Benchmark does: grow geometrically
+    // (at most 10x per step) until a run takes at least minTime.
+    uint64_t iterations = 1;
+    double realSec = 0, cpuSec = 0;
+    uint64_t items = 0;
+    for ( ;; )
+    {
+        time_passes( b, iterations, realSec, cpuSec, items );
+        if ( realSec >= opt.minTime || iterations >= ( 1ULL << 40 ) )
+            break;
+        double multiplier = realSec > 0 ? opt.minTime * 1.4 / realSec : 10.0;
+        multiplier = std::min( 10.0, std::max( 2.0, multiplier ) );
+        iterations = ( uint64_t )( double( iterations ) * multiplier );
+    }
+    Result best;
+    best.name = b.name;
+    for ( int rep = 0; rep < std::max( 1, opt.repetitions ); ++rep )
+    {
+        if ( rep > 0 )
+            time_passes( b, iterations, realSec, cpuSec, items );
+        double realNs = realSec * 1e9 / double( iterations );
+        if ( rep == 0 || realNs < best.realNs )
+        {
+            best.iterations = iterations;
+            best.realNs = realNs;
+            best.cpuNs = cpuSec * 1e9 / double( iterations );
+            best.itemsPerSecond = realSec > 0 ? double( items ) / realSec : 0.0;
+        }
+    }
+    return best;
+}
+
+std::string json_escape( const std::string& s )
+{
+    std::string o;
+    for ( char c : s )
+    {
+        if ( c == '"' || c == '\\' )
+            o.push_back( '\\' );
+        o.push_back( c );
+    }
+    return o;
+}
+
+bool write_json( const std::string& path, const Options& opt, const std::vector< Result >& results )
+{
+    FILE* f = std::fopen( path.c_str(), "w" );
+    if ( !f )
+        return false;
+    char date[ 64 ];
+    std::time_t now = std::time( nullptr );
+    std::strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%S", std::localtime( &now ) );
+    std::fprintf( f, "{\n  \"context\": {\n" );
+    std::fprintf( f, "    \"date\": \"%s\",\n", date );
+    std::fprintf( f, "    \"executable\": \"movegen_bench\",\n" );
+    std::fprintf( f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency() );
+    std::fprintf( f, "    \"corpus_positions\": %d,\n", kCorpusSize );
+    std::fprintf( f, "    \"min_time\": %.3f,\n", opt.minTime );
+    std::fprintf( f, "    \"repetitions\": %d,\n", opt.repetitions );
+    std::fprintf( f, "    \"label\": \"%s\",\n", json_escape( opt.label ).c_str() );
+#if defined( NDEBUG )
+    std::fprintf( f, "    \"library_build_type\": \"release\"\n" );
+#else
+    std::fprintf( f, "    \"library_build_type\": \"debug\"\n" );
+#endif
+    std::fprintf( f, "  },\n  \"benchmarks\": [\n" );
+    for ( size_t i = 0; i < results.size(); ++i )
+    {
+        const Result& r = results[ i ];
+        std::fprintf( f, "    {\n" );
+        std::fprintf( f, "      \"name\": \"%s\",\n", json_escape( r.name ).c_str() );
+        std::fprintf( f, "      \"run_name\": \"%s\",\n", json_escape( r.name ).c_str() );
+        std::fprintf( f, "      \"run_type\": \"iteration\",\n" );
+        std::fprintf( f, "      \"iterations\": %llu,\n", ( unsigned long long )r.iterations );
+        std::fprintf( f, "      \"real_time\": %.3f,\n", r.realNs );
+        std::fprintf( f, "      \"cpu_time\": %.3f,\n", r.cpuNs );
+        std::fprintf( f, "      \"time_unit\": \"ns\",\n" );
+        std::fprintf( f, "      \"items_per_second\": %.3f\n", r.itemsPerSecond );
+        std::fprintf( f, "    }%s\n", i + 1 < results.size() ? "," : "" );
+    }
+    std::fprintf( f, "  ]\n}\n" );
+    std::fclose( f );
+    return true;
+}
+
+void usage()
+{
+    std::printf( "movegen_bench [--filter <substr>] [--min-time <sec>] [--repetitions <n>] [--json <file>] [--label <text>] [--list]\n" );
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    Options opt;
+    bool listOnly = false;
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        if ( a == "--filter" && i + 1 < argc )
+            opt.filter = argv[ ++i ];
+        else if ( a == "--min-time" && i + 1 < argc )
+            opt.minTime = std::atof( argv[ ++i ] );
+        else if ( a == "--repetitions" && i + 1 < argc )
+            opt.repetitions = std::atoi( argv[ ++i ] );
+        else if ( a == "--json" && i + 1 < argc )
+            opt.jsonPath = argv[ ++i ];
+        else if ( a == "--label" && i + 1 < argc )
+            opt.label = argv[ ++i ];
+        else if ( a == "--list" )
+            listOnly = true;
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+
+    std::vector< BenchProbe::Case1 > cases1( kCorpusSize );
+    std::vector< BenchProbe::Case2 > cases2( kCorpusSize );
+    for ( int i = 0; i < kCorpusSize; ++i )
+    {
+        if ( !BenchProbe::prepare( kCorpus[ i ], cases1[ i ] ) || !BenchProbe::prepare( kCorpus[ i ], cases2[ i ] ) )
+        {
+            std::fprintf( stderr, "corpus position %d failed to load: %s\n", i, kCorpus[ i ] );
+            return 1;
+        }
+    }
+
+    std::vector< Benchmark > benches;
+    register_engine< BenchProbe::Case1, BenchProbe::Move1 >( "ChessEngine1", cases1, benches );
+    register_engine< BenchProbe::Case2, BenchProbe::Move2 >( "ChessEngine2", cases2, benches );
+    register_batch_eval( cases2, benches );
+
+    std::vector< Result > results;
+    if ( !listOnly )
+        std::printf( "%-40s %15s %15s %12s %15s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "items/s" );
+    for ( const auto& b : benches )
+    {
+        if ( !opt.filter.empty() && b.name.find( opt.filter ) == std::string::npos )
+            continue;
+        if ( listOnly )
+        {
+            std::printf( "%s\n", b.name.c_str() );
+            continue;
+        }
+        Result r = run_benchmark( b, opt );
+        std::printf( "%-40s %15.0f %15.0f %12llu %15.4g\n", r.name.c_str(), r.realNs, r.cpuNs, ( unsigned long long )r.iterations, r.itemsPerSecond );
+        std::fflush( stdout );
+        results.push_back( r );
+    }
+    if ( !opt.jsonPath.empty() && !listOnly && !write_json( opt.jsonPath, opt, results ) )
+    {
+        std::fprintf( stderr, "could not write %s\n", opt.jsonPath.c_str() );
+        return 1;
+    }
+    return 0;
+}
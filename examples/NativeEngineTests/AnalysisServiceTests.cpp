@@ -0,0 +1,151 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/AnalysisService.h"
+#include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/EngineRegistry.h"
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(AnalysisServiceTests)
+    {
+    public:
+        TEST_METHOD(RequestsAndRepliesRoundTrip){
+            engine::AnalysisRequest r;
+            std::string error;
+            Assert::IsTrue(engine::parse_request("{\"id\":17, \"fen\":\"8/8/8/8/8/8/8/K1k5 w - - 0 1\",\"depth\":3,\"multipv\":2,"
+                                                 "\"priority\":-1,\"deadline_ms\":40,\"tag\":{\"a\":[1,\"x\"]}}", r, error));
+            Assert::AreEqual(std::string("17"), r.id);
+            Assert::AreEqual(std::string("8/8/8/8/8/8/8/K1k5 w - - 0 1"), r.fen);
+            Assert::IsTrue(r.depth == 3 && r.multipv == 2 && r.priority == -1 && r.deadline_ms == 40);
+            Assert::IsTrue(engine::parse_request("{\"fen\":\"x\"}", r, error) && r.depth == 6 && r.multipv == 1, L"Defaults not applied");
+            Assert::IsFalse(engine::parse_request("{\"id\":\"1\"}", r, error));
+            Assert::AreEqual(std::string("missing fen"), error);
+            Assert::IsFalse(engine::parse_request("{\"fen\":\"x\",\"depth\":2.5}", r, error));
+            Assert::IsFalse(engine::parse_request("{\"fen\":\"x\"} trailing", r, error));
+
+            engine::AnalysisReply reply;
+            reply.id = "a\"b";
+            reply.lines.push_back({ 31, 4, { "e2e4", "e7e5" } });
+            Assert::AreEqual(std::string("{\"id\":\"a\\\"b\",\"ok\":true,\"lines\":[{\"depth\":4,\"score\":31,\"pv\":[\"e2e4\",\"e7e5\"]}],"
+                                         "\"queue_ms\":0.000,\"search_ms\":0.000,\"coalesced\":false}"), engine::format_reply(reply));
+            engine::AnalysisReply back;
+            reply.queue_ms = 1.5;
+            Assert::IsTrue(engine::parse_reply(engine::format_reply(reply), back));
+            Assert::IsTrue(back.id == reply.id && back.error.empty() && back.queue_ms == 1.5 && back.lines.size() == 1);
+            Assert::IsTrue(back.lines[0].score == 31 && back.lines[0].depth == 4 && back.lines[0].pv == reply.lines[0].pv);
+            reply.error = "deadline exceeded";
+            Assert::AreEqual(std::string("{\"id\":\"a\\\"b\",\"ok\":false,\"error\":\"deadline exceeded\"}"), engine::format_reply(reply));
+            Assert::IsTrue(engine::parse_reply(engine::format_reply(reply), back) && back.error == reply.error && back.lines.empty());
+            Assert::IsFalse(engine::parse_reply("{\"id\":\"1\",\"lines\":[", back));
+
+            engine::AnalysisRequest sent;
+            sent.id = "9";
+            sent.fen = "8/8/8/8/8/8/8/K1k5 w - - 0 1";
+            sent.multipv = 3;
+            Assert::IsTrue(engine::parse_request(engine::format_request(sent), r, error) && r.id == "9" && r.fen == sent.fen && r.multipv == 3);
+        }
+
+        // No worker threads: the test runs the queue itself, so the order of searches is observable.
+        TEST_METHOD(QueueOrdersCoalescesAndExpires){
+            const char* fens[] = {
+                "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+                "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                "8/2p5/7p/pP2k1pP/5pP1/8/1P2PPK1/8 w - - 0 1",
+            };
+            std::shared_ptr<engine::EngineBase> eng(engine::find_engine("Engine2")->create());
+            std::vector<engine::AnalysisReply> replies;
+            auto collect = [&replies](const engine::AnalysisReply& r) { replies.push_back(r); };
+            {
+                engine::AnalysisService service(eng, 0);
+                auto request = [](const char* id, const char* fen, int priority, int deadline) {
+                    engine::AnalysisRequest r;
+                    r.id = id;
+                    r.fen = fen;
+                    r.depth = 2;
+                    r.priority = priority;
+                    r.deadline_ms = deadline;
+                    return r;
+                };
+                service.submit(request("plain", fens[0], 0, 0), collect);
+                service.submit(request("deadline", fens[1], 0, 60000), collect);
+                service.submit(request("urgent", fens[2], 5, 0), collect);
+                service.submit(request("again", fens[0], 9, 0), collect); // joins "plain" and lifts it to the front
+                service.submit(request("bad", "not a fen", 0, 0), collect);
+                Assert::AreEqual(size_t(1), replies.size());
+                Assert::AreEqual(std::string("bad"), replies[0].id);
+                Assert::AreEqual(size_t(3), service.stats().queued);
+
+                while (service.process_next()) {}
+                Assert::AreEqual(size_t(5), replies.size());
+                const char* order[] = { "bad", "plain", "again", "urgent", "deadline" };
+                for (size_t i = 0; i < 5; ++i) Assert::AreEqual(std::string(order[i]), replies[i].id);
+                Assert::IsTrue(!replies[1].coalesced && replies[2].coalesced);
+                Assert::IsTrue(replies[1].error.empty() && !replies[1].lines.empty());
+                Assert::AreEqual(replies[1].lines[0].pv[0], replies[2].lines[0].pv[0]);
+
+                replies.clear();
+                service.submit(request("late", fens[1], 0, 1), collect);
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                Assert::IsFalse(service.process_next(), L"An expired request was searched");
+                Assert::AreEqual(std::string("deadline exceeded"), replies.at(0).error);
+
+                engine::AnalysisServiceStats s = service.stats();
+                Assert::IsTrue(s.requests == 6 && s.searches == 3 && s.coalesced == 1 && s.expired == 1 && s.rejected == 1);
+
+                replies.clear();
+                service.submit(request("left", fens[2], 0, 0), collect);
+            }
+            Assert::AreEqual(std::string("server shutting down"), replies.at(0).error, L"Queued request not answered at shutdown");
+        }
+
+        struct ThrowingEngine : engine::ChessEngine2
+        {
+            std::vector<engine::PvLine> multipv(const std::string&, int, int) override { throw std::runtime_error("boom"); }
+        };
+
+        // A FEN the loader cannot take is refused at submit, and a search that throws answers with an
+        // error; neither reaches a worker thread's top level.
+        TEST_METHOD(BadPositionsAreAnsweredNotFatal){
+            std::vector<engine::AnalysisReply> replies;
+            auto collect = [&replies](const engine::AnalysisReply& r) { replies.push_back(r); };
+            const char* bad[] = {
+                "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",      // truncated
+                "rnbq1bnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQ - 0 1",    // no black king
+                "8/8/8/8/8/8/8/KK1k4 w - - 0 1",                             // two white kings
+                "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - x 1",  // counter not a number
+                "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPP/RNBQKBNR w KQkq - 0 1",   // seven squares on a rank
+            };
+            {
+                engine::AnalysisService service(std::shared_ptr<engine::EngineBase>(engine::find_engine("Engine2")->create()), 1);
+                for (const char* fen : bad) {
+                    engine::AnalysisRequest r;
+                    r.id = fen;
+                    r.fen = fen;
+                    r.depth = 2;
+                    service.submit(r, collect);
+                }
+                Assert::AreEqual(size_t(5), replies.size());
+                for (const auto& reply : replies) Assert::AreEqual(std::string("invalid fen"), reply.error);
+                Assert::AreEqual(uint64_t(5), service.stats().rejected);
+            }
+            replies.clear();
+            {
+                engine::AnalysisService service(std::make_shared<ThrowingEngine>(), 0);
+                engine::AnalysisRequest r;
+                r.id = "throws";
+                r.fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+                service.submit(r, collect);
+                Assert::IsTrue(service.process_next());
+                Assert::AreEqual(std::string("search failed: boom"), replies.at(0).error);
+                Assert::IsTrue(replies[0].lines.empty());
+            }
+        }
+    };
+}
@@ -0,0 +1,120 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/AnalysisStore.h"
+#include "../chessnative2/EngineRegistry.h"
+#include "../chessnative2/Zobrist.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(AnalysisStoreTests)
+    {
+    public:
+        TEST_METHOD(EntriesPersistAndAreShared){
+            const char* path = "analysis_store_test.cas";
+            std::remove(path);
+            const uint64_t key = 0x123456789abcdef1ULL;
+            {
+                engine::AnalysisStore a(path, 1);
+                engine::AnalysisStore b(path, 64); // existing file: its own size wins
+                Assert::IsTrue(a.is_open() && b.is_open() && a.writable());
+                Assert::AreEqual(a.capacity(), b.capacity());
+                engine::TTEntry e;
+                Assert::IsFalse(a.probe(key, e));
+                a.store(key, 6, -35, engine::Bound::Exact, engine::encode_move(12, 28, 0));
+                Assert::IsTrue(b.probe(key, e), L"A second mapping does not see the write");
+                Assert::AreEqual(6, e.depth);
+                Assert::AreEqual(-35, e.score);
+                b.store(key, 4, 80, engine::Bound::Exact, engine::encode_move(6, 21, 0));
+                Assert::IsTrue(a.probe(key, e) && e.depth == 6 && e.score == -35, L"A shallower result replaced a deeper one");
+                b.store(key, 7, 12, engine::Bound::Lower, engine::encode_move(6, 21, 0));
+                Assert::IsTrue(a.probe(key, e) && e.depth == 7 && e.bound == engine::Bound::Lower);
+                a.flush();
+            }
+            {
+                engine::AnalysisStore r(path, 1, true);
+                engine::TTEntry e;
+                Assert::IsTrue(r.is_open() && !r.writable());
+                Assert::IsTrue(r.probe(key, e) && e.depth == 7 && e.score == 12, L"Entry lost across reopening");
+                r.store(key ^ 1, 9, 0, engine::Bound::Exact, 1);
+                Assert::IsFalse(r.probe(key ^ 1, e));
+            }
+            {
+                std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+                f.seekp(8);
+                f.put(2); // version field
+            }
+            Assert::IsFalse(engine::AnalysisStore(path, 1).is_open(), L"Store of another version opened");
+            std::remove(path);
+        }
+
+        // A second process (here a second engine) answers a position searched before from the store.
+        TEST_METHOD(ChooseMoveReusesStoredAnalysis){
+            const char* path = "analysis_engine_test.cas";
+            const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+            for(const auto& info : engine::engine_registry()){
+                std::remove(path);
+                auto first = info.create();
+                auto store = std::make_shared<engine::AnalysisStore>(path, 1);
+                Assert::IsTrue(store->is_open());
+                first->set_analysis_store(store);
+                std::string best = first->choose_move(fen, 3);
+                Assert::IsTrue(first->last_search_stats().nodes > 0);
+
+                auto second = info.create();
+                second->set_analysis_store(std::make_shared<engine::AnalysisStore>(path, 1));
+                Assert::AreEqual(best, second->choose_move(fen, 3));
+                Assert::AreEqual(uint64_t(0), second->last_search_stats().nodes, L"Stored result not used");
+                Assert::AreEqual(best, second->choose_move(fen, 2), L"A deeper stored result is good for a shallower request");
+                second->choose_move(fen, 4);
+                Assert::IsTrue(second->last_search_stats().nodes > 0, L"A shallower stored result answered a deeper request");
+                engine::TTEntry e;
+                Assert::IsTrue(store->probe(second->analysis_key(fen), e) && e.depth == 4, L"Deeper result not written back");
+
+                // Another engine, or the same one with a search option changed, keeps its results apart;
+                // a different table size does not.
+                for(const auto& other : engine::engine_registry())
+                    if(&other != &info) Assert::AreNotEqual(second->analysis_key(fen), other.create()->analysis_key(fen), L"Engines share store keys");
+                auto changed = info.create();
+                Assert::IsTrue(changed->set_option("DrawDetection", 0));
+                changed->set_analysis_store(store);
+                changed->choose_move(fen, 3);
+                Assert::IsTrue(changed->last_search_stats().nodes > 0, L"Result found with other options reused");
+                auto sized = info.create();
+                Assert::IsTrue(sized->set_option("Hash", 64));
+                Assert::AreEqual(second->analysis_key(fen), sized->analysis_key(fen), L"Table size changed the store key");
+
+                second->set_game_history({ 1 });
+                second->choose_move(fen, 4);
+                Assert::IsTrue(second->last_search_stats().nodes > 0, L"Store used despite game history");
+            }
+            std::remove(path);
+        }
+
+        // The store key leaves out the halfmove clock, so results are kept and reused only where the
+        // search cannot reach the fifty-move rule.
+        TEST_METHOD(FiftyMoveClockKeepsPositionsOut){
+            const char* path = "analysis_clock_test.cas";
+            const std::string board = "4k3/8/8/8/8/8/4P3/R3K3 w Q - ";
+            std::remove(path);
+            auto store = std::make_shared<engine::AnalysisStore>(path, 1);
+            auto first = engine::create_engine("Engine2"), second = engine::create_engine("Engine2");
+            first->set_analysis_store(store);
+            second->set_analysis_store(store);
+            engine::TTEntry e;
+            first->choose_move(board + "97 60", 3);
+            Assert::IsFalse(store->probe(first->analysis_key(board + "97 60"), e), L"Result near the fifty-move rule stored");
+            first->choose_move(board + "90 60", 3);
+            Assert::IsTrue(store->probe(first->analysis_key(board + "90 60"), e));
+            second->choose_move(board + "0 1", 3);
+            Assert::AreEqual(uint64_t(0), second->last_search_stats().nodes, L"Result far from the rule not reused");
+            second->choose_move(board + "97 60", 3);
+            Assert::IsTrue(second->last_search_stats().nodes > 0, L"Result reused where the fifty-move rule is in reach");
+            std::remove(path);
+        }
+    };
+}
@@ -0,0 +1,47 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/BatchEval.h"
+#include <cstdint>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(BatchEvalTests)
+    {
+    public:
+        // Fills a batch with sparse random boards; 203 positions leaves a tail for every kernel width.
+        static void FillRandom(engine::LeafBatch& batch, int count){
+            uint64_t s = 0x9E3779B97F4A7C15ULL;
+            auto next = [&](){ s ^= s << 13; s ^= s >> 7; s ^= s << 17; return s; };
+            batch.clear();
+            for(int i=0;i<count;++i){ uint64_t bb[12]; for(int p=0;p<12;++p) bb[p] = next() & next() & next(); batch.add(bb); }
+        }
+
+        TEST_METHOD(SimdKernelsMatchScalar){
+            static engine::LeafBatch batch; // too large for a comfortable stack frame in a test
+            FillRandom(batch, 203);
+            const int values[6] = { 100, 320, 330, 500, 900, 10000 };
+            int ref[engine::LeafBatch::kCapacity], got[engine::LeafBatch::kCapacity];
+            Assert::IsTrue(engine::evaluate_batch_with(engine::EvalKernel::Scalar, batch, values, ref));
+            const engine::EvalKernel kernels[] = { engine::EvalKernel::AVX2, engine::EvalKernel::AVX512 };
+            for(auto k : kernels){
+                if(!engine::evaluate_batch_with(k, batch, values, got)) continue; // not supported on this CPU
+                for(int i=0;i<batch.count;++i) Assert::AreEqual(ref[i], got[i], L"SIMD kernel differs from scalar reference");
+            }
+            engine::evaluate_batch(batch, values, got);
+            for(int i=0;i<batch.count;++i) Assert::AreEqual(ref[i], got[i], L"Dispatched kernel differs from scalar reference");
+        }
+
+        TEST_METHOD(ScalarMatchesMaterialCount){
+            static engine::LeafBatch batch;
+            batch.clear();
+            // White: 8 pawns + queen; black: 7 pawns + rook.
+            uint64_t bb[12] = { 0xFF00ULL, 0, 0, 0, 0x8ULL, 0x10ULL, 0x7F000000000000ULL, 0, 0, 0x100000000000000ULL, 0, 0x1000000000000000ULL };
+            batch.add(bb);
+            const int values[6] = { 100, 320, 330, 500, 900, 0 };
+            int out[1];
+            engine::evaluate_batch(batch, values, out);
+            Assert::AreEqual(800 + 900 - 700 - 500, out[0]);
+        }
+    };
+}
@@ -32,12 +32,29 @@ namespace ChessNativeTests
         static void EngineChoosesHighestMaterialCaptureGeneric() {
             const std::string fen = "r4rk1/8/8/8/8/8/8/R3K2R w KQkq - 0 1"; int depth = 2; EngineT e; auto scores = e.root_search_scores(fen, depth); Assert::IsTrue(!scores.empty(), L"No scores"); int bestScore = -1000000; for (auto& p : scores) bestScore = std::max(bestScore, p.second); std::vector<std::string> best; for (auto& p : scores) if (p.second == bestScore) best.push_back(p.first.substr(0, 4)); std::string chosen = e.choose_move(fen, depth).substr(0, 4); bool ok = std::find(best.begin(), best.end(), chosen) != best.end(); Assert::IsTrue(ok, L"Engine did not choose a best scoring move in rook capture test");
         }
+        template<typename EngineT>
+        static void Chess960CastlingGeneric() {
+            // Rooks on b1/g1 (Shredder-FEN "GB"): non-standard castling is written king-takes-rook.
+            const std::string fen = "4k3/8/8/8/8/8/8/1R2K1R1 w GB - 0 1"; EngineT e; auto moves = e.legal_moves_uci(fen);
+            Assert::IsTrue(std::find(moves.begin(), moves.end(), "e1g1") != moves.end(), L"Chess960 kingside castling missing");
+            Assert::IsTrue(std::find(moves.begin(), moves.end(), "e1b1") != moves.end(), L"Chess960 queenside castling missing");
+            Assert::AreEqual(std::string("4k3/8/8/8/8/8/8/2KR2R1 b - - 1 1"), e.apply_move(fen, "e1b1"), L"Queenside castling result wrong");
+            Assert::AreEqual(std::string("4k3/8/8/8/8/8/8/1R3RK1 b - - 1 1"), e.apply_move(fen, "e1g1"), L"Kingside castling result wrong");
+        }
+        template<typename EngineT>
+        static void CastlingThroughAttackRejectedGeneric() {
+            const std::string fen = "4kr2/8/8/8/8/8/8/1R2K1R1 w GB - 0 1"; EngineT e; auto moves = e.legal_moves_uci(fen);
+            Assert::IsTrue(std::find(moves.begin(), moves.end(), "e1g1") == moves.end(), L"King may not cross the attacked f1 square");
+            Assert::IsTrue(std::find(moves.begin(), moves.end(), "e1b1") != moves.end(), L"Queenside castling should still be legal");
+        }
 
         TEST_METHOD(BlackCanCastleKingside) { VerifyBlackCanCastleKingsideGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(EngineBestMoveCaptureVsChosen) { EngineBestMoveCaptureVsChosenGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(NegamaxRootSignSanity) { NegamaxRootSignSanityGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(BlackCanCastleQueenside) { VerifyBlackCanCastleQueensideGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(EngineChoosesHighestMaterialCapture) { EngineChoosesHighestMaterialCaptureGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(Chess960Castling) { Chess960CastlingGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(CastlingThroughAttackRejected) { CastlingThroughAttackRejectedGeneric<engine::ChessEngine1>(); }
     };
 
     TEST_CLASS(CastlingAndMoveSelectionTests2)
@@ -48,5 +65,7 @@ namespace ChessNativeTests
         TEST_METHOD(NegamaxRootSignSanity) { CastlingAndMoveSelectionTests1::NegamaxRootSignSanityGeneric<engine::ChessEngine2>(); }
         TEST_METHOD(BlackCanCastleQueenside) { CastlingAndMoveSelectionTests1::VerifyBlackCanCastleQueensideGeneric<engine::ChessEngine2>(); }
         TEST_METHOD(EngineChoosesHighestMaterialCapture) { CastlingAndMoveSelectionTests1::EngineChoosesHighestMaterialCaptureGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(Chess960Castling) { CastlingAndMoveSelectionTests1::Chess960CastlingGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(CastlingThroughAttackRejected) { CastlingAndMoveSelectionTests1::CastlingThroughAttackRejectedGeneric<engine::ChessEngine2>(); }
     };
 }
@@ -1,7 +1,9 @@
 #include "CppUnitTest.h"
 #include "../chessnative2/ChessEngine1.hpp"
 #include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/Zobrist.h"
 #include <algorithm>
+#include <cctype>
 #include <string>
 #include <vector>
 
@@ -67,10 +69,147 @@ namespace ChessNativeTests {
             Assert::AreEqual('.', after[g2], L"Source square not emptied");
             Assert::AreEqual((int)before[g2], (int)after[g3], L"Piece did not move to target square");
         }
+        template<typename EngineT>
+        static void LastSearchStatsGeneric(){
+            const std::string fen = "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3";
+            EngineT e;
+            std::string chosen = e.choose_move(fen, 3);
+            Assert::IsTrue(!chosen.empty(), L"Empty choose_move result");
+            const engine::SearchStats& st = e.last_search_stats();
+            Assert::AreEqual(3, st.depth, L"Stats depth not recorded");
+#if ENGINE_SEARCH_STATS
+            Assert::IsTrue(st.nodes > 1, L"No nodes counted");
+            Assert::AreEqual((uint64_t)1, st.nodes_at_ply[0], L"Root should be counted once");
+            uint64_t perPly = 0; for (int i = 0; i < engine::SearchStats::kMaxPly; ++i) perPly += st.nodes_at_ply[i];
+            Assert::AreEqual(st.nodes, perPly, L"Per-ply node counts do not add up");
+            Assert::IsTrue(st.branching_factor(0) > 1.0, L"Root branching factor missing");
+            uint64_t cutoffs = 0; for (int i = 0; i < engine::SearchStats::kCutoffSlots; ++i) cutoffs += st.cutoff_at[i];
+            Assert::AreEqual(st.beta_cutoffs, cutoffs, L"Cutoff histogram does not add up");
+            Assert::IsTrue(st.search_ns >= st.eval_ns, L"Eval time exceeds search time");
+            // A second search must start from fresh counters. last_search_stats() is a snapshot, so read it again.
+            e.choose_move(fen, 1);
+            const engine::SearchStats st1 = e.last_search_stats();
+            Assert::AreEqual(1, st1.depth);
+            Assert::AreEqual(st1.nodes, (uint64_t)1 + st1.nodes_at_ply[1], L"Stats not reset between searches");
+#endif
+        }
+
+        template<typename EngineT>
+        static void RepetitionDrawGeneric(){
+            // Ng1-f3 / Ke8-e7 / Nf3-g1 / Ke7-e8 has been played; Nf3 again would repeat the position after move 1.
+            const char* history[] = {
+                "4k3/8/8/8/8/8/8/3QK1N1 w - - 0 1",
+                "4k3/8/8/8/8/5N2/8/3QK3 b - - 1 1",
+                "8/4k3/8/8/8/5N2/8/3QK3 w - - 2 2",
+                "8/4k3/8/8/8/8/8/3QK1N1 b - - 3 2" };
+            const std::string fen = "4k3/8/8/8/8/8/8/3QK1N1 w - - 4 3";
+            std::vector<uint64_t> keys;
+            for(const char* h : history) keys.push_back(engine::zobrist_hash_fen(h));
+            EngineT e;
+            e.set_game_history(keys);
+            auto scores = e.root_search_scores(fen, 2);
+            int repeat = -1, other = -1;
+            for(auto &pr : scores){ if(pr.first.substr(0,4)=="g1f3") repeat = pr.second; if(pr.first.substr(0,4)=="d1d2") other = pr.second; }
+            Assert::AreEqual(0, repeat, L"Repeating move should score as a draw");
+            Assert::IsTrue(other > 500, L"Non-repeating move should keep the material advantage");
+            Assert::IsTrue(e.last_search_stats().draw_cutoffs > 0, L"Draw cutoffs not counted");
+            Assert::IsTrue(e.choose_move(fen, 2).substr(0,4) != "g1f3", L"Engine chose the repetition while winning");
+        }
+        template<typename EngineT>
+        static void FiftyMoveDrawGeneric(){
+            const std::string fen = "4k3/8/8/8/8/8/8/3QK3 w - - 99 80";
+            EngineT e;
+            auto scores = e.root_search_scores(fen, 2);
+            Assert::IsTrue(!scores.empty(), L"No root scores returned");
+            for(auto &pr : scores) Assert::AreEqual(0, pr.second, L"Every quiet move reaches the fifty-move limit");
+        }
+
+        template<typename EngineT>
+        static void PinsAndChecksGeneric(){
+            EngineT e;
+            // Knight e2 is pinned by the rook on e7: none of its moves are legal.
+            auto pinned = e.legal_moves_uci("4k3/4r3/8/8/8/8/4N3/4K3 w - - 0 1");
+            Assert::IsTrue(!pinned.empty(), L"King moves missing");
+            for(auto &m : pinned) Assert::IsTrue(m.substr(0,2) != "e2", L"Pinned knight moved");
+            // Rook check on the first rank: Ra1 can capture, king can step off the rank, nothing else.
+            auto check = e.legal_moves_uci("4k3/8/8/8/8/8/8/R2r1K2 w - - 0 1");
+            std::sort(check.begin(), check.end());
+            std::vector<std::string> expected = { "a1d1", "f1e2", "f1f2", "f1g2" };
+            Assert::IsTrue(check == expected, L"Check evasions wrong");
+        }
+
+        template<typename EngineT>
+        static void PinnedSlidersAndBlocksGeneric(){
+            EngineT e;
+            // Rook e2 is pinned on the e-file: it may slide along the pin up to and including the pinner.
+            std::vector<std::string> rook;
+            for(auto& m : e.legal_moves_uci("4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1")) if(m.substr(0,2) == "e2") rook.push_back(m);
+            std::sort(rook.begin(), rook.end());
+            std::vector<std::string> along = { "e2e3", "e2e4", "e2e5", "e2e6", "e2e7" };
+            Assert::IsTrue(rook == along, L"Pinned rook left its line");
+            // Check along the first rank: the rook can only interpose on b1, the king cannot stay on the rank.
+            auto block = e.legal_moves_uci("4k3/8/8/8/8/8/1R6/r3K3 w - - 0 1");
+            std::sort(block.begin(), block.end());
+            std::vector<std::string> expected = { "b2b1", "e1d2", "e1e2", "e1f2" };
+            Assert::IsTrue(block == expected, L"Check blocks wrong");
+        }
+
+        // Colour-mirrored FEN: ranks reversed, piece case and side to move swapped (castling/ep dropped).
+        static std::string MirrorFen(const std::string& fen){
+            std::string board = fen.substr(0, fen.find(' ')), out;
+            for(size_t end = board.size(); ; ){ size_t start = board.rfind('/', end - 1); std::string rank = board.substr(start == std::string::npos ? 0 : start + 1, end - (start == std::string::npos ? 0 : start + 1)); for(char c : rank) out += std::isupper((unsigned char)c) ? (char)std::tolower((unsigned char)c) : (char)std::toupper((unsigned char)c); if(start == std::string::npos) break; out += '/'; end = start; }
+            return out + (fen[fen.find(' ') + 1] == 'w' ? " b - - 0 1" : " w - - 0 1");
+        }
+
+        template<typename EngineT>
+        static void MirroredMovesGeneric(){
+            EngineT e;
+            // The generators are templated on the side to move; both instantiations must agree.
+            const char* fens[] = {
+                "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w - - 2 3",
+                "4k3/5p2/5N2/8/2B5/8/3P4/4K3 w - - 0 1",
+                "2r3k1/1q3pp1/p3pn1p/1pb5/4P3/1BN2Q1P/PP3PP1/3R2K1 b - - 0 1",
+            };
+            for(auto fen : fens){
+                auto mirrorSq = [](const std::string& m){ std::string r = m; r[1] = (char)('1' + '8' - m[1]); r[3] = (char)('1' + '8' - m[3]); return r; };
+                auto a = e.legal_moves_uci(fen);
+                auto b = e.legal_moves_uci(MirrorFen(fen));
+                for(auto& m : b) m = mirrorSq(m);
+                std::sort(a.begin(), a.end()); std::sort(b.begin(), b.end());
+                Assert::IsTrue(!a.empty() && a == b, L"Mirrored position gave different moves");
+            }
+            // A pawn cannot jump over a blocker with its double step.
+            for(auto& m : e.legal_moves_uci("4k3/5p2/5N2/8/8/8/8/4K3 b - - 0 1")) Assert::IsTrue(m.substr(0,2) != "f7", L"Blocked pawn moved");
+        }
+
+        template<typename EngineT>
+        static void ExtensionsSeePastTheHorizonGeneric(){
+            // Qxd8+ Qxd8 Rxd8# is three plies: at depth 2 only the check and recapture extensions see the
+            // rook land on d8. Without them the queen is lost for the rook.
+            const char* fen = "3r2k1/2q2ppp/8/8/8/8/3Q1PPP/3R2K1 w - - 0 1";
+            auto scoreOf = [&](EngineT& e){ int score = -1000000; for(auto& s : e.root_search_scores(fen, 2)) if(s.first == "d2d8") score = s.second; return score; };
+            EngineT e;
+            Assert::AreEqual(-400, scoreOf(e), L"Extensions not off by default");
+            Assert::IsTrue(e.set_option("ExtensionBudget", 2));
+            Assert::IsTrue(scoreOf(e) >= 500, L"Forcing line not extended");
+            // Lines below an extension are stored under keys that count it; the PV continues through them.
+            e.new_game();
+            for(auto& line : e.multipv("4r1k1/p1pb1ppp/Qbp1r3/8/1P6/2Pq1B2/R2P1PPP/2B2RK1 b - - 0 1", 5, 2))
+                Assert::AreEqual((size_t)5, line.pv.size(), L"PV through an extended line cut short");
+            Assert::IsTrue(e.set_option("SingularExtension", 1));
+            Assert::AreEqual(std::string("d2d8"), e.choose_move(fen, 4));
+        }
 
         TEST_METHOD(ChooseMove) { ChooseMoveGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(RootScoresContainLegalMoves) { RootScoresContainLegalMovesGeneric<engine::ChessEngine1>(); }
         TEST_METHOD(ApplyMove) { ApplyMoveGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(LastSearchStats) { LastSearchStatsGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(RepetitionDraw) { RepetitionDrawGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(FiftyMoveDraw) { FiftyMoveDrawGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(PinsAndChecks) { PinsAndChecksGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(MirroredMoves) { MirroredMovesGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(PinnedSlidersAndBlocks) { PinnedSlidersAndBlocksGeneric<engine::ChessEngine1>(); }
+        TEST_METHOD(ExtensionsSeePastTheHorizon) { ExtensionsSeePastTheHorizonGeneric<engine::ChessEngine1>(); }
     };
 
     TEST_CLASS(EngineApiTests2) // Same assertions; may fail for ChessEngine2 by design
@@ -79,5 +218,12 @@ namespace ChessNativeTests {
         TEST_METHOD(ChooseMove) { EngineApiTests1::ChooseMoveGeneric<engine::ChessEngine2>(); }
         TEST_METHOD(RootScoresContainLegalMoves) { EngineApiTests1::RootScoresContainLegalMovesGeneric<engine::ChessEngine2>(); }
         TEST_METHOD(ApplyMove) { EngineApiTests1::ApplyMoveGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(LastSearchStats) { EngineApiTests1::LastSearchStatsGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(RepetitionDraw) { EngineApiTests1::RepetitionDrawGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(FiftyMoveDraw) { EngineApiTests1::FiftyMoveDrawGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(PinsAndChecks) { EngineApiTests1::PinsAndChecksGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(MirroredMoves) { EngineApiTests1::MirroredMovesGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(PinnedSlidersAndBlocks) { EngineApiTests1::PinnedSlidersAndBlocksGeneric<engine::ChessEngine2>(); }
+        TEST_METHOD(ExtensionsSeePastTheHorizon) { EngineApiTests1::ExtensionsSeePastTheHorizonGeneric<engine::ChessEngine2>(); }
     };
 }
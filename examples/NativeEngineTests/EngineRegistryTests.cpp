@@ -0,0 +1,200 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/EngineRegistry.h"
+#include "../chessnative2/Platform.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(EngineRegistryTests)
+    {
+    public:
+        TEST_METHOD(EveryEngineCreatesAndPlays){
+            Assert::IsTrue(engine::engine_registry().size() >= 2);
+            for(const auto& info : engine::engine_registry()){
+                auto e = engine::create_engine(info.name);
+                Assert::IsTrue(e != nullptr, L"Registered engine failed to create");
+                Assert::AreEqual(size_t(20), e->legal_moves_uci("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1").size());
+            }
+            Assert::IsTrue(engine::create_engine("NoSuchEngine") == nullptr);
+        }
+
+        TEST_METHOD(OptionSchemaValidatesValues){
+            for(const auto& info : engine::engine_registry()){
+                auto e = info.create();
+                Assert::IsTrue(e->find_option("batchfrontier"), L"Option lookup should be case-insensitive");
+                Assert::IsTrue(e->set_option("BatchFrontier", std::string("false")));
+                Assert::AreEqual(0, e->option_value("BatchFrontier"));
+                Assert::IsTrue(e->set_option("EvalKernel", std::string("scalar")));
+                engine::EngineOption kernel;
+                Assert::IsTrue(e->find_option("EvalKernel", &kernel));
+                Assert::AreEqual(std::string("Scalar"), kernel.value_string());
+                Assert::IsFalse(e->set_option("EvalKernel", std::string("SSE9")));
+                Assert::IsFalse(e->set_option("EvalKernel", 17));
+                Assert::IsFalse(e->set_option("NoSuchOption", 1));
+                e->reset_options();
+                for(const auto& o : e->options()) Assert::AreEqual(o.default_value, o.value);
+            }
+        }
+
+        // Search shortcuts are performance settings only: root scores must not depend on them.
+        TEST_METHOD(SearchOptionsKeepScores){
+            const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+            for(const auto& info : engine::engine_registry()){
+                auto e = info.create();
+                auto expected = e->root_search_scores(fen, 3);
+                const char* kernels[] = { "Scalar", "AVX2", "AVX512" };
+                // Each search starts from empty tables: a warm table may tighten the bounds Engine1 reports for refuted moves.
+                for(const char* k : kernels){
+                    e->set_option("EvalKernel", std::string(k));
+                    e->new_game();
+                    Assert::IsTrue(expected == e->root_search_scores(fen, 3), L"Eval kernel changed root scores");
+                }
+                e->set_option("BatchFrontier", 0);
+                e->new_game();
+                Assert::IsTrue(expected == e->root_search_scores(fen, 3), L"Batched frontier changed root scores");
+                if(!e->find_option("PawnHash")) continue;
+                e->set_option("EvalCache", 256);
+                e->new_game();
+                Assert::IsTrue(expected == e->root_search_scores(fen, 3), L"Evaluation cache changed root scores");
+#if ENGINE_SEARCH_STATS
+                engine::SearchStats st = e->last_search_stats();
+                Assert::IsTrue(st.pawn_hit_rate() > 0.9, L"Pawn structure cache misses");
+                Assert::IsTrue(st.eval_hits > 0);
+#endif
+                e->set_option("PawnHash", 0);
+                e->new_game();
+                Assert::IsTrue(expected == e->root_search_scores(fen, 3), L"Pawn structure cache changed root scores");
+            }
+        }
+
+        // One engine instance shared by several threads must give each caller the serial answer. The threads
+        // share one transposition table, so only the best move and its score are fixed; the bounds reported for
+        // refuted moves may depend on what the other searches stored.
+        TEST_METHOD(SharedInstanceServesConcurrentSearches){
+            const char* fens[] = {
+                "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+                "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            };
+            const int n = 4;
+            for(const auto& info : engine::engine_registry()){
+                auto e = info.create();
+                std::vector<std::vector<std::pair<std::string,int>>> serial(n), parallel(n);
+                std::vector<std::string> serialBest(n), parallelBest(n);
+                for(int i=0;i<n;++i){ serial[i] = e->root_search_scores(fens[i], 3); serialBest[i] = e->choose_move(fens[i], 3); }
+                std::vector<std::thread> threads;
+                for(int i=0;i<n;++i) threads.emplace_back([&, i](){ parallel[i] = e->root_search_scores(fens[i], 3); parallelBest[i] = e->choose_move(fens[i], 3); });
+                for(auto& t : threads) t.join();
+                auto best = [](const std::vector<std::pair<std::string,int>>& s){ int b = -1000000; for(auto& p : s) b = std::max(b, p.second); return b; };
+                for(int i=0;i<n;++i){
+                    Assert::AreEqual(serial[i].size(), parallel[i].size(), L"Concurrent search scored other moves");
+                    Assert::AreEqual(best(serial[i]), best(parallel[i]), L"Concurrent best score differs from serial");
+                    Assert::AreEqual(serialBest[i], parallelBest[i]);
+                }
+                Assert::IsTrue(e->last_search_stats().nodes > 0, L"Stats of a finished search not published");
+            }
+        }
+
+        // The tables each move leaves behind order the next move's search: over a game the engine plays the
+        // same moves in fewer nodes. A new game starts cold again and reproduces the first search exactly.
+        TEST_METHOD(AnalysisCarriesAcrossMoves){
+            const char* start = "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3";
+            for(const auto& info : engine::engine_registry()){
+                auto e = info.create();
+                auto cold = e->root_search_scores(start, 4);
+                std::vector<std::string> moves[2];
+                uint64_t nodes[2] = {};
+                for(int keep = 0; keep < 2; ++keep){
+                    e->set_option("KeepAnalysis", keep);
+                    e->new_game();
+                    std::string fen = start;
+                    for(int ply = 0; ply < 10; ++ply){
+                        moves[keep].push_back(e->choose_move(fen, 4));
+                        nodes[keep] += e->last_search_stats().nodes;
+                        fen = e->apply_move(fen, moves[keep].back());
+                    }
+                }
+                Assert::IsTrue(moves[0] == moves[1], L"Kept analysis changed the moves played");
+#if ENGINE_SEARCH_STATS
+                Assert::IsTrue(nodes[1] < nodes[0], L"Kept analysis did not shrink the search");
+#endif
+                e->new_game();
+                Assert::IsTrue(cold == e->root_search_scores(start, 4), L"new_game did not restore a cold search");
+            }
+        }
+
+        // Table placement and thread pinning are performance settings too; pinned searches get their mask back.
+        TEST_METHOD(MemoryAndAffinityOptionsKeepScores){
+            engine::LargeMemory block(3 << 20, true, true);
+            Assert::IsTrue(block.data() != nullptr && block.size() == size_t(3 << 20));
+            Assert::AreEqual(size_t(0), (size_t)block.data() % 4096, L"Large memory is not page-aligned");
+            const unsigned char* bytes = static_cast<const unsigned char*>(block.data());
+            Assert::IsTrue(std::all_of(bytes, bytes + block.size(), [](unsigned char b){ return b == 0; }), L"Large memory is not zeroed");
+            engine::Affinity policy;
+            Assert::IsTrue(engine::parse_affinity("Scatter", policy) && policy == engine::Affinity::Scatter);
+            Assert::AreEqual(-1, engine::affinity_cpu(engine::Affinity::None, 0));
+            Assert::IsTrue(engine::affinity_cpu(engine::Affinity::Compact, 0) >= 0);
+
+            const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+            for(const auto& info : engine::engine_registry()){
+                auto e = info.create();
+                auto expected = e->root_search_scores(fen, 3);
+                e->set_option("Hash", 128);
+                e->set_option("LargePages", 1);
+                e->set_option("NumaInterleave", 1);
+                e->set_option("Affinity", std::string("Scatter"));
+                e->new_game();
+                Assert::IsTrue(expected == e->root_search_scores(fen, 3), L"Table placement or pinning changed root scores");
+                e->set_option("LargePages", 0);
+                e->new_game();
+                Assert::IsTrue(expected == e->root_search_scores(fen, 3), L"Small pages changed root scores");
+            }
+        }
+
+        // Lines come best first with distinct, legal first moves; the first line is the single-PV best score.
+        TEST_METHOD(MultiPvReportsBestLines){
+            const char* fens[] = {
+                "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1",
+            };
+            for(const auto& info : engine::engine_registry()){
+                auto e = info.create();
+                for(const char* fen : fens){
+                    e->new_game();
+                    auto scores = e->root_search_scores(fen, 4);
+                    int best = -1000000;
+                    for(auto& p : scores) best = std::max(best, p.second);
+                    e->new_game();
+                    auto lines = e->multipv(fen, 4, 4);
+                    Assert::AreEqual(std::min(size_t(4), scores.size()), lines.size());
+                    Assert::AreEqual(best, lines[0].score, L"First line is not the best score");
+                    std::vector<std::string> first;
+                    for(size_t k = 0; k < lines.size(); ++k){
+                        Assert::AreEqual(4, lines[k].depth);
+                        if(k) Assert::IsTrue(lines[k].score <= lines[k - 1].score, L"Lines out of order");
+                        Assert::IsFalse(lines[k].pv.empty());
+                        first.push_back(lines[k].pv[0]);
+                        std::string pos = fen;
+                        for(const auto& m : lines[k].pv){
+                            pos = e->apply_move(pos, m);
+                            Assert::IsFalse(pos.empty(), L"Illegal move in a PV");
+                        }
+                    }
+                    std::sort(first.begin(), first.end());
+                    Assert::IsTrue(std::unique(first.begin(), first.end()) == first.end(), L"Two lines start with the same move");
+                    e->new_game();
+                    auto one = e->multipv(fen, 4, 1);
+                    Assert::AreEqual(size_t(1), one.size());
+                    Assert::AreEqual(best, one[0].score);
+                }
+            }
+        }
+    };
+}
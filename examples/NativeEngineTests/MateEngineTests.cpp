@@ -0,0 +1,67 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/MateEngine.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(MateEngineTests)
+    {
+    public:
+        // Plays the pv and checks every move is legal and the side to move is left without one.
+        static void AssertPvMates(engine::MateEngine& e, std::string fen, const std::vector<std::string>& pv){
+            for(const auto& m : pv){
+                auto legal = e.legal_moves_uci(fen);
+                Assert::IsTrue(std::find(legal.begin(), legal.end(), m) != legal.end(), L"Illegal move in mate pv");
+                fen = e.apply_move(fen, m);
+            }
+            Assert::IsTrue(e.legal_moves_uci(fen).empty(), L"Pv does not end in mate");
+        }
+
+        TEST_METHOD(ProvesShortestMates){
+            engine::MateEngine e;
+            engine::MateResult r = e.solve_mate("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 3);
+            Assert::IsTrue(r.status == engine::MateResult::Status::Mate);
+            Assert::AreEqual(1, r.moves);
+            Assert::AreEqual(size_t(1), r.pv.size());
+            Assert::AreEqual(std::string("a1a8"), r.pv[0]);
+
+            const std::string two = "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1";
+            r = e.solve_mate(two, 3);
+            Assert::IsTrue(r.status == engine::MateResult::Status::Mate);
+            Assert::AreEqual(2, r.moves);
+            Assert::AreEqual(size_t(3), r.pv.size());
+            AssertPvMates(e, two, r.pv);
+
+            const std::string three = "1k5r/pP3ppp/3p2b1/1BN1n3/1Q2P3/P1B5/KP3P1P/7q w - - 1 0";
+            r = e.solve_mate(three, 3);
+            Assert::IsTrue(r.status == engine::MateResult::Status::Mate);
+            Assert::AreEqual(3, r.moves);
+            AssertPvMates(e, three, r.pv);
+            Assert::IsTrue(e.last_search_stats().nodes > 0);
+        }
+
+        TEST_METHOD(RefutesAndGivesUp){
+            engine::MateEngine e;
+            engine::MateResult r = e.solve_mate("8/8/8/4k3/8/8/8/4K2R w K - 0 1", 2);
+            Assert::IsTrue(r.status == engine::MateResult::Status::NoMate, L"KR v K has no mate in 2 from here");
+            r = e.solve_mate("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 1);
+            Assert::IsTrue(r.status == engine::MateResult::Status::NoMate);
+            Assert::IsTrue(r.pv.empty());
+
+            Assert::IsTrue(e.set_option("MateNodes", 1));
+            r = e.solve_mate("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5);
+            Assert::IsTrue(r.status == engine::MateResult::Status::Unknown, L"A 1000 node budget settled a middlegame");
+        }
+
+        TEST_METHOD(ChooseMovePlaysTheMate){
+            engine::MateEngine e;
+            Assert::AreEqual(std::string("h5f7"), e.choose_move("r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 1));
+            Assert::IsTrue(e.set_option("MateMoves", 0));
+            Assert::IsFalse(e.choose_move("r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 1).empty());
+        }
+    };
+}
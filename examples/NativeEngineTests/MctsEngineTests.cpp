@@ -0,0 +1,65 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/MctsEngine.hpp"
+#include "../chessnative2/Zobrist.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(MctsEngineTests)
+    {
+    public:
+        TEST_METHOD(FindsTacticsAndMates){
+            engine::MctsEngine e;
+            Assert::AreEqual(std::string("a1a8"), e.choose_move("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 2));
+            Assert::AreEqual(std::string("d1d5"), e.choose_move("4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1", 2), L"Undefended queen not taken");
+            Assert::AreEqual(uint64_t(1000), e.last_search_stats().playouts);
+        }
+
+        // Virtual loss spreads the threads over the tree; they still run exactly the budget between them.
+        TEST_METHOD(ThreadsShareOneBudget){
+            const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+            engine::MctsEngine e;
+            std::string serial = e.choose_move(fen, 3);
+            e.new_game();
+            Assert::AreEqual(serial, e.choose_move(fen, 3), L"One thread is not deterministic");
+            Assert::AreEqual(uint64_t(1500), e.last_search_stats().playouts, L"new_game kept the tree");
+            Assert::IsTrue(e.set_option("Threads", 4));
+            Assert::IsTrue(e.set_option("KeepAnalysis", 0));
+            std::string parallel = e.choose_move(fen, 3);
+            auto legal = e.legal_moves_uci(fen);
+            Assert::IsTrue(std::find(legal.begin(), legal.end(), parallel) != legal.end());
+            Assert::AreEqual(uint64_t(1500), e.last_search_stats().playouts);
+            Assert::IsTrue(e.last_search_stats().nodes > 1500);
+        }
+
+        // The subtree under the moves actually played is carried into the next search and its visits
+        // count towards the budget; without KeepAnalysis, or in another game, the search starts over.
+        TEST_METHOD(RecyclesTheSubtreeOfTheGame){
+            const std::string start = "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3";
+            for(int keep = 0; keep < 2; ++keep){
+                engine::MctsEngine e;
+                e.set_option("KeepAnalysis", keep);
+                std::string fen = start;
+                std::vector<uint64_t> history;
+                for(int ply = 0; ply < 3; ++ply){
+                    std::string move = e.choose_move(fen, 4);
+                    uint64_t playouts = e.last_search_stats().playouts;
+                    if(keep && ply) Assert::IsTrue(playouts < 2000, L"Subtree of the played moves not reused");
+                    else Assert::AreEqual(uint64_t(2000), playouts);
+                    history.push_back(engine::zobrist_hash_fen(fen));
+                    fen = e.apply_move(fen, move);
+                    e.set_game_history(history);
+                }
+            }
+            engine::MctsEngine e;
+            std::string next = e.apply_move(start, e.choose_move(start, 4));
+            e.set_game_history({ engine::zobrist_hash_fen(next) ^ 1 });
+            e.choose_move(next, 4);
+            Assert::AreEqual(uint64_t(2000), e.last_search_stats().playouts, L"Tree of another game reused");
+        }
+    };
+}
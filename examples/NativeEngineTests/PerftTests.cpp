@@ -0,0 +1,50 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/Perft.h"
+#include <cstdint>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(PerftTests)
+    {
+    public:
+        // Shallow enough for a unit test; PerftTool --check covers the deeper counts.
+        static const int kDepth = 3;
+
+        TEST_METHOD(CorpusMatchesPublishedCounts){
+            engine::PerftOptions opt;
+            opt.hash_mb = 0;
+            for(const auto& c : engine::perft_corpus()){
+                for(int d=1; d<=kDepth; ++d){
+                    Assert::AreEqual(c.nodes[d-1], engine::perft(c.fen, d, opt).nodes, L"ChessEngine2 perft differs from published count");
+                }
+            }
+        }
+
+        TEST_METHOD(ReferenceMatchesEngine2){
+            for(const auto& c : engine::perft_corpus()){
+                for(int d=1; d<=kDepth; ++d){
+                    Assert::AreEqual(c.nodes[d-1], engine::perft_reference(c.fen, d), L"ChessEngine1 perft differs from published count");
+                }
+            }
+        }
+
+        TEST_METHOD(HashThreadsAndBulkDoNotChangeCounts){
+            const auto& c = engine::perft_corpus()[1]; // kiwipete: castling, ep, promotions and pins
+            engine::PerftOptions plain;
+            plain.hash_mb = 0; plain.bulk = false;
+            engine::PerftOptions fast;
+            fast.threads = 4; fast.hash_mb = 1;
+            uint64_t expected = engine::perft(c.fen, kDepth + 1, plain).nodes;
+            Assert::AreEqual(c.nodes[kDepth], expected);
+            Assert::AreEqual(expected, engine::perft(c.fen, kDepth + 1, fast).nodes);
+            // Divide sums to the total, one entry per legal root move.
+            auto divide = engine::perft_divide(c.fen, kDepth + 1, fast);
+            uint64_t sum = 0;
+            for(const auto& m : divide) sum += m.second;
+            Assert::AreEqual(size_t(c.nodes[0]), divide.size());
+            Assert::AreEqual(expected, sum);
+        }
+    };
+}
@@ -0,0 +1,135 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/Pgn.h"
+#include "../chessnative2/Perft.h"
+#include "../chessnative2/ChessEngine2.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(PgnTests)
+    {
+    public:
+        TEST_METHOD(SanCoversEveryNotationCase){
+            struct Case { const char* fen; const char* uci; const char* san; };
+            const Case cases[] = {
+                { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "g1f3", "Nf3" },
+                { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e2e4", "e4" },
+                { "4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1", "e1g1", "O-O" },
+                { "4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1", "e1c1", "O-O-O" },
+                { "4k3/8/8/8/8/5N2/8/1N2K3 w - - 0 1", "b1d2", "Nbd2" },           // file tells the knights apart
+                { "4k3/8/8/8/R7/8/8/R3K3 w - - 0 1", "a1a2", "R1a2" },              // same file: rank
+                { "K1k5/8/8/8/Q6Q/8/8/7Q w - - 0 1", "h4e4", "Qh4e4" },             // neither alone is enough
+                { "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 2", "e5d6", "exd6" },            // en passant
+                { "3rk3/4P3/8/8/8/8/8/4K3 w - - 0 1", "e7d8q", "exd8=Q+" },
+                { "4k3/8/8/8/8/8/4p3/3RK3 b - - 0 1", "e2d1n", "exd1=N" },
+                { "6k1/5ppp/8/8/8/8/8/R3K3 w - - 0 1", "a1a8", "Ra8#" },
+                { "4k3/8/8/8/8/8/8/4KR2 w - - 0 1", "f1f8", "Rf8+" },
+                { "r3k3/8/8/8/8/8/8/4K3 b q - 0 1", "e8c8", "O-O-O" },
+                { "4k3/8/8/8/8/8/8/RK5R w HA - 0 1", "b1a1", "O-O-O" },             // Chess960, king takes rook
+            };
+            for(const Case& c : cases){
+                std::string san = engine::to_san(c.fen, c.uci);
+                std::wstring msg(c.san, c.san + std::strlen(c.san));
+                Assert::AreEqual(std::string(c.san), san, msg.c_str());
+                Assert::AreEqual(std::string(c.uci), engine::from_san(c.fen, c.san), msg.c_str());
+            }
+            Assert::AreEqual(std::string("g1f3"), engine::from_san("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "Ng1-f3!?"));
+            Assert::AreEqual(std::string("e7d8q"), engine::from_san("3rk3/4P3/8/8/8/8/8/4K3 w - - 0 1", "exd8Q"));
+            Assert::AreEqual(std::string("e1g1"), engine::from_san("4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1", "0-0"));
+            Assert::AreEqual(std::string(), engine::from_san("K1k5/8/8/8/Q6Q/8/8/7Q w - - 0 1", "Qe4"), L"Ambiguous SAN accepted");
+            Assert::AreEqual(std::string(), engine::to_san("4k3/8/8/8/8/8/8/4K3 w - - 0 1", "e1e3"), L"Illegal move written");
+        }
+
+        // Every legal move of the perft corpus (standard and Chess960) goes to SAN and back unchanged.
+        TEST_METHOD(SanRoundTripsOverCorpus){
+            engine::ChessEngine2 e;
+            for(const auto& c : engine::perft_corpus()){
+                std::vector<std::string> frontier(1, c.fen);
+                for(const std::string& m : e.legal_moves_uci(c.fen)) frontier.push_back(e.apply_move(c.fen, m));
+                for(const std::string& fen : frontier){
+                    std::vector<std::string> sans;
+                    for(const std::string& m : e.legal_moves_uci(fen)){
+                        std::string san = engine::to_san(fen, m);
+                        Assert::IsFalse(san.empty());
+                        Assert::AreEqual(m, engine::from_san(fen, san));
+                        sans.push_back(san);
+                    }
+                    std::sort(sans.begin(), sans.end());
+                    Assert::IsTrue(std::adjacent_find(sans.begin(), sans.end()) == sans.end(), L"Two moves share a SAN");
+                }
+            }
+        }
+
+        TEST_METHOD(ReaderSkipsCommentsAndVariations){
+            const std::string text =
+                "[Event \"Test \\\"one\\\"\"]\n[Site \"?\"]\n[Result \"1-0\"]\n\n"
+                "1. e4 {best by test} e5 2. Nf3 (2. f4 exf4 (2... d5) 3. Nf3) 2... Nc6 $1 3.Bb5 a6?! ; Ruy Lopez\n"
+                "4. Ba4 Nf6 5. O-O 1-0\n\n"
+                "[Event \"Setup\"]\n[SetUp \"1\"]\n[FEN \"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\"]\n\n"
+                "1. e4 Kd7 2. e5 Ke6 *\n\n"
+                "[Event \"Broken\"]\n\n1. e4 e5 2. Ke3 Nf6 0-1\n\n"
+                "[Event \"Zeros\"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bc4 Bc5 4.0-0 Nf6 5 d3 0-0 *\n";
+            engine::PgnReader reader(text.data(), text.size());
+            std::vector<engine::PgnGame> games;
+            std::vector<std::string> events;
+            size_t n = reader.for_each([&](const engine::PgnGame& g){ games.push_back(g); events.push_back(g.tag("Event").str()); });
+            Assert::AreEqual((size_t)4, n);
+            Assert::AreEqual(std::string("Test \\\"one\\\""), events[0]);
+            Assert::AreEqual((size_t)9, games[0].moves.size());
+            Assert::IsTrue(games[0].ok());
+            Assert::IsTrue(games[0].result == "1-0");
+            Assert::AreEqual(std::string("e1g1"), engine::move_uci(games[0].moves.back()));
+            Assert::AreEqual(std::string("4k3/8/8/8/8/8/4P3/4K3 w - - 0 1"), games[1].fen);
+            Assert::AreEqual((size_t)4, games[1].moves.size());
+            Assert::IsTrue(games[1].result == "*");
+            Assert::AreEqual(2, games[2].error_ply, L"Illegal Ke3 not reported at its ply");
+            Assert::AreEqual((size_t)2, games[2].moves.size());
+            // Castling written with zeros is not a move number; a bare "5" is.
+            Assert::IsTrue(games[3].ok(), L"Zero castling stopped the game");
+            Assert::AreEqual((size_t)10, games[3].moves.size());
+            Assert::AreEqual(std::string("e1g1"), engine::move_uci(games[3].moves[6]));
+            Assert::AreEqual(std::string("e8g8"), engine::move_uci(games[3].moves[9]));
+        }
+
+        // Games written by write_pgn read back move for move, with one worker or several.
+        TEST_METHOD(WriterAndParallelReaderRoundTrip){
+            engine::ChessEngine2 e;
+            std::string text;
+            std::vector<std::vector<std::string>> written;
+            const char* starts[] = { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", "bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w HFhf - 2 9" };
+            for(int g = 0; g < 60; ++g){
+                std::string fen = starts[g % 3];
+                std::vector<std::string> moves;
+                for(int ply = 0; ply < 30 + g % 17; ++ply){
+                    auto legal = e.legal_moves_uci(fen);
+                    if(legal.empty()) break;
+                    moves.push_back(legal[(g * 7 + ply * 13) % legal.size()]);
+                    fen = e.apply_move(fen, moves.back());
+                }
+                written.push_back(moves);
+                text += engine::write_pgn({ { "Event", "Round trip" }, { "Round", std::to_string(g) } }, starts[g % 3], moves, "*");
+            }
+            for(int threads : { 1, 4 }){
+                engine::PgnReader reader(text.data(), text.size());
+                std::mutex lock;
+                std::map<int, std::vector<std::string>> read;
+                size_t n = reader.for_each([&](const engine::PgnGame& g){
+                    Assert::IsTrue(g.ok());
+                    std::vector<std::string> moves;
+                    for(uint16_t m : g.moves) moves.push_back(engine::move_uci(m));
+                    std::lock_guard<std::mutex> hold(lock);
+                    read[std::stoi(g.tag("Round").str())] = moves;
+                }, threads);
+                Assert::AreEqual(written.size(), n);
+                for(size_t g = 0; g < written.size(); ++g) Assert::IsTrue(written[g] == read[(int)g], L"Game did not read back as written");
+            }
+        }
+    };
+}
@@ -0,0 +1,75 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/EngineRegistry.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(SlicedSearchTests)
+    {
+    public:
+        // Runs the search slices nodes at a time; returns the number of slices it took.
+        static int RunInSlices(engine::SlicedSearch& s, uint64_t nodes){
+            int slices = 1;
+            while(!s.advance(nodes, 0)) ++slices;
+            Assert::IsTrue(s.finished());
+            return slices;
+        }
+
+        // However small the slices, every engine plays the move its choose_move plays.
+        TEST_METHOD(EveryEngineMatchesChooseMove){
+            const char* fens[] = {
+                "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                "3r2k1/2q2ppp/8/8/8/8/3Q1PPP/3R2K1 w - - 0 1",
+                "8/2p5/7p/pP2k1pP/5pP1/8/1P2PPK1/8 w - - 0 1",
+            };
+            for(const auto& info : engine::engine_registry()){
+                for(auto fen : fens){
+                    auto whole = info.create(), sliced = info.create();
+                    std::string expected = whole->choose_move(fen, 3);
+                    auto search = sliced->start_search(fen, 3);
+                    Assert::IsTrue(search->best_move().empty());
+                    RunInSlices(*search, 7);
+                    Assert::AreEqual(expected, search->best_move(), L"Sliced search chose another move");
+                }
+            }
+        }
+
+        // Engine2 stops between nodes and resumes the same search: the same nodes, scores and move as
+        // one call, with extensions on and singular extensions (which search inside a node) on as well.
+        TEST_METHOD(Engine2ResumesTheSameSearch){
+            const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+            for(int singular = 0; singular < 2; ++singular){
+                engine::ChessEngine2 whole, sliced;
+                whole.set_option("ExtensionBudget", 2);
+                sliced.set_option("ExtensionBudget", 2);
+                whole.set_option("SingularExtension", singular);
+                sliced.set_option("SingularExtension", singular);
+                std::string expected = whole.choose_move(fen, 4);
+                uint64_t nodes = whole.last_search_stats().nodes;
+                auto scores = whole.root_search_scores(fen, 4);
+                auto search = sliced.start_search(fen, 4);
+                Assert::IsTrue(RunInSlices(*search, 100) > 10, L"Node budget not kept");
+                Assert::AreEqual(expected, search->best_move());
+                Assert::AreEqual(nodes, sliced.last_search_stats().nodes, L"Sliced search visited other nodes");
+                Assert::IsTrue(scores == search->root_scores(), L"Root scores differ from root_search_scores");
+                Assert::IsTrue(search->advance(1, 0), L"A finished search is not finished");
+            }
+            // An abandoned search hands its tables back; the engine searches on as before.
+            engine::ChessEngine2 e;
+            std::string expected = e.choose_move(fen, 3);
+            e.new_game();
+            {
+                auto search = e.start_search(fen, 3);
+                Assert::IsFalse(search->advance(50, 0));
+            }
+            Assert::AreEqual(expected, e.choose_move(fen, 3));
+            auto timed = e.start_search(fen, 5);
+            Assert::IsFalse(timed->advance(0, 1000), L"A 1 ms slice ran a depth-5 search to the end");
+        }
+    };
+}
@@ -0,0 +1,139 @@
+#include "CppUnitTest.h"
+#include "../chessnative2/Texel.h"
+#include "../chessnative2/Pgn.h"
+#include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/EngineBase.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ChessNativeTests {
+
+    TEST_CLASS(TexelTests)
+    {
+    public:
+        TEST_METHOD(PackedPositionsRoundTrip){
+            const char* fens[] = {
+                "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+                "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+                "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            };
+            std::vector<engine::PackedPosition> packed;
+            for(const char* fen : fens){
+                engine::BoardState b;
+                b.loadFEN(fen);
+                engine::PackedPosition p = engine::pack_position(fen, 2, -37);
+                uint64_t pieces[12];
+                engine::unpack_pieces(p, pieces);
+                Assert::IsTrue(std::equal(pieces, pieces + 12, b.pieces), L"Bitboards changed by packing");
+                Assert::AreEqual(b.side_to_move, (int)p.side);
+                int material = 0;
+                const int values[6] = { 100, 300, 300, 500, 900, 10000 };
+                for(int t = 0; t < 6; ++t){
+                    for(uint64_t x = b.pieces[t]; x; x &= x - 1) material += values[t];
+                    for(uint64_t x = b.pieces[t + 6]; x; x &= x - 1) material -= values[t];
+                }
+                Assert::AreEqual(material, engine::EvalWeights::engine_default().evaluate(p), L"Default weights are not the engine's material count");
+                packed.push_back(p);
+            }
+            const char* path = "texel_roundtrip.ctp";
+            std::remove(path);
+            {
+                engine::PositionWriter w(path);
+                Assert::IsTrue(w.is_open());
+                w.write(packed.data(), 2);
+            }
+            {
+                engine::PositionWriter w(path); // appends without a second header
+                w.write(packed.data() + 2, 1);
+            }
+            std::vector<engine::PackedPosition> read;
+            Assert::IsTrue(engine::read_positions(path, read));
+            std::remove(path);
+            Assert::AreEqual(packed.size(), read.size());
+            for(size_t i = 0; i < packed.size(); ++i){
+                Assert::IsTrue(std::memcmp(&packed[i], &read[i], sizeof(engine::PackedPosition)) == 0, L"Record did not read back");
+            }
+        }
+
+        // 2. a3?? leaves e4 hanging, so only the position before dxe4 is dropped; exd5 Qxd5 is an even trade.
+        TEST_METHOD(ExtractorKeepsQuietPositions){
+            const std::string text =
+                "[Event \"Quiet\"]\n[Result \"1/2-1/2\"]\n\n1. e4 d5 2. a3 dxe4 3. Nc3 Nf6 1/2-1/2\n\n"
+                "[Event \"Unfinished\"]\n[Result \"*\"]\n\n1. e4 e5 *\n\n"
+                "[Event \"Win\"]\n[Result \"1-0\"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 d6 1-0\n";
+            engine::PgnReader reader(text.data(), text.size());
+            engine::ExtractOptions opt;
+            opt.skip_plies = 0;
+            std::vector<engine::PackedPosition> out;
+            engine::ExtractStats s = engine::extract_positions(reader, opt, [&](const engine::PackedPosition* p, size_t n){ out.insert(out.end(), p, p + n); });
+            Assert::AreEqual((size_t)3, s.games);
+            Assert::AreEqual((size_t)1, s.skipped_games);
+            Assert::AreEqual((size_t)7 + 15, s.positions);
+            Assert::AreEqual(s.positions, s.written + s.in_check + s.not_quiet);
+            Assert::AreEqual(s.written, out.size());
+            std::vector<int> quietPlies;
+            for(const auto& p : out){
+                Assert::AreEqual(engine::EvalWeights::engine_default().evaluate(p), (int)p.score, L"Quiet score is not the static evaluation");
+                if(p.result == 1) quietPlies.push_back(p.ply);
+            }
+            Assert::IsTrue(quietPlies == std::vector<int>({ 0, 1, 2, 4, 5, 6 }), L"Wrong positions kept from the first game");
+
+            // Several workers and a deeper search score keep the same positions.
+            opt.threads = 3;
+            opt.skip_plies = 4;
+            opt.search_depth = 2;
+            std::vector<engine::PackedPosition> deep;
+            engine::extract_positions(reader, opt, [&](const engine::PackedPosition* p, size_t n){ deep.insert(deep.end(), p, p + n); });
+            auto key = [](const engine::PackedPosition& p){ return std::make_tuple(p.result, p.ply, p.occupied); };
+            std::vector<std::tuple<int, int, uint64_t>> a, b;
+            for(const auto& p : out) if(p.ply >= 4) a.push_back(key(p));
+            for(const auto& p : deep) b.push_back(key(p));
+            std::sort(a.begin(), a.end());
+            std::sort(b.begin(), b.end());
+            Assert::IsTrue(a == b);
+        }
+
+        // Scores from a known evaluation (heavier knights, pawns worth more as they advance) are fitted
+        // from the engine's material values.
+        TEST_METHOD(TunerFitsKnownEvaluation){
+            engine::EvalWeights truth = engine::EvalWeights::engine_default();
+            truth.material[1] = 340;
+            for(int sq = 8; sq < 56; ++sq) truth.pst[0][sq] = 8 * (sq / 8 - 1);
+            engine::ChessEngine2 e;
+            std::vector<engine::PackedPosition> positions;
+            uint32_t seed = 7;
+            for(int g = 0; g < 150; ++g){
+                std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+                for(int ply = 0; ply < 80; ++ply){
+                    auto legal = e.legal_moves_uci(fen);
+                    if(legal.empty()) break;
+                    seed = seed * 1664525u + 1013904223u;
+                    fen = e.apply_move(fen, legal[(seed >> 8) % legal.size()]);
+                    engine::PackedPosition p = engine::pack_position(fen, 1, 0);
+                    p.score = (int16_t)std::max(-30000, std::min(truth.evaluate(p), 30000));
+                    positions.push_back(p);
+                }
+            }
+            engine::TuneOptions opt;
+            opt.k = 1.0;
+            opt.lambda = 1.0;
+            opt.epochs = 200;
+            engine::TuneResult r = engine::tune_weights(positions, engine::EvalWeights::engine_default(), opt);
+            Assert::IsTrue(r.final_error < r.initial_error / 4, L"Tuning did not reduce the error");
+            Assert::IsTrue(r.weights.material[1] > 310, L"Knight value did not move towards 340");
+            Assert::IsTrue(r.weights.pst[0][6 * 8 + 3] > r.weights.pst[0][1 * 8 + 3], L"Advanced pawns not valued higher");
+            Assert::AreEqual(10000, r.weights.material[5]);
+
+            double one = engine::texel_error(positions, r.weights, r.k, opt.lambda, 1);
+            double four = engine::texel_error(positions, r.weights, r.k, opt.lambda, 4);
+            Assert::IsTrue(std::abs(one - four) < 1e-12, L"Thread count changed the error");
+        }
+    };
+}
@@ -0,0 +1,108 @@
+// PerftTool.cpp : Perft driver for ChessEngine2's move generator.
+//
+//   perft_tool --depth 6 --threads 8 --hash 256 --fen "<fen>"   count one position
+//   perft_tool --depth 7 --threads 64 --affinity scatter        workers pinned round-robin over NUMA nodes
+//   perft_tool --divide --depth 3 --fen "<fen>"                 per-root-move counts
+//   perft_tool --check --depth 4                                corpus vs published counts and ChessEngine1
+//
+// --check is the move generation gate: every corpus position must match its published count,
+// and ChessEngine1's plain recursive perft must agree with ChessEngine2's at every depth.
+
+#include "../chessnative2/Perft.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+void usage()
+{
+    std::printf( "usage: perft_tool [--fen FEN] [--depth N] [--threads N] [--hash MB] [--no-bulk] [--affinity none|compact|scatter] [--divide] [--check] [--no-reference]\n" );
+}
+
+int run_check( int depth, const engine::PerftOptions& opt, bool reference )
+{
+    int failures = 0;
+    const auto& corpus = engine::perft_corpus();
+    for ( size_t i = 0; i < corpus.size(); ++i )
+    {
+        const engine::PerftCase& c = corpus[ i ];
+        for ( int d = 1; d <= depth && d <= 6; ++d )
+        {
+            if ( c.nodes[ d - 1 ] == 0 )
+                continue;
+            engine::PerftResult r = engine::perft( c.fen, d, opt );
+            bool ok = r.nodes == c.nodes[ d - 1 ];
+            uint64_t ref = reference ? engine::perft_reference( c.fen, d ) : r.nodes;
+            ok = ok && ref == r.nodes;
+            std::printf( "%-4s #%zu d%d %12llu expected %12llu reference %12llu %8.1f Mnps\n", ok ? "ok" : "FAIL", i, d,
+                         ( unsigned long long )r.nodes, ( unsigned long long )c.nodes[ d - 1 ], ( unsigned long long )ref, r.nps() / 1e6 );
+            std::fflush( stdout );
+            failures += ok ? 0 : 1;
+        }
+    }
+    std::printf( "%d failure(s)\n", failures );
+    return failures ? 1 : 0;
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    engine::PerftOptions opt;
+    opt.threads = ( int )std::thread::hardware_concurrency();
+    if ( opt.threads < 1 )
+        opt.threads = 1;
+    std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    int depth = 5;
+    bool divide = false, check = false, reference = true;
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        if ( a == "--fen" && i + 1 < argc )
+            fen = argv[ ++i ];
+        else if ( a == "--depth" && i + 1 < argc )
+            depth = std::atoi( argv[ ++i ] );
+        else if ( a == "--threads" && i + 1 < argc )
+            opt.threads = std::atoi( argv[ ++i ] );
+        else if ( a == "--hash" && i + 1 < argc )
+            opt.hash_mb = ( size_t )std::atoi( argv[ ++i ] );
+        else if ( a == "--no-bulk" )
+            opt.bulk = false;
+        else if ( a == "--affinity" && i + 1 < argc && engine::parse_affinity( argv[ i + 1 ], opt.affinity ) )
+            ++i;
+        else if ( a == "--divide" )
+            divide = true;
+        else if ( a == "--check" )
+            check = true;
+        else if ( a == "--no-reference" )
+            reference = false;
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+
+    if ( check )
+        return run_check( depth, opt, reference );
+
+    if ( divide )
+    {
+        uint64_t total = 0;
+        for ( const auto& m : engine::perft_divide( fen, depth, opt ) )
+        {
+            std::printf( "%s: %llu\n", m.first.c_str(), ( unsigned long long )m.second );
+            total += m.second;
+        }
+        std::printf( "\nNodes searched: %llu\n", ( unsigned long long )total );
+        return 0;
+    }
+
+    engine::PerftResult r = engine::perft( fen, depth, opt );
+    std::printf( "depth %d nodes %llu time %.3fs nps %.0f hash hits %llu threads %d\n", depth, ( unsigned long long )r.nodes, r.seconds, r.nps(),
+                 ( unsigned long long )r.hash_hits, opt.threads );
+    return 0;
+}
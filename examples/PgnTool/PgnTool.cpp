@@ -0,0 +1,115 @@
+// PgnTool.cpp : Driver for the memory-mapped PGN reader.
+//
+//   pgn_tool --threads 8 games.pgn          parse every game, report games / plies / errors / MB/s
+//   pgn_tool --generate 2000 out.pgn        write pseudo-random legal games with write_pgn
+//
+// Games with a move that is not legal SAN are counted, and the first few are listed with their
+// offset and ply, so a broken database can be found with a text editor.
+
+#include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/Pgn.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+void usage()
+{
+    std::printf( "usage: pgn_tool [--threads N] FILE | pgn_tool --generate N FILE\n" );
+}
+
+int generate( int games, const std::string& path )
+{
+    FILE* f = std::fopen( path.c_str(), "wb" );
+    if ( !f )
+    {
+        std::printf( "cannot write %s\n", path.c_str() );
+        return 1;
+    }
+    engine::ChessEngine2 e;
+    const std::string start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    uint32_t seed = 12345;
+    for ( int g = 0; g < games; ++g )
+    {
+        std::string fen = start;
+        std::vector<std::string> moves;
+        for ( int ply = 0; ply < 160; ++ply )
+        {
+            auto legal = e.legal_moves_uci( fen );
+            if ( legal.empty() )
+                break;
+            seed = seed * 1664525u + 1013904223u;
+            moves.push_back( legal[ ( seed >> 8 ) % legal.size() ] );
+            fen = e.apply_move( fen, moves.back() );
+        }
+        std::string text = engine::write_pgn( { { "Event", "Generated" }, { "Round", std::to_string( g + 1 ) } }, start, moves, "*" );
+        std::fwrite( text.data(), 1, text.size(), f );
+    }
+    std::fclose( f );
+    return 0;
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    int threads = ( int )std::thread::hardware_concurrency();
+    if ( threads < 1 )
+        threads = 1;
+    int games = 0;
+    std::string path;
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        if ( a == "--threads" && i + 1 < argc )
+            threads = std::atoi( argv[ ++i ] );
+        else if ( a == "--generate" && i + 1 < argc )
+            games = std::atoi( argv[ ++i ] );
+        else if ( a[ 0 ] != '-' && path.empty() )
+            path = a;
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+    if ( path.empty() )
+    {
+        usage();
+        return 1;
+    }
+    if ( games > 0 )
+        return generate( games, path );
+
+    engine::PgnReader reader( path );
+    if ( !reader.is_open() )
+    {
+        std::printf( "cannot open %s\n", path.c_str() );
+        return 1;
+    }
+    std::atomic<uint64_t> plies{ 0 }, errors{ 0 };
+    std::mutex lock;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t n = reader.for_each(
+        [&]( const engine::PgnGame& g ) {
+            plies += g.moves.size();
+            if ( g.ok() )
+                return;
+            if ( errors++ < 10 )
+            {
+                std::lock_guard<std::mutex> hold( lock );
+                std::printf( "error at offset %zu ply %d\n", g.offset, g.error_ply );
+            }
+        },
+        threads );
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+    std::printf( "games %zu plies %llu errors %llu size %.1f MB time %.3fs %.1f MB/s threads %d\n", n, ( unsigned long long )plies.load(),
+                 ( unsigned long long )errors.load(), reader.size() / 1e6, seconds, seconds > 0 ? reader.size() / 1e6 / seconds : 0.0, threads );
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+// TexelTool.cpp : Evaluation tuning pipeline, PGN archive to tuned weights.
+//
+//   texel_tool extract [--threads N] [--skip N] [--sample N] [--depth N] games.pgn positions.ctp
+//       quiet positions of every finished game, appended to a packed positions file
+//   texel_tool tune [--threads N] [--epochs N] [--rate X] [--k X] [--lambda X] [--no-material] [--no-pst] positions.ctp
+//       fits material and piece-square tables from ChessEngine2's values and prints them as C++
+//
+// Extraction runs more than once into the same file to merge archives. A position takes 32 bytes
+// in memory while tuning, so tens of millions fit in a few gigabytes.
+
+#include "../chessnative2/Pgn.h"
+#include "../chessnative2/Texel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+void usage()
+{
+    std::printf( "usage: texel_tool extract [--threads N] [--skip N] [--sample N] [--depth N] GAMES.pgn OUT.ctp\n"
+                 "       texel_tool tune [--threads N] [--epochs N] [--rate X] [--k X] [--lambda X] [--no-material] [--no-pst] IN.ctp\n" );
+}
+
+double seconds_since( std::chrono::steady_clock::time_point t0 )
+{
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+}
+
+int extract( const engine::ExtractOptions& opt, const std::string& pgn, const std::string& out )
+{
+    engine::PgnReader reader( pgn );
+    if ( !reader.is_open() )
+    {
+        std::printf( "cannot open %s\n", pgn.c_str() );
+        return 1;
+    }
+    engine::PositionWriter writer( out );
+    if ( !writer.is_open() )
+    {
+        std::printf( "cannot write %s\n", out.c_str() );
+        return 1;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    engine::ExtractStats s = engine::extract_positions( reader, opt, [&]( const engine::PackedPosition* p, size_t n ) { writer.write( p, n ); } );
+    std::printf( "games %zu skipped %zu positions %zu in check %zu not quiet %zu written %zu time %.1fs\n", s.games, s.skipped_games, s.positions,
+                 s.in_check, s.not_quiet, s.written, seconds_since( t0 ) );
+    return 0;
+}
+
+int tune( const engine::TuneOptions& opt, const std::string& path )
+{
+    std::vector<engine::PackedPosition> positions;
+    if ( !engine::read_positions( path, positions ) )
+    {
+        std::printf( "cannot read %s\n", path.c_str() );
+        return 1;
+    }
+    std::printf( "%zu positions (%.1f MB)\n", positions.size(), positions.size() * sizeof( engine::PackedPosition ) / 1e6 );
+    auto t0 = std::chrono::steady_clock::now();
+    engine::TuneResult r = engine::tune_weights( positions, engine::EvalWeights::engine_default(), opt, [&]( int epoch, double error ) {
+        if ( epoch % 25 == 0 )
+        {
+            std::printf( "epoch %4d error %.6f %.1fs\n", epoch, error, seconds_since( t0 ) );
+            std::fflush( stdout );
+        }
+    } );
+    std::printf( "k %.4f error %.6f -> %.6f\n\n%s", r.k, r.initial_error, r.final_error, engine::format_weights( r.weights ).c_str() );
+    return 0;
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    if ( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+    std::string mode = argv[ 1 ];
+    int threads = ( int )std::thread::hardware_concurrency();
+    if ( threads < 1 )
+        threads = 1;
+    engine::ExtractOptions ex;
+    engine::TuneOptions tu;
+    std::vector<std::string> files;
+    for ( int i = 2; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        if ( a == "--threads" && i + 1 < argc )
+            threads = std::atoi( argv[ ++i ] );
+        else if ( a == "--skip" && i + 1 < argc )
+            ex.skip_plies = std::atoi( argv[ ++i ] );
+        else if ( a == "--sample" && i + 1 < argc )
+            ex.sample_every = std::atoi( argv[ ++i ] );
+        else if ( a == "--depth" && i + 1 < argc )
+            ex.search_depth = std::atoi( argv[ ++i ] );
+        else if ( a == "--epochs" && i + 1 < argc )
+            tu.epochs = std::atoi( argv[ ++i ] );
+        else if ( a == "--rate" && i + 1 < argc )
+            tu.learning_rate = std::atof( argv[ ++i ] );
+        else if ( a == "--k" && i + 1 < argc )
+            tu.k = std::atof( argv[ ++i ] );
+        else if ( a == "--lambda" && i + 1 < argc )
+            tu.lambda = std::atof( argv[ ++i ] );
+        else if ( a == "--no-material" )
+            tu.tune_material = false;
+        else if ( a == "--no-pst" )
+            tu.tune_pst = false;
+        else if ( a[ 0 ] != '-' )
+            files.push_back( a );
+        else
+        {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+    ex.threads = tu.threads = threads;
+    if ( mode == "extract" && files.size() == 2 )
+        return extract( ex, files[ 0 ], files[ 1 ] );
+    if ( mode == "tune" && files.size() == 1 )
+        return tune( tu, files[ 0 ] );
+    usage();
+    return 1;
+}
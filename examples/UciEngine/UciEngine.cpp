@@ -0,0 +1,447 @@
+// UciEngine.cpp : UCI front end for the registered engines, plus a fixed-depth "bench" command.
+//
+//   uci_engine                                    speak UCI on stdin/stdout (Engine2 by default)
+//   uci_engine --engine Engine1                   pick another registered engine
+//   uci_engine --option BatchFrontier=false bench 5
+//
+// Options are announced from the engine's schema, so anything an engine registers can be set by a GUI
+// with "setoption" or on the command line with --option, and A/B-compared with "bench" without rebuilding.
+// Commands after the flags are run in order and the program exits, as with Stockfish's "bench".
+//
+//   uci_engine --option AnalysisFile=/var/lib/chess/analysis.cas
+//
+// maps a persistent analysis store (created at 256 MB if missing) that every engine process given the
+// same file shares. Results are keyed by engine and by the options that change them, so an engine only
+// reuses what the same engine with the same settings found; "bench" always searches without it.
+//
+//   uci_engine --engine MCTS scaling 8 4
+//
+// runs the bench positions with 1, 2, 4, 8 threads: the MCTS engine puts all of them on each search,
+// the alpha-beta engines run one bench per thread.
+
+#include "../chessnative2/AnalysisStore.h"
+#include "../chessnative2/EngineRegistry.h"
+#include "../chessnative2/MateEngine.hpp"
+#include "../chessnative2/Zobrist.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const char* const kStartFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Fixed bench positions; changing the list invalidates node counts recorded from earlier runs.
+const char* const kBenchFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "4r1k1/p1pb1ppp/Qbp1r3/8/1P6/2Pq1B2/R2P1PPP/2B2RK1 b - - 0 1",
+    "r1bq1rk1/pp4bp/2np4/2p1p1p1/P1N1P3/1P1P1NP1/1BP1QPKP/1R3R2 b - - 0 1",
+    "8/2p5/7p/pP2k1pP/5pP1/8/1P2PPK1/8 w - - 0 1",
+    "8/2kPR3/5q2/5N2/8/1p1P4/1p6/1K6 w - - 0 1",
+};
+
+const char* type_name( engine::EngineOption::Type t )
+{
+    switch ( t )
+    {
+    case engine::EngineOption::Type::Check: return "check";
+    case engine::EngineOption::Type::Combo: return "combo";
+    default: return "spin";
+    }
+}
+
+class UciSession
+{
+public:
+    explicit UciSession( const engine::EngineInfo& info ) { select( info ); }
+
+    bool set_option( const std::string& name, const std::string& value )
+    {
+        if ( name == "Engine" )
+        {
+            const engine::EngineInfo* info = engine::find_engine( value );
+            if ( info )
+                select( *info );
+            return info != nullptr;
+        }
+        if ( name == "AnalysisFile" )
+        {
+            std::shared_ptr< engine::AnalysisStore > next;
+            if ( !value.empty() && value != "<empty>" )
+            {
+                next = std::make_shared< engine::AnalysisStore >( value, 256 );
+                if ( !next->is_open() )
+                    return false;
+            }
+            store = next;
+            eng->set_analysis_store( store );
+            return true;
+        }
+        return eng->set_option( name, value );
+    }
+
+    // Returns false on "quit".
+    bool handle( const std::string& line )
+    {
+        std::istringstream in( line );
+        std::string cmd;
+        in >> cmd;
+        if ( cmd == "uci" )
+        {
+            std::printf( "id name ChessCpp %s\nid author ChessCpp\n", info->name );
+            std::printf( "option name Engine type combo default %s", info->name );
+            for ( const auto& e : engine::engine_registry() )
+                std::printf( " var %s", e.name );
+            std::printf( "\noption name AnalysisFile type string default <empty>\n" );
+            for ( const engine::EngineOption& o : eng->options() )
+            {
+                engine::EngineOption def = o;
+                def.value = o.default_value;
+                std::printf( "option name %s type %s default %s", o.name.c_str(), type_name( o.type ), def.value_string().c_str() );
+                if ( o.type == engine::EngineOption::Type::Spin )
+                    std::printf( " min %d max %d", o.min, o.max );
+                for ( const auto& c : o.choices )
+                    std::printf( " var %s", c.c_str() );
+                std::printf( "\n" );
+            }
+            std::printf( "uciok\n" );
+        }
+        else if ( cmd == "isready" )
+            std::printf( "readyok\n" );
+        else if ( cmd == "setoption" )
+            setoption( in );
+        else if ( cmd == "ucinewgame" )
+        {
+            eng->new_game();
+            set_position( kStartFen );
+        }
+        else if ( cmd == "position" )
+            position( in );
+        else if ( cmd == "go" )
+            go( in );
+        else if ( cmd == "bench" )
+            bench( in );
+        else if ( cmd == "scaling" )
+            scaling( in );
+        else if ( cmd == "d" )
+            std::printf( "%s\n", fens.back().c_str() );
+        else if ( cmd == "quit" )
+            return false;
+        else if ( !cmd.empty() )
+            std::printf( "info string unknown command %s\n", cmd.c_str() );
+        std::fflush( stdout );
+        return true;
+    }
+
+private:
+    const engine::EngineInfo* info = nullptr;
+    std::unique_ptr< engine::EngineBase > eng;
+    std::shared_ptr< engine::AnalysisStore > store;
+    std::vector< std::string > fens;
+    std::vector< uint64_t > keys;
+
+    // Switching engines carries over the values of options both engines have.
+    void select( const engine::EngineInfo& next )
+    {
+        std::unique_ptr< engine::EngineBase > e = next.create();
+        if ( eng )
+            for ( const engine::EngineOption& o : eng->options() )
+                e->set_option( o.name, o.value );
+        info = &next;
+        eng = std::move( e );
+        eng->set_analysis_store( store );
+        if ( fens.empty() )
+            set_position( kStartFen );
+        eng->set_game_history( std::vector< uint64_t >( keys.begin(), keys.end() - 1 ) );
+    }
+
+    void set_position( const std::string& fen )
+    {
+        fens.assign( 1, fen );
+        keys.assign( 1, engine::zobrist_hash_fen( fen ) );
+        eng->set_game_history( {} );
+    }
+
+    // setoption name <name...> [value <value...>]; both parts may contain spaces.
+    void setoption( std::istringstream& in )
+    {
+        std::string tok, name, value;
+        std::string* cur = nullptr;
+        while ( in >> tok )
+        {
+            if ( tok == "name" )
+                cur = &name;
+            else if ( tok == "value" )
+                cur = &value;
+            else if ( cur )
+                *cur += ( cur->empty() ? "" : " " ) + tok;
+        }
+        if ( !set_option( name, value ) )
+            std::printf( "info string cannot set option %s to %s\n", name.c_str(), value.c_str() );
+    }
+
+    // position startpos|fen <fen> [moves <uci>...]
+    void position( std::istringstream& in )
+    {
+        std::string tok, fen;
+        in >> tok;
+        if ( tok == "startpos" )
+        {
+            fen = kStartFen;
+            in >> tok;
+        }
+        else if ( tok == "fen" )
+        {
+            while ( in >> tok && tok != "moves" )
+                fen += ( fen.empty() ? "" : " " ) + tok;
+        }
+        else
+            return;
+        set_position( fen );
+        if ( tok != "moves" )
+            return;
+        while ( in >> tok )
+        {
+            std::string next = eng->apply_move( fens.back(), tok );
+            if ( next.empty() )
+            {
+                std::printf( "info string illegal move %s\n", tok.c_str() );
+                break;
+            }
+            fens.push_back( next );
+            keys.push_back( engine::zobrist_hash_fen( next ) );
+        }
+        eng->set_game_history( std::vector< uint64_t >( keys.begin(), keys.end() - 1 ) );
+    }
+
+    // go depth N, or go mate N: the Mate engine's solver, or for other engines a search deep enough
+    // to see a mate in N. Other go parameters are ignored.
+    void go( std::istringstream& in )
+    {
+        int depth = 4, mate = 0;
+        std::string tok;
+        while ( in >> tok )
+            if ( tok == "depth" )
+                in >> depth;
+            else if ( tok == "mate" )
+                in >> mate;
+        int lines = eng->option_value( "MultiPV" );
+        std::string best;
+        engine::MateEngine* solver = dynamic_cast< engine::MateEngine* >( eng.get() );
+        if ( mate > 0 && solver )
+        {
+            engine::MateResult r = solver->solve_mate( fens.back(), mate );
+            const engine::SearchStats& st = eng->last_search_stats();
+            if ( r.status == engine::MateResult::Status::Mate )
+            {
+                std::string pv;
+                for ( const std::string& m : r.pv )
+                    pv += " " + m;
+                std::printf( "info depth %d score mate %d nodes %llu time %llu pv%s\n", 2 * r.moves - 1, r.moves, ( unsigned long long )r.nodes,
+                             ( unsigned long long )( st.search_ns / 1000000 ), pv.c_str() );
+                std::printf( "bestmove %s\n", r.pv.empty() ? "0000" : r.pv[ 0 ].c_str() );
+                return;
+            }
+            std::printf( "info string %s mate in %d (%llu nodes)\n", r.status == engine::MateResult::Status::NoMate ? "no" : "budget exhausted before finding a", mate,
+                         ( unsigned long long )r.nodes );
+        }
+        else if ( mate > 0 )
+            depth = 2 * mate - 1;
+        if ( lines > 1 )
+        {
+            std::vector< engine::PvLine > pvs = eng->multipv( fens.back(), depth, lines );
+            for ( size_t k = 0; k < pvs.size(); ++k )
+            {
+                std::string pv;
+                for ( const std::string& m : pvs[ k ].pv )
+                    pv += " " + m;
+                std::printf( "info depth %d multipv %zu score cp %d pv%s\n", pvs[ k ].depth, k + 1, pvs[ k ].score, pv.c_str() );
+            }
+            if ( !pvs.empty() && !pvs[ 0 ].pv.empty() )
+                best = pvs[ 0 ].pv[ 0 ];
+        }
+        else
+            best = eng->choose_move( fens.back(), depth );
+        const engine::SearchStats& st = eng->last_search_stats();
+        std::printf( "info depth %d nodes %llu time %llu nps %.0f\n", depth, ( unsigned long long )( st.nodes + st.qnodes ),
+                     ( unsigned long long )( st.search_ns / 1000000 ), st.nps() );
+        std::printf( "bestmove %s\n", best.empty() ? "0000" : best.c_str() );
+    }
+
+    // bench [depth]: fixed positions at a fixed depth; total nodes identify the search, nps its speed.
+    void bench( std::istringstream& in )
+    {
+        int depth = 4;
+        in >> depth;
+        uint64_t nodes = 0, ns = 0;
+        engine::SearchStats caches;
+        eng->set_analysis_store( nullptr );
+        for ( const char* fen : kBenchFens )
+        {
+            eng->set_game_history( {} );
+            std::string best = eng->choose_move( fen, depth );
+            const engine::SearchStats& st = eng->last_search_stats();
+            nodes += st.nodes + st.qnodes;
+            ns += st.search_ns;
+            caches.pawn_probes += st.pawn_probes;
+            caches.pawn_hits += st.pawn_hits;
+            caches.eval_probes += st.eval_probes;
+            caches.eval_hits += st.eval_hits;
+            caches.playouts += st.playouts;
+            std::printf( "%-6s %12llu nodes %10.0f nps  %s\n", best.c_str(), ( unsigned long long )( st.nodes + st.qnodes ), st.nps(), fen );
+        }
+        std::printf( "\nEngine: %s", info->name );
+        for ( const engine::EngineOption& o : eng->options() )
+            std::printf( " %s=%s", o.name.c_str(), o.value_string().c_str() );
+        std::printf( "\nNodes searched  : %llu\nTime (ms)       : %llu\nNodes/second    : %.0f\n", ( unsigned long long )nodes, ( unsigned long long )( ns / 1000000 ),
+                     ns ? double( nodes ) * 1e9 / double( ns ) : 0.0 );
+        if ( caches.pawn_probes )
+            std::printf( "Pawn hash hits  : %.1f%%\n", caches.pawn_hit_rate() * 100.0 );
+        if ( caches.eval_probes )
+            std::printf( "Eval cache hits : %.1f%%\n", caches.eval_hit_rate() * 100.0 );
+        if ( caches.playouts )
+            std::printf( "Playouts        : %llu\n", ( unsigned long long )caches.playouts );
+        eng->set_analysis_store( store );
+        eng->set_game_history( std::vector< uint64_t >( keys.begin(), keys.end() - 1 ) );
+    }
+
+    // scaling [threads] [depth]: the bench positions with 1, 2, 4 .. threads, each count from empty
+    // tables. An engine with a Threads option spends them all on each search, so its speedup is that
+    // of one search. The others search on one thread each, so every thread runs the bench on its own
+    // copy of the engine (a shared table would answer the copies from each other's work) and theirs is
+    // throughput.
+    void scaling( std::istringstream& in )
+    {
+        int most = ( int )std::max( 1u, std::thread::hardware_concurrency() ), depth = 4;
+        in >> most >> depth;
+        most = std::max( 1, most );
+        const bool shared = eng->find_option( "Threads" );
+        const int saved = shared ? eng->option_value( "Threads" ) : 0;
+        const size_t count = sizeof( kBenchFens ) / sizeof( kBenchFens[ 0 ] );
+        eng->set_analysis_store( nullptr );
+        eng->set_game_history( {} );
+        std::printf( "Engine: %s, depth %d, %s\n", info->name, depth, shared ? "threads share each search" : "one search per thread" );
+        double base = 0;
+        for ( int threads = 1;; threads = std::min( threads * 2, most ) )
+        {
+            eng->new_game();
+            uint64_t playouts = 0;
+            auto start = std::chrono::steady_clock::now();
+            if ( shared )
+            {
+                eng->set_option( "Threads", threads );
+                for ( const char* fen : kBenchFens )
+                {
+                    eng->choose_move( fen, depth );
+                    playouts += eng->last_search_stats().playouts;
+                }
+            }
+            else
+            {
+                std::vector< std::unique_ptr< engine::EngineBase > > copies;
+                for ( int t = 0; t < threads; ++t )
+                {
+                    copies.push_back( info->create() );
+                    for ( const engine::EngineOption& o : eng->options() )
+                        copies.back()->set_option( o.name, o.value );
+                }
+                std::vector< std::thread > pool;
+                for ( auto& copy : copies )
+                    pool.emplace_back( [ &copy, depth ] {
+                        for ( const char* fen : kBenchFens )
+                            copy->choose_move( fen, depth );
+                    } );
+                for ( auto& t : pool )
+                    t.join();
+            }
+            double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+            double rate = seconds > 0 ? double( shared ? count : count * threads ) / seconds : 0.0;
+            if ( threads == 1 )
+                base = rate;
+            std::printf( "threads %3d  %9.2f searches/s  speedup %5.2f", threads, rate, base > 0 ? rate / base : 0.0 );
+            if ( playouts )
+                std::printf( "  %10.0f playouts/s", seconds > 0 ? playouts / seconds : 0.0 );
+            std::printf( "\n" );
+            std::fflush( stdout );
+            if ( threads == most )
+                break;
+        }
+        if ( shared )
+            eng->set_option( "Threads", saved );
+        eng->set_analysis_store( store );
+        eng->set_game_history( std::vector< uint64_t >( keys.begin(), keys.end() - 1 ) );
+    }
+};
+
+void usage()
+{
+    std::printf( "usage: uci_engine [--engine NAME] [--option NAME=VALUE]... [command args...]\nengines:" );
+    for ( const auto& e : engine::engine_registry() )
+        std::printf( " %s", e.name );
+    std::printf( "\n" );
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    const engine::EngineInfo* info = &engine::default_engine();
+    std::vector< std::pair< std::string, std::string > > options;
+    std::string command;
+    for ( int i = 1; i < argc; ++i )
+    {
+        std::string a = argv[ i ];
+        if ( a == "--engine" && i + 1 < argc )
+        {
+            info = engine::find_engine( argv[ ++i ] );
+            if ( !info )
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if ( a == "--option" && i + 1 < argc )
+        {
+            std::string kv = argv[ ++i ];
+            size_t eq = kv.find( '=' );
+            options.emplace_back( kv.substr( 0, eq ), eq == std::string::npos ? std::string() : kv.substr( eq + 1 ) );
+        }
+        else if ( a == "--help" || a == "-h" )
+        {
+            usage();
+            return 0;
+        }
+        else
+            command += ( command.empty() ? "" : " " ) + a;
+    }
+
+    UciSession session( *info );
+    for ( const auto& kv : options )
+    {
+        if ( !session.set_option( kv.first, kv.second ) )
+        {
+            std::fprintf( stderr, "cannot set option %s to %s\n", kv.first.c_str(), kv.second.c_str() );
+            return 1;
+        }
+    }
+    if ( !command.empty() )
+    {
+        session.handle( command );
+        return 0;
+    }
+    std::string line;
+    while ( std::getline( std::cin, line ) && session.handle( line ) )
+    {
+    }
+    return 0;
+}
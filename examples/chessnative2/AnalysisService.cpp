@@ -0,0 +1,515 @@
+#include "AnalysisService.h"
+#include "Zobrist.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <sstream>
+
+namespace engine
+{
+    namespace
+    {
+        // Just enough JSON for flat request objects: string, number, true/false/null values, and
+        // nested arrays or objects skipped whole.
+        struct JsonReader
+        {
+            const std::string& s;
+            size_t i = 0;
+
+            explicit JsonReader(const std::string& text) : s(text) {}
+
+            void space()
+            {
+                while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+            }
+            bool eat(char c)
+            {
+                space();
+                if (i >= s.size() || s[i] != c) return false;
+                ++i;
+                return true;
+            }
+            bool string(std::string& out)
+            {
+                if (!eat('"')) return false;
+                out.clear();
+                while (i < s.size() && s[i] != '"')
+                {
+                    char c = s[i++];
+                    if (c != '\\') out.push_back(c);
+                    else if (i < s.size())
+                    {
+                        char e = s[i++];
+                        switch (e)
+                        {
+                        case 'n': out.push_back('\n'); break;
+                        case 't': out.push_back('\t'); break;
+                        case 'r': out.push_back('\r'); break;
+                        case 'b': out.push_back('\b'); break;
+                        case 'f': out.push_back('\f'); break;
+                        case 'u':
+                        {
+                            // FENs and ids are ASCII; anything wider is kept as '?'.
+                            if (i + 4 > s.size()) return false;
+                            long code = std::strtol(s.substr(i, 4).c_str(), nullptr, 16);
+                            out.push_back(code < 0x80 ? (char)code : '?');
+                            i += 4;
+                            break;
+                        }
+                        default: out.push_back(e); break;
+                        }
+                    }
+                }
+                return i++ < s.size();
+            }
+            bool number(double& out)
+            {
+                space();
+                const char* start = s.c_str() + i;
+                char* end = nullptr;
+                out = std::strtod(start, &end);
+                if (end == start) return false;
+                i += end - start;
+                return true;
+            }
+            bool word(const char* w)
+            {
+                space();
+                size_t n = std::char_traits<char>::length(w);
+                if (s.compare(i, n, w) != 0) return false;
+                i += n;
+                return true;
+            }
+            // Calls member(key) for each member of an object; member reads the value.
+            template <class Member>
+            bool object(Member member)
+            {
+                if (!eat('{')) return false;
+                if (eat('}')) return true;
+                std::string key;
+                do
+                    if (!string(key) || !eat(':') || !member(key)) return false;
+                while (eat(','));
+                return eat('}');
+            }
+            template <class Element>
+            bool array(Element element)
+            {
+                if (!eat('[')) return false;
+                if (eat(']')) return true;
+                do
+                    if (!element()) return false;
+                while (eat(','));
+                return eat(']');
+            }
+            bool boolean(bool& out)
+            {
+                if (word("true")) out = true;
+                else if (word("false")) out = false;
+                else return false;
+                return true;
+            }
+            bool skip_value(int nesting = 0)
+            {
+                space();
+                if (i >= s.size() || nesting > 32) return false;
+                std::string text;
+                double d;
+                if (s[i] == '"') return string(text);
+                if (s[i] == '[' || s[i] == '{')
+                {
+                    char close = s[i] == '[' ? ']' : '}';
+                    ++i;
+                    if (eat(close)) return true;
+                    do
+                    {
+                        if (close == '}' && !(string(text) && eat(':'))) return false;
+                        if (!skip_value(nesting + 1)) return false;
+                    } while (eat(','));
+                    return eat(close);
+                }
+                return word("true") || word("false") || word("null") || number(d);
+            }
+        };
+
+        bool read_int(JsonReader& r, int& out)
+        {
+            double d;
+            if (!r.number(d) || d != std::floor(d) || std::fabs(d) > 1e9) return false;
+            out = (int)d;
+            return true;
+        }
+
+        void append_quoted(std::string& out, const std::string& text)
+        {
+            out.push_back('"');
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out.push_back('\\');
+                    out.push_back(c);
+                }
+                else if ((unsigned char)c < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+                    out += buf;
+                }
+                else
+                    out.push_back(c);
+            }
+            out.push_back('"');
+        }
+
+        double ms_between(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b)
+        {
+            return std::chrono::duration<double, std::milli>(b - a).count();
+        }
+
+        // A FEN the engines' loaders can take: six fields, eight ranks of eight squares with one king
+        // per side, w or b to move, and numeric counters. Anything else would reach the loader's
+        // number parsing on a worker thread, or be searched as a position that cannot occur.
+        bool valid_fen(const std::string& fen)
+        {
+            std::istringstream in(fen);
+            std::string f[7];
+            int n = 0;
+            while (n < 7 && in >> f[n]) ++n;
+            if (n != 6 || (f[1] != "w" && f[1] != "b")) return false;
+            int ranks = 1, squares = 0;
+            for (char c : f[0])
+            {
+                if (c == '/') { if (squares != 8) return false; ++ranks; squares = 0; }
+                else squares += c >= '1' && c <= '8' ? c - '0' : 1;
+            }
+            if (ranks != 8 || squares != 8) return false;
+            if (std::count(f[0].begin(), f[0].end(), 'K') != 1 || std::count(f[0].begin(), f[0].end(), 'k') != 1) return false;
+            for (int i = 4; i < 6; ++i)
+                if (f[i].size() > 6 || std::find_if(f[i].begin(), f[i].end(), [](char c) { return c < '0' || c > '9'; }) != f[i].end()) return false;
+            return zobrist_hash_fen(fen) != 0;
+        }
+    } // namespace
+
+    bool parse_request(const std::string& json, AnalysisRequest& out, std::string& error)
+    {
+        out = AnalysisRequest();
+        JsonReader r(json);
+        bool haveFen = false;
+        if (!r.eat('{'))
+        {
+            error = "expected a JSON object";
+            return false;
+        }
+        if (!r.eat('}'))
+        {
+            do
+            {
+                std::string key;
+                if (!r.string(key) || !r.eat(':'))
+                {
+                    error = "malformed JSON";
+                    return false;
+                }
+                bool ok = true;
+                if (key == "id")
+                {
+                    // Clients number their requests; keep numbers as they were written.
+                    r.space();
+                    size_t from = r.i;
+                    double d;
+                    if (r.string(out.id)) {}
+                    else if (r.number(d)) out.id = json.substr(from, r.i - from);
+                    else ok = false;
+                }
+                else if (key == "fen") ok = haveFen = r.string(out.fen);
+                else if (key == "depth") ok = read_int(r, out.depth);
+                else if (key == "multipv") ok = read_int(r, out.multipv);
+                else if (key == "priority") ok = read_int(r, out.priority);
+                else if (key == "deadline_ms") ok = read_int(r, out.deadline_ms);
+                else ok = r.skip_value();
+                if (!ok)
+                {
+                    error = key == "id" || key == "fen" || key == "depth" || key == "multipv" || key == "priority" || key == "deadline_ms"
+                                ? "bad value for " + key
+                                : "malformed JSON";
+                    return false;
+                }
+            } while (r.eat(','));
+            if (!r.eat('}'))
+            {
+                error = "malformed JSON";
+                return false;
+            }
+        }
+        r.space();
+        if (r.i != json.size())
+        {
+            error = "trailing characters after the object";
+            return false;
+        }
+        if (!haveFen)
+        {
+            error = "missing fen";
+            return false;
+        }
+        return true;
+    }
+
+    std::string format_reply(const AnalysisReply& reply)
+    {
+        std::string out = "{\"id\":";
+        append_quoted(out, reply.id);
+        if (!reply.error.empty())
+        {
+            out += ",\"ok\":false,\"error\":";
+            append_quoted(out, reply.error);
+            return out + "}";
+        }
+        out += ",\"ok\":true,\"lines\":[";
+        for (size_t k = 0; k < reply.lines.size(); ++k)
+        {
+            const PvLine& line = reply.lines[k];
+            out += (k ? ",{\"depth\":" : "{\"depth\":") + std::to_string(line.depth) + ",\"score\":" + std::to_string(line.score) + ",\"pv\":[";
+            for (size_t m = 0; m < line.pv.size(); ++m)
+            {
+                if (m) out.push_back(',');
+                append_quoted(out, line.pv[m]);
+            }
+            out += "]}";
+        }
+        char tail[96];
+        std::snprintf(tail, sizeof(tail), "],\"queue_ms\":%.3f,\"search_ms\":%.3f,\"coalesced\":%s}", reply.queue_ms, reply.search_ms,
+                      reply.coalesced ? "true" : "false");
+        return out + tail;
+    }
+
+    std::string format_request(const AnalysisRequest& request)
+    {
+        std::string out = "{\"id\":";
+        append_quoted(out, request.id);
+        out += ",\"fen\":";
+        append_quoted(out, request.fen);
+        return out + ",\"depth\":" + std::to_string(request.depth) + ",\"multipv\":" + std::to_string(request.multipv) +
+               ",\"priority\":" + std::to_string(request.priority) + ",\"deadline_ms\":" + std::to_string(request.deadline_ms) + "}";
+    }
+
+    bool parse_reply(const std::string& json, AnalysisReply& out)
+    {
+        out = AnalysisReply();
+        JsonReader r(json);
+        bool ok = false;
+        bool parsed = r.object([&](const std::string& key) {
+            if (key == "id") return r.string(out.id);
+            if (key == "ok") return r.boolean(ok);
+            if (key == "error") return r.string(out.error);
+            if (key == "queue_ms") return r.number(out.queue_ms);
+            if (key == "search_ms") return r.number(out.search_ms);
+            if (key == "coalesced") return r.boolean(out.coalesced);
+            if (key != "lines") return r.skip_value();
+            return r.array([&] {
+                PvLine line;
+                out.lines.push_back(line);
+                PvLine& l = out.lines.back();
+                return r.object([&](const std::string& field) {
+                    if (field == "depth") return read_int(r, l.depth);
+                    if (field == "score") return read_int(r, l.score);
+                    if (field != "pv") return r.skip_value();
+                    return r.array([&] {
+                        l.pv.emplace_back();
+                        return r.string(l.pv.back());
+                    });
+                });
+            });
+        });
+        r.space();
+        if (!parsed || r.i != json.size()) return false;
+        if (!ok && out.error.empty()) out.error = "error reply without a message";
+        return true;
+    }
+
+    AnalysisService::AnalysisService(std::shared_ptr<EngineBase> eng, int workerCount) : engine(std::move(eng))
+    {
+        for (int w = 0; w < workerCount; ++w)
+            workers.emplace_back([this] {
+                std::unique_lock<std::mutex> held(lock);
+                for (;;)
+                {
+                    wake.wait(held, [this] { return stopping || !queue.empty(); });
+                    if (stopping) return;
+                    std::shared_ptr<Job> job = take(held);
+                    if (!job) continue;
+                    held.unlock();
+                    run(job);
+                    held.lock();
+                }
+            });
+    }
+
+    AnalysisService::~AnalysisService()
+    {
+        std::vector<Waiter> dropped;
+        {
+            std::lock_guard<std::mutex> held(lock);
+            stopping = true;
+            for (const auto& job : queue)
+            {
+                dropped.insert(dropped.end(), job->waiters.begin(), job->waiters.end());
+                inflight.erase(job->key);
+            }
+            queue.clear();
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+        for (const Waiter& w : dropped)
+        {
+            AnalysisReply reply;
+            reply.id = w.id;
+            reply.error = "server shutting down";
+            w.done(reply);
+        }
+    }
+
+    void AnalysisService::submit(const AnalysisRequest& request, Callback done)
+    {
+        Clock::time_point now = Clock::now();
+        uint64_t key = zobrist_hash_fen(request.fen);
+        AnalysisReply rejected;
+        rejected.id = request.id;
+        if (!key || !valid_fen(request.fen)) rejected.error = "invalid fen";
+        else if (request.depth < 1 || request.depth > kMaxDepth) rejected.error = "depth must be 1.." + std::to_string((int)kMaxDepth);
+        else if (request.multipv < 1 || request.multipv > kMaxLines) rejected.error = "multipv must be 1.." + std::to_string((int)kMaxLines);
+        else if (request.deadline_ms < 0) rejected.error = "deadline_ms must not be negative";
+
+        Waiter w;
+        w.id = request.id;
+        w.done = std::move(done);
+        w.submitted = now;
+        w.deadline = request.deadline_ms ? now + std::chrono::milliseconds(request.deadline_ms) : Clock::time_point::max();
+        {
+            std::lock_guard<std::mutex> held(lock);
+            ++counters.requests;
+            if (rejected.error.empty() && stopping) rejected.error = "server shutting down";
+            if (!rejected.error.empty()) ++counters.rejected;
+            else
+            {
+                Key k(key, request.depth, request.multipv);
+                auto found = inflight.find(k);
+                if (found != inflight.end())
+                {
+                    ++counters.coalesced;
+                    std::shared_ptr<Job> job = found->second;
+                    if (job->running) job->waiters.push_back(std::move(w));
+                    else
+                    {
+                        // Re-rank the queued search for its most urgent waiter.
+                        queue.erase(job);
+                        job->priority = std::max(job->priority, request.priority);
+                        job->deadline = std::min(job->deadline, w.deadline);
+                        job->waiters.push_back(std::move(w));
+                        queue.insert(job);
+                    }
+                    return;
+                }
+                auto job = std::make_shared<Job>();
+                job->key = k;
+                job->fen = request.fen;
+                job->priority = request.priority;
+                job->deadline = w.deadline;
+                job->seq = next_seq++;
+                job->waiters.push_back(std::move(w));
+                inflight[k] = job;
+                queue.insert(job);
+            }
+        }
+        if (!rejected.error.empty())
+        {
+            w.done(rejected);
+            return;
+        }
+        wake.notify_one();
+    }
+
+    std::shared_ptr<AnalysisService::Job> AnalysisService::take(std::unique_lock<std::mutex>& held)
+    {
+        // Waiters whose deadline passed are answered here; a job left without waiters is dropped.
+        while (!queue.empty())
+        {
+            std::shared_ptr<Job> job = *queue.begin();
+            queue.erase(queue.begin());
+            Clock::time_point now = Clock::now();
+            std::vector<Waiter> late, live;
+            for (Waiter& w : job->waiters) (w.deadline <= now ? late : live).push_back(std::move(w));
+            job->waiters = std::move(live);
+            if (job->waiters.empty()) inflight.erase(job->key);
+            else job->running = true;
+            counters.expired += late.size();
+            if (!late.empty())
+            {
+                held.unlock();
+                for (const Waiter& w : late)
+                {
+                    AnalysisReply reply;
+                    reply.id = w.id;
+                    reply.error = "deadline exceeded";
+                    reply.queue_ms = ms_between(w.submitted, now);
+                    w.done(reply);
+                }
+                held.lock();
+            }
+            if (job->running) return job;
+        }
+        return nullptr;
+    }
+
+    void AnalysisService::run(const std::shared_ptr<Job>& job)
+    {
+        Clock::time_point start = Clock::now();
+        std::vector<PvLine> lines;
+        std::string error;
+        // One search that throws answers its waiters with an error; it must not take the server down.
+        try { lines = engine->multipv(job->fen, std::get<1>(job->key), std::get<2>(job->key)); }
+        catch (const std::exception& e) { error = std::string("search failed: ") + e.what(); }
+        catch (...) { error = "search failed"; }
+        Clock::time_point end = Clock::now();
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> held(lock);
+            ++counters.searches;
+            inflight.erase(job->key);
+            waiters.swap(job->waiters);
+        }
+        for (size_t k = 0; k < waiters.size(); ++k)
+        {
+            AnalysisReply reply;
+            reply.id = waiters[k].id;
+            if (!error.empty()) reply.error = error;
+            else if (lines.empty()) reply.error = "no legal moves";
+            else reply.lines = lines;
+            reply.queue_ms = waiters[k].submitted < start ? ms_between(waiters[k].submitted, start) : 0;
+            reply.search_ms = ms_between(std::max(start, waiters[k].submitted), end);
+            reply.coalesced = k > 0;
+            waiters[k].done(reply);
+        }
+    }
+
+    bool AnalysisService::process_next()
+    {
+        std::unique_lock<std::mutex> held(lock);
+        std::shared_ptr<Job> job = take(held);
+        held.unlock();
+        if (!job) return false;
+        run(job);
+        return true;
+    }
+
+    AnalysisServiceStats AnalysisService::stats() const
+    {
+        std::lock_guard<std::mutex> held(lock);
+        AnalysisServiceStats s = counters;
+        s.queued = queue.size();
+        return s;
+    }
+} // namespace engine
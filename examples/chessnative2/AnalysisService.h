@@ -0,0 +1,128 @@
+#pragma once
+#include "EngineBase.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace engine
+{
+    // Analysis requests from many clients served by one engine instance, so every search shares its
+    // transposition table and history, on a fixed pool of worker threads. Requests wait in a priority
+    // queue (higher priority first, then earliest deadline, then arrival). A request for a position,
+    // depth and line count that is already queued or being searched joins that search instead of
+    // starting another. The search itself runs to its depth: a deadline only decides whether a
+    // request that has not started yet is still worth starting.
+
+    struct AnalysisRequest
+    {
+        std::string id;      // echoed in the reply
+        std::string fen;     // all six fields, one king per side; otherwise answered with "invalid fen"
+        int depth = 6;
+        int multipv = 1;
+        int priority = 0;    // higher is served first
+        int deadline_ms = 0; // past it, a worker that reaches the request answers it with an error; 0 = none
+    };
+
+    struct AnalysisReply
+    {
+        std::string id;
+        std::string error;         // empty on success
+        std::vector<PvLine> lines; // best first, as EngineBase::multipv returns them
+        double queue_ms = 0;       // from submit to the start of the search that answered it
+        double search_ms = 0;
+        bool coalesced = false;    // answered by a search started for an identical request
+    };
+
+    // The server's wire format, one JSON object per line:
+    //   {"id":"7","fen":"...","depth":8,"multipv":3,"priority":1,"deadline_ms":250}
+    //   {"id":"7","ok":true,"lines":[{"depth":8,"score":31,"pv":["e2e4","e7e5"]}],"queue_ms":0.4,"search_ms":91.2,"coalesced":false}
+    //   {"id":"7","ok":false,"error":"deadline exceeded"}
+    // Only fen is required. Unknown keys are ignored, so clients may add their own.
+    bool parse_request(const std::string& json, AnalysisRequest& out, std::string& error);
+    std::string format_reply(const AnalysisReply& reply);
+    // The client's side of the same format. parse_reply is false only for malformed JSON; an error
+    // reply parses with out.error set.
+    std::string format_request(const AnalysisRequest& request);
+    bool parse_reply(const std::string& json, AnalysisReply& out);
+
+    struct AnalysisServiceStats
+    {
+        uint64_t requests = 0;  // submitted
+        uint64_t searches = 0;  // searches run
+        uint64_t coalesced = 0; // requests that joined a search already queued or running
+        uint64_t expired = 0;   // answered with "deadline exceeded"
+        uint64_t rejected = 0;  // answered with an error at submit (bad FEN or limits)
+        size_t queued = 0;      // searches waiting now
+    };
+
+    class AnalysisService
+    {
+    public:
+        using Callback = std::function<void(const AnalysisReply&)>;
+        enum { kMaxDepth = 32, kMaxLines = 64 };
+
+        // workers = 0 starts no threads: the owner runs the queue with process_next().
+        AnalysisService(std::shared_ptr<EngineBase> engine, int workers);
+        // Lets running searches finish and answers everything still queued with an error.
+        ~AnalysisService();
+        AnalysisService(const AnalysisService&) = delete;
+        AnalysisService& operator=(const AnalysisService&) = delete;
+
+        // done is called once, on a worker thread (or the submitting thread for a rejected request).
+        void submit(const AnalysisRequest& request, Callback done);
+        // Runs the most urgent queued search on the calling thread; false if none was left to run.
+        bool process_next();
+        AnalysisServiceStats stats() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        using Key = std::tuple<uint64_t, int, int>; // Zobrist key, depth, lines
+
+        struct Waiter
+        {
+            std::string id;
+            Callback done;
+            Clock::time_point submitted;
+            Clock::time_point deadline;
+        };
+        struct Job
+        {
+            Key key;
+            std::string fen;
+            int priority = 0;
+            Clock::time_point deadline; // the earliest of its waiters'
+            uint64_t seq = 0;
+            bool running = false;
+            std::vector<Waiter> waiters;
+        };
+        struct Urgency
+        {
+            bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const
+            {
+                return std::make_tuple(-a->priority, a->deadline, a->seq) < std::make_tuple(-b->priority, b->deadline, b->seq);
+            }
+        };
+
+        std::shared_ptr<EngineBase> engine;
+        mutable std::mutex lock;
+        std::condition_variable wake;
+        std::set<std::shared_ptr<Job>, Urgency> queue;
+        std::map<Key, std::shared_ptr<Job>> inflight; // queued or running, for coalescing
+        std::vector<std::thread> workers;
+        AnalysisServiceStats counters;
+        uint64_t next_seq = 0;
+        bool stopping = false;
+
+        std::shared_ptr<Job> take(std::unique_lock<std::mutex>& held);
+        void run(const std::shared_ptr<Job>& job);
+    };
+} // namespace engine
@@ -0,0 +1,223 @@
+#include "AnalysisStore.h"
+#include <atomic>
+#include <cstring>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine
+{
+    // Other processes map the same slots, so the atomics must be plain lock-free words.
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "AnalysisStore needs lock-free 64-bit atomics");
+
+    struct AnalysisStore::Slot
+    {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    namespace
+    {
+        const size_t kBucketSlots = 4;
+        const size_t kHeaderBytes = 64;
+
+        struct StoreHeader
+        {
+            char magic[8];       // "CHESSAS" and a zero
+            uint32_t version;    // AnalysisStore::kVersion
+            uint32_t slot_bytes; // 16
+            uint64_t buckets;    // a power of two
+            uint64_t checksum;   // FNV-1a of the fields above
+            uint8_t reserved[32];
+        };
+        static_assert(sizeof(StoreHeader) == kHeaderBytes, "the header fills the first cache line");
+
+        uint64_t header_checksum(const StoreHeader& h)
+        {
+            uint64_t x = 1469598103934665603ULL;
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(&h);
+            for (size_t i = 0; i < offsetof(StoreHeader, checksum); ++i) x = (x ^ p[i]) * 1099511628211ULL;
+            return x;
+        }
+
+        StoreHeader make_header(uint64_t buckets)
+        {
+            StoreHeader h;
+            std::memset(&h, 0, sizeof(h));
+            std::memcpy(h.magic, "CHESSAS", 8);
+            h.version = AnalysisStore::kVersion;
+            h.slot_bytes = 16;
+            h.buckets = buckets;
+            h.checksum = header_checksum(h);
+            return h;
+        }
+
+        bool valid_header(const StoreHeader& h, uint64_t fileSize)
+        {
+            return std::memcmp(h.magic, "CHESSAS", 8) == 0 && h.version == AnalysisStore::kVersion && h.slot_bytes == 16 && h.buckets &&
+                   !(h.buckets & (h.buckets - 1)) && h.checksum == header_checksum(h) && fileSize == kHeaderBytes + h.buckets * kBucketSlots * 16;
+        }
+
+        // data layout: score (32, two's complement) | move << 32 | depth << 48 | bound << 56; never 0 for a real entry.
+        uint64_t pack(int depth, int score, Bound bound, uint16_t move)
+        {
+            return (uint64_t)(uint32_t)score | ((uint64_t)move << 32) | ((uint64_t)(uint8_t)depth << 48) | ((uint64_t)bound << 56);
+        }
+
+        // Builds a zeroed store in a file of its own and links it in under path, so path never names
+        // a half-written store. True if path exists afterwards (another process may have won the race).
+        bool create_store(const std::string& path, uint64_t buckets)
+        {
+            StoreHeader h = make_header(buckets);
+            uint64_t size = kHeaderBytes + buckets * kBucketSlots * 16;
+#if defined(_WIN32)
+            std::string tmp = path + ".tmp" + std::to_string(GetCurrentProcessId());
+            HANDLE f = CreateFileA(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (f == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER end;
+            end.QuadPart = (LONGLONG)size;
+            DWORD written = 0;
+            bool ok = SetFilePointerEx(f, end, nullptr, FILE_BEGIN) && SetEndOfFile(f) && SetFilePointer(f, 0, nullptr, FILE_BEGIN) == 0 &&
+                      WriteFile(f, &h, sizeof(h), &written, nullptr) && written == sizeof(h) && FlushFileBuffers(f);
+            CloseHandle(f);
+            ok = ok && MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_WRITE_THROUGH);
+            if (!ok) DeleteFileA(tmp.c_str());
+            return ok || GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+            std::string tmp = path + ".tmp" + std::to_string(getpid());
+            int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            bool ok = ftruncate(fd, (off_t)size) == 0 && pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && fsync(fd) == 0;
+            close(fd);
+            ok = ok && (link(tmp.c_str(), path.c_str()) == 0 || errno == EEXIST);
+            unlink(tmp.c_str());
+            return ok;
+#endif
+        }
+    } // namespace
+
+    AnalysisStore::AnalysisStore(const std::string& path, size_t mb, bool readOnly)
+    {
+        uint64_t buckets = 1;
+        while (buckets * 2 * kBucketSlots * 16 <= (uint64_t)mb * 1024 * 1024) buckets *= 2;
+        StoreHeader h;
+#if defined(_WIN32)
+        HANDLE f = INVALID_HANDLE_VALUE;
+        for (int attempt = 0; attempt < 2 && f == INVALID_HANDLE_VALUE; ++attempt)
+        {
+            can_write = !readOnly;
+            f = CreateFileA(path.c_str(), GENERIC_READ | (can_write ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (f == INVALID_HANDLE_VALUE && can_write && GetLastError() == ERROR_ACCESS_DENIED)
+            {
+                can_write = false;
+                f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            }
+            if (f == INVALID_HANDLE_VALUE && (readOnly || attempt || GetLastError() != ERROR_FILE_NOT_FOUND || !create_store(path, buckets))) return;
+        }
+        file = f;
+        LARGE_INTEGER size;
+        DWORD got = 0;
+        if (!GetFileSizeEx(f, &size) || !ReadFile(f, &h, sizeof(h), &got, nullptr) || got != sizeof(h) || !valid_header(h, (uint64_t)size.QuadPart)) return;
+        HANDLE m = CreateFileMappingA(f, nullptr, can_write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (!m) return;
+        mapping = m;
+        void* view = MapViewOfFile(m, can_write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+        if (!view) return;
+        length = (size_t)size.QuadPart;
+#else
+        int fd = -1;
+        for (int attempt = 0; attempt < 2 && fd < 0; ++attempt)
+        {
+            can_write = !readOnly;
+            fd = open(path.c_str(), can_write ? O_RDWR : O_RDONLY);
+            if (fd < 0 && can_write && (errno == EACCES || errno == EROFS))
+            {
+                can_write = false;
+                fd = open(path.c_str(), O_RDONLY);
+            }
+            if (fd < 0 && (readOnly || attempt || errno != ENOENT || !create_store(path, buckets))) return;
+        }
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && valid_header(h, (uint64_t)st.st_size);
+        void* view = ok ? mmap(nullptr, (size_t)st.st_size, PROT_READ | (can_write ? PROT_WRITE : 0), MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (view == MAP_FAILED) return;
+        mapping = view;
+        length = (size_t)st.st_size;
+#endif
+        slots = reinterpret_cast<Slot*>(static_cast<char*>(view) + kHeaderBytes);
+        slot_count = (size_t)h.buckets * kBucketSlots;
+    }
+
+    AnalysisStore::~AnalysisStore()
+    {
+#if defined(_WIN32)
+        if (slots) UnmapViewOfFile(reinterpret_cast<char*>(slots) - kHeaderBytes);
+        if (mapping) CloseHandle((HANDLE)mapping);
+        if (file) CloseHandle((HANDLE)file);
+#else
+        if (mapping) munmap(mapping, length);
+#endif
+    }
+
+    bool AnalysisStore::probe(uint64_t key, TTEntry& out) const
+    {
+        if (!slots) return false;
+        const Slot* b = slots + (key & (slot_count / kBucketSlots - 1)) * kBucketSlots;
+        for (size_t i = 0; i < kBucketSlots; ++i)
+        {
+            uint64_t data = b[i].data.load(std::memory_order_relaxed);
+            if ((b[i].check.load(std::memory_order_relaxed) ^ data) != key || !data) continue;
+            out.score = (int32_t)(uint32_t)data;
+            out.move = (uint16_t)(data >> 32);
+            out.depth = (int)(uint8_t)(data >> 48);
+            out.bound = (Bound)((data >> 56) & 3);
+            return true;
+        }
+        return false;
+    }
+
+    void AnalysisStore::store(uint64_t key, int depth, int score, Bound bound, uint16_t move)
+    {
+        if (!slots || !can_write) return;
+        Slot* b = slots + (key & (slot_count / kBucketSlots - 1)) * kBucketSlots;
+        Slot* victim = &b[0];
+        int victimDepth = 1 << 30;
+        for (size_t i = 0; i < kBucketSlots; ++i)
+        {
+            uint64_t data = b[i].data.load(std::memory_order_relaxed);
+            int d = data ? (int)(uint8_t)(data >> 48) : -1;
+            if ((b[i].check.load(std::memory_order_relaxed) ^ data) == key && data)
+            {
+                if (d > depth || (d == depth && ((data >> 56) & 3) >= (uint64_t)bound)) return;
+                victim = &b[i];
+                break;
+            }
+            if (d < victimDepth)
+            {
+                victimDepth = d;
+                victim = &b[i];
+            }
+        }
+        uint64_t data = pack(depth, score, bound, move);
+        victim->data.store(data, std::memory_order_relaxed);
+        victim->check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    void AnalysisStore::flush()
+    {
+        if (!slots || !can_write) return;
+#if defined(_WIN32)
+        FlushViewOfFile(reinterpret_cast<char*>(slots) - kHeaderBytes, 0);
+#else
+        msync(mapping, length, MS_ASYNC);
+#endif
+    }
+} // namespace engine
@@ -0,0 +1,51 @@
+#pragma once
+#include "SearchTables.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace engine
+{
+    // Search results kept in a memory-mapped file, so deep analysis outlives the process and is
+    // shared by every engine process on the host that maps the same file.
+    //
+    // File layout (little-endian): a 64-byte header, then buckets of four 16-byte slots. Slots are
+    // written lock-free as (key ^ data, data), like the transposition table's, so a slot torn by two
+    // writers or by a crash mid-write fails the key check and reads as empty. The header is written
+    // whole to a temporary file that is then linked into place, so a file under the store's name
+    // always has a complete header; its version, geometry and checksum are verified on open.
+    class AnalysisStore
+    {
+    public:
+        enum { kVersion = 1 };
+
+        // Maps path, creating it with room for about mb megabytes of entries if it does not exist
+        // (mb is ignored for an existing file). readOnly maps it without write access, and a
+        // writable open falls back to read-only when the file is not writable.
+        AnalysisStore(const std::string& path, size_t mb, bool readOnly = false);
+        ~AnalysisStore();
+        AnalysisStore(const AnalysisStore&) = delete;
+        AnalysisStore& operator=(const AnalysisStore&) = delete;
+
+        // False if the file could not be created or mapped, or its header is not a valid store.
+        bool is_open() const { return slots != nullptr; }
+        bool writable() const { return can_write; }
+        size_t capacity() const { return slot_count; }
+
+        bool probe(uint64_t key, TTEntry& out) const;
+        // Replaces the slot of the same key only with a deeper result (or an equal depth with a
+        // better bound); otherwise evicts the shallowest slot of the bucket.
+        void store(uint64_t key, int depth, int score, Bound bound, uint16_t move);
+        // Starts writing dirty pages back to the file; the OS writes them in any case.
+        void flush();
+
+    private:
+        struct Slot;
+        Slot* slots = nullptr;
+        size_t slot_count = 0;
+        size_t length = 0;
+        bool can_write = false;
+        void* mapping = nullptr; // platform mapping handle(s)
+        void* file = nullptr;
+    };
+} // namespace engine
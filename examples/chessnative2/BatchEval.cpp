@@ -0,0 +1,183 @@
+#include "BatchEval.h"
+
+#if !defined(ENGINE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define ENGINE_BATCH_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define ENGINE_BATCH_SIMD 0
+#endif
+
+// MSVC accepts AVX intrinsics in any function; GCC and Clang need the target named per function.
+#if ENGINE_BATCH_SIMD && !defined(_MSC_VER)
+#define ENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#define ENGINE_TARGET_AVX512 __attribute__((target("avx512f,avx512vpopcntdq")))
+#else
+#define ENGINE_TARGET_AVX2
+#define ENGINE_TARGET_AVX512
+#endif
+
+namespace engine
+{
+    namespace
+    {
+        int popcount(uint64_t x)
+        {
+            int n = 0;
+            for (; x; x &= x - 1) ++n;
+            return n;
+        }
+
+        void eval_scalar(const LeafBatch& b, const int values[6], int begin, int* out)
+        {
+            for (int i = begin; i < b.count; ++i)
+            {
+                int score = 0;
+                for (int t = 0; t < 6; ++t)
+                    score += (popcount(b.pieces[t][i]) - popcount(b.pieces[t + 6][i])) * values[t];
+                out[i] = score;
+            }
+        }
+
+#if ENGINE_BATCH_SIMD
+        // Per-64-bit-lane popcount: nibble lookup with pshufb, then byte sums with psadbw.
+        ENGINE_TARGET_AVX2 inline __m256i popcount_epi64(__m256i v)
+        {
+            const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i low = _mm256_set1_epi8(0x0f);
+            __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+            __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+            return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+        }
+
+        ENGINE_TARGET_AVX2 void eval_avx2(const LeafBatch& b, const int values[6], int* out)
+        {
+            int i = 0;
+            for (; i + 4 <= b.count; i += 4)
+            {
+                __m256i plus = _mm256_setzero_si256(), minus = _mm256_setzero_si256();
+                for (int t = 0; t < 6; ++t)
+                {
+                    __m256i v = _mm256_set1_epi64x(values[t]);
+                    plus = _mm256_add_epi64(plus, _mm256_mul_epu32(popcount_epi64(_mm256_load_si256((const __m256i*)&b.pieces[t][i])), v));
+                    minus = _mm256_add_epi64(minus, _mm256_mul_epu32(popcount_epi64(_mm256_load_si256((const __m256i*)&b.pieces[t + 6][i])), v));
+                }
+                // Low dword of each 64-bit lane holds the (small) signed result.
+                __m256i packed = _mm256_permutevar8x32_epi32(_mm256_sub_epi64(plus, minus), _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+                _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(packed));
+            }
+            eval_scalar(b, values, i, out);
+        }
+
+// GCC 12 warns about the deliberately undefined pass-through operand inside its AVX-512 intrinsic headers.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+        ENGINE_TARGET_AVX512 void eval_avx512(const LeafBatch& b, const int values[6], int* out)
+        {
+            int i = 0;
+            for (; i + 8 <= b.count; i += 8)
+            {
+                __m512i plus = _mm512_setzero_si512(), minus = _mm512_setzero_si512();
+                for (int t = 0; t < 6; ++t)
+                {
+                    __m512i v = _mm512_set1_epi64(values[t]);
+                    plus = _mm512_add_epi64(plus, _mm512_mul_epu32(_mm512_popcnt_epi64(_mm512_load_si512(&b.pieces[t][i])), v));
+                    minus = _mm512_add_epi64(minus, _mm512_mul_epu32(_mm512_popcnt_epi64(_mm512_load_si512(&b.pieces[t + 6][i])), v));
+                }
+                _mm256_storeu_si256((__m256i*)(out + i), _mm512_cvtepi64_epi32(_mm512_sub_epi64(plus, minus)));
+            }
+            eval_scalar(b, values, i, out);
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        bool cpu_has(EvalKernel k)
+        {
+#if defined(_MSC_VER)
+            int r[4];
+            __cpuid(r, 0);
+            if (r[0] < 7) return false;
+            __cpuid(r, 1);
+            bool osxsave = (r[2] & (1 << 27)) != 0;
+            if (!osxsave) return false;
+            unsigned long long xcr0 = _xgetbv(0);
+            __cpuidex(r, 7, 0);
+            bool avx2 = (r[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+            if (k == EvalKernel::AVX2) return avx2;
+            bool avx512 = (r[1] & (1 << 16)) != 0 && (r[2] & (1 << 14)) != 0 && (xcr0 & 0xE6) == 0xE6;
+            return k == EvalKernel::AVX512 ? avx512 : true;
+#else
+            __builtin_cpu_init();
+            if (k == EvalKernel::AVX2) return __builtin_cpu_supports("avx2");
+            if (k == EvalKernel::AVX512) return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+            return true;
+#endif
+        }
+#endif
+
+        EvalKernel detect_kernel()
+        {
+#if ENGINE_BATCH_SIMD
+            if (cpu_has(EvalKernel::AVX512)) return EvalKernel::AVX512;
+            if (cpu_has(EvalKernel::AVX2)) return EvalKernel::AVX2;
+#endif
+            return EvalKernel::Scalar;
+        }
+    } // namespace
+
+    EvalKernel batch_eval_kernel()
+    {
+        static const EvalKernel kernel = detect_kernel(); // thread-safe one-time detection
+        return kernel;
+    }
+
+    const char* batch_eval_kernel_name(EvalKernel kernel)
+    {
+        switch (kernel)
+        {
+        case EvalKernel::AVX2: return "avx2";
+        case EvalKernel::AVX512: return "avx512";
+        default: return "scalar";
+        }
+    }
+
+    bool evaluate_batch_with(EvalKernel kernel, const LeafBatch& batch, const int values[6], int* out)
+    {
+        switch (kernel)
+        {
+#if ENGINE_BATCH_SIMD
+        case EvalKernel::AVX2:
+            if (!cpu_has(kernel)) return false;
+            eval_avx2(batch, values, out);
+            return true;
+        case EvalKernel::AVX512:
+            if (!cpu_has(kernel)) return false;
+            eval_avx512(batch, values, out);
+            return true;
+#endif
+        case EvalKernel::Scalar:
+            eval_scalar(batch, values, 0, out);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void evaluate_batch(const LeafBatch& batch, const int values[6], int* out)
+    {
+        switch (batch_eval_kernel())
+        {
+#if ENGINE_BATCH_SIMD
+        case EvalKernel::AVX512: eval_avx512(batch, values, out); break;
+        case EvalKernel::AVX2: eval_avx2(batch, values, out); break;
+#endif
+        default: eval_scalar(batch, values, 0, out); break;
+        }
+    }
+} // namespace engine
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+// Batched leaf evaluation. Sibling leaves at a frontier node are collected into a LeafBatch
+// and scored together; on x86-64 the kernel is picked once at runtime (AVX-512, AVX2 or scalar).
+// Define ENGINE_NO_SIMD to build only the scalar kernel.
+namespace engine
+{
+    // Structure-of-arrays storage so a kernel can load the same bitboard of 4 or 8 positions at once.
+    // Bitboards 0-5 are the side scored positively (PNBRQK), 6-11 the other side.
+    struct LeafBatch
+    {
+        enum { kCapacity = 256 }; // more than the legal moves of any position
+        alignas(64) uint64_t pieces[12][kCapacity];
+        int count = 0;
+
+        void clear() { count = 0; }
+        int add(const uint64_t bb[12])
+        {
+            for (int p = 0; p < 12; ++p) pieces[p][count] = bb[p];
+            return count++;
+        }
+    };
+
+    enum class EvalKernel { Scalar, AVX2, AVX512 };
+
+    // out[i] = sum over piece types of (popcount(pieces[t][i]) - popcount(pieces[t + 6][i])) * values[t].
+    // values must be non-negative.
+    void evaluate_batch(const LeafBatch& batch, const int values[6], int* out);
+    // Runs one specific kernel; false if this CPU (or build) does not support it. Used to check the
+    // SIMD kernels against the scalar reference.
+    bool evaluate_batch_with(EvalKernel kernel, const LeafBatch& batch, const int values[6], int* out);
+    EvalKernel batch_eval_kernel();
+    const char* batch_eval_kernel_name(EvalKernel kernel);
+} // namespace engine
@@ -0,0 +1,34 @@
+#include "Castling.h"
+
+namespace engine
+{
+    namespace
+    {
+        // Rank-1 squares between files a and b, both included.
+        constexpr uint64_t file_span(int a, int b)
+        {
+            uint64_t m = 0;
+            for (int f = (a < b ? a : b); f <= (a < b ? b : a); ++f)
+                m |= 1ULL << f;
+            return m;
+        }
+
+        constexpr CastleTable make_paths()
+        {
+            CastleTable t{};
+            for (int k = 0; k < 8; ++k)
+                for (int r = 0; r < 8; ++r)
+                {
+                    if (r == k) continue;
+                    CastlePath& p = t.path[k][r];
+                    p.king_to = r > k ? 6 : 2;
+                    p.rook_to = r > k ? 5 : 3;
+                    p.must_be_empty = (file_span(k, p.king_to) | file_span(r, p.rook_to)) & ~((1ULL << k) | (1ULL << r));
+                    p.must_be_safe = file_span(k, p.king_to);
+                }
+            return t;
+        }
+    } // namespace
+
+    const CastleTable kCastlePaths = make_paths();
+} // namespace engine
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+
+namespace engine
+{
+    // Castling geometry for standard chess and Chess960, looked up by the king and rook
+    // files on the back rank. Masks are for rank 1; shift left by 56 for rank 8.
+    // The king always lands on the g/c file and the rook on f/d, whatever the start files.
+    struct CastlePath
+    {
+        uint64_t must_be_empty; // squares both pieces cross or land on, minus the king and rook themselves
+        uint64_t must_be_safe;  // squares the king stands on, crosses or lands on
+        int king_to;            // destination files
+        int rook_to;
+    };
+
+    struct CastleTable
+    {
+        CastlePath path[8][8]; // [king file][rook file]; rook == king entries are unused
+    };
+
+    extern const CastleTable kCastlePaths;
+
+    inline const CastlePath& castle_path(int kingFile, int rookFile) { return kCastlePaths.path[kingFile][rookFile]; }
+
+    // Standard castling is written king-two-squares (e1g1); anything else uses the
+    // Chess960 king-takes-rook form (e.g. b1a1) so the move is never ambiguous.
+    inline bool is_standard_castle(int kingFile, int rookFile) { return kingFile == 4 && (rookFile == 0 || rookFile == 7); }
+} // namespace engine
@@ -1,16 +1,30 @@
 #include "ChessEngine1.hpp"
+#include "BatchEval.h"
+#include "Castling.h"
+#include "Color.h"
+#include "Geometry.h"
+#include "Zobrist.h"
 #include <algorithm>
 #include <cctype>
+#include <cstddef>
 #include <cstdlib>
 
 namespace engine
 {
 
-std::array< ChessEngine1::U64, 64 > ChessEngine1::pawnAttW{};
-std::array< ChessEngine1::U64, 64 > ChessEngine1::pawnAttB{};
-std::array< ChessEngine1::U64, 64 > ChessEngine1::knightMask{};
-std::array< ChessEngine1::U64, 64 > ChessEngine1::kingMask{};
-bool ChessEngine1::masksInit = false;
+const int ChessEngine1::pieceValues[ 6 ] = { 100, 320, 330, 500, 900, 0 };
+
+// Pawn-structure terms in centipawns; passed pawns by rank from their own side.
+static const int kPassedBonus[ 8 ] = { 0, 5, 10, 20, 35, 60, 100, 0 };
+static const int kIsolatedPenalty = 12;
+static const int kDoubledPenalty = 15;
+
+ChessEngine1::ChessEngine1()
+{
+    add_option( EngineOption::spin( "PawnHash", 256, 0, 65536, "Pawn-structure cache size in KB, 0 to analyse the pawns at every leaf" ) );
+    // Off by default: material plus a cached pawn score costs less than the cache's memory traffic.
+    add_option( EngineOption::spin( "EvalCache", 0, 0, 65536, "Evaluation cache size in KB, 0 to evaluate every leaf" ) );
+}
 
 // Public overrides
 std::string ChessEngine1::choose_move( const std::string& fen, int depth )
@@ -21,6 +35,15 @@ std::vector< std::pair< std::string, int > > ChessEngine1::root_search_scores( c
 {
     return root_scores_internal( fen, depth );
 }
+std::vector< PvLine > ChessEngine1::multipv( const std::string& fen, int depth, int lines )
+{
+    SearchContext ctx;
+    begin_search( ctx, depth );
+    std::vector< PvLine > out;
+    search_lines( fen, depth, lines, ctx, out );
+    end_search( ctx );
+    return out;
+}
 std::vector< std::string > ChessEngine1::legal_moves_uci( const std::string& fen )
 {
     return legal_moves_internal( fen );
@@ -32,16 +55,21 @@ std::string ChessEngine1::apply_move( const std::string& fen, const std::string&
         return {};
     if ( uci.size() < 4 )
         return {};
+    AttackInfo ai;
+    compute_attack_info( p, ai );
     std::vector< Move > pseudo;
-    generate_pseudo_moves( p, pseudo );
+    generate_pseudo_moves( p, pseudo, ai );
     std::vector< Move > legal;
-    filter_legal( p, pseudo, legal );
+    filter_legal( p, pseudo, legal, ai );
     Move chosen{};
     bool found = false;
     for ( auto& m : legal )
     {
         std::string mv = move_to_uci( m );
-        if ( mv == uci )
+        // Castling is also accepted in the other notation (e1g1 vs king-takes-rook e1h1).
+        int target = ( uci[ 2 ] - 'a' ) + 8 * ( uci[ 3 ] - '1' );
+        bool castleAlias = m.isCastle && uci.compare( 0, 2, mv, 0, 2 ) == 0 && ( target == m.to || target == m.rookFrom );
+        if ( mv == uci || castleAlias )
         {
             chosen = m;
             found = true;
@@ -55,120 +83,17 @@ std::string ChessEngine1::apply_move( const std::string& fen, const std::string&
     return build_fen( out );
 }
 
-// Init attack masks
-void ChessEngine1::init_masks()
-{
-    if ( masksInit )
-        return;
-    for ( int sq = 0; sq < 64; ++sq )
-    {
-        int r = rank_of( sq ), f = file_of( sq );
-        if ( r < 7 )
-        {
-            if ( f > 0 )
-                pawnAttW[ sq ] |= bb( sq + 8 - 1 );
-            if ( f < 7 )
-                pawnAttW[ sq ] |= bb( sq + 8 + 1 );
-        }
-        if ( r > 0 )
-        {
-            if ( f > 0 )
-                pawnAttB[ sq ] |= bb( sq - 8 - 1 );
-            if ( f < 7 )
-                pawnAttB[ sq ] |= bb( sq - 8 + 1 );
-        }
-        const int kd[ 8 ][ 2 ] = { { -2, -1 }, { -2, 1 }, { -1, -2 }, { -1, 2 }, { 1, -2 }, { 1, 2 }, { 2, -1 }, { 2, 1 } };
-        for ( auto& d : kd )
-        {
-            int rr = r + d[ 0 ], ff = f + d[ 1 ];
-            if ( rr >= 0 && rr < 8 && ff >= 0 && ff < 8 )
-                knightMask[ sq ] |= bb( rr * 8 + ff );
-        }
-        for ( int dr = -1; dr <= 1; ++dr )
-            for ( int dc = -1; dc <= 1; ++dc )
-            {
-                if ( !dr && !dc )
-                    continue;
-                int rr = r + dr, ff = f + dc;
-                if ( rr >= 0 && rr < 8 && ff >= 0 && ff < 8 )
-                    kingMask[ sq ] |= bb( rr * 8 + ff );
-            }
-    }
-    masksInit = true;
-}
-
 ChessEngine1::U64 ChessEngine1::rook_attacks( int sq, U64 occ )
 {
-    U64 a = 0;
-    int r = rank_of( sq ), f = file_of( sq );
-    for ( int rr = r + 1; rr < 8; ++rr )
-    {
-        int s = rr * 8 + f;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    for ( int rr = r - 1; rr >= 0; --rr )
-    {
-        int s = rr * 8 + f;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    for ( int ff = f + 1; ff < 8; ++ff )
-    {
-        int s = r * 8 + ff;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    for ( int ff = f - 1; ff >= 0; --ff )
-    {
-        int s = r * 8 + ff;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    return a;
+    return orthogonal_attacks( sq, occ );
 }
 ChessEngine1::U64 ChessEngine1::bishop_attacks( int sq, U64 occ )
 {
-    U64 a = 0;
-    int r = rank_of( sq ), f = file_of( sq );
-    for ( int rr = r + 1, ff = f + 1; rr < 8 && ff < 8; ++rr, ++ff )
-    {
-        int s = rr * 8 + ff;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    for ( int rr = r + 1, ff = f - 1; rr < 8 && ff >= 0; ++rr, --ff )
-    {
-        int s = rr * 8 + ff;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    for ( int rr = r - 1, ff = f + 1; rr >= 0 && ff < 8; --rr, ++ff )
-    {
-        int s = rr * 8 + ff;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    for ( int rr = r - 1, ff = f - 1; rr >= 0 && ff >= 0; --rr, --ff )
-    {
-        int s = rr * 8 + ff;
-        a |= bb( s );
-        if ( occ & bb( s ) )
-            break;
-    }
-    return a;
+    return diagonal_attacks( sq, occ );
 }
 
 bool ChessEngine1::parse_fen( const std::string& fen, Position& out )
 {
-    init_masks();
     out = Position();
     std::array< char, 64 > sqArr;
     sqArr.fill( '.' );
@@ -221,15 +146,39 @@ bool ChessEngine1::parse_fen( const std::string& fen, Position& out )
     out.castleRights = 0;
     if ( tok.size() >= 3 )
     {
-        std::string c = tok[ 2 ];
-        if ( c.find( 'K' ) != std::string::npos )
-            out.castleRights |= 1;
-        if ( c.find( 'Q' ) != std::string::npos )
-            out.castleRights |= 2;
-        if ( c.find( 'k' ) != std::string::npos )
-            out.castleRights |= 4;
-        if ( c.find( 'q' ) != std::string::npos )
-            out.castleRights |= 8;
+        // KQkq take the outermost rook on that side of the king; A-H / a-h name the rook file (Shredder-FEN / X-FEN).
+        auto setRight = [ & ]( bool white, char c )
+        {
+            int rank = white ? 0 : 7;
+            U64 rooks = white ? out.bb.WR : out.bb.BR;
+            int kingSq = lsb_index( white ? out.bb.WK : out.bb.BK );
+            if ( kingSq < 0 || rank_of( kingSq ) != rank )
+                return;
+            int kf = file_of( kingSq ), rf = -1;
+            char u = ( char )std::toupper( ( unsigned char )c );
+            if ( u == 'K' )
+            {
+                for ( int f = 7; f > kf && rf < 0; --f )
+                    if ( rooks & bb( rank * 8 + f ) )
+                        rf = f;
+            }
+            else if ( u == 'Q' )
+            {
+                for ( int f = 0; f < kf && rf < 0; ++f )
+                    if ( rooks & bb( rank * 8 + f ) )
+                        rf = f;
+            }
+            else if ( u >= 'A' && u <= 'H' )
+                rf = u - 'A';
+            if ( rf < 0 || rf == kf )
+                return;
+            int bit = ( white ? 0 : 2 ) + ( rf > kf ? 0 : 1 );
+            out.castleRights |= 1 << bit;
+            out.castleRookFile[ bit ] = rf;
+        };
+        for ( char c : tok[ 2 ] )
+            if ( c != '-' )
+                setRight( std::isupper( ( unsigned char )c ) != 0, c );
     }
     out.epSquare = -1;
     if ( tok.size() >= 4 && tok[ 3 ] != "-" )
@@ -249,158 +198,177 @@ bool ChessEngine1::parse_fen( const std::string& fen, Position& out )
     // TODO: ensure both kings exist; fail parse if missing
     if ( lsb_index( out.bb.WK ) < 0 || lsb_index( out.bb.BK ) < 0 )
         return false;
+    out.key = hash_position( out );
+    out.pawnKey = hash_pawns( out );
     return true;
 }
 
-ChessEngine1::U64 ChessEngine1::attackers_to( const Position& pos, int sq, int byWhite )
+// Bitboards WP..BK are laid out in the Zobrist piece order; side_bb and side_occ index into them.
+static_assert( offsetof( ChessEngine1::Bitboards, BK ) == 11 * sizeof( ChessEngine1::U64 ), "piece bitboards must be contiguous" );
+static_assert( offsetof( ChessEngine1::Bitboards, occBlack ) == offsetof( ChessEngine1::Bitboards, occWhite ) + sizeof( ChessEngine1::U64 ), "side_occ indexes occWhite/occBlack" );
+ChessEngine1::U64 ChessEngine1::hash_position( const Position& pos )
 {
-    U64 attackers = 0ULL;
-    U64 occ = pos.bb.occAll;
-    int f = file_of( sq ), r = rank_of( sq );
-    if ( byWhite )
-    {
-        if ( r > 0 )
-        {
-            if ( f < 7 )
-            {
-                int p = sq - 7;
-                if ( p >= 0 && ( pos.bb.WP & bb( p ) ) )
-                    attackers |= bb( p );
-            }
-            if ( f > 0 )
-            {
-                int p = sq - 9;
-                if ( p >= 0 && ( pos.bb.WP & bb( p ) ) )
-                    attackers |= bb( p );
-            }
-        }
-    }
-    else
+    return zobrist_hash( &pos.bb.WP, pos.sideToMove, pos.castleRights, pos.epSquare );
+}
+
+// Zobrist key of the pawns alone, the pawn-structure cache's index.
+ChessEngine1::U64 ChessEngine1::hash_pawns( const Position& pos )
+{
+    U64 key = 0;
+    for ( int side = 0; side < 2; ++side )
+        for ( U64 p = side_bb( pos, side )[ 0 ]; p; p &= p - 1 )
+            key ^= kZobrist.piece[ 6 * side ][ lsb_index( p ) ];
+    return key;
+}
+
+// Incremental key update: only the squares whose occupancy changed are XORed.
+void ChessEngine1::update_key( const Position& before, Position& after )
+{
+    U64 key = before.key ^ kZobrist.side ^ kZobrist.castling[ before.castleRights ^ after.castleRights ];
+    if ( before.epSquare >= 0 )
+        key ^= kZobrist.ep_file[ file_of( before.epSquare ) ];
+    if ( after.epSquare >= 0 )
+        key ^= kZobrist.ep_file[ file_of( after.epSquare ) ];
+    const U64* a = &before.bb.WP;
+    const U64* b = &after.bb.WP;
+    U64 pawnKey = before.pawnKey;
+    for ( int i = 0; i < 12; ++i )
     {
-        if ( r < 7 )
+        U64 diff = a[ i ] ^ b[ i ];
+        while ( diff )
         {
-            if ( f > 0 )
-            {
-                int p = sq + 7;
-                if ( p < 64 && ( pos.bb.BP & bb( p ) ) )
-                    attackers |= bb( p );
-            }
-            if ( f < 7 )
-            {
-                int p = sq + 9;
-                if ( p < 64 && ( pos.bb.BP & bb( p ) ) )
-                    attackers |= bb( p );
-            }
+            U64 z = kZobrist.piece[ i ][ lsb_index( diff ) ];
+            key ^= z;
+            if ( i % 6 == 0 )
+                pawnKey ^= z;
+            diff &= diff - 1;
         }
     }
-    attackers |= knightMask[ sq ] & ( byWhite ? pos.bb.WN : pos.bb.BN );
-    attackers |= kingMask[ sq ] & ( byWhite ? pos.bb.WK : pos.bb.BK );
-    auto ray_scan = [ & ]( const int* df, const int* dr, int c, U64 mask )
-    { for(int d=0; d<c; ++d){ int cf=f, cr=r; while(true){ cf+=df[d]; cr+=dr[d]; if(cf<0||cf>7||cr<0||cr>7) break; int s=cr*8+cf; U64 b=bb(s); if(occ & b){ if(mask & b) attackers |= b; break; } } } };
-    const int bdf[ 4 ] = { 1, 1, -1, -1 };
-    const int bdr[ 4 ] = { 1, -1, 1, -1 };
-    U64 bq = byWhite ? ( pos.bb.WB | pos.bb.WQ ) : ( pos.bb.BB | pos.bb.BQ );
-    ray_scan( bdf, bdr, 4, bq );
-    const int rdf[ 4 ] = { 1, -1, 0, 0 };
-    const int rdr[ 4 ] = { 0, 0, 1, -1 };
-    U64 rq = byWhite ? ( pos.bb.WR | pos.bb.WQ ) : ( pos.bb.BR | pos.bb.BQ );
-    ray_scan( rdf, rdr, 4, rq );
+    after.key = key;
+    after.pawnKey = pawnKey;
+}
+
+// Fifty-move rule, or a repetition within the reversible plies since the last
+// capture or pawn move. Only positions with the same side to move can match.
+bool ChessEngine1::is_draw( const Position& pos, const std::vector< U64 >& keys )
+{
+    if ( pos.halfmoveClock >= 100 )
+        return true;
+    int n = ( int )keys.size();
+    int limit = std::min( pos.halfmoveClock, n );
+    for ( int i = 4; i <= limit; i += 2 )
+        if ( keys[ n - i ] == pos.key )
+            return true;
+    return false;
+}
+
+template < int By >
+ChessEngine1::U64 ChessEngine1::attackers_to( const Position& pos, int sq )
+{
+    const U64* p = side_bb( pos, By );
+    U64 occ = pos.bb.occAll;
+    // A pawn of By attacks sq exactly when a pawn of the other colour on sq would attack it.
+    U64 attackers = kGeometry.pawn[ ColorTraits< By >::them ][ sq ] & p[ 0 ];
+    attackers |= kGeometry.knight[ sq ] & p[ 1 ];
+    attackers |= kGeometry.king[ sq ] & p[ 5 ];
+    attackers |= bishop_attacks( sq, occ ) & ( p[ 2 ] | p[ 4 ] );
+    attackers |= rook_attacks( sq, occ ) & ( p[ 3 ] | p[ 4 ] );
     return attackers;
 }
+ChessEngine1::U64 ChessEngine1::attackers_to( const Position& pos, int sq, int byWhite )
+{
+    return byWhite ? attackers_to< White >( pos, sq ) : attackers_to< Black >( pos, sq );
+}
 bool ChessEngine1::square_attacked( const Position& pos, int sq, int byWhite )
 {
     return attackers_to( pos, sq, byWhite ) != 0ULL;
 }
 
+template < int Us >
 void ChessEngine1::apply_move( const Position& pos, const Move& m, Position& out )
 {
+    using C = ColorTraits< Us >;
     out = pos;
     U64 fromB = bb( m.from ), toB = bb( m.to );
-    bool white = ( pos.sideToMove == 0 );
-    if ( m.isCapture )
+    U64* own = side_bb( out, Us );
+    U64* their = side_bb( out, C::them );
+    if ( m.isEnPassant )
+        their[ 0 ] &= ~bb( m.to - C::push );
+    else if ( m.isCapture )
     {
-        if ( white )
-        {
-            out.bb.BP &= ~toB;
-            out.bb.BN &= ~toB;
-            out.bb.BB &= ~toB;
-            out.bb.BR &= ~toB;
-            out.bb.BQ &= ~toB;
-            out.bb.BK &= ~toB;
-        }
-        else
-        {
-            out.bb.WP &= ~toB;
-            out.bb.WN &= ~toB;
-            out.bb.WB &= ~toB;
-            out.bb.WR &= ~toB;
-            out.bb.WQ &= ~toB;
-            out.bb.WK &= ~toB;
-        }
+        for ( int t = 0; t < 6; ++t )
+            their[ t ] &= ~toB;
     }
-    auto movePiece = [ & ]( U64& bbt )
-    { if(bbt & fromB){ bbt ^= fromB; bbt |= toB; } };
-    movePiece( white ? out.bb.WP : out.bb.BP );
-    movePiece( white ? out.bb.WN : out.bb.BN );
-    movePiece( white ? out.bb.WB : out.bb.BB );
-    movePiece( white ? out.bb.WR : out.bb.BR );
-    movePiece( white ? out.bb.WQ : out.bb.BQ );
-    movePiece( white ? out.bb.WK : out.bb.BK );
+    bool pawnMove = ( own[ 0 ] & fromB ) != 0;
+    bool kingMove = ( own[ 5 ] & fromB ) != 0;
     if ( m.isCastle )
     {
-        if ( white )
+        // Lift king and rook before placing them: in Chess960 either may land on the other's start square.
+        own[ 5 ] = ( own[ 5 ] & ~fromB ) | toB;
+        own[ 3 ] = ( own[ 3 ] & ~bb( m.rookFrom ) ) | bb( C::home_rank * 8 + castle_path( file_of( m.from ), file_of( m.rookFrom ) ).rook_to );
+    }
+    else
+    {
+        for ( int t = 0; t < 6; ++t )
         {
-            if ( m.to == 6 )
+            if ( own[ t ] & fromB )
             {
-                out.bb.WR &= ~bb( 7 );
-                out.bb.WR |= bb( 5 );
-            }
-            else if ( m.to == 2 )
-            {
-                out.bb.WR &= ~bb( 0 );
-                out.bb.WR |= bb( 3 );
+                own[ t ] ^= fromB | toB;
+                break;
             }
         }
-        else
+        if ( pawnMove && m.promo )
         {
-            if ( m.to == 62 )
-            {
-                out.bb.BR &= ~bb( 63 );
-                out.bb.BR |= bb( 61 );
-            }
-            else if ( m.to == 58 )
+            own[ 0 ] &= ~toB;
+            switch ( std::tolower( m.promo ) )
             {
-                out.bb.BR &= ~bb( 56 );
-                out.bb.BR |= bb( 59 );
+            case 'n':
+                own[ 1 ] |= toB;
+                break;
+            case 'b':
+                own[ 2 ] |= toB;
+                break;
+            case 'r':
+                own[ 3 ] |= toB;
+                break;
+            default:
+                own[ 4 ] |= toB;
+                break;
             }
         }
     }
     out.bb.occWhite = out.bb.WP | out.bb.WN | out.bb.WB | out.bb.WR | out.bb.WQ | out.bb.WK;
     out.bb.occBlack = out.bb.BP | out.bb.BN | out.bb.BB | out.bb.BR | out.bb.BQ | out.bb.BK;
     out.bb.occAll = out.bb.occWhite | out.bb.occBlack;
-    if ( !white )
+    if ( Us == Black )
         out.fullmoveNumber++;
-    out.sideToMove = white ? 1 : 0;
-    out.epSquare = -1;
+    out.halfmoveClock = ( pawnMove || m.isCapture ) ? 0 : pos.halfmoveClock + 1;
+    out.sideToMove = C::them;
+    // Set after every double step, as in ChessEngine2, so both engines hash the same positions alike.
+    out.epSquare = ( pawnMove && m.to - m.from == 2 * C::push ) ? m.from + C::push : -1;
     auto strip = [ & ]( int mask )
-    { out.castleRights &= ~mask; };
-    if ( m.from == 4 )
-        strip( 1 | 2 );
-    if ( m.from == 60 )
-        strip( 4 | 8 );
-    if ( m.from == 0 || m.to == 0 )
-        strip( 2 );
-    if ( m.from == 7 || m.to == 7 )
-        strip( 1 );
-    if ( m.from == 56 || m.to == 56 )
-        strip( 8 );
-    if ( m.from == 63 || m.to == 63 )
-        strip( 4 );
+    { out.castleRights &= ~mask; for(int i=0;i<4;++i) if(mask & (1<<i)) out.castleRookFile[i] = -1; };
+    if ( kingMove )
+        strip( C::castle_rights );
+    // A rook leaving, or being captured on, its castling square loses that right.
+    for ( int i = 0; i < 4; ++i )
+    {
+        if ( pos.castleRookFile[ i ] < 0 )
+            continue;
+        int rookSq = ( i < 2 ? 0 : 56 ) + pos.castleRookFile[ i ];
+        if ( ( m.from == rookSq && !m.isCastle ) || ( m.to == rookSq && m.isCapture ) )
+            strip( 1 << i );
+    }
+    update_key( pos, out );
+}
+void ChessEngine1::apply_move( const Position& pos, const Move& m, Position& out )
+{
+    pos.sideToMove == White ? apply_move< White >( pos, m, out ) : apply_move< Black >( pos, m, out );
 }
 
 int ChessEngine1::evaluate_material( const Position& pos )
 {
-    static const int pieceValue[ 6 ] = { 100, 320, 330, 500, 900, 0 };
+    const int* pieceValue = pieceValues;
     int w = 0, b = 0;
     auto add = [ & ]( U64 bb, int val, bool white )
     { while(bb){ bb &= bb-1; if(white) w+=val; else b+=val; } };
@@ -416,75 +384,227 @@ int ChessEngine1::evaluate_material( const Position& pos )
     add( pos.bb.BQ, pieceValue[ 4 ], false );
     return w - b;
 }
+void ChessEngine1::evaluate_pawns( U64 white, U64 black, PawnEntry& e )
+{
+    const U64 fileA = 0x0101010101010101ULL;
+    const U64 pawns[ 2 ] = { white, black };
+    int score[ 2 ] = {};
+    for ( int side = 0; side < 2; ++side )
+    {
+        int ahead = side == White ? North : South;
+        U64 own = pawns[ side ], enemy = pawns[ side ^ 1 ];
+        e.passed[ side ] = e.isolated[ side ] = e.doubled[ side ] = 0;
+        for ( U64 p = own; p; p &= p - 1 )
+        {
+            int sq = lsb_index( p );
+            int file = file_of( sq );
+            U64 adjacentFiles = ( file > 0 ? fileA << ( file - 1 ) : 0 ) | ( file < 7 ? fileA << ( file + 1 ) : 0 );
+            U64 front = kGeometry.ray[ ahead ][ sq ];
+            U64 span = front | ( file > 0 ? kGeometry.ray[ ahead ][ sq - 1 ] : 0 ) | ( file < 7 ? kGeometry.ray[ ahead ][ sq + 1 ] : 0 );
+            if ( !( span & enemy ) )
+            {
+                e.passed[ side ] |= bb( sq );
+                score[ side ] += kPassedBonus[ side == White ? rank_of( sq ) : 7 - rank_of( sq ) ];
+            }
+            if ( !( adjacentFiles & own ) )
+            {
+                e.isolated[ side ] |= bb( sq );
+                score[ side ] -= kIsolatedPenalty;
+            }
+            if ( front & own )
+            {
+                e.doubled[ side ] |= bb( sq );
+                score[ side ] -= kDoubledPenalty;
+            }
+        }
+    }
+    e.score = score[ White ] - score[ Black ];
+}
+
+int ChessEngine1::pawn_score( const Position& pos, SearchContext& ctx )
+{
+    if ( !ctx.pawns )
+    {
+        PawnEntry e;
+        evaluate_pawns( pos.bb.WP, pos.bb.BP, e );
+        return e.score;
+    }
+    ENGINE_STAT( ++ctx.stats.pawn_probes );
+    PawnEntry& e = ctx.pawns->slot( pos.pawnKey );
+    if ( e.key == pos.pawnKey )
+    {
+        ENGINE_STAT( ++ctx.stats.pawn_hits );
+        return e.score;
+    }
+    evaluate_pawns( pos.bb.WP, pos.bb.BP, e );
+    e.key = pos.pawnKey;
+    return e.score;
+}
+
 int ChessEngine1::evaluate( const Position& pos )
 {
-    int mat = evaluate_material( pos );
-    return ( pos.sideToMove == 0 ) ? mat : -mat;
+    PawnEntry e;
+    evaluate_pawns( pos.bb.WP, pos.bb.BP, e );
+    int score = evaluate_material( pos ) + e.score;
+    return ( pos.sideToMove == 0 ) ? score : -score;
 }
 
-ChessEngine1::U64 ChessEngine1::can_castle( const Position& pos, bool white, bool kingside )
+int ChessEngine1::evaluate( const Position& pos, SearchContext& ctx )
 {
-    return 0;
+    int score;
+    if ( ctx.evals )
+    {
+        ENGINE_STAT( ++ctx.stats.eval_probes );
+        if ( ctx.evals->probe( pos.key, score ) )
+        {
+            ENGINE_STAT( ++ctx.stats.eval_hits );
+            return score;
+        }
+    }
+    score = evaluate_material( pos ) + pawn_score( pos, ctx );
+    if ( pos.sideToMove != 0 )
+        score = -score;
+    if ( ctx.evals )
+        ctx.evals->store( pos.key, score );
+    return score;
+}
+
+template < int Us >
+void ChessEngine1::compute_attack_info( const Position& pos, AttackInfo& ai )
+{
+    using C = ColorTraits< Us >;
+    ai = AttackInfo();
+    const U64* own = side_bb( pos, Us );
+    const U64* their = side_bb( pos, C::them );
+    ai.kingSq = lsb_index( own[ 5 ] );
+    U64 ownKing = own[ 5 ];
+    const U64* pieces[ 2 ] = { &pos.bb.WP, &pos.bb.BP };
+    for ( int side = 0; side < 2; ++side )
+    {
+        U64 occ = side == C::them ? ( pos.bb.occAll & ~ownKing ) : pos.bb.occAll;
+        U64* out = ai.byPiece[ side ];
+        for ( U64 p = pieces[ side ][ 0 ]; p; p &= p - 1 )
+            out[ 0 ] |= kGeometry.pawn[ side ][ lsb_index( p ) ];
+        for ( U64 n = pieces[ side ][ 1 ]; n; n &= n - 1 )
+            out[ 1 ] |= kGeometry.knight[ lsb_index( n ) ];
+        for ( U64 b = pieces[ side ][ 2 ]; b; b &= b - 1 )
+            out[ 2 ] |= bishop_attacks( lsb_index( b ), occ );
+        for ( U64 r = pieces[ side ][ 3 ]; r; r &= r - 1 )
+            out[ 3 ] |= rook_attacks( lsb_index( r ), occ );
+        for ( U64 q = pieces[ side ][ 4 ]; q; q &= q - 1 )
+            out[ 4 ] |= bishop_attacks( lsb_index( q ), occ ) | rook_attacks( lsb_index( q ), occ );
+        if ( pieces[ side ][ 5 ] )
+            out[ 5 ] = kGeometry.king[ lsb_index( pieces[ side ][ 5 ] ) ];
+        for ( int t = 0; t < 6; ++t )
+            ai.bySide[ side ] |= out[ t ];
+    }
+    if ( ai.kingSq < 0 )
+        return;
+    ai.checkers = attackers_to< C::them >( pos, ai.kingSq );
+    // A pinned piece is the only piece between our king and an enemy slider on the same line:
+    // the king's ray and the slider's ray then both stop on it.
+    U64 ownOcc = side_occ( pos, Us );
+    U64 theirOcc = side_occ( pos, C::them );
+    U64 theirDiag = their[ 2 ] | their[ 4 ];
+    U64 theirOrtho = their[ 3 ] | their[ 4 ];
+    U64 snipers = ( bishop_attacks( ai.kingSq, theirOcc ) & theirDiag ) | ( rook_attacks( ai.kingSq, theirOcc ) & theirOrtho );
+    for ( ; snipers; snipers &= snipers - 1 )
+    {
+        U64 between = between_mask( ai.kingSq, lsb_index( snipers ) ) & pos.bb.occAll;
+        if ( between && !( between & ( between - 1 ) ) )
+            ai.pinned |= between & ownOcc;
+    }
+}
+void ChessEngine1::compute_attack_info( const Position& pos, AttackInfo& ai )
+{
+    pos.sideToMove == White ? compute_attack_info< White >( pos, ai ) : compute_attack_info< Black >( pos, ai );
+}
+
+// Rook square bitboard if the side may castle that way now, else 0. Works for Chess960 rook files.
+template < int Us >
+ChessEngine1::U64 ChessEngine1::can_castle( const Position& pos, bool kingside, U64 enemyAttacks )
+{
+    using C = ColorTraits< Us >;
+    int bit = 2 * Us + ( kingside ? 0 : 1 );
+    if ( !( pos.castleRights & ( 1 << bit ) ) )
+        return 0;
+    int kingSq = lsb_index( side_bb( pos, Us )[ 5 ] );
+    if ( kingSq < 0 || rank_of( kingSq ) != C::home_rank )
+        return 0;
+    int rookSq = C::home_rank * 8 + pos.castleRookFile[ bit ];
+    if ( !( side_bb( pos, Us )[ 3 ] & bb( rookSq ) ) )
+        return 0;
+    const CastlePath& path = castle_path( file_of( kingSq ), file_of( rookSq ) );
+    int shift = C::home_rank * 8;
+    if ( pos.bb.occAll & ( path.must_be_empty << shift ) )
+        return 0;
+    if ( enemyAttacks & ( path.must_be_safe << shift ) )
+        return 0;
+    return bb( rookSq );
 }
 
 void ChessEngine1::generate_pseudo_moves( const Position& pos, std::vector< Move >& out )
 {
+    AttackInfo ai;
+    compute_attack_info( pos, ai );
+    generate_pseudo_moves( pos, out, ai );
+}
+
+void ChessEngine1::generate_pseudo_moves( const Position& pos, std::vector< Move >& out, const AttackInfo& ai )
+{
+    pos.sideToMove == White ? generate_pseudo_moves< White >( pos, out, ai ) : generate_pseudo_moves< Black >( pos, out, ai );
+}
+
+template < int Us >
+void ChessEngine1::generate_pseudo_moves( const Position& pos, std::vector< Move >& out, const AttackInfo& ai )
+{
+    using C = ColorTraits< Us >;
     out.clear();
-    bool white = pos.sideToMove == 0;
-    U64 occOwn = white ? pos.bb.occWhite : pos.bb.occBlack;
-    U64 occEnemy = white ? pos.bb.occBlack : pos.bb.occWhite;
+    const U64* own = side_bb( pos, Us );
+    U64 occOwn = side_occ( pos, Us );
+    U64 occEnemy = side_occ( pos, C::them );
     U64 occAll = pos.bb.occAll;
+    const U64* pawnAtt = kGeometry.pawn[ Us ];
     auto add = [ & ]( int f, int t, bool cap = false, int promo = 0, bool castle = false )
     { Move m; m.from=f; m.to=t; m.isCapture=cap; m.promo=promo; m.isCastle=castle; out.push_back(m); };
     auto slide = [ & ]( U64 pieces, bool bishop )
     { while(pieces){ int from=lsb_index(pieces); if(from<0) break; pieces &= pieces-1; U64 att=(bishop? bishop_attacks(from,occAll):rook_attacks(from,occAll)) & ~occOwn; while(att){ int to=lsb_index(att); if(to<0) break; bool cap= occEnemy & bb(to); add(from,to,cap); att &= att-1; } } };
-    U64 pawns = white ? pos.bb.WP : pos.bb.BP;
+    // Queen first: search tries it before the underpromotions.
+    auto addPawn = [ & ]( int f, int t, bool cap )
+    { if(rank_of(t) != C::promotion_rank){ add(f,t,cap); return; } for(char p : { 'q', 'r', 'b', 'n' }) add(f,t,cap,p); };
+    // Pawns already on the last rank cannot move; skipping them keeps from + push on the board.
+    U64 pawns = own[ 0 ] & ~C::promotion_mask;
     while ( pawns )
     {
         int from = lsb_index( pawns );
-        if ( from < 0 )
-            break;
         pawns &= pawns - 1;
-        int r = rank_of( from );
-        int dir = white ? +8 : -8;
-        int one = from + dir;
-        if ( one >= 0 && one < 64 && !( occAll & bb( one ) ) )
-        {
-            if ( ( white && r == 6 ) || ( !white && r == 1 ) )
-                add( from, one, false, 'q' );
-            else
-                add( from, one );
-            int startRank = white ? 1 : 6;
-            int two = from + 2 * dir;
-            if ( r == startRank && !( occAll & bb( two ) ) )
-                add( from, two );
-        }
-        int f = file_of( from );
-        auto capTry = [ & ]( int to )
-        { if(to>=0&&to<64){ if(occEnemy & bb(to)){ int tr=rank_of(to); if((white&&tr==7)||(!white&&tr==0)) add(from,to,true,'q'); else add(from,to,true);} } };
-        if ( white )
+        int one = from + C::push;
+        if ( !( occAll & bb( one ) ) )
         {
-            if ( f > 0 )
-                capTry( from + 7 );
-            if ( f < 7 )
-                capTry( from + 9 );
+            addPawn( from, one, false );
+            if ( rank_of( from ) == C::pawn_start_rank && !( occAll & bb( one + C::push ) ) )
+            {
+                add( from, one + C::push );
+                out.back().isDoublePawnPush = true;
+            }
         }
-        else
+        // The attack mask lists the a-file side capture first for both colours.
+        for ( U64 caps = pawnAtt[ from ] & occEnemy; caps; caps &= caps - 1 )
+            addPawn( from, lsb_index( caps ), true );
+        if ( pos.epSquare >= 0 && ( pawnAtt[ from ] & bb( pos.epSquare ) ) )
         {
-            if ( f > 0 )
-                capTry( from - 9 );
-            if ( f < 7 )
-                capTry( from - 7 );
+            add( from, pos.epSquare, true );
+            out.back().isEnPassant = true;
         }
     }
-    U64 knights = white ? pos.bb.WN : pos.bb.BN;
+    U64 knights = own[ 1 ];
     while ( knights )
     {
         int from = lsb_index( knights );
         if ( from < 0 )
             break;
         knights &= knights - 1;
-        U64 att = knightMask[ from ] & ~occOwn;
+        U64 att = kGeometry.knight[ from ] & ~occOwn;
         while ( att )
         {
             int to = lsb_index( att );
@@ -495,9 +615,9 @@ void ChessEngine1::generate_pseudo_moves( const Position& pos, std::vector< Move
             att &= att - 1;
         }
     }
-    slide( white ? pos.bb.WB : pos.bb.BB, true );
-    slide( white ? pos.bb.WR : pos.bb.BR, false );
-    U64 queens = white ? pos.bb.WQ : pos.bb.BQ;
+    slide( own[ 2 ], true );
+    slide( own[ 3 ], false );
+    U64 queens = own[ 4 ];
     while ( queens )
     {
         int from = lsb_index( queens );
@@ -515,10 +635,10 @@ void ChessEngine1::generate_pseudo_moves( const Position& pos, std::vector< Move
             att &= att - 1;
         }
     }
-    int kingSq = lsb_index( white ? pos.bb.WK : pos.bb.BK );
+    int kingSq = lsb_index( own[ 5 ] );
     if ( kingSq >= 0 )
     {
-        U64 kAtt = kingMask[ kingSq ] & ~occOwn;
+        U64 kAtt = kGeometry.king[ kingSq ] & ~occOwn;
         while ( kAtt )
         {
             int to = lsb_index( kAtt );
@@ -529,111 +649,446 @@ void ChessEngine1::generate_pseudo_moves( const Position& pos, std::vector< Move
             kAtt &= kAtt - 1;
         }
     }
-    auto canCastle = [ & ]( bool kside )
-    { if(white){ if(kside){ if(!(pos.castleRights&1)) return false; if(!(pos.bb.WK & bb(4))) return false; if(pos.bb.occAll & (bb(5)|bb(6))) return false; if(square_attacked(pos,4,false)||square_attacked(pos,5,false)||square_attacked(pos,6,false)) return false; return true;} else { if(!(pos.castleRights&2)) return false; if(!(pos.bb.WK & bb(4))) return false; if(pos.bb.occAll & (bb(1)|bb(2)|bb(3))) return false; if(square_attacked(pos,4,false)||square_attacked(pos,3,false)||square_attacked(pos,2,false)) return false; return true; }} else { if(kside){ if(!(pos.castleRights&4)) return false; if(!(pos.bb.BK & bb(60))) return false; if(pos.bb.occAll & (bb(61)|bb(62))) return false; if(square_attacked(pos,60,true)||square_attacked(pos,61,true)||square_attacked(pos,62,true)) return false; return true;} else { if(!(pos.castleRights&8)) return false; if(!(pos.bb.BK & bb(60))) return false; if(pos.bb.occAll & (bb(57)|bb(58)|bb(59))) return false; if(square_attacked(pos,60,true)||square_attacked(pos,59,true)||square_attacked(pos,58,true)) return false; return true; }} };
-    if ( canCastle( true ) )
-        add( kingSq, white ? 6 : 62, false, 0, true );
-    if ( canCastle( false ) )
-        add( kingSq, white ? 2 : 58, false, 0, true );
+    if ( kingSq >= 0 && ( pos.castleRights & C::castle_rights ) )
+    {
+        U64 enemyAttacks = ai.bySide[ C::them ];
+        for ( int side = 0; side < 2; ++side )
+        {
+            U64 rook = can_castle< Us >( pos, side == 0, enemyAttacks );
+            if ( !rook )
+                continue;
+            Move m;
+            m.from = kingSq;
+            m.to = C::home_rank * 8 + castle_path( file_of( kingSq ), lsb_index( rook ) & 7 ).king_to;
+            m.isCastle = true;
+            m.rookFrom = lsb_index( rook );
+            out.push_back( m );
+        }
+    }
+}
+
+namespace
+{
+// Singular extensions: the shallowest node tested, and how far below the table score the other moves
+// must stay. Unlike Engine2 there is no mate bound to skip: this search scores a position without legal
+// moves by its evaluation, so it has no mate scores, and a check extension finds material, not mates.
+const int kSingularDepth = 4;
+const int kSingularMargin = 50;
 }
 
-int ChessEngine1::negamax( Position& pos, int depth, int alpha, int beta, std::vector< Move >& pv )
+int ChessEngine1::negamax( Position& pos, int depth, int alpha, int beta, SearchContext& ctx, int ply )
 {
+    return pos.sideToMove == White ? negamax< White >( pos, depth, alpha, beta, ctx, ply )
+                                   : negamax< Black >( pos, depth, alpha, beta, ctx, ply );
+}
+
+// The side to move alternates with every ply, so each instantiation recurses into the other
+// colour's and the colour is never tested inside the tree.
+template < int Us >
+int ChessEngine1::negamax( Position& pos, int depth, int alpha, int beta, SearchContext& ctx, int ply )
+{
+    ENGINE_STAT( ctx.stats.enter_node( ply ) );
+    ctx.pv.clear( ply );
+    if ( ctx.cfg.draw_detection && is_draw( pos, ctx.keys ) )
+    {
+        ENGINE_STAT( ++ctx.stats.draw_cutoffs );
+        return 0;
+    }
     if ( depth == 0 )
-        return evaluate( pos );
-    std::vector< Move > pseudo;
-    generate_pseudo_moves( pos, pseudo );
+    {
+        ENGINE_STAT_TIMER( evalTimer, ctx.stats.eval_ns );
+        return evaluate( pos, ctx );
+    }
+    uint16_t ttMove = 0;
+    TTEntry e;
+    bool hit = false;
+    if ( ctx.tt )
+    {
+        ENGINE_STAT( ++ctx.stats.tt_probes );
+        if ( ( hit = ctx.tt->probe( ctx.table_key( pos.key ), e ) ) )
+        {
+            ENGINE_STAT( ++ctx.stats.tt_hits );
+            ttMove = e.move;
+            // Only an entry of this very depth may end the node, so a fixed-depth search returns
+            // the same best score whether the table is cold or left warm by earlier moves.
+            if ( e.depth == depth && ( e.bound == Bound::Exact || ( e.bound == Bound::Lower && e.score >= beta ) || ( e.bound == Bound::Upper && e.score <= alpha ) ) )
+            {
+                ENGINE_STAT( ++ctx.stats.tt_cutoffs );
+                return e.score;
+            }
+        }
+    }
     std::vector< Move > legal;
-    filter_legal( pos, pseudo, legal );
+    {
+        ENGINE_STAT_TIMER( genTimer, ctx.stats.movegen_ns );
+        AttackInfo ai;
+        compute_attack_info< Us >( pos, ai );
+        std::vector< Move > pseudo;
+        generate_pseudo_moves< Us >( pos, pseudo, ai );
+        filter_legal< Us >( pos, pseudo, legal, ai );
+    }
     if ( legal.empty() )
-        return evaluate( pos );
+    {
+        ENGINE_STAT_TIMER( evalTimer, ctx.stats.eval_ns );
+        return evaluate( pos, ctx );
+    }
+    order_moves( legal, ttMove, ctx.history, Us );
     int best = -10000000;
+    int alphaIn = alpha;
     Move bestM{};
-    for ( auto& m : legal )
+    ctx.keys.push_back( pos.key );
+    // The table move, stored as a lower bound or exact from nearly this depth, is singular when every
+    // other move stays below its score by a margin at half the depth.
+    bool singular = ctx.cfg.singular_extension && depth >= kSingularDepth && hit && ttMove && e.bound != Bound::Upper && e.depth >= depth - 3 &&
+                    ctx.extensions < ctx.cfg.extension_budget && is_singular< Us >( pos, legal, ttMove, e.score - kSingularMargin, ( depth - 1 ) / 2, ctx, ply );
+    if ( depth == 1 && ctx.cfg.batch_frontier )
+        best = search_frontier< Us >( pos, legal, alpha, beta, bestM, ctx, ply );
+    else
     {
-        Position next;
-        apply_move( pos, m, next );
-        int score = -negamax( next, depth - 1, -beta, -alpha, pv );
+        for ( size_t i = 0; i < legal.size(); ++i )
+        {
+            const Move& m = legal[ i ];
+            Position next;
+            apply_move< Us >( pos, m, next );
+            int ext = extension( next, m, ctx, singular && tt_move( m ) == ttMove );
+            int score = search_child( next, m, depth - 1 + ext, alpha, beta, ctx, ply + 1, ext );
+            if ( score > best )
+            {
+                best = score;
+                bestM = m;
+            }
+            if ( score > alpha )
+            {
+                alpha = score;
+                ctx.pv.update( ply, tt_move( m ) );
+            }
+            if ( alpha >= beta )
+            {
+                ENGINE_STAT( ctx.stats.record_cutoff( ( int )i ) );
+                if ( !m.isCapture && !m.promo )
+                    ctx.history.reward( Us, m.from, m.to, depth );
+                break;
+            }
+        }
+    }
+    ctx.keys.pop_back();
+    if ( ctx.tt )
+    {
+        Bound bound = best >= beta ? Bound::Lower : best > alphaIn ? Bound::Exact : Bound::Upper;
+        ctx.tt->store( ctx.table_key( pos.key ), depth, best, bound, bound == Bound::Upper ? 0 : tt_move( bestM ) );
+    }
+    return best;
+}
+
+// Transposition-table move first, then captures and promotions in generation order, then quiet moves
+// by history score. The sort is stable, so with empty tables the generation order is kept.
+void ChessEngine1::order_moves( std::vector< Move >& moves, uint16_t ttMove, const HistoryTable& history, int side )
+{
+    std::vector< std::pair< int, Move > > keyed;
+    keyed.reserve( moves.size() );
+    for ( const Move& m : moves )
+    {
+        int key = ( ttMove && tt_move( m ) == ttMove ) ? 1 << 30 : ( m.isCapture || m.promo ) ? 1 << 29 : history.get( side, m.from, m.to );
+        keyed.emplace_back( key, m );
+    }
+    std::stable_sort( keyed.begin(), keyed.end(), []( const auto& a, const auto& b ) { return a.first > b.first; } );
+    for ( size_t i = 0; i < moves.size(); ++i )
+        moves[ i ] = keyed[ i ].second;
+}
+
+// Depth-1 node: make every child, score all non-drawn leaves with one batched evaluation, then run
+// the usual alpha-beta loop over the ready scores. Node counts and results match the per-leaf path.
+template < int Us >
+int ChessEngine1::search_frontier( const Position& pos, const std::vector< Move >& legal, int alpha, int beta, Move& bestM, SearchContext& ctx, int ply )
+{
+    using C = ColorTraits< Us >;
+    LeafBatch batch;
+    int slot[ LeafBatch::kCapacity ];
+    int evals[ LeafBatch::kCapacity ];
+    int pawns[ LeafBatch::kCapacity ];
+    size_t n = std::min( legal.size(), ( size_t )LeafBatch::kCapacity );
+    {
+        ENGINE_STAT_TIMER( evalTimer, ctx.stats.eval_ns );
+        for ( size_t i = 0; i < n; ++i )
+        {
+            Position next;
+            apply_move< Us >( pos, legal[ i ], next );
+            if ( ctx.cfg.draw_detection && is_draw( next, ctx.keys ) )
+            {
+                slot[ i ] = -1;
+                continue;
+            }
+            // An extended move is searched below instead.
+            if ( extension( next, legal[ i ], ctx, false ) )
+            {
+                slot[ i ] = -2;
+                continue;
+            }
+            // Leaves are scored for their side to move, which is the opponent of pos. The batch adds
+            // up material; pawn structure comes from the pawn cache per leaf.
+            pawns[ i ] = pawn_score( next, ctx );
+            U64 bbs[ 12 ];
+            const U64* own = side_bb( next, C::them );
+            const U64* other = side_bb( next, Us );
+            for ( int t = 0; t < 6; ++t )
+            {
+                bbs[ t ] = own[ t ];
+                bbs[ t + 6 ] = other[ t ];
+            }
+            slot[ i ] = batch.add( bbs );
+        }
+        ctx.cfg.evaluate_batch( batch, pieceValues, evals );
+    }
+    int best = -10000000;
+    for ( size_t i = 0; i < n; ++i )
+    {
+        int score;
+        if ( slot[ i ] == -2 )
+        {
+            Position next;
+            apply_move< Us >( pos, legal[ i ], next );
+            score = search_child( next, legal[ i ], 1, alpha, beta, ctx, ply + 1, 1 );
+        }
+        else
+        {
+            ENGINE_STAT( ctx.stats.enter_node( ply + 1 ) );
+            if ( slot[ i ] < 0 )
+                ENGINE_STAT( ++ctx.stats.draw_cutoffs );
+            ctx.pv.clear( ply + 1 );
+            score = slot[ i ] < 0 ? 0 : -( evals[ slot[ i ] ] + ( C::them == White ? pawns[ i ] : -pawns[ i ] ) );
+        }
         if ( score > best )
         {
             best = score;
-            bestM = m;
+            bestM = legal[ i ];
         }
         if ( score > alpha )
+        {
             alpha = score;
+            ctx.pv.update( ply, tt_move( legal[ i ] ) );
+        }
         if ( alpha >= beta )
+        {
+            ENGINE_STAT( ctx.stats.record_cutoff( ( int )i ) );
+            if ( !legal[ i ].isCapture && !legal[ i ].promo )
+                ctx.history.reward( Us, legal[ i ].from, legal[ i ].to, 1 );
             break;
+        }
     }
-    pv.clear();
-    pv.push_back( bestM );
     return best;
 }
 
+int ChessEngine1::extension( const Position& next, const Move& m, SearchContext& ctx, bool singular )
+{
+    if ( ctx.extensions >= ctx.cfg.extension_budget )
+        return 0;
+    if ( singular )
+        return 1;
+    if ( ctx.cfg.recapture_extension && m.isCapture && m.to == ctx.recapture_square )
+        return 1;
+    if ( !ctx.cfg.check_extension )
+        return 0;
+    U64 king = side_bb( next, next.sideToMove )[ 5 ];
+    return king && attackers_to( next, lsb_index( king ), next.sideToMove != White ) ? 1 : 0;
+}
+
+int ChessEngine1::search_child( Position& next, const Move& m, int depth, int alpha, int beta, SearchContext& ctx, int ply, int ext )
+{
+    int saved = ctx.recapture_square;
+    ctx.recapture_square = m.isCapture ? m.to : -1;
+    ctx.extensions += ext;
+    int score = -negamax( next, depth, -beta, -alpha, ctx, ply );
+    ctx.extensions -= ext;
+    ctx.recapture_square = saved;
+    return score;
+}
+
+// Every move but the table move against bound with a null window; the first to reach it ends the test.
+template < int Us >
+bool ChessEngine1::is_singular( const Position& pos, const std::vector< Move >& legal, uint16_t ttMove, int bound, int depth, SearchContext& ctx, int ply )
+{
+    for ( const Move& m : legal )
+    {
+        if ( tt_move( m ) == ttMove )
+            continue;
+        Position next;
+        apply_move< Us >( pos, m, next );
+        if ( search_child( next, m, depth, bound - 1, bound, ctx, ply + 1, 0 ) >= bound )
+            return false;
+    }
+    return true;
+}
+
 std::string ChessEngine1::move_to_uci( const Move& m )
 {
     std::string s;
+    int to = ( m.isCastle && !is_standard_castle( file_of( m.from ), file_of( m.rookFrom ) ) ) ? m.rookFrom : m.to;
     s.push_back( char( 'a' + file_of( m.from ) ) );
     s.push_back( char( '1' + rank_of( m.from ) ) );
-    s.push_back( char( 'a' + file_of( m.to ) ) );
-    s.push_back( char( '1' + rank_of( m.to ) ) );
+    s.push_back( char( 'a' + file_of( to ) ) );
+    s.push_back( char( '1' + rank_of( to ) ) );
     if ( m.promo )
         s.push_back( std::tolower( ( unsigned char )m.promo ) );
     return s;
 }
 
-std::string ChessEngine1::choose_move_internal( const std::string& fen, int depth )
+// Every legal root move with its score, alpha narrowing from move to move. False if the FEN does not parse.
+bool ChessEngine1::search_root( const std::string& fen, int depth, SearchContext& ctx, std::vector< std::pair< Move, int > >& scores )
 {
+    ENGINE_STAT_TIMER( searchTimer, ctx.stats.search_ns );
     Position p;
     if ( !parse_fen( fen, p ) )
-        return {};
+        return false;
+    ENGINE_STAT( ctx.stats.enter_node( 0 ) );
+    AttackInfo ai;
+    compute_attack_info( p, ai );
     std::vector< Move > pseudo;
-    generate_pseudo_moves( p, pseudo );
+    generate_pseudo_moves( p, pseudo, ai );
     std::vector< Move > legal;
-    filter_legal( p, pseudo, legal );
-    if ( legal.empty() )
-        return {};
+    filter_legal( p, pseudo, legal, ai );
     int alpha = -1000000, beta = 1000000;
-    int best = -1000000;
-    Move bestM{};
-    std::vector< Move > pv;
+    ctx.keys.push_back( p.key );
     for ( auto& m : legal )
     {
         Position next;
         apply_move( p, m, next );
-        int score = -negamax( next, depth - 1, -beta, -alpha, pv );
-        if ( score > best )
-        {
-            best = score;
-            bestM = m;
-        }
+        int ext = extension( next, m, ctx, false );
+        int score = search_child( next, m, depth - 1 + ext, alpha, beta, ctx, 1, ext );
         if ( score > alpha )
             alpha = score;
+        scores.emplace_back( m, score );
     }
-    return move_to_uci( bestM );
+    return true;
 }
-std::vector< std::pair< std::string, int > > ChessEngine1::root_scores_internal( const std::string& fen, int depth )
+
+// MultiPV by iterative deepening (see EngineBase::multipv): per depth, one full-window root search per
+// line over the root moves not yet reported, so the best of them gets an exact score. False if the FEN
+// does not parse.
+bool ChessEngine1::search_lines( const std::string& fen, int depth, int lines, SearchContext& ctx, std::vector< PvLine >& out )
 {
+    ENGINE_STAT_TIMER( searchTimer, ctx.stats.search_ns );
     Position p;
-    std::vector< std::pair< std::string, int > > out;
     if ( !parse_fen( fen, p ) )
-        return out;
+        return false;
+    AttackInfo ai;
+    compute_attack_info( p, ai );
     std::vector< Move > pseudo;
-    generate_pseudo_moves( p, pseudo );
-    std::vector< Move > legal;
-    filter_legal( p, pseudo, legal );
-    if ( legal.empty() )
-        return out;
-    int alpha = -1000000, beta = 1000000;
-    std::vector< Move > pv;
-    for ( auto& m : legal )
+    generate_pseudo_moves( p, pseudo, ai );
+    std::vector< Move > root;
+    filter_legal( p, pseudo, root, ai );
+    ctx.keys.push_back( p.key );
+    size_t n = std::min( root.size(), ( size_t )std::max( lines, 0 ) );
+    std::vector< uint16_t > previous( n, 0 ); // each line's root move one iteration earlier
+    for ( int d = 1; d <= depth; ++d )
     {
+        ctx.stats.depth = d;
+        std::vector< Move > remaining = root;
+        std::vector< PvLine > found;
+        for ( size_t k = 0; k < n; ++k )
+        {
+            ENGINE_STAT( ctx.stats.enter_node( 0 ) );
+            order_moves( remaining, previous[ k ], ctx.history, p.sideToMove );
+            int alpha = -1000000;
+            size_t best = 0;
+            ctx.pv.clear( 0 );
+            for ( size_t i = 0; i < remaining.size(); ++i )
+            {
+                Position next;
+                apply_move( p, remaining[ i ], next );
+                int ext = extension( next, remaining[ i ], ctx, false );
+                int score = search_child( next, remaining[ i ], d - 1 + ext, alpha, 1000000, ctx, 1, ext );
+                if ( score > alpha )
+                {
+                    alpha = score;
+                    best = i;
+                    ctx.pv.update( 0, tt_move( remaining[ i ] ) );
+                }
+            }
+            PvLine line;
+            line.score = alpha;
+            line.depth = d;
+            line.pv = pv_moves( p, d, ctx );
+            found.push_back( line );
+            previous[ k ] = tt_move( remaining[ best ] );
+            remaining.erase( remaining.begin() + best );
+        }
+        out.swap( found );
+    }
+    return true;
+}
+
+// UCI of ctx.pv's root line replayed from root, continued from the transposition table to plies moves
+// where a table hit cut the line short. The replay spends check and recapture extensions as the search
+// did, so the table is probed under the key the line's entries were stored under; a singular extension
+// on the line cannot be told from the moves, and the table part of the line stops there.
+std::vector< std::string > ChessEngine1::pv_moves( const Position& root, int plies, SearchContext& ctx )
+{
+    std::vector< std::string > out;
+    Position pos = root;
+    int saved_extensions = ctx.extensions, saved_recapture = ctx.recapture_square;
+    for ( int i = 0; i < plies; ++i )
+    {
+        uint16_t want = i < ctx.pv.size( 0 ) ? ctx.pv.line( 0 )[ i ] : 0;
+        TTEntry e;
+        if ( !want && ctx.tt && ctx.tt->probe( ctx.table_key( pos.key ), e ) )
+            want = e.move;
+        if ( !want )
+            break;
+        AttackInfo ai;
+        compute_attack_info( pos, ai );
+        std::vector< Move > pseudo, legal;
+        generate_pseudo_moves( pos, pseudo, ai );
+        filter_legal( pos, pseudo, legal, ai );
+        auto it = std::find_if( legal.begin(), legal.end(), [ & ]( const Move& m ) { return tt_move( m ) == want; } );
+        if ( it == legal.end() )
+            break;
+        out.push_back( move_to_uci( *it ) );
         Position next;
-        apply_move( p, m, next );
-        int score = -negamax( next, depth - 1, -beta, -alpha, pv );
-        if ( score > alpha )
-            alpha = score;
-        out.emplace_back( move_to_uci( m ), score );
+        apply_move( pos, *it, next );
+        ctx.extensions += extension( next, *it, ctx, false );
+        ctx.recapture_square = it->isCapture ? it->to : -1;
+        pos = next;
     }
+    ctx.extensions = saved_extensions;
+    ctx.recapture_square = saved_recapture;
+    return out;
+}
+
+std::string ChessEngine1::choose_move_internal( const std::string& fen, int depth )
+{
+    std::string stored;
+    if ( recall_move( fen, depth, stored ) )
+        return stored;
+    SearchContext ctx;
+    begin_search( ctx, depth );
+    std::vector< std::pair< Move, int > > scores;
+    search_root( fen, depth, ctx, scores );
+    end_search( ctx );
+    if ( scores.empty() )
+        return {};
+    int best = -1000000;
+    Move bestM{};
+    for ( auto& s : scores )
+    {
+        if ( s.second > best )
+        {
+            best = s.second;
+            bestM = s.first;
+        }
+    }
+    record_move( fen, depth, best, move_to_uci( bestM ) );
+    return move_to_uci( bestM );
+}
+std::vector< std::pair< std::string, int > > ChessEngine1::root_scores_internal( const std::string& fen, int depth )
+{
+    SearchContext ctx;
+    begin_search( ctx, depth );
+    std::vector< std::pair< Move, int > > scores;
+    search_root( fen, depth, ctx, scores );
+    end_search( ctx );
+    std::vector< std::pair< std::string, int > > out;
+    for ( auto& s : scores )
+        out.emplace_back( move_to_uci( s.first ), s.second );
     return out;
 }
 std::vector< std::string > ChessEngine1::legal_moves_internal( const std::string& fen )
@@ -642,10 +1097,12 @@ std::vector< std::string > ChessEngine1::legal_moves_internal( const std::string
     std::vector< std::string > out;
     if ( !parse_fen( fen, p ) )
         return out;
+    AttackInfo ai;
+    compute_attack_info( p, ai );
     std::vector< Move > pseudo;
-    generate_pseudo_moves( p, pseudo );
+    generate_pseudo_moves( p, pseudo, ai );
     std::vector< Move > legal;
-    filter_legal( p, pseudo, legal );
+    filter_legal( p, pseudo, legal, ai );
     for ( auto& m : legal )
         out.push_back( move_to_uci( m ) );
     return out;
@@ -705,15 +1162,17 @@ std::string ChessEngine1::build_fen( const Position& p )
         if ( rank )
             board.push_back( '/' );
     }
+    // KQkq for a/h rooks, otherwise the Shredder-FEN rook file.
     std::string cast = "";
-    if ( p.castleRights & 1 )
-        cast += "K";
-    if ( p.castleRights & 2 )
-        cast += "Q";
-    if ( p.castleRights & 4 )
-        cast += "k";
-    if ( p.castleRights & 8 )
-        cast += "q";
+    const char* names = "KQkq";
+    for ( int i = 0; i < 4; ++i )
+    {
+        if ( !( p.castleRights & ( 1 << i ) ) )
+            continue;
+        int f = p.castleRookFile[ i ];
+        bool outer = ( i % 2 == 0 ) ? f == 7 : f == 0;
+        cast += outer ? names[ i ] : char( ( i < 2 ? 'A' : 'a' ) + f );
+    }
     if ( cast.empty() )
         cast = "-";
     std::string ep = "-";
@@ -728,22 +1187,55 @@ std::string ChessEngine1::build_fen( const Position& p )
 
 void ChessEngine1::filter_legal( const Position& pos, const std::vector< Move >& pseudo, std::vector< Move >& legal )
 {
+    AttackInfo ai;
+    compute_attack_info( pos, ai );
+    filter_legal( pos, pseudo, legal, ai );
+}
+
+void ChessEngine1::filter_legal( const Position& pos, const std::vector< Move >& pseudo, std::vector< Move >& legal, const AttackInfo& ai )
+{
+    pos.sideToMove == White ? filter_legal< White >( pos, pseudo, legal, ai ) : filter_legal< Black >( pos, pseudo, legal, ai );
+}
+
+// Legality from the attack info alone: king moves against the enemy attack map, other moves
+// against the check-evasion mask (capture the checker or block its ray) and, for a pinned piece,
+// the line through the king. Only en passant and castling are made and tested.
+template < int Us >
+void ChessEngine1::filter_legal( const Position& pos, const std::vector< Move >& pseudo, std::vector< Move >& legal, const AttackInfo& ai )
+{
+    using C = ColorTraits< Us >;
     legal.clear();
     Position tmp;
-    bool white = pos.sideToMove == 0;
-    U64 oppKing = white ? pos.bb.BK : pos.bb.WK;
-    int ownKingSq = lsb_index( white ? pos.bb.WK : pos.bb.BK );
+    U64 oppKing = side_bb( pos, C::them )[ 5 ];
+    int ownKingSq = lsb_index( side_bb( pos, Us )[ 5 ] );
     if ( ownKingSq < 0 )
         return;
+    U64 enemyAttacks = ai.bySide[ C::them ];
+    bool doubleCheck = ai.checkers && ( ai.checkers & ( ai.checkers - 1 ) );
+    U64 evasion = !ai.checkers ? ~0ULL : doubleCheck ? 0 : ai.checkers | between_mask( ownKingSq, lsb_index( ai.checkers ) );
     for ( const auto& m : pseudo )
     {
         if ( oppKing & bb( m.to ) )
             continue;
-        apply_move( pos, m, tmp );
-        int newKingSq = lsb_index( white ? tmp.bb.WK : tmp.bb.BK );
+        if ( m.from == ownKingSq && !m.isCastle )
+        {
+            if ( !( enemyAttacks & bb( m.to ) ) )
+                legal.push_back( m );
+            continue;
+        }
+        if ( doubleCheck )
+            continue;
+        if ( !m.isEnPassant && !m.isCastle )
+        {
+            if ( ( evasion & bb( m.to ) ) && ( !( ai.pinned & bb( m.from ) ) || aligned( ownKingSq, m.from, m.to ) ) )
+                legal.push_back( m );
+            continue;
+        }
+        apply_move< Us >( pos, m, tmp );
+        int newKingSq = lsb_index( side_bb( tmp, Us )[ 5 ] );
         if ( newKingSq < 0 )
             continue;
-        if ( !square_attacked( tmp, newKingSq, !white ) )
+        if ( !attackers_to< C::them >( tmp, newKingSq ) )
             legal.push_back( m );
     }
 }
@@ -1,5 +1,8 @@
 #pragma once
 #include "EngineBase.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -9,25 +12,30 @@
 namespace engine {
 
 class ChessEngine1 : public EngineBase {
+    friend struct BenchProbe;
+    friend struct PerftRunner;
 public:
-    ChessEngine1() = default;
+    // Adds the PawnHash and EvalCache options (see evaluate()).
+    ChessEngine1();
     using U64 = std::uint64_t;
     struct Bitboards { U64 WP{},WN{},WB{},WR{},WQ{},WK{}; U64 BP{},BN{},BB{},BR{},BQ{},BK{}; U64 occWhite{},occBlack{},occAll{}; };
-    struct Position { Bitboards bb; int sideToMove=0; int castleRights=0; int epSquare=-1; int halfmoveClock=0; int fullmoveNumber=1; };
-    struct Move { int from{}, to{}, promo{}; bool isCapture=false; bool isEnPassant=false; bool isCastle=false; bool isDoublePawnPush=false; };
+    // castleRookFile[i] is the rook file for castleRights bit i (K, Q, k, q), -1 when the right is gone; files other than a/h are Chess960.
+    struct Position { Bitboards bb; int sideToMove=0; int castleRights=0; int castleRookFile[4]{-1,-1,-1,-1}; int epSquare=-1; int halfmoveClock=0; int fullmoveNumber=1; U64 key{}; U64 pawnKey{}; };
+    struct Move { int from{}, to{}, promo{}; bool isCapture=false; bool isEnPassant=false; bool isCastle=false; bool isDoublePawnPush=false; int rookFrom=-1; };
+    // Attack data for one position, built once per node and shared by move generation, legality and castling.
+    // Side index 0 = white, 1 = black; piece index P N B R Q K. The opponent's attacks are computed with the
+    // side-to-move king lifted off the board, so a king cannot step back along a slider's ray.
+    struct AttackInfo { U64 bySide[2]{}; U64 byPiece[2][6]{}; U64 checkers{}; U64 pinned{}; int kingSq=-1; };
 
     // EngineBase interface
     std::string choose_move(const std::string& fen, int depth) override;
     std::vector<std::pair<std::string,int>> root_search_scores(const std::string& fen, int depth) override;
+    std::vector<PvLine> multipv(const std::string& fen, int depth, int lines) override;
     std::vector<std::string> legal_moves_uci(const std::string& fen) override;
     std::string apply_move(const std::string& fen, const std::string& uci) override;
 
 private:
-    static std::array<U64,64> pawnAttW;
-    static std::array<U64,64> pawnAttB;
-    static std::array<U64,64> knightMask;
-    static std::array<U64,64> kingMask;
-    static bool masksInit;
+    static const int pieceValues[6];
 
     static inline U64 bb(int sq){ return 1ULL<<sq; }
     static inline int file_of(int sq){ return sq & 7; }
@@ -39,21 +47,60 @@ private:
     static inline int lsb_index(U64 x){ return x ? (int)__builtin_ctzll(x) : -1; }
     static inline int popcount64(U64 x){ return (int)__builtin_popcountll(x); }
 #endif
-    static void init_masks();
+    // A side's six boards and its occupancy; Bitboards keeps WP..BK and occWhite/occBlack contiguous.
+    static inline const U64* side_bb(const Position& pos, int side){ return &pos.bb.WP + 6 * side; }
+    static inline U64* side_bb(Position& pos, int side){ return &pos.bb.WP + 6 * side; }
+    static inline U64 side_occ(const Position& pos, int side){ return (&pos.bb.occWhite)[side]; }
     static bool parse_fen(const std::string& fen, Position& out);
+    // The untemplated overloads dispatch on pos.sideToMove; search calls the Color-templated ones
+    // directly, so the side is fixed once per ply instead of tested per piece and per move.
     static void generate_pseudo_moves(const Position& pos, std::vector<Move>& out);
+    static void generate_pseudo_moves(const Position& pos, std::vector<Move>& out, const AttackInfo& ai);
+    template<int Us> static void generate_pseudo_moves(const Position& pos, std::vector<Move>& out, const AttackInfo& ai);
     static void filter_legal(const Position& pos, const std::vector<Move>& pseudo, std::vector<Move>& legal);
+    static void filter_legal(const Position& pos, const std::vector<Move>& pseudo, std::vector<Move>& legal, const AttackInfo& ai);
+    template<int Us> static void filter_legal(const Position& pos, const std::vector<Move>& pseudo, std::vector<Move>& legal, const AttackInfo& ai);
     static U64 attackers_to(const Position& pos, int sq, int byWhite);
+    template<int By> static U64 attackers_to(const Position& pos, int sq);
     static bool square_attacked(const Position& pos, int sq, int byWhite);
+    static void compute_attack_info(const Position& pos, AttackInfo& ai);
+    template<int Us> static void compute_attack_info(const Position& pos, AttackInfo& ai);
     static void apply_move(const Position& pos, const Move& m, Position& out);
+    template<int Us> static void apply_move(const Position& pos, const Move& m, Position& out);
     static int evaluate_material(const Position& pos);
+    // Passed, isolated and doubled pawns of both sides into e (key left to the caller).
+    static void evaluate_pawns(U64 white, U64 black, PawnEntry& e);
+    // Pawn-structure score, white's view, from ctx.pawns when the search has one.
+    static int pawn_score(const Position& pos, SearchContext& ctx);
+    // Material and pawn structure for the side to move. The ctx overload reads and fills the search's
+    // evaluation caches; both return the same score.
     static int evaluate(const Position& pos);
-    static int negamax(Position& pos,int depth,int alpha,int beta,std::vector<Move>& pv);
+    static int evaluate(const Position& pos, SearchContext& ctx);
+    // ply is the height from the root, where the node keeps its line in ctx.pv.
+    static int negamax(Position& pos,int depth,int alpha,int beta,SearchContext& ctx,int ply);
+    template<int Us> static int negamax(Position& pos,int depth,int alpha,int beta,SearchContext& ctx,int ply);
+    static uint16_t tt_move(const Move& m){ return encode_move(m.from, m.to, m.promo == 'n' ? 1 : m.promo == 'b' ? 2 : m.promo == 'r' ? 3 : m.promo ? 4 : 0); }
+    static void order_moves(std::vector<Move>& moves, uint16_t ttMove, const HistoryTable& history, int side);
+    template<int Us> static int search_frontier(const Position& pos,const std::vector<Move>& legal,int alpha,int beta,Move& bestM,SearchContext& ctx,int ply);
+    // Search extensions (see SearchConfig): 1 to search m, just played into next, a ply deeper; 0 once
+    // the line has used its budget.
+    static int extension(const Position& next,const Move& m,SearchContext& ctx,bool singular);
+    // Negated score of next, reached by m, searched to depth with ext extra plies counted against the line.
+    static int search_child(Position& next,const Move& m,int depth,int alpha,int beta,SearchContext& ctx,int ply,int ext);
+    // True when no move but ttMove reaches bound in a null-window search to depth.
+    template<int Us> static bool is_singular(const Position& pos,const std::vector<Move>& legal,uint16_t ttMove,int bound,int depth,SearchContext& ctx,int ply);
+    static U64 hash_position(const Position& pos);
+    static U64 hash_pawns(const Position& pos);
+    static void update_key(const Position& before, Position& after);
+    static bool is_draw(const Position& pos, const std::vector<U64>& keys);
     static std::string move_to_uci(const Move& m);
     static U64 rook_attacks(int sq,U64 occ);
     static U64 bishop_attacks(int sq,U64 occ);
-    static U64 can_castle(const Position& pos,bool white,bool kingside);
+    template<int Us> static U64 can_castle(const Position& pos,bool kingside,U64 enemyAttacks);
 
+    static bool search_root(const std::string& fen,int depth,SearchContext& ctx,std::vector<std::pair<Move,int>>& scores);
+    static bool search_lines(const std::string& fen,int depth,int lines,SearchContext& ctx,std::vector<PvLine>& out);
+    static std::vector<std::string> pv_moves(const Position& root,int plies,SearchContext& ctx);
     std::string choose_move_internal(const std::string& fen,int depth);
     std::vector<std::pair<std::string,int>> root_scores_internal(const std::string& fen,int depth);
     std::vector<std::string> legal_moves_internal(const std::string& fen);
@@ -9,163 +9,500 @@
 #endif
 #include "EngineBase.h"
 #include "ChessEngine2.hpp"
+#include "BatchEval.h"
+#include "Castling.h"
+#include "Color.h"
+#include "Geometry.h"
 
 namespace engine {
 
-    void ChessEngine2::flipPosition(){ EngineBase::flipPosition(); }
-    std::string ChessEngine2::buildFen() const { return EngineBase::buildFen(*this); }
-
     std::string ChessEngine2::choose_move(const std::string& fen, int depth) {
-        loadFEN(fen);
-        return getBestMove(depth);
+        std::string stored;
+        if (recall_move(fen, depth, stored)) return stored;
+        Context ctx;
+        begin_search(ctx, depth);
+        ctx.loadFEN(fen);
+        std::vector<std::pair<Move, int>> scores;
+        ctx.rootScores(depth, scores);
+        end_search(ctx);
+        Move best{}; int best_score = -INF;
+        for (auto& s : scores) if (s.second > best_score) { best_score = s.second; best = s.first; }
+        if (!scores.empty()) record_move(fen, depth, best_score, Context::moveToUci(best));
+        return Context::moveToUci(best);
     }
 
     std::vector<std::pair<std::string, int>> ChessEngine2::root_search_scores(const std::string& fen, int depth) {
-        loadFEN(fen);
-        std::vector<Move> moves;
-        generateLegalMoves(depth, moves);
+        Context ctx;
+        begin_search(ctx, depth);
+        ctx.loadFEN(fen);
+        std::vector<std::pair<Move, int>> scores;
+        ctx.rootScores(depth, scores);
+        end_search(ctx);
         std::vector<std::pair<std::string, int>> out;
-        for (auto& m : moves) {
-            ChessEngine2 save = *this;
-            makeMove(m);
-            flipPosition();
-            int score = -alphaBeta(depth - 1, -INF, INF, depth - 1);
-            *this = save;
-            out.emplace_back(moveToUci(m), score);
-        }
+        for (auto& s : scores) out.emplace_back(Context::moveToUci(s.first), s.second);
+        return out;
+    }
+
+    std::vector<PvLine> ChessEngine2::multipv(const std::string& fen, int depth, int lines) {
+        Context ctx;
+        begin_search(ctx, depth);
+        ctx.loadFEN(fen);
+        std::vector<PvLine> out;
+        ctx.searchLines(depth, lines, out);
+        end_search(ctx);
         return out;
     }
 
     std::vector<std::string> ChessEngine2::legal_moves_uci(const std::string& fen) {
-        loadFEN(fen);
+        Context ctx;
+        ctx.loadFEN(fen);
         std::vector<Move> moves;
-        generateLegalMoves(1, moves);
+        ctx.generateLegalMoves(1, moves);
         std::vector<std::string> r;
-        for (auto& m : moves) r.push_back(moveToUci(m));
+        for (auto& m : moves) r.push_back(Context::moveToUci(m));
         return r;
     }
 
     std::string ChessEngine2::apply_move(const std::string& fen, const std::string& uci) {
-        loadFEN(fen);
         if (uci.size() < 4) return {};
-        std::vector<Move> moves; generateLegalMoves(1, moves);
+        Context ctx;
+        ctx.loadFEN(fen);
+        std::vector<Move> moves; ctx.generateLegalMoves(1, moves);
         Move chosen{}; bool found = false;
-        for (auto& m : moves) { if (moveToUci(m) == uci) { chosen = m; found = true; break; } }
+        // Castling is also accepted in the other notation (e1g1 vs king-takes-rook e1h1).
+        int target = (uci[2] - 'a') + 8 * (uci[3] - '1');
+        for (auto& m : moves) { std::string mv = Context::moveToUci(m); bool alias = m.is_castling && uci.compare(0, 2, mv, 0, 2) == 0 && (target == m.to || target == m.rook_from); if (mv == uci || alias) { chosen = m; found = true; break; } }
         if (!found) return {};
-        makeMove(chosen);
-        if (side_to_move == 0) fullmove_number++;
-        flipPosition();
-        return buildFen(); /* depth logic not here */
+        ctx.makeMove(chosen);
+        return BoardState::buildFen(ctx);
     }
 
     const int ChessEngine2::PIECE_VALUES[6] = { 100,300,300,500,900,10000 };
 
-    void ChessEngine2::parseCastling(const std::string& c) { /* TODO: implement proper castling parsing */ }
+    ChessEngine2::Snapshot ChessEngine2::Context::snapshot() const {
+        Snapshot s;
+        std::copy(std::begin(pieces), std::end(pieces), std::begin(s.pieces));
+        s.side_to_move = side_to_move; s.white_kingside_rook_file = white_kingside_rook_file; s.white_queenside_rook_file = white_queenside_rook_file;
+        s.black_kingside_rook_file = black_kingside_rook_file; s.black_queenside_rook_file = black_queenside_rook_file;
+        s.ep_square = ep_square; s.halfmove_clock = halfmove_clock; s.fullmove_number = fullmove_number;
+        return s;
+    }
 
-    std::string ChessEngine2::getBestMove(int max_depth) {
+    void ChessEngine2::Context::restore(const Snapshot& s) {
+        std::copy(std::begin(s.pieces), std::end(s.pieces), std::begin(pieces));
+        side_to_move = s.side_to_move; white_kingside_rook_file = s.white_kingside_rook_file; white_queenside_rook_file = s.white_queenside_rook_file;
+        black_kingside_rook_file = s.black_kingside_rook_file; black_queenside_rook_file = s.black_queenside_rook_file;
+        ep_square = s.ep_square; halfmove_clock = s.halfmove_clock; fullmove_number = s.fullmove_number;
+    }
+
+    void ChessEngine2::Context::rootScores(int depth, std::vector<std::pair<Move, int>>& scores) {
+        ENGINE_STAT_TIMER(searchTimer, stats.search_ns);
+        ENGINE_STAT(stats.enter_node(0));
+        keys.push_back(position_key());
+        if (side_to_move == White) searchRoot<White>(depth, scores); else searchRoot<Black>(depth, scores);
+    }
+
+    // Full-window score of every legal root move. The side is fixed here; alphaBeta<Us> recurses into
+    // alphaBeta<Them>, so nothing below the root tests side_to_move.
+    template<int Us> void ChessEngine2::Context::searchRoot(int depth, std::vector<std::pair<Move, int>>& scores) {
+        root_depth = depth;
         std::vector<Move> moves;
-        generateLegalMoves(max_depth, moves);
-        Move best{}; int best_score = -INF;
+        generateLegalMoves<Us>(depth, moves);
         for (auto& m : moves) {
-            ChessEngine2 save = *this;
-            makeMove(m);
-            flipPosition();
-            // Depth decrease occurs here when calling alphaBeta with (max_depth - 1)
-            int score = -alphaBeta(max_depth - 1, -INF, INF, max_depth - 1);
-            *this = save;
-            if (score > best_score) { best_score = score; best = m; }
+            int captured = capturedSquare(m);
+            Snapshot save = snapshot();
+            makeMove<Us>(m);
+            // Depth decrease occurs here when calling alphaBeta with (depth - 1)
+            int ext = extension<Us>(captured, false);
+            int score = searchChild<Us>(depth - 1 + ext, -INF, INF, depth - 1 + ext, ext, captured);
+            restore(save);
+            scores.emplace_back(m, score);
+        }
+    }
+
+    void ChessEngine2::Context::searchLines(int depth, int lines, std::vector<PvLine>& out) {
+        ENGINE_STAT_TIMER(searchTimer, stats.search_ns);
+        keys.push_back(position_key());
+        if (side_to_move == White) searchLines<White>(depth, lines, out); else searchLines<Black>(depth, lines, out);
+    }
+
+    // Each iteration searches the root once per line with a full window, so the best remaining move's
+    // score is exact; it is then taken out for the next line. The table and history filled by the
+    // shallower iterations and earlier lines order the deeper ones.
+    template<int Us> void ChessEngine2::Context::searchLines(int depth, int lines, std::vector<PvLine>& out) {
+        std::vector<Move> root;
+        generateLegalMoves<Us>(depth, root);
+        size_t n = std::min(root.size(), (size_t)std::max(lines, 0));
+        std::vector<uint16_t> previous(n, 0); // each line's root move one iteration earlier
+        for (int d = 1; d <= depth; ++d) {
+            root_depth = stats.depth = d;
+            std::vector<Move> remaining = root;
+            std::vector<PvLine> found;
+            for (size_t k = 0; k < n; ++k) {
+                ENGINE_STAT(stats.enter_node(0));
+                orderMoves(remaining, previous[k]);
+                int alpha = -INF;
+                size_t best = 0;
+                pv.clear(0);
+                for (size_t i = 0; i < remaining.size(); ++i) {
+                    int captured = capturedSquare(remaining[i]);
+                    Snapshot save = snapshot();
+                    makeMove<Us>(remaining[i]);
+                    int ext = extension<Us>(captured, false);
+                    int score = searchChild<Us>(d - 1 + ext, alpha, INF, d - 1 + ext, ext, captured);
+                    restore(save);
+                    if (score > alpha) { alpha = score; best = i; pv.update(0, ttMove(remaining[i])); }
+                }
+                PvLine line;
+                line.score = alpha;
+                line.depth = d;
+                line.pv = pvMoves(d);
+                found.push_back(line);
+                previous[k] = ttMove(remaining[best]);
+                remaining.erase(remaining.begin() + best);
+            }
+            out.swap(found);
         }
-        return moveToUci(best);
     }
 
-    int ChessEngine2::alphaBeta(int depth, int alpha, int beta, int ply) {
+    std::vector<std::string> ChessEngine2::Context::pvMoves(int plies) {
+        Snapshot save = snapshot();
+        int saved_extensions = extensions, saved_recapture = recapture_square;
+        std::vector<std::string> out;
+        std::vector<Move> legal;
+        for (int i = 0; i < plies; ++i) {
+            uint16_t want = i < pv.size(0) ? pv.line(0)[i] : 0;
+            TTEntry e;
+            if (!want && tt && tt->probe(table_key(position_key()), e)) want = e.move;
+            if (!want) break;
+            legal.clear();
+            generateLegalMoves(1, legal);
+            auto it = std::find_if(legal.begin(), legal.end(), [&](const Move& m) { return ttMove(m) == want; });
+            if (it == legal.end()) break;
+            out.push_back(moveToUci(*it));
+            int captured = capturedSquare(*it);
+            makeMove(*it);
+            extensions += extension(captured, false);
+            recapture_square = captured;
+        }
+        restore(save);
+        extensions = saved_extensions;
+        recapture_square = saved_recapture;
+        return out;
+    }
+
+    bool ChessEngine2::Context::isRepetition(uint64_t key) const {
+        // Only positions since the last capture or pawn move can repeat, and only with the same side to move.
+        int n = (int)keys.size();
+        int limit = std::min(halfmove_clock, n);
+        for (int i = 4; i <= limit; i += 2)
+            if (keys[n - i] == key) return true;
+        return false;
+    }
+
+    template<int Us> int ChessEngine2::Context::alphaBeta(int depth, int alpha, int beta, int ply) {
+        ENGINE_STAT(stats.enter_node(stats.depth - depth + extensions));
+        int height = root_depth - depth + extensions;
+        pv.clear(height);
+        // Draws by the fifty-move rule or repetition end the line without searching it.
+        uint64_t key = position_key();
+        if (cfg.draw_detection && (halfmove_clock >= 100 || isRepetition(key))) {
+            ENGINE_STAT(++stats.draw_cutoffs);
+            return 0;
+        }
         // Depth termination check
-        if (depth == 0)
-            return evaluate();
+        if (depth == 0) {
+            ENGINE_STAT_TIMER(evalTimer, stats.eval_ns);
+            return evaluate<Us>();
+        }
+        // Fail-hard, so a usable entry is clamped to the window exactly as searching would. Entries of
+        // another depth only lend their move: a fixed-depth search scores the same with a warm table.
+        uint16_t tt_move = 0;
+        TTEntry e;
+        bool hit = false;
+        if (tt) {
+            ENGINE_STAT(++stats.tt_probes);
+            if ((hit = tt->probe(table_key(key), e))) {
+                ENGINE_STAT(++stats.tt_hits);
+                tt_move = e.move;
+                if (e.depth == depth) {
+                    int v = e.bound == Bound::Exact ? std::max(alpha, std::min(e.score, beta)) : e.bound == Bound::Lower && e.score >= beta ? beta : e.bound == Bound::Upper && e.score <= alpha ? alpha : INF;
+                    if (v != INF) { ENGINE_STAT(++stats.tt_cutoffs); return v; }
+                }
+            }
+        }
 
         std::vector<Move> moves;
-        generateLegalMoves(ply, moves);
+        {
+            ENGINE_STAT_TIMER(genTimer, stats.movegen_ns);
+            generateLegalMoves<Us>(ply, moves);
+        }
         if (moves.empty()) {
-            int king_sq = ctz64(pieces[5]);
-            return isSquareAttacked(king_sq) ? -10000 - (4 - depth) : 0;
+            bool in_check = (attacksBy<ColorTraits<Us>::them>(occupancy()) & pieces[ColorTraits<Us>::piece_offset + 5]) != 0;
+            return in_check ? -10000 - (4 - depth) : 0;
         }
-        for (auto& m : moves) {
-            ChessEngine2 save = *this;
-            makeMove(m);
-            flipPosition();
-            int score = -alphaBeta(depth - 1, -beta, -alpha, ply - 1);
-            *this = save;
-            if (score >= beta) return beta;
-            if (score > alpha) alpha = score;
+        orderMoves(moves, tt_move);
+        int alpha_in = alpha;
+        int best = -1;
+        keys.push_back(key);
+        // A stored lower bound or exact score for the table move, from a search nearly as deep, that
+        // every other move fails to come near at half the depth: the table move is the only move here.
+        bool singular = cfg.singular_extension && depth >= kSingularDepth && hit && tt_move && e.bound != Bound::Upper && e.depth >= depth - 3 &&
+                        e.score > -kMateBound && e.score < kMateBound && extensions < cfg.extension_budget &&
+                        isSingular<Us>(moves, tt_move, e.score - kSingularMargin, (depth - 1) / 2);
+        if (depth == 1 && cfg.batch_frontier) alpha = searchFrontier<Us>(moves, alpha, beta, best);
+        else {
+            for (size_t i = 0; i < moves.size(); ++i) {
+                bool quiet = isQuiet(moves[i]);
+                int captured = capturedSquare(moves[i]);
+                Snapshot save = snapshot();
+                makeMove<Us>(moves[i]);
+                int ext = extension<Us>(captured, singular && ttMove(moves[i]) == tt_move);
+                int score = searchChild<Us>(depth - 1 + ext, alpha, beta, ply - 1 + ext, ext, captured);
+                restore(save);
+                if (score >= beta) {
+                    ENGINE_STAT(stats.record_cutoff((int)i));
+                    if (quiet) history.reward(Us, moves[i].from, moves[i].to, depth);
+                    alpha = beta; best = (int)i;
+                    break;
+                }
+                if (score > alpha) { alpha = score; best = (int)i; pv.update(height, ttMove(moves[i])); }
+            }
+        }
+        keys.pop_back();
+        if (tt) {
+            Bound bound = alpha >= beta ? Bound::Lower : alpha > alpha_in ? Bound::Exact : Bound::Upper;
+            tt->store(table_key(key), depth, alpha, bound, best >= 0 ? ttMove(moves[best]) : 0);
+        }
+        return alpha;
+    }
+
+    // Transposition-table move first, then captures and promotions in generation order, then quiet
+    // moves by history score. Stable, so with empty tables the generation order is kept.
+    void ChessEngine2::Context::orderMoves(std::vector<Move>& moves, uint16_t tt_move) const {
+        std::vector<std::pair<int, Move>> keyed;
+        keyed.reserve(moves.size());
+        for (const Move& m : moves)
+            keyed.emplace_back((tt_move && ttMove(m) == tt_move) ? 1 << 30 : !isQuiet(m) ? 1 << 29 : history.get(side_to_move, m.from, m.to), m);
+        std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t i = 0; i < moves.size(); ++i) moves[i] = keyed[i].second;
+    }
+
+    // Depth-1 node: make each child once to collect its board, score the non-drawn leaves in one
+    // batched evaluation, then replay the alpha-beta loop. Same scores and node counts as recursing.
+    template<int Us> int ChessEngine2::Context::searchFrontier(const std::vector<Move>& moves, int alpha, int beta, int& best) {
+        // slot: the leaf's place in the batch, -1 for a draw, -2 for an extended move, which is searched.
+        LeafBatch batch; int slot[LeafBatch::kCapacity]; int evals[LeafBatch::kCapacity]; int captured[LeafBatch::kCapacity];
+        int height = root_depth - 1 + extensions;
+        size_t n = std::min(moves.size(), (size_t)LeafBatch::kCapacity);
+        {
+            ENGINE_STAT_TIMER(evalTimer, stats.eval_ns);
+            for (size_t i = 0; i < n; ++i) {
+                captured[i] = capturedSquare(moves[i]);
+                Snapshot save = snapshot();
+                makeMove<Us>(moves[i]);
+                slot[i] = (cfg.draw_detection && (halfmove_clock >= 100 || isRepetition(position_key()))) ? -1 : extension<Us>(captured[i], false) ? -2 : batch.add(pieces);
+                restore(save);
+            }
+            cfg.evaluate_batch(batch, PIECE_VALUES, evals);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            int score;
+            if (slot[i] == -2) {
+                Snapshot save = snapshot();
+                makeMove<Us>(moves[i]);
+                score = searchChild<Us>(1, alpha, beta, 1, 1, captured[i]);
+                restore(save);
+            } else {
+                ENGINE_STAT(stats.enter_node(stats.depth + extensions));
+                if (slot[i] < 0) ENGINE_STAT(++stats.draw_cutoffs);
+                pv.clear(height + 1);
+                // The batch scores white minus black; the leaf is worth that to white.
+                score = slot[i] < 0 ? 0 : (Us == White ? evals[slot[i]] : -evals[slot[i]]);
+            }
+            if (score >= beta) {
+                ENGINE_STAT(stats.record_cutoff((int)i));
+                if (isQuiet(moves[i])) history.reward(Us, moves[i].from, moves[i].to, 1);
+                best = (int)i;
+                return beta;
+            }
+            if (score > alpha) { alpha = score; best = (int)i; pv.update(height, ttMove(moves[i])); }
         }
         return alpha;
     }
 
-    int ChessEngine2::evaluate() {
+    template<int Us> bool ChessEngine2::Context::givesCheck() {
+        using Them = ColorTraits<ColorTraits<Us>::them>;
+        uint64_t king = pieces[Them::piece_offset + 5];
+        if (!king) return false;
+        int sq = ctz64(king);
+        const uint64_t* own = pieces + ColorTraits<Us>::piece_offset;
+        uint64_t occupied = occupancy();
+        return (pawnAttacks<ColorTraits<Us>::them>(sq) & own[0]) || (knightAttacks(sq) & own[1]) ||
+               (sliderAttacks(sq, occupied, true) & (own[2] | own[4])) || (sliderAttacks(sq, occupied, false) & (own[3] | own[4]));
+    }
+
+    // The side that made the move is the one not to move now.
+    int ChessEngine2::Context::extension(int captured, bool singular) { return side_to_move == Black ? extension<White>(captured, singular) : extension<Black>(captured, singular); }
+    template<int Us> int ChessEngine2::Context::extension(int captured, bool singular) {
+        if (extensions >= cfg.extension_budget) return 0;
+        if (singular) return 1;
+        if (cfg.recapture_extension && captured >= 0 && captured == recapture_square) return 1;
+        return cfg.check_extension && givesCheck<Us>() ? 1 : 0;
+    }
+
+    template<int Us> int ChessEngine2::Context::searchChild(int depth, int alpha, int beta, int ply, int ext, int captured) {
+        int saved = recapture_square;
+        recapture_square = captured;
+        extensions += ext;
+        int score = -alphaBeta<ColorTraits<Us>::them>(depth, -beta, -alpha, ply);
+        extensions -= ext;
+        recapture_square = saved;
+        return score;
+    }
+
+    // Every move but the table move searched against bound - 1 with a null window; the first to reach
+    // bound ends it. The node's own table entry is left for the real search to overwrite.
+    template<int Us> bool ChessEngine2::Context::isSingular(const std::vector<Move>& moves, uint16_t tt_move, int bound, int depth) {
+        for (const Move& m : moves) {
+            if (ttMove(m) == tt_move) continue;
+            int captured = capturedSquare(m);
+            Snapshot save = snapshot();
+            makeMove<Us>(m);
+            int score = searchChild<Us>(depth, bound - 1, bound, depth, 0, captured);
+            restore(save);
+            if (score >= bound) return false;
+        }
+        return true;
+    }
+
+    int ChessEngine2::Context::evaluate() { return side_to_move == White ? evaluate<White>() : evaluate<Black>(); }
+    template<int Us> int ChessEngine2::Context::evaluate() {
         int score = 0;
         for (int i = 0; i < 6; ++i) {
             score += popcount64(pieces[i]) * PIECE_VALUES[i];
             score -= popcount64(pieces[i + 6]) * PIECE_VALUES[i];
         }
-        return score;
+        return Us == White ? score : -score;
+    }
+
+    void ChessEngine2::Context::generateLegalMoves(int ply, std::vector<Move>& moves) { if (side_to_move == White) generateLegalMoves<White>(ply, moves); else generateLegalMoves<Black>(ply, moves); }
+    template<int Us> void ChessEngine2::Context::generateLegalMoves(int ply, std::vector<Move>& moves) {
+        pseudo_buffer.clear();
+        generatePseudoMoves<Us>(pseudo_buffer);
+        addCastlingMoves<Us>(ply, pseudo_buffer);
+        filterLegal<Us>(pseudo_buffer, moves);
     }
 
-    void ChessEngine2::generateLegalMoves(int ply, std::vector<Move>& moves) {
-        std::vector<Move> pseudo;
-        generatePseudoMoves(pseudo);
-        addCastlingMoves(ply, pseudo);
-        int king_sq = ctz64(pieces[5]);
+    void ChessEngine2::Context::filterLegal(const std::vector<Move>& pseudo, std::vector<Move>& moves) { if (side_to_move == White) filterLegal<White>(pseudo, moves); else filterLegal<Black>(pseudo, moves); }
+    // King moves are checked against the enemy attack map with the king lifted, everything else
+    // against the check-evasion mask and, for pinned pieces, the line through the king. Only en
+    // passant and castling are made and tested.
+    template<int Us> void ChessEngine2::Context::filterLegal(const std::vector<Move>& pseudo, std::vector<Move>& moves) {
+        using C = ColorTraits<Us>;
+        const uint64_t* own = pieces + C::piece_offset;
+        const uint64_t* their = pieces + ColorTraits<C::them>::piece_offset;
+        uint64_t occupied = occupancy();
+        int king_sq = ctz64(own[5]);
+        uint64_t danger = attacksBy<C::them>(occupied ^ own[5]);
+        uint64_t diag = their[2] | their[4], orth = their[3] | their[4];
+        uint64_t checkers = (pawnAttacks<Us>(king_sq) & their[0]) | (kGeometry.knight[king_sq] & their[1]) | (diagonal_attacks(king_sq, occupied) & diag) | (orthogonal_attacks(king_sq, occupied) & orth);
+        uint64_t pinned = 0;
+        uint64_t their_occ = 0; for (int i = 0; i < 6; ++i) their_occ |= their[i];
+        for (uint64_t s = (diagonal_attacks(king_sq, their_occ) & diag) | (orthogonal_attacks(king_sq, their_occ) & orth); s; s &= s - 1) {
+            uint64_t b = between_mask(king_sq, ctz64(s)) & occupied;
+            if (b && !(b & (b - 1))) pinned |= b;
+        }
+        uint64_t evasion = !checkers ? ~0ULL : (checkers & (checkers - 1)) ? 0 : checkers | between_mask(king_sq, ctz64(checkers));
         for (auto& m : pseudo) {
-            ChessEngine2 save = *this;
-            makeMove(m);
-            int new_king = (m.from == king_sq) ? m.to : king_sq;
-            if (!isSquareAttacked(new_king)) moves.push_back(m);
-            *this = save;
-        }
-    }
-
-    void ChessEngine2::addCastlingMoves(int ply, std::vector<Move>& pseudo) { /* TODO: implement castling legality */ }
-    bool ChessEngine2::isCastlingLegal(int king_src, int king_dest, int rook_src) { /* TODO: implement full legality */ return true; }
-    std::vector<int> ChessEngine2::getKingPathSquares(int src, int dest) { std::vector<int> path{ src }; int step = (dest > src) ? 1 : -1; for (int s = src + step; s != dest; s += step) path.push_back(s); path.push_back(dest); return path; }
-
-    bool ChessEngine2::isSquareAttacked(int sq) {
-        ChessEngine2 copy = *this;
-        copy.flipPosition();
-        std::vector<Move> opp;
-        copy.generatePseudoMoves(opp);
-        int flipped_sq = sq ^ 56; /* TODO: verify square flip mapping (sq ^ 56) correctness; incorrect mapping may cause missing attacks/captures */
-        for (auto& m : opp)
-            if (m.to == flipped_sq)
-                return true;
-        return false;
+            uint64_t to_bit = 1ULL << m.to;
+            if (m.from == king_sq && !m.is_castling) { if (!(danger & to_bit)) moves.push_back(m); continue; }
+            bool en_passant = m.to == ep_square && (own[0] & (1ULL << m.from));
+            if (!m.is_castling && !en_passant) {
+                if ((evasion & to_bit) && (!(pinned & (1ULL << m.from)) || aligned(king_sq, m.from, m.to))) moves.push_back(m);
+                continue;
+            }
+            Snapshot save = snapshot();
+            makeMove<Us>(m);
+            if (!(attacksBy<C::them>(occupancy()) & pieces[C::piece_offset + 5])) moves.push_back(m);
+            restore(save);
+        }
+    }
+
+    // Castling masks are for rank 1; the home-rank shift moves them to rank 8 for black.
+    template<int Us> void ChessEngine2::Context::addCastlingMoves(int ply, std::vector<Move>& pseudo) {
+        using C = ColorTraits<Us>;
+        const int base = C::home_rank * 8;
+        int rook_files[2] = { Us == White ? white_kingside_rook_file : black_kingside_rook_file, Us == White ? white_queenside_rook_file : black_queenside_rook_file };
+        if (rook_files[0] < 0 && rook_files[1] < 0) return;
+        uint64_t king = pieces[C::piece_offset + 5];
+        if (!(king & (0xFFULL << base))) return;
+        int king_sq = ctz64(king);
+        // One attack map for both wings, with the king lifted so squares behind it on a checking ray count as attacked.
+        uint64_t attacks = attacksBy<C::them>(occupancy() ^ king);
+        for (int rf : rook_files) {
+            if (rf < 0 || !isCastlingLegal<Us>(king_sq, base + rf, attacks)) continue;
+            const CastlePath& path = castle_path(king_sq - base, rf);
+            Move m{ king_sq, base + path.king_to, 0 }; m.is_castling = true; m.rook_from = base + rf; m.rook_to = base + path.rook_to;
+            pseudo.push_back(m);
+        }
+    }
+    template<int Us> bool ChessEngine2::Context::isCastlingLegal(int king_src, int rook_src, uint64_t enemy_attacks) {
+        using C = ColorTraits<Us>;
+        if (rook_src == king_src || !(pieces[C::piece_offset + 3] & (1ULL << rook_src))) return false;
+        uint64_t occupied = occupancy();
+        const int base = C::home_rank * 8;
+        const CastlePath& path = castle_path(king_src - base, rook_src - base);
+        return !(occupied & (path.must_be_empty << base)) && !(enemy_attacks & (path.must_be_safe << base));
+    }
+    uint64_t ChessEngine2::Context::sliderAttacks(int sq, uint64_t occupied, bool diagonal) { return diagonal ? diagonal_attacks(sq, occupied) : orthogonal_attacks(sq, occupied); }
+    uint64_t ChessEngine2::Context::occupancy() const { uint64_t o = 0; for (int i = 0; i < 12; ++i) o |= pieces[i]; return o; }
+    // Squares attacked by side By (0 = white, 1 = black).
+    template<int By> uint64_t ChessEngine2::Context::attacksBy(uint64_t occupied) {
+        const uint64_t* p = pieces + ColorTraits<By>::piece_offset;
+        uint64_t a = 0;
+        for (uint64_t pw = p[0]; pw; pw &= pw - 1) a |= pawnAttacks<By>(ctz64(pw));
+        for (uint64_t n = p[1]; n; n &= n - 1) a |= kGeometry.knight[ctz64(n)];
+        for (uint64_t b = p[2] | p[4]; b; b &= b - 1) a |= diagonal_attacks(ctz64(b), occupied);
+        for (uint64_t r = p[3] | p[4]; r; r &= r - 1) a |= orthogonal_attacks(ctz64(r), occupied);
+        if (p[5]) a |= kGeometry.king[ctz64(p[5])];
+        return a;
     }
+    // Squares attacked by the side not to move.
+    uint64_t ChessEngine2::Context::enemyAttacks() { return side_to_move == White ? attacksBy<Black>(occupancy()) : attacksBy<White>(occupancy()); }
 
-    void ChessEngine2::generatePseudoMoves(std::vector<Move>& moves) {
+    // One attack map instead of copying the engine and generating the opponent's moves.
+    bool ChessEngine2::Context::isSquareAttacked(int sq) { return (enemyAttacks() >> sq) & 1; }
+
+    void ChessEngine2::Context::generatePseudoMoves(std::vector<Move>& moves) { if (side_to_move == White) generatePseudoMoves<White>(moves); else generatePseudoMoves<Black>(moves); }
+    template<int Us> void ChessEngine2::Context::generatePseudoMoves(std::vector<Move>& moves) {
+        using C = ColorTraits<Us>;
+        const uint64_t* own = pieces + C::piece_offset;
         uint64_t friendly = 0, enemy = 0, occupied = 0;
-        for (int i = 0; i < 6; ++i) friendly |= pieces[i];
-        for (int i = 6; i < 12; ++i) enemy |= pieces[i];
+        for (int i = 0; i < 6; ++i) friendly |= own[i];
+        for (int i = 0; i < 6; ++i) enemy |= pieces[ColorTraits<C::them>::piece_offset + i];
         occupied = friendly | enemy;
-        uint64_t pawns = pieces[0];
+        uint64_t pawns = own[0];
         while (pawns) {
             int from = ctz64(pawns);
-            uint64_t attacks = pawnAttacksWhite(from) & enemy;
-            uint64_t pushes = pawnPushesWhite(from) & ~occupied;
+            uint64_t attacks = pawnAttacks<Us>(from) & enemy;
+            uint64_t pushes = pawnPushes<Us>(from, occupied);
             while (pushes) {
                 int to = ctz64(pushes);
-                if ((to / 8) == 7) { for (int p = 1; p <= 4; ++p) moves.push_back({ from,to,p }); }
+                if ((to / 8) == C::promotion_rank) { for (int p = 1; p <= 4; ++p) moves.push_back({ from,to,p }); }
                 else { moves.push_back({ from,to,0 }); }
                 pushes &= pushes - 1;
             }
             while (attacks) {
                 int to = ctz64(attacks);
-                if ((to / 8) == 7) { for (int p = 1; p <= 4; ++p) moves.push_back({ from,to,p }); }
+                if ((to / 8) == C::promotion_rank) { for (int p = 1; p <= 4; ++p) moves.push_back({ from,to,p }); }
                 else { moves.push_back({ from,to,0 }); }
                 attacks &= attacks - 1;
             }
-            if (ep_square != -1 && (pawnAttacksWhite(from) & (1ULL << ep_square))) moves.push_back({ from, ep_square,0 });
+            if (ep_square != -1 && (pawnAttacks<Us>(from) & (1ULL << ep_square))) moves.push_back({ from, ep_square,0 });
             pawns &= pawns - 1;
         }
-        uint64_t knights = pieces[1];
+        uint64_t knights = own[1];
         while (knights) {
             int from = ctz64(knights);
             uint64_t targets = knightAttacks(from) & ~friendly;
@@ -176,25 +513,25 @@ namespace engine {
             }
             knights &= knights - 1;
         }
-        uint64_t bishops = pieces[2];
+        uint64_t bishops = own[2];
         while (bishops) {
             int from = ctz64(bishops);
-            addSliderMoves(from, moves, { 7,9,-7,-9 }, occupied, friendly);
+            addTargets(from, diagonal_attacks(from, occupied) & ~friendly, moves);
             bishops &= bishops - 1;
         }
-        uint64_t rooks = pieces[3];
+        uint64_t rooks = own[3];
         while (rooks) {
             int from = ctz64(rooks);
-            addSliderMoves(from, moves, { 1,-1,8,-8 }, occupied, friendly);
+            addTargets(from, orthogonal_attacks(from, occupied) & ~friendly, moves);
             rooks &= rooks - 1;
         }
-        uint64_t queens = pieces[4];
+        uint64_t queens = own[4];
         while (queens) {
             int from = ctz64(queens);
-            addSliderMoves(from, moves, { 7,9,-7,-9,1,-1,8,-8 }, occupied, friendly);
+            addTargets(from, (diagonal_attacks(from, occupied) | orthogonal_attacks(from, occupied)) & ~friendly, moves);
             queens &= queens - 1;
         }
-        int king_sq = ctz64(pieces[5]);
+        int king_sq = ctz64(own[5]);
         uint64_t k_attacks = kingAttacks(king_sq) & ~friendly;
         while (k_attacks) {
             int to = ctz64(k_attacks);
@@ -203,40 +540,65 @@ namespace engine {
         }
     }
 
-    void ChessEngine2::addSliderMoves(int from, std::vector<Move>& moves, const std::vector<int>& dirs, uint64_t occupied, uint64_t friendly) {
-        for (int d : dirs) {
-            int to = from + d;
-            while (to >= 0 && to < 64 && std::abs((to % 8) - (from % 8)) <= std::abs(d % 8)) {
-                if ((1ULL << to) & friendly) break;
-                moves.push_back({ from,to,0 });
-                if ((1ULL << to) & (occupied ^ friendly)) break;
-                to += d;
-            }
-        }
+    void ChessEngine2::Context::addTargets(int from, uint64_t targets, std::vector<Move>& moves) {
+        for (; targets; targets &= targets - 1) moves.push_back({ from,ctz64(targets),0 });
     }
 
-    void ChessEngine2::makeMove(const Move& m) {
+    void ChessEngine2::Context::makeMove(const Move& m) { if (side_to_move == White) makeMove<White>(m); else makeMove<Black>(m); }
+    template<int Us> void ChessEngine2::Context::makeMove(const Move& m) {
+        using C = ColorTraits<Us>;
+        uint64_t* own = pieces + C::piece_offset;
+        uint64_t* their = pieces + ColorTraits<C::them>::piece_offset;
         uint64_t from_bit = 1ULL << m.from;
         uint64_t to_bit = 1ULL << m.to;
-        int ptype = getPieceType(m.from);
+        int ptype = getPieceType(m.from, Us);
+        side_to_move = C::them;
+        if (Us == Black) fullmove_number++;
+        // Rook files belong to the real colours.
+        int& own_k = Us == White ? white_kingside_rook_file : black_kingside_rook_file; int& own_q = Us == White ? white_queenside_rook_file : black_queenside_rook_file;
+        int& opp_k = Us == White ? black_kingside_rook_file : white_kingside_rook_file; int& opp_q = Us == White ? black_queenside_rook_file : white_queenside_rook_file;
+        if (m.is_castling) {
+            // Lift both pieces first: in Chess960 either may land on the other's start square.
+            own[5] &= ~from_bit; own[3] &= ~(1ULL << m.rook_from);
+            own[5] |= to_bit; own[3] |= 1ULL << m.rook_to;
+            halfmove_clock++; ep_square = -1;
+            own_k = -1; own_q = -1;
+            return;
+        }
         int piece_idx = ptype;
-        pieces[piece_idx] ^= from_bit;
+        own[piece_idx] ^= from_bit;
         if (m.prom_piece) piece_idx = m.prom_piece;
-        pieces[piece_idx] |= to_bit;
-        int enemy_ptype = getPieceType(m.to, true);
-        if (enemy_ptype != -1) { pieces[enemy_ptype + 6] ^= to_bit; halfmove_clock = 0; }
+        own[piece_idx] |= to_bit;
+        int enemy_ptype = getPieceType(m.to, C::them);
+        if (enemy_ptype != -1) { their[enemy_ptype] ^= to_bit; halfmove_clock = 0; }
         else if (ptype == 0) halfmove_clock = 0; else halfmove_clock++;
-        if (m.is_castling) { uint64_t r_from_bit = 1ULL << m.rook_from; uint64_t r_to_bit = 1ULL << m.rook_to; pieces[3] ^= r_from_bit; pieces[3] |= r_to_bit; }
-        if (ptype == 0 && m.to == ep_square) { int enemy_pawn_sq = m.to - 8; pieces[6] ^= (1ULL << enemy_pawn_sq); halfmove_clock = 0; }
-        if (ptype == 0 && (m.to - m.from == 16)) ep_square = m.from + 8; else ep_square = -1;
-        if (ptype == 5) { white_kingside_rook_file = -1; white_queenside_rook_file = -1; }
-        if (ptype == 3) { if (m.from % 8 == white_kingside_rook_file) white_kingside_rook_file = -1; if (m.from % 8 == white_queenside_rook_file) white_queenside_rook_file = -1; }
-    }
-
-    int ChessEngine2::getPieceType(int sq, bool enemy) { uint64_t bit = 1ULL << sq; int offset = enemy ? 6 : 0; for (int i = 0; i < 6; ++i) if (pieces[i + offset] & bit) return i; return -1; }
-    std::string ChessEngine2::squareToAlg(int sq) { char file = 'a' + (sq % 8); char rank = '1' + (sq / 8); return { file,rank }; }
-    uint64_t ChessEngine2::knightAttacks(int sq) { uint64_t a = 0; int f = sq % 8, r = sq / 8; const int ofs[8][2] = { {1,2},{2,1},{-1,2},{-2,1},{1,-2},{2,-1},{-1,-2},{-2,-1} }; for (auto& o : ofs) { int nf = f + o[0], nr = r + o[1]; if (nf >= 0 && nf < 8 && nr >= 0 && nr < 8) a |= (1ULL << (nr * 8 + nf)); } return a; }
-    uint64_t ChessEngine2::kingAttacks(int sq) { uint64_t a = 0; int f = sq % 8, r = sq / 8; for (int dr = -1; dr <= 1; ++dr) for (int df = -1; df <= 1; ++df) { if (!dr && !df) continue; int nf = f + df, nr = r + dr; if (nf >= 0 && nf < 8 && nr >= 0 && nr < 8) a |= (1ULL << (nr * 8 + nf)); } return a; }
-    uint64_t ChessEngine2::pawnPushesWhite(int sq) { uint64_t push = 0; int r = sq / 8; int one = sq + 8; if (r < 7) push |= (1ULL << one); if (r == 1) push |= (1ULL << (sq + 16)); return push; }
-    uint64_t ChessEngine2::pawnAttacksWhite(int sq) { uint64_t a = 0; int f = sq % 8, r = sq / 8; if (f > 0 && r < 7) a |= (1ULL << (sq + 7)); if (f < 7 && r < 7) a |= (1ULL << (sq + 9)); return a; }
+        if (ptype == 0 && m.to == ep_square) { int enemy_pawn_sq = m.to - C::push; their[0] ^= (1ULL << enemy_pawn_sq); halfmove_clock = 0; }
+        if (ptype == 0 && (m.to - m.from == 2 * C::push)) ep_square = m.from + C::push; else ep_square = -1;
+        if (ptype == 5) { own_k = -1; own_q = -1; }
+        if (ptype == 3 && m.from / 8 == C::home_rank) { if (m.from % 8 == own_k) own_k = -1; if (m.from % 8 == own_q) own_q = -1; }
+        if (enemy_ptype == 3 && m.to / 8 == ColorTraits<C::them>::home_rank) { if (m.to % 8 == opp_k) opp_k = -1; if (m.to % 8 == opp_q) opp_q = -1; }
+    }
+
+    int ChessEngine2::Context::getPieceType(int sq, int side) { uint64_t bit = 1ULL << sq; int offset = 6 * side; for (int i = 0; i < 6; ++i) if (pieces[i + offset] & bit) return i; return -1; }
+    std::string ChessEngine2::Context::moveToUci(const Move& m) {
+        int from = m.from, to = (m.is_castling && !is_standard_castle(m.from % 8, m.rook_from % 8)) ? m.rook_from : m.to;
+        std::string u = squareToAlg(from) + squareToAlg(to); if (m.prom_piece) u += "nbrq"[m.prom_piece - 1]; return u;
+    }
+    std::string ChessEngine2::Context::squareToAlg(int sq) { char file = 'a' + (sq % 8); char rank = '1' + (sq / 8); return { file,rank }; }
+    uint64_t ChessEngine2::Context::knightAttacks(int sq) { return kGeometry.knight[sq]; }
+    uint64_t ChessEngine2::Context::kingAttacks(int sq) { return kGeometry.king[sq]; }
+    // Single push, plus the double push from the start rank when the square in between is free too.
+    template<int Us> uint64_t ChessEngine2::Context::pawnPushes(int sq, uint64_t occupied) { using C = ColorTraits<Us>; if (sq / 8 == C::promotion_rank) return 0; uint64_t one = (1ULL << (sq + C::push)) & ~occupied; if (!one || sq / 8 != C::pawn_start_rank) return one; return one | ((1ULL << (sq + 2 * C::push)) & ~occupied); }
+    template<int Us> uint64_t ChessEngine2::Context::pawnAttacks(int sq) { using C = ColorTraits<Us>; uint64_t a = 0; int f = sq % 8; if (sq / 8 == C::promotion_rank) return 0; if (f > 0) a |= (1ULL << (sq + C::pawn_west)); if (f < 7) a |= (1ULL << (sq + C::pawn_east)); return a; }
+
+    // Instantiated here for Perft, which drives the generator directly, and the Texel corpus builder,
+    // which also evaluates and searches.
+    template void ChessEngine2::Context::generateLegalMoves<White>(int, std::vector<Move>&);
+    template void ChessEngine2::Context::generateLegalMoves<Black>(int, std::vector<Move>&);
+    template void ChessEngine2::Context::makeMove<White>(const Move&);
+    template void ChessEngine2::Context::makeMove<Black>(const Move&);
+    template int ChessEngine2::Context::evaluate<White>();
+    template int ChessEngine2::Context::evaluate<Black>();
+    template int ChessEngine2::Context::alphaBeta<White>(int, int, int, int);
+    template int ChessEngine2::Context::alphaBeta<Black>(int, int, int, int);
 } // namespace engine
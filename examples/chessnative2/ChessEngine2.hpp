@@ -1,5 +1,8 @@
 #pragma once
 #include "EngineBase.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include <cstdint>
 #include <vector>
 #include <functional>
@@ -7,17 +10,13 @@
 namespace engine
 {
     class ChessEngine2 : public EngineBase {
+        friend struct BenchProbe;
+        friend struct PerftRunner;
+        friend struct PgnCodec;
+        friend struct CorpusBuilder;
+        friend class MateEngine;
+        friend class MctsEngine;
     public:
-        using EngineBase::loadFEN; // expose base implementation
-        uint64_t pieces[12];
-        int side_to_move = 0;
-        int white_kingside_rook_file = -1;
-        int white_queenside_rook_file = -1;
-        int black_kingside_rook_file = -1;
-        int black_queenside_rook_file = -1;
-        int ep_square = -1;
-        int halfmove_clock = 0;
-        int fullmove_number = 1;
         std::function<int(int, char)> kingDestCallback;
 
         ChessEngine2() = default;
@@ -25,38 +24,92 @@ namespace engine
 
         std::string choose_move(const std::string& fen, int depth) override;
         std::vector<std::pair<std::string, int>> root_search_scores(const std::string& fen, int depth) override;
+        std::vector<PvLine> multipv(const std::string& fen, int depth, int lines) override;
+        // The root search of choose_move with its stack kept in a Slicer between slices.
+        std::unique_ptr<SlicedSearch> start_search(const std::string& fen, int depth) override;
         std::vector<std::string> legal_moves_uci(const std::string& fen) override;
         std::string apply_move(const std::string& fen, const std::string& uci) override;
 
-        std::string getBestMove(int max_depth = 4);
-        std::string buildFen() const;
-        void flipPosition();
-
     private:
+        struct Slicer;
         struct Move { int from; int to; int prom_piece; bool is_castling = false; int rook_from = -1; int rook_to = -1; };
+        // Position fields saved around makeMove. Copying the whole context would also roll back its stats.
+        struct Snapshot { uint64_t pieces[12]; int side_to_move, white_kingside_rook_file, white_queenside_rook_file, black_kingside_rook_file, black_queenside_rook_file, ep_square, halfmove_clock, fullmove_number; };
         static constexpr int INF = 2000000;
+        // Singular extensions: the shallowest node tested, how far below the table score the other moves
+        // must stay, and the score beyond which a table entry is a mate and not tested.
+        static constexpr int kSingularDepth = 4, kSingularMargin = 50, kMateBound = 9000;
         static const int PIECE_VALUES[6];
+
+        // The board one call makes and unmakes moves on, plus its search state. Every public call builds
+        // its own on the stack; keys holds the game history followed by the current search path.
+        struct Context : BoardState, SearchContext {
+            std::vector<Move> pseudo_buffer; // reused by generateLegalMoves; consumed before any recursion
+            int root_depth = 0;              // depth of the running iteration; a node's height is root_depth - depth
+
+            Snapshot snapshot() const;
+            void restore(const Snapshot& s);
 #if defined(_MSC_VER)
-        inline int ctz64(uint64_t x) { unsigned long idx; _BitScanForward64(&idx, x); return (int)idx; }
-        inline int popcount64(uint64_t x) { return (int)__popcnt64(x); }
+            static int ctz64(uint64_t x) { unsigned long idx; _BitScanForward64(&idx, x); return (int)idx; }
+            static int popcount64(uint64_t x) { return (int)__popcnt64(x); }
 #else
-        inline int ctz64(uint64_t x) { return __builtin_ctzll(x); }
-        inline int popcount64(uint64_t x) { return __builtin_popcountll(x); }
+            static int ctz64(uint64_t x) { return __builtin_ctzll(x); }
+            static int popcount64(uint64_t x) { return __builtin_popcountll(x); }
 #endif
-        void parseCastling(const std::string& s);
-        int alphaBeta(int depth, int alpha, int beta, int ply_remaining);
-        int evaluate();
-        void generateLegalMoves(int ply_remaining, std::vector<Move>& moves);
-        void addCastlingMoves(int ply_remaining, std::vector<Move>& pseudo);
-        bool isCastlingLegal(int king_src, int king_dest, int rook_src);
-        std::vector<int> getKingPathSquares(int src, int dest);
-        bool isSquareAttacked(int sq);
-        void generatePseudoMoves(std::vector<Move>& moves);
-        void addSliderMoves(int from, std::vector<Move>& moves, const std::vector<int>& dirs, uint64_t occupied, uint64_t friendly);
-        void makeMove(const Move& m);
-        int getPieceType(int sq, bool enemy = false);
-        std::string squareToAlg(int sq); std::string moveToUci(const Move& m) { std::string u = squareToAlg(m.from) + squareToAlg(m.to); if (m.prom_piece) u += "nbrq"[m.prom_piece - 1]; return u; }
-        uint64_t knightAttacks(int sq); uint64_t kingAttacks(int sq); uint64_t pawnPushesWhite(int sq); uint64_t pawnAttacksWhite(int sq);
+            // Scores every legal root move; the timer and root node are counted here.
+            void rootScores(int depth, std::vector<std::pair<Move, int>>& scores);
+            // Pieces are stored by colour (0-5 white, 6-11 black). Search and move generation are templated
+            // on the side to move (see Color.h); the untemplated overloads dispatch on side_to_move once.
+            template<int Us> void searchRoot(int depth, std::vector<std::pair<Move, int>>& scores);
+            // MultiPV by iterative deepening; see EngineBase::multipv.
+            void searchLines(int depth, int lines, std::vector<PvLine>& out);
+            template<int Us> void searchLines(int depth, int lines, std::vector<PvLine>& out);
+            // UCI of pv.line(0), replayed from the root, then continued from the transposition table to
+            // plies moves where the line was cut short by a table hit, probing under the extensions the
+            // replayed line spends (a singular extension cannot be replayed and ends the table part).
+            std::vector<std::string> pvMoves(int plies);
+            template<int Us> int alphaBeta(int depth, int alpha, int beta, int ply_remaining);
+            template<int Us> int searchFrontier(const std::vector<Move>& moves, int alpha, int beta, int& best);
+            // Search extensions (see SearchConfig). With the move just made by Us on the board: 1 to search
+            // it a ply deeper, 0 once the line has used its budget. captured is the square it took a piece
+            // on, or -1.
+            int extension(int captured, bool singular);
+            template<int Us> int extension(int captured, bool singular);
+            template<int Us> bool givesCheck();
+            int capturedSquare(const Move& m) const { return !m.is_castling && ((occupancy() >> m.to) & 1) ? m.to : -1; }
+            // Negated score of the move just made, searched to depth with ext extra plies counted against the line.
+            template<int Us> int searchChild(int depth, int alpha, int beta, int ply_remaining, int ext, int captured);
+            // True when no move but tt_move reaches bound in a null-window search to depth.
+            template<int Us> bool isSingular(const std::vector<Move>& moves, uint16_t tt_move, int bound, int depth);
+            // Moves for the history heuristic: no promotion and nothing on the target square (castling
+            // counts as quiet even when the king lands on its own rook). En passant passes as quiet.
+            bool isQuiet(const Move& m) const { return !m.prom_piece && (m.is_castling || !((occupancy() >> m.to) & 1)); }
+            void orderMoves(std::vector<Move>& moves, uint16_t tt_move) const;
+            static uint16_t ttMove(const Move& m) { return encode_move(m.from, m.to, m.prom_piece); }
+            bool isRepetition(uint64_t key) const;
+            int evaluate();
+            template<int Us> int evaluate();
+            void generateLegalMoves(int ply_remaining, std::vector<Move>& moves);
+            template<int Us> void generateLegalMoves(int ply_remaining, std::vector<Move>& moves);
+            void filterLegal(const std::vector<Move>& pseudo, std::vector<Move>& moves);
+            template<int Us> void filterLegal(const std::vector<Move>& pseudo, std::vector<Move>& moves);
+            template<int Us> void addCastlingMoves(int ply_remaining, std::vector<Move>& pseudo);
+            template<int Us> bool isCastlingLegal(int king_src, int rook_src, uint64_t enemy_attacks);
+            uint64_t enemyAttacks();
+            template<int By> uint64_t attacksBy(uint64_t occupied);
+            uint64_t occupancy() const;
+            uint64_t sliderAttacks(int sq, uint64_t occupied, bool diagonal);
+            bool isSquareAttacked(int sq);
+            void generatePseudoMoves(std::vector<Move>& moves);
+            template<int Us> void generatePseudoMoves(std::vector<Move>& moves);
+            void addTargets(int from, uint64_t targets, std::vector<Move>& moves);
+            void makeMove(const Move& m);
+            template<int Us> void makeMove(const Move& m);
+            int getPieceType(int sq, int side);
+            static std::string squareToAlg(int sq); static std::string moveToUci(const Move& m);
+            static uint64_t knightAttacks(int sq); static uint64_t kingAttacks(int sq);
+            template<int Us> static uint64_t pawnPushes(int sq, uint64_t occupied); template<int Us> static uint64_t pawnAttacks(int sq);
+        };
     };
 }
 
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+namespace engine
+{
+    enum Color { White = 0, Black = 1 };
+
+    // Per-colour constants for code templated on the side to move. Pawn directions, home and
+    // promotion ranks and castling bits become compile-time values instead of per-move branches.
+    // Piece bitboards follow the Zobrist order (white P N B R Q K, then black), so a side's
+    // boards start at index piece_offset.
+    template <int Us>
+    struct ColorTraits
+    {
+        static constexpr int them = 1 - Us;
+        static constexpr int push = Us == White ? 8 : -8;      // one square forward
+        static constexpr int pawn_west = Us == White ? 7 : -9; // capture towards the a-file
+        static constexpr int pawn_east = Us == White ? 9 : -7; // capture towards the h-file
+        static constexpr int home_rank = Us == White ? 0 : 7;
+        static constexpr int pawn_start_rank = Us == White ? 1 : 6;
+        static constexpr int promotion_rank = Us == White ? 7 : 0;
+        static constexpr uint64_t promotion_mask = 0xFFULL << (8 * promotion_rank);
+        static constexpr int castle_rights = Us == White ? 3 : 12; // K|Q or k|q in a Zobrist castling mask
+        static constexpr int piece_offset = 6 * Us;
+    };
+} // namespace engine
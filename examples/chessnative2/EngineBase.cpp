@@ -1,24 +1,325 @@
 #include "EngineBase.h"
+#include "AnalysisStore.h"
+#include "Geometry.h"
+#include "Zobrist.h"
+#include <algorithm>
 #include <bit>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <typeinfo>
 namespace engine {
-    void EngineBase::flipPosition()
+    EngineBase::EngineBase()
     {
-        uint64_t new_pieces[12];
-        for (int i = 0; i < 6; ++i) {
-            new_pieces[i] = byteswap(pieces[i + 6]);
-            new_pieces[i + 6] = byteswap(pieces[i]);
+        add_option(EngineOption::check("BatchFrontier", true, "Score the children of depth-1 nodes with one batched evaluation"));
+        add_option(EngineOption::combo("EvalKernel", 0, { "Auto", "Scalar", "AVX2", "AVX512" }, "Batched evaluation kernel; Auto picks the widest this CPU supports"));
+        add_option(EngineOption::check("DrawDetection", true, "Score repetitions and fifty-move draws as 0"));
+        add_option(EngineOption::check("CheckExtension", true, "Search moves that give check one ply deeper"));
+        add_option(EngineOption::check("RecaptureExtension", true, "Search a recapture on the square just captured on one ply deeper"));
+        add_option(EngineOption::check("SingularExtension", false, "Search the table move one ply deeper when a reduced search finds no other move near it"));
+        add_option(EngineOption::spin("ExtensionBudget", 0, 0, 32, "Plies a line may be extended by in all; 0, the default, turns extensions off"));
+        add_option(EngineOption::spin("Hash", 16, 0, 65536, "Transposition table size in MB, 0 to search without one"));
+        add_option(EngineOption::check("LargePages", true, "Back the transposition table with 2 MB pages where the OS grants them"));
+        add_option(EngineOption::check("NumaInterleave", false, "Spread the transposition table's pages over all NUMA nodes (Linux)"));
+        add_option(EngineOption::combo("Affinity", 0, { "None", "Compact", "Scatter" }, "Pin each search's thread to a CPU while it runs: filling one NUMA node first, or nodes in turn"));
+        add_option(EngineOption::check("KeepAnalysis", true, "Keep the transposition table and move history from one search to the next until a new game"));
+        add_option(EngineOption::spin("MultiPV", 1, 1, 64, "Best lines an analysis reports (see multipv()); the UCI front end prints one info line each"));
+    }
+
+    const EngineOption* EngineBase::option_slot(const std::string& name) const
+    {
+        for (const EngineOption& o : engine_options)
+        {
+            if (o.name.size() != name.size()) continue;
+            bool same = true;
+            for (size_t i = 0; i < name.size() && same; ++i) same = std::tolower((unsigned char)o.name[i]) == std::tolower((unsigned char)name[i]);
+            if (same) return &o;
         }
-        std::copy(std::begin(new_pieces), std::end(new_pieces), std::begin(pieces));
-        side_to_move = 1 - side_to_move;
+        return nullptr;
+    }
+
+    void EngineBase::add_option(const EngineOption& o)
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        engine_options.push_back(o);
+    }
+
+    std::vector<EngineOption> EngineBase::options() const
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        return engine_options;
+    }
+
+    bool EngineBase::find_option(const std::string& name, EngineOption* out) const
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        const EngineOption* o = option_slot(name);
+        if (o && out) *out = *o;
+        return o != nullptr;
+    }
+
+    int EngineBase::option_value(const std::string& name) const
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        const EngineOption* o = option_slot(name);
+        return o ? o->value : 0;
     }
 
-    std::string EngineBase::buildFen(const EngineBase& e)
+    bool EngineBase::set_option(const std::string& name, int value)
     {
-        auto pieceAt = [&](int sq)->char { uint64_t b = 1ULL << sq; for (int i = 0; i < 6; ++i) { if (e.pieces[i] & b) { return "PNBRQK"[i]; } if (e.pieces[i + 6] & b) { return "pnbrqk"[i]; } } return '.'; }; std::string board; for (int rank = 7; rank >= 0; --rank) { int empty = 0; for (int file = 0; file < 8; ++file) { int idx = rank * 8 + file; char pc = pieceAt(idx); if (pc == '.') { ++empty; } else { if (empty) { board.push_back(char('0' + empty)); empty = 0; } board.push_back(pc); } } if (empty) board.push_back(char('0' + empty)); if (rank) board.push_back('/'); } std::string cast = "KQkq"; if (cast == "KQkq") {} // placeholder always full rights for simplicity
+        std::lock_guard<std::mutex> lock(state_mutex);
+        EngineOption* o = const_cast<EngineOption*>(option_slot(name));
+        if (!o || value < o->min || value > o->max) return false;
+        o->value = value;
+        return true;
+    }
+
+    bool EngineBase::set_option(const std::string& name, const std::string& value)
+    {
+        EngineOption o;
+        int v = 0;
+        return find_option(name, &o) && o.parse(value, v) && set_option(name, v);
+    }
+
+    void EngineBase::reset_options()
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        for (EngineOption& o : engine_options) o.value = o.default_value;
+    }
+
+    SearchStats EngineBase::last_search_stats() const
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        return search_stats;
+    }
+
+    void EngineBase::set_game_history(const std::vector<uint64_t>& keys)
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        game_history = keys;
+    }
+
+    std::vector<uint64_t> EngineBase::get_game_history() const
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        return game_history;
+    }
+
+    void EngineBase::new_game()
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (tt) tt->clear();
+        history.clear();
+    }
+
+    namespace
+    {
+        // A search that cannot be suspended: all of choose_move in the first advance.
+        class BlockingSearch : public SlicedSearch
+        {
+        public:
+            BlockingSearch(EngineBase& e, const std::string& f, int d) : engine(e), fen(f), depth(d) {}
+            bool advance(uint64_t, uint64_t) override
+            {
+                if (!done) move = engine.choose_move(fen, depth);
+                done = true;
+                return true;
+            }
+
+        private:
+            EngineBase& engine;
+            std::string fen;
+            int depth;
+        };
+    } // namespace
+
+    std::unique_ptr<SlicedSearch> EngineBase::start_search(const std::string& fen, int depth)
+    {
+        return std::unique_ptr<SlicedSearch>(new BlockingSearch(*this, fen, depth));
+    }
+
+    void EngineBase::set_analysis_store(std::shared_ptr<AnalysisStore> store)
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        analysis = std::move(store);
+    }
+
+    namespace
+    {
+        // encode_move() of a UCI string and back; the store keeps moves in this engine-neutral form.
+        uint16_t encode_uci(const std::string& uci)
+        {
+            if (uci.size() < 4) return 0;
+            int from = (uci[0] - 'a') + 8 * (uci[1] - '1'), to = (uci[2] - 'a') + 8 * (uci[3] - '1');
+            const char* promos = "nbrq";
+            const char* p = uci.size() > 4 ? std::strchr(promos, uci[4]) : nullptr;
+            return encode_move(from, to, p && *p ? (int)(p - promos) + 1 : 0);
+        }
+
+        std::string decode_uci(uint16_t move)
+        {
+            int from = move & 63, to = (move >> 6) & 63, promo = move >> 12;
+            std::string s = { char('a' + from % 8), char('1' + from / 8), char('a' + to % 8), char('1' + to / 8) };
+            if (promo) s.push_back("nbrq"[promo - 1]);
+            return s;
+        }
+    } // namespace
+
+    namespace
+    {
+        // Options that size or place memory and threads, or pick among kernels that give equal values:
+        // a fixed-depth result does not depend on them, so they leave the store key alone.
+        const char* const kResourceOptions[] = { "Hash", "LargePages", "NumaInterleave", "Affinity", "KeepAnalysis", "MultiPV", "EvalKernel", "PawnHash", "EvalCache" };
+    } // namespace
+
+    uint64_t EngineBase::analysis_key(const std::string& fen) const
+    {
+        // FNV-1a over the engine's type and every other option's name and value.
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&](const std::string& s) { for (char c : s + '\0') { h ^= (unsigned char)c; h *= 1099511628211ULL; } };
+        mix(typeid(*this).name());
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            for (const EngineOption& o : engine_options)
+            {
+                if (std::find_if(std::begin(kResourceOptions), std::end(kResourceOptions), [&](const char* r) { return o.name == r; }) != std::end(kResourceOptions)) continue;
+                mix(o.name);
+                mix(std::to_string(o.value));
+            }
+        }
+        return zobrist_hash_fen(fen) ^ h;
+    }
+
+    bool EngineBase::clock_free(const std::string& fen, int depth) const
+    {
+        int reach;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            const EngineOption* draws = option_slot("DrawDetection");
+            if (draws && !draws->value) return true;
+            const EngineOption* budget = option_slot("ExtensionBudget");
+            reach = depth + (budget ? budget->value : 0);
+        }
+        std::istringstream fields(fen);
+        std::string field;
+        int clock = 0;
+        for (int i = 0; i < 5 && fields >> field; ++i)
+            if (i == 4) clock = std::atoi(field.c_str());
+        return clock + reach < 100;
+    }
+
+    bool EngineBase::recall_move(const std::string& fen, int depth, std::string& uci)
+    {
+        std::shared_ptr<AnalysisStore> store;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            if (!game_history.empty()) return false;
+            store = analysis;
+        }
+        TTEntry e;
+        if (!store || !store->probe(analysis_key(fen), e) || e.depth < depth || e.bound != Bound::Exact || !clock_free(fen, e.depth)) return false;
+        std::string move = decode_uci(e.move);
+        std::vector<std::string> legal = legal_moves_uci(fen);
+        if (std::find(legal.begin(), legal.end(), move) == legal.end()) return false; // a key collision
+        uci = move;
+        std::lock_guard<std::mutex> lock(state_mutex);
+        search_stats.reset();
+        search_stats.depth = e.depth;
+        return true;
+    }
+
+    void EngineBase::record_move(const std::string& fen, int depth, int score, const std::string& uci)
+    {
+        std::shared_ptr<AnalysisStore> store;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            if (!game_history.empty()) return;
+            store = analysis;
+        }
+        if (store && !uci.empty() && clock_free(fen, depth)) store->store(analysis_key(fen), depth, score, Bound::Exact, encode_uci(uci));
+    }
+
+    void EngineBase::begin_search(SearchContext& ctx, int depth) const
+    {
+        ctx.stats.reset();
+        ctx.stats.depth = depth;
+        std::lock_guard<std::mutex> lock(state_mutex);
+        auto value = [&](const char* name) { const EngineOption* o = option_slot(name); return o ? o->value : 0; };
+        ctx.cfg.batch_frontier = value("BatchFrontier") != 0;
+        ctx.cfg.draw_detection = value("DrawDetection") != 0;
+        ctx.cfg.check_extension = value("CheckExtension") != 0;
+        ctx.cfg.recapture_extension = value("RecaptureExtension") != 0;
+        ctx.cfg.singular_extension = value("SingularExtension") != 0;
+        ctx.cfg.extension_budget = value("ExtensionBudget");
+        int kernel = value("EvalKernel");
+        ctx.cfg.eval_kernel = kernel == 0 ? -1 : (int)EvalKernel::Scalar + kernel - 1;
+        ctx.keys = game_history;
+        size_t hashMb = (size_t)value("Hash");
+        if (!hashMb) tt.reset();
+        else
+        {
+            bool huge = value("LargePages") != 0, interleave = value("NumaInterleave") != 0;
+            if (!tt || !tt->built_for(hashMb, huge, interleave)) tt = std::make_shared<TranspositionTable>(hashMb, huge, interleave);
+        }
+        bool keep = value("KeepAnalysis") != 0;
+        if (tt)
+        {
+            if (!keep) tt->clear();
+            tt->new_search();
+        }
+        ctx.tt = tt;
+        if (keep)
+        {
+            ctx.history = history;
+            ctx.history.age();
+        }
+        size_t pawnKb = (size_t)value("PawnHash"), evalKb = (size_t)value("EvalCache");
+        if (pawnKb) ctx.pawns = pawn_table && pawn_table->size_kb() == pawnKb ? std::move(pawn_table) : std::make_shared<PawnHashTable>(pawnKb);
+        if (evalKb) ctx.evals = eval_cache && eval_cache->size_kb() == evalKb ? std::move(eval_cache) : std::make_shared<EvalCache>(evalKb);
+        Affinity policy = (Affinity)value("Affinity");
+        if (policy != Affinity::None)
+        {
+            // Concurrent searches take the lowest free slot, so each gets a CPU of its own.
+            size_t slot = std::find(pin_slots.begin(), pin_slots.end(), false) - pin_slots.begin();
+            if (slot == pin_slots.size()) pin_slots.push_back(false);
+            pin_slots[slot] = true;
+            ctx.pin_slot = (int)slot;
+            ctx.pin = std::make_shared<ThreadPin>(affinity_cpu(policy, (int)slot));
+        }
+    }
+
+    void EngineBase::end_search(SearchContext& ctx)
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        search_stats = ctx.stats;
+        history = ctx.history;
+        if (ctx.pawns) pawn_table = std::move(ctx.pawns);
+        if (ctx.evals) eval_cache = std::move(ctx.evals);
+        if (ctx.pin_slot >= 0) pin_slots[ctx.pin_slot] = false;
+        ctx.pin_slot = -1;
+        ctx.pin.reset();
+    }
+
+    int BoardState::castle_mask() const
+    {
+        return (white_kingside_rook_file >= 0 ? 1 : 0) | (white_queenside_rook_file >= 0 ? 2 : 0) | (black_kingside_rook_file >= 0 ? 4 : 0) | (black_queenside_rook_file >= 0 ? 8 : 0);
+    }
+
+    uint64_t BoardState::position_key() const
+    {
+        return zobrist_hash(pieces, side_to_move, castle_mask(), ep_square);
+    }
+
+    std::string BoardState::buildFen(const BoardState& e)
+    {
+        auto pieceAt = [&](int sq)->char { uint64_t b = 1ULL << sq; for (int i = 0; i < 6; ++i) { if (e.pieces[i] & b) { return "PNBRQK"[i]; } if (e.pieces[i + 6] & b) { return "pnbrqk"[i]; } } return '.'; }; std::string board; for (int rank = 7; rank >= 0; --rank) { int empty = 0; for (int file = 0; file < 8; ++file) { int idx = rank * 8 + file; char pc = pieceAt(idx); if (pc == '.') { ++empty; } else { if (empty) { board.push_back(char('0' + empty)); empty = 0; } board.push_back(pc); } } if (empty) board.push_back(char('0' + empty)); if (rank) board.push_back('/'); }
+        // Standard rook files keep KQkq, anything else is written Shredder-style as the rook file.
+        std::string cast; if (e.white_kingside_rook_file >= 0) cast += (e.white_kingside_rook_file == 7 ? 'K' : char('A' + e.white_kingside_rook_file)); if (e.white_queenside_rook_file >= 0) cast += (e.white_queenside_rook_file == 0 ? 'Q' : char('A' + e.white_queenside_rook_file)); if (e.black_kingside_rook_file >= 0) cast += (e.black_kingside_rook_file == 7 ? 'k' : char('a' + e.black_kingside_rook_file)); if (e.black_queenside_rook_file >= 0) cast += (e.black_queenside_rook_file == 0 ? 'q' : char('a' + e.black_queenside_rook_file)); if (cast.empty()) cast = "-";
         std::string ep = (e.ep_square >= 0 ? std::string(1, char('a' + (e.ep_square % 8))) + char('1' + (e.ep_square / 8)) : "-"); return board + (e.side_to_move == 0 ? " w " : " b ") + cast + " " + ep + " " + std::to_string(e.halfmove_clock) + " " + std::to_string(e.fullmove_number);
     }
 
-    void EngineBase::loadFEN(const std::string& fen) {
+    void BoardState::loadFEN(const std::string& fen) {
         std::fill(std::begin(pieces), std::end(pieces), 0ULL);
         size_t idx = 0;
         int sq = 56;
@@ -33,12 +334,22 @@ namespace engine {
         }
         idx++;
         side_to_move = (fen[idx++] == 'w' ? 0 : 1); idx += 1;
-        // skip castling (simplified, keep existing flags default)
+        // castling: KQkq picks the outermost rook on that side of the king, A-H/a-h name the rook file (Shredder/X-FEN)
+        white_kingside_rook_file = white_queenside_rook_file = black_kingside_rook_file = black_queenside_rook_file = -1;
+        auto outerRook = [&](int rook, int king, bool kingside) { uint64_t rank = (rook == 3 ? 0xFFULL : 0xFFULL << 56); int kf = pieces[king] & rank ? bit_scan_forward(pieces[king] & rank) % 8 : 4; for (int f = kingside ? 7 : 0; kingside ? f > kf : f < kf; f += kingside ? -1 : 1) if (pieces[rook] & rank & (0x0101010101010101ULL << f)) return f; return -1; };
+        for (; idx < fen.size() && fen[idx] != ' '; ++idx) {
+            char c = fen[idx];
+            if (c == 'K') white_kingside_rook_file = outerRook(3, 5, true);
+            else if (c == 'Q') white_queenside_rook_file = outerRook(3, 5, false);
+            else if (c == 'k') black_kingside_rook_file = outerRook(9, 11, true);
+            else if (c == 'q') black_queenside_rook_file = outerRook(9, 11, false);
+            else if (c >= 'A' && c <= 'H') { int kf = pieces[5] & 0xFFULL ? bit_scan_forward(pieces[5] & 0xFFULL) % 8 : 4; (c - 'A' > kf ? white_kingside_rook_file : white_queenside_rook_file) = c - 'A'; }
+            else if (c >= 'a' && c <= 'h') { int kf = pieces[11] & (0xFFULL << 56) ? bit_scan_forward(pieces[11] & (0xFFULL << 56)) % 8 : 4; (c - 'a' > kf ? black_kingside_rook_file : black_queenside_rook_file) = c - 'a'; }
+        }
         idx = fen.find(' ', idx) + 1;
         // ep square
         ep_square = (fen[idx] == '-' ? -1 : (fen[idx] - 'a') + (fen[idx + 1] - '1') * 8); idx = fen.find(' ', idx) + 1;
         halfmove_clock = std::stoi(fen.substr(idx, fen.find(' ', idx) - idx)); idx = fen.find(' ', idx) + 1;
         fullmove_number = std::stoi(fen.substr(idx));
-        if (side_to_move == 1) flipPosition();
     }
 }
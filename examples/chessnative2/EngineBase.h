@@ -2,13 +2,27 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <utility>
+#include "EngineOptions.h"
+#include "Platform.h"
+#include "SearchStats.h"
+#include "SearchTables.h"
+#include "SlicedSearch.h"
 namespace engine
 {
-    // Abstract base for selectable engines.
-    class EngineBase {
-    public:
-        uint64_t pieces[12];
+    // Befriended by the engines so benchmarks and tools can drive their internal hot paths directly.
+    struct BenchProbe;
+    struct PerftRunner;
+    class AnalysisStore;
+
+    // A position in the Zobrist piece order, read from and written back to FEN. Engines that search by
+    // making and unmaking moves on one board keep it in their per-search context.
+    struct BoardState
+    {
+        // White P N B R Q K, then black, on real squares whichever side is to move (the Zobrist order).
+        uint64_t pieces[12] = {};
         int side_to_move = 0;
         int white_kingside_rook_file = -1;
         int white_queenside_rook_file = -1;
@@ -17,34 +31,142 @@ namespace engine
         int ep_square = -1;
         int halfmove_clock = 0;
         int fullmove_number = 1;
-        // utilities
-        void flipPosition();
-
-        // Build FEN from internal state (simplified: keep original castling flags as KQkq)
-        static std::string buildFen(const EngineBase& e);
 
         void loadFEN(const std::string& fen);
+        static std::string buildFen(const BoardState& b);
+        // Castling rights as a Zobrist mask (1 = K, 2 = Q, 4 = k, 8 = q).
+        int castle_mask() const;
+        uint64_t position_key() const;
+    };
+
+    // Everything one search call writes: counters, the option values it runs with, the repetition
+    // stack (game history, then the current line) and its copy of the history heuristic. Each call
+    // builds its own; the transposition table is the one thing concurrent calls share, and it is
+    // written lock-free (see SearchTables.h). tt is null when the Hash option is 0.
+    struct SearchContext
+    {
+        SearchStats stats;
+        SearchConfig cfg;
+        std::vector<uint64_t> keys;
+        std::shared_ptr<TranspositionTable> tt;
+        HistoryTable history;
+        PvTable pv;
+        // The current line: plies it has been extended by (see SearchConfig), and the square its last
+        // move captured on, -1 if it captured nothing. Set around each recursion and restored after it.
+        int extensions = 0;
+        int recapture_square = -1;
+        // Transposition-table key of a node on the current line. A node searched with part of the budget
+        // spent has a different subtree below it, so its entries are kept apart from unextended ones.
+        uint64_t table_key(uint64_t position) const { return extensions ? position ^ (uint64_t)extensions * 0x9E3779B97F4A7C15ULL : position; }
+        // Evaluation caches, null when the engine has no such option or it is 0. Their entries depend
+        // on the position only, so a search borrows the engine's pair and end_search hands it back.
+        std::shared_ptr<PawnHashTable> pawns;
+        std::shared_ptr<EvalCache> evals;
+        // Holds the calling thread on one CPU (Affinity option) until end_search; pin_slot is its
+        // index among the engine's running searches, -1 when not pinned.
+        std::shared_ptr<ThreadPin> pin;
+        int pin_slot = -1;
+    };
 
+    // One line of a MultiPV analysis.
+    struct PvLine
+    {
+        int score = 0;               // exact, for the side to move at the root
+        int depth = 0;               // the iteration that produced the line
+        std::vector<std::string> pv; // UCI moves from the root; pv[0] is the root move
+    };
+
+    // Abstract base for selectable engines. The engine object holds only settings (options, game
+    // history) and the stats of the last finished search, all behind one mutex; search state lives in
+    // a SearchContext, so a single instance can serve calls from several threads at once.
+    class EngineBase {
+    public:
+        // Registers the options every engine shares (see begin_search()).
+        EngineBase();
         virtual ~EngineBase() = default;
+        EngineBase(const EngineBase&) = delete;
+        EngineBase& operator=(const EngineBase&) = delete;
         // Compute best move in UCI form for given FEN and search depth.
         virtual std::string choose_move(const std::string& fen, int depth) = 0;
         // Return (uci, score) for all legal root moves searched to given depth.
         virtual std::vector<std::pair<std::string, int>> root_search_scores(const std::string& fen, int depth) = 0;
+        // The best `lines` root moves, best first, each with an exact score and its principal variation.
+        // Iterative deepening to depth: at each depth, line k searches the root without the moves of
+        // lines 0..k-1, starting with the move line k had one depth earlier. Far cheaper than
+        // root_search_scores when lines is small. Fewer lines if there are fewer legal moves.
+        virtual std::vector<PvLine> multipv(const std::string& fen, int depth, int lines) = 0;
+        // choose_move(fen, depth) as a search the caller advances a slice at a time (see SlicedSearch.h).
+        // Engines that cannot suspend their search run all of it in the first slice.
+        virtual std::unique_ptr<SlicedSearch> start_search(const std::string& fen, int depth);
         // Return legal moves (no search) in UCI for given FEN.
         virtual std::vector<std::string> legal_moves_uci(const std::string& fen) = 0;
         // Apply a legal UCI move to a FEN, returning new FEN (empty string on failure).
         virtual std::string apply_move(const std::string& fen, const std::string& uci) = 0;
+        // Counters and timings of the most recently finished choose_move / root_search_scores / multipv call.
+        SearchStats last_search_stats() const;
+        // Zobrist keys (see Zobrist.h) of the game positions before the FEN handed to the next
+        // searches, oldest first. Search treats a repeat of any of them as a draw. Stays in effect
+        // until replaced; GameController keeps it in sync with its move history.
+        void set_game_history(const std::vector<uint64_t>& keys);
+        std::vector<uint64_t> get_game_history() const;
+        // Forgets what earlier searches learnt (transposition table, history heuristic). Until then
+        // each search starts from the tables the previous ones left, so consecutive moves of one game
+        // reuse their analysis. GameController calls this when a game is reset or loaded from FEN.
+        // Engines that keep analysis of their own override it and call this one.
+        virtual void new_game();
+        // Persistent analysis (see AnalysisStore.h), shared with other engines and processes; null
+        // detaches it. choose_move answers from the store when it holds an exact result at least as
+        // deep as asked for, and writes its own results back when they are deeper. Only searches
+        // with no game history use it: a repetition in the history can change a position's score.
+        void set_analysis_store(std::shared_ptr<AnalysisStore> store);
+        // The store key of fen's results: its Zobrist key mixed with the engine's type and the values of
+        // the options that can change a search's result, so one file keeps every configuration apart.
+        uint64_t analysis_key(const std::string& fen) const;
+
+        // Tunable settings, built into option UIs by the GUI, the UCI front end and the benchmarks.
+        // Values are read at the start of the next search. Names are case-insensitive, as in UCI.
+        std::vector<EngineOption> options() const;
+        bool find_option(const std::string& name, EngineOption* out = nullptr) const;
+        int option_value(const std::string& name) const;
+        // False for an unknown name or a value outside the option's range; spin values are not clamped.
+        bool set_option(const std::string& name, int value);
+        bool set_option(const std::string& name, const std::string& value);
+        void reset_options();
 
     protected:
-        static uint64_t byteswap(uint64_t x) {
-#if defined(_MSC_VER)
-            return _byteswap_uint64(x);
-#elif defined(__GNUC__) || defined(__clang__)
-            return __builtin_bswap64(x);
-#else
-            return ((x & 0x00000000000000FFULL) << 56) | ((x & 0x000000000000FF00ULL) << 40) | ((x & 0x0000000000FF0000ULL) << 24) | ((x & 0x00000000FF000000ULL) << 8) | ((x & 0x000000FF00000000ULL) >> 8) | ((x & 0x0000FF0000000000ULL) >> 24) | ((x & 0x00FF000000000000ULL) >> 40) | ((x & 0xFF00000000000000ULL) >> 56);
-#endif
-        }
+        // Engine-specific options are added by the derived constructor.
+        void add_option(const EngineOption& o);
+        // Fills ctx from the current options, game history and search tables; end_search publishes its
+        // stats, keeps its history table for the next search and takes back the evaluation caches.
+        void begin_search(SearchContext& ctx, int depth) const;
+        void end_search(SearchContext& ctx);
+        // choose_move's use of the analysis store: recall_move gives a stored legal best move of at
+        // least depth plies (publishing empty stats for the search it saves); record_move stores the
+        // exact root score a search found. Both pass over positions whose halfmove clock is close
+        // enough to the fifty-move rule for the search to see it.
+        bool recall_move(const std::string& fen, int depth, std::string& uci);
+        void record_move(const std::string& fen, int depth, int score, const std::string& uci);
+
+    private:
+        mutable std::mutex state_mutex;
+        SearchStats search_stats;
+        std::vector<uint64_t> game_history;
+        std::vector<EngineOption> engine_options;
+        // Replaced, not resized, when the Hash option changes, so searches still running keep theirs.
+        mutable std::shared_ptr<TranspositionTable> tt;
+        HistoryTable history;
+        // Lent to one search at a time; a search started while they are out builds its own.
+        mutable std::shared_ptr<PawnHashTable> pawn_table;
+        mutable std::shared_ptr<EvalCache> eval_cache;
+        mutable std::vector<bool> pin_slots; // true while a pinned search holds the slot
+        std::shared_ptr<AnalysisStore> analysis;
+
+        const EngineOption* option_slot(const std::string& name) const; // caller holds state_mutex
+        // True when no line of a depth-ply search of fen, extensions included, can reach the fifty-move
+        // rule (or draw detection is off): the result does not depend on the halfmove clock, which the
+        // store key leaves out. depth counts plies as the alpha-beta searches do; an MCTS tree may grow past
+        // it, so for that engine the check is only as good as its depth is a bound.
+        bool clock_free(const std::string& fen, int depth) const;
     };
 
 } // namespace engine
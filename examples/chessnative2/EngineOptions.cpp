@@ -0,0 +1,78 @@
+#include "EngineOptions.h"
+#include <cctype>
+#include <cstdlib>
+
+namespace engine
+{
+    namespace
+    {
+        bool iequals(const std::string& a, const std::string& b)
+        {
+            if (a.size() != b.size()) return false;
+            for (size_t i = 0; i < a.size(); ++i)
+                if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+            return true;
+        }
+    } // namespace
+
+    EngineOption EngineOption::check(const std::string& name, bool def, const std::string& help)
+    {
+        EngineOption o;
+        o.name = name; o.type = Type::Check; o.value = o.default_value = def ? 1 : 0; o.max = 1; o.help = help;
+        return o;
+    }
+
+    EngineOption EngineOption::spin(const std::string& name, int def, int min, int max, const std::string& help)
+    {
+        EngineOption o;
+        o.name = name; o.type = Type::Spin; o.value = o.default_value = def; o.min = min; o.max = max; o.help = help;
+        return o;
+    }
+
+    EngineOption EngineOption::combo(const std::string& name, int def, const std::vector<std::string>& choices, const std::string& help)
+    {
+        EngineOption o;
+        o.name = name; o.type = Type::Combo; o.value = o.default_value = def; o.max = (int)choices.size() - 1; o.choices = choices; o.help = help;
+        return o;
+    }
+
+    std::string EngineOption::value_string() const
+    {
+        switch (type)
+        {
+        case Type::Check: return value ? "true" : "false";
+        case Type::Combo: return value >= 0 && value < (int)choices.size() ? choices[value] : std::string();
+        default: return std::to_string(value);
+        }
+    }
+
+    bool EngineOption::parse(const std::string& text, int& out) const
+    {
+        switch (type)
+        {
+        case Type::Check:
+            if (iequals(text, "true") || text == "1") { out = 1; return true; }
+            if (iequals(text, "false") || text == "0") { out = 0; return true; }
+            return false;
+        case Type::Combo:
+            for (size_t i = 0; i < choices.size(); ++i)
+                if (iequals(text, choices[i])) { out = (int)i; return true; }
+            return false;
+        default:
+        {
+            if (text.empty()) return false;
+            char* end = nullptr;
+            long v = std::strtol(text.c_str(), &end, 10);
+            if (*end != '\0' || v < min || v > max) return false;
+            out = (int)v;
+            return true;
+        }
+        }
+    }
+
+    void SearchConfig::evaluate_batch(const LeafBatch& batch, const int values[6], int* out) const
+    {
+        if (eval_kernel < 0 || !evaluate_batch_with((EvalKernel)eval_kernel, batch, values, out))
+            engine::evaluate_batch(batch, values, out);
+    }
+} // namespace engine
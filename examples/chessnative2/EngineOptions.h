@@ -0,0 +1,55 @@
+#pragma once
+#include "BatchEval.h"
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    // One tunable engine setting. The types are UCI's (check, spin, combo) so a UCI front end can announce
+    // them unchanged; the GUI maps them to a checkbox, an integer field and a drop-down. Every value is an
+    // int: 0/1 for a check, the choice index for a combo.
+    struct EngineOption
+    {
+        enum class Type { Check, Spin, Combo };
+
+        std::string name;
+        Type type = Type::Spin;
+        int value = 0;
+        int default_value = 0;
+        int min = 0;
+        int max = 0;
+        std::vector<std::string> choices;
+        std::string help;
+
+        static EngineOption check(const std::string& name, bool def, const std::string& help);
+        static EngineOption spin(const std::string& name, int def, int min, int max, const std::string& help);
+        static EngineOption combo(const std::string& name, int def, const std::vector<std::string>& choices, const std::string& help);
+
+        // "true"/"false", the number, or the choice name.
+        std::string value_string() const;
+        // Inverse of value_string (choice names and true/false case-insensitive); false if the text does not fit.
+        bool parse(const std::string& text, int& out) const;
+    };
+
+    // Search settings taken from the options once at the start of each search call.
+    struct SearchConfig
+    {
+        bool batch_frontier = true;  // score depth-1 children with one batched evaluation
+        bool draw_detection = true;  // repetition and fifty-move checks
+        int eval_kernel = -1;        // an EvalKernel, or -1 to use the runtime-dispatched one
+        // Extensions search a move one ply deeper than its nominal depth: a move that gives check, a
+        // capture on the square the previous move captured on, and a transposition-table move that a
+        // reduced search of the other moves shows to be the only good one (singular). A line is
+        // extended by at most extension_budget plies in all. The budget is 0 by default, which turns them
+        // all off: with a material-only evaluation and no quiescence search they cost more nodes than they
+        // save. Singular extension is off on its own as well: the test reads the transposition table, so
+        // scores would then depend on what earlier searches left.
+        bool check_extension = true;
+        bool recapture_extension = true;
+        bool singular_extension = false;
+        int extension_budget = 0;
+
+        // evaluate_batch with the selected kernel, falling back to the dispatched one if this CPU lacks it.
+        void evaluate_batch(const LeafBatch& batch, const int values[6], int* out) const;
+    };
+} // namespace engine
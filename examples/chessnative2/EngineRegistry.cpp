@@ -0,0 +1,43 @@
+#include "EngineRegistry.h"
+#include "ChessEngine1.hpp"
+#include "ChessEngine2.hpp"
+#include "MateEngine.hpp"
+#include "MctsEngine.hpp"
+
+namespace engine
+{
+    namespace
+    {
+        template <typename EngineT>
+        std::unique_ptr<EngineBase> make() { return std::unique_ptr<EngineBase>(new EngineT()); }
+    } // namespace
+
+    const std::vector<EngineInfo>& engine_registry()
+    {
+        static const std::vector<EngineInfo> engines = {
+            { "Engine1", "Copy-make bitboard engine; a Position copy per ply, search state per call", &make<ChessEngine1> },
+            { "Engine2", "Make/unmake bitboard engine; one board per search call, can search in time slices", &make<ChessEngine2> },
+            { "Mate", "Engine2 behind a df-pn mate solver; plays the forced mates it proves", &make<MateEngine> },
+            { "MCTS", "Monte Carlo tree search with PUCT on Engine2's board; parallel playouts with virtual loss", &make<MctsEngine> },
+        };
+        return engines;
+    }
+
+    const EngineInfo& default_engine()
+    {
+        return *find_engine("Engine2");
+    }
+
+    const EngineInfo* find_engine(const std::string& name)
+    {
+        for (const EngineInfo& e : engine_registry())
+            if (name == e.name) return &e;
+        return nullptr;
+    }
+
+    std::unique_ptr<EngineBase> create_engine(const std::string& name)
+    {
+        const EngineInfo* e = find_engine(name);
+        return e ? e->create() : nullptr;
+    }
+} // namespace engine
@@ -0,0 +1,26 @@
+#pragma once
+#include "EngineBase.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    // Every selectable engine, in display order. The GUI's engine list, the UCI front end's --engine flag
+    // and the tests all iterate this instead of naming engine classes. The list is a plain table in
+    // EngineRegistry.cpp rather than self-registering statics, which a static library link would drop.
+    struct EngineInfo
+    {
+        const char* name;
+        const char* description;
+        std::unique_ptr<EngineBase> (*create)();
+    };
+
+    const std::vector<EngineInfo>& engine_registry();
+    // The engine the GUI and the tools start with (Engine2).
+    const EngineInfo& default_engine();
+    // Case-sensitive name lookup; null for an unknown name.
+    const EngineInfo* find_engine(const std::string& name);
+    // New engine with default options, or null for an unknown name.
+    std::unique_ptr<EngineBase> create_engine(const std::string& name);
+} // namespace engine
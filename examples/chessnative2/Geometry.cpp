@@ -0,0 +1,59 @@
+#include "Geometry.h"
+
+namespace engine
+{
+    namespace
+    {
+        // File and rank step of each Direction.
+        constexpr int kStepFile[8] = { 0, 0, 1, -1, 1, -1, -1, 1 };
+        constexpr int kStepRank[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+
+        constexpr int abs_diff(int a, int b) { return a > b ? a - b : b - a; }
+
+        constexpr GeometryTables make_tables()
+        {
+            GeometryTables t{};
+            for (int sq = 0; sq < 64; ++sq)
+            {
+                int f = sq & 7, r = sq >> 3;
+                for (int d = 0; d < 8; ++d)
+                {
+                    // Walking outwards, everything passed so far lies between sq and the current square.
+                    uint64_t passed = 0;
+                    for (int cf = f + kStepFile[d], cr = r + kStepRank[d]; cf >= 0 && cf < 8 && cr >= 0 && cr < 8; cf += kStepFile[d], cr += kStepRank[d])
+                    {
+                        int to = cr * 8 + cf;
+                        t.between[sq][to] = passed;
+                        passed |= 1ULL << to;
+                    }
+                    t.ray[d][sq] = passed;
+                }
+                for (int to = 0; to < 64; ++to)
+                {
+                    int df = abs_diff(f, to & 7), dr = abs_diff(r, to >> 3);
+                    t.distance[sq][to] = (uint8_t)(df > dr ? df : dr);
+                    if (df == 1 && (to >> 3) == r + 1) t.pawn[0][sq] |= 1ULL << to;
+                    if (df == 1 && (to >> 3) == r - 1) t.pawn[1][sq] |= 1ULL << to;
+                    if ((df == 1 && dr == 2) || (df == 2 && dr == 1)) t.knight[sq] |= 1ULL << to;
+                    if (t.distance[sq][to] == 1) t.king[sq] |= 1ULL << to;
+                }
+            }
+            // Lines need both rays of a direction pair, so they are filled once all rays exist.
+            for (int sq = 0; sq < 64; ++sq)
+                for (int d = 0; d < 8; ++d)
+                {
+                    uint64_t full = t.ray[d][sq] | t.ray[d ^ 1][sq] | (1ULL << sq);
+                    for (uint64_t m = t.ray[d][sq]; m; m &= m - 1)
+                    {
+                        int to = 0;
+                        while (!((m >> to) & 1)) ++to;
+                        t.line[sq][to] = full;
+                    }
+                }
+            return t;
+        }
+    } // namespace
+
+    // make_tables() is a constant expression, so the tables are built at compile time.
+    const GeometryTables kGeometry = make_tables();
+} // namespace engine
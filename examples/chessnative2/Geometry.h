@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace engine
+{
+    // Square geometry shared by both engines, built at compile time (see Geometry.cpp).
+    // Squares are 0 = a1 .. 63 = h8. Directions pair up so that d ^ 1 is the opposite
+    // direction; even directions increase the square index, odd ones decrease it.
+    enum Direction { North, South, East, West, NorthEast, SouthWest, NorthWest, SouthEast };
+
+    struct GeometryTables
+    {
+        uint64_t ray[8][64];        // squares from sq to the board edge in one direction, sq excluded
+        uint64_t between[64][64];   // squares strictly between a and b when they share a line, else 0
+        uint64_t line[64][64];      // the whole edge-to-edge line through a and b, else 0
+        uint64_t pawn[2][64];       // squares a white (0) or black (1) pawn on sq attacks
+        uint64_t knight[64];
+        uint64_t king[64];
+        uint8_t distance[64][64];   // king-move (Chebyshev) distance
+    };
+
+    extern const GeometryTables kGeometry;
+
+    inline int bit_scan_forward(uint64_t x)
+    {
+#if defined(_MSC_VER)
+        unsigned long idx; _BitScanForward64(&idx, x); return (int)idx;
+#else
+        return __builtin_ctzll(x);
+#endif
+    }
+    inline int bit_scan_reverse(uint64_t x)
+    {
+#if defined(_MSC_VER)
+        unsigned long idx; _BitScanReverse64(&idx, x); return (int)idx;
+#else
+        return 63 - __builtin_clzll(x);
+#endif
+    }
+
+    inline uint64_t ray_mask(int dir, int sq) { return kGeometry.ray[dir][sq]; }
+    inline uint64_t between_mask(int a, int b) { return kGeometry.between[a][b]; }
+    inline uint64_t line_mask(int a, int b) { return kGeometry.line[a][b]; }
+    inline bool aligned(int a, int b, int c) { return (kGeometry.line[a][b] >> c) & 1; }
+    inline int square_distance(int a, int b) { return kGeometry.distance[a][b]; }
+
+    // Squares a slider on sq reaches in one direction: the ray up to and including the first blocker.
+    inline uint64_t ray_attacks(int dir, int sq, uint64_t occupied)
+    {
+        uint64_t ray = kGeometry.ray[dir][sq];
+        uint64_t blockers = ray & occupied;
+        if (!blockers) return ray;
+        return ray ^ kGeometry.ray[dir][(dir & 1) ? bit_scan_reverse(blockers) : bit_scan_forward(blockers)];
+    }
+    inline uint64_t orthogonal_attacks(int sq, uint64_t occupied)
+    {
+        return ray_attacks(North, sq, occupied) | ray_attacks(South, sq, occupied) | ray_attacks(East, sq, occupied) | ray_attacks(West, sq, occupied);
+    }
+    inline uint64_t diagonal_attacks(int sq, uint64_t occupied)
+    {
+        return ray_attacks(NorthEast, sq, occupied) | ray_attacks(SouthWest, sq, occupied) | ray_attacks(NorthWest, sq, occupied) | ray_attacks(SouthEast, sq, occupied);
+    }
+} // namespace engine
@@ -0,0 +1,293 @@
+#include "MateEngine.hpp"
+#include "Color.h"
+#include "EngineOptions.h"
+#include <algorithm>
+
+namespace engine
+{
+    namespace
+    {
+        // Proof and disproof numbers saturate here; a number at kInfinite is a proven result.
+        const uint32_t kInfinite = 1u << 30;
+        const size_t kBucket = 4;
+
+        uint32_t add(uint32_t a, uint32_t b) { return (uint32_t)std::min<uint64_t>((uint64_t)a + b, kInfinite); }
+
+        // Results are keyed by plies left as well as position: a mate in 2 from here is not a mate in 1.
+        uint64_t node_key(uint64_t position, int plies) { return position ^ ((uint64_t)(plies + 1) * 0x9E3779B97F4A7C15ULL); }
+    } // namespace
+
+    // Depth-limited df-pn (Nagai 2002). The attacker is to move at even heights (OR nodes: one child
+    // must be proven), the defender at odd heights (AND nodes: every child must be). A node is searched
+    // until its proof or disproof number reaches the threshold its parent gave it, always descending
+    // into the child that is cheapest to prove (OR) or disprove (AND); thresholds leave room up to
+    // the second-best sibling, so the search stays in one subtree until another becomes cheaper.
+    struct MateEngine::Solver
+    {
+        using Context = ChessEngine2::Context;
+        using Move = ChessEngine2::Move;
+
+        struct Entry
+        {
+            uint64_t key;
+            uint32_t pn, dn;
+            uint32_t work;  // nodes spent below; the cheapest entry of a bucket is replaced
+            uint16_t move;  // proving move (OR) or longest-resisting reply (AND) once proven
+            uint8_t length; // plies to mate once proven
+        };
+        struct Value
+        {
+            uint32_t pn = 1, dn = 1;
+            int length = 0;
+        };
+
+        Context& ctx;
+        std::vector<Entry> table;
+        uint64_t nodes = 0;
+        uint64_t budget;
+
+        Solver(Context& c, size_t bytes, uint64_t maxNodes) : ctx(c), budget(maxNodes)
+        {
+            // A call touches at most a few entries per node, so a small budget gets a small table.
+            size_t cap = std::max<size_t>(bytes / sizeof(Entry), kBucket);
+            size_t want = (size_t)std::min<uint64_t>(cap, std::max<uint64_t>(4 * maxNodes, 1024));
+            size_t buckets = 1;
+            while (buckets * 2 * kBucket <= want) buckets *= 2;
+            table.assign(buckets * kBucket, Entry());
+        }
+
+        Entry* bucket(uint64_t key) { return &table[(key & (table.size() / kBucket - 1)) * kBucket]; }
+
+        bool probe(uint64_t key, Value& out)
+        {
+            Entry* b = bucket(key);
+            for (size_t i = 0; i < kBucket; ++i)
+                if (b[i].key == key && b[i].work)
+                {
+                    out.pn = b[i].pn;
+                    out.dn = b[i].dn;
+                    out.length = b[i].length;
+                    return true;
+                }
+            return false;
+        }
+
+        void store(uint64_t key, const Value& v, uint64_t work, uint16_t move)
+        {
+            Entry* b = bucket(key);
+            Entry* victim = b;
+            for (size_t i = 0; i < kBucket; ++i)
+            {
+                if (b[i].key == key) { victim = &b[i]; break; }
+                if (b[i].work < victim->work) victim = &b[i];
+            }
+            *victim = { key, v.pn, v.dn, (uint32_t)std::min<uint64_t>(std::max<uint64_t>(work, 1), 0xffffffffu), move, (uint8_t)v.length };
+        }
+
+        uint16_t stored_move(uint64_t key)
+        {
+            Entry* b = bucket(key);
+            for (size_t i = 0; i < kBucket; ++i)
+                if (b[i].key == key && b[i].work) return b[i].move;
+            return 0;
+        }
+
+        bool in_check()
+        {
+            uint64_t king = ctx.pieces[(ctx.side_to_move == White ? 0 : 6) + 5];
+            return king && ctx.isSquareAttacked(Context::ctz64(king));
+        }
+
+        Value mid(int plies, int height, uint32_t thpn, uint32_t thdn)
+        {
+            ++nodes;
+            ENGINE_STAT(ctx.stats.enter_node(height));
+            const uint64_t start = nodes;
+            const bool attacker = (height & 1) == 0;
+            const uint64_t position = ctx.position_key();
+            const uint64_t key = node_key(position, plies);
+            std::vector<Move> moves;
+            {
+                ENGINE_STAT_TIMER(genTimer, ctx.stats.movegen_ns);
+                ctx.generateLegalMoves(1, moves);
+            }
+            Value v;
+            if (moves.empty() || plies == 0)
+            {
+                // Mate only if the defender is to move, in check, without a move.
+                bool mated = !attacker && moves.empty() && in_check();
+                v.pn = mated ? 0 : kInfinite;
+                v.dn = mated ? kInfinite : 0;
+                store(key, v, 1, 0);
+                return v;
+            }
+
+            struct Child
+            {
+                Move move;
+                uint64_t key;
+                Value value;
+            };
+            std::vector<Child> children(moves.size());
+            ctx.keys.push_back(position);
+            for (size_t i = 0; i < moves.size(); ++i)
+            {
+                Child& c = children[i];
+                c.move = moves[i];
+                ChessEngine2::Snapshot save = ctx.snapshot();
+                ctx.makeMove(moves[i]);
+                uint64_t p = ctx.position_key();
+                c.key = node_key(p, plies - 1);
+                if (ctx.isRepetition(p))
+                {
+                    c.value.pn = kInfinite; // a draw refutes the mate; not stored, it depends on the line
+                    c.value.dn = 0;
+                }
+                else if (!probe(c.key, c.value) && attacker && !in_check())
+                    c.value.pn = 2; // quiet attacking moves are tried after checks
+                ctx.restore(save);
+            }
+
+            size_t best = 0;
+            for (;;)
+            {
+                uint32_t second = kInfinite;
+                best = 0;
+                if (attacker)
+                {
+                    v.pn = kInfinite;
+                    v.dn = 0;
+                    for (size_t i = 0; i < children.size(); ++i)
+                    {
+                        const Value& c = children[i].value;
+                        v.dn = add(v.dn, c.dn);
+                        if (c.pn < v.pn) { second = v.pn; v.pn = c.pn; best = i; }
+                        else if (c.pn < second) second = c.pn;
+                    }
+                }
+                else
+                {
+                    v.pn = 0;
+                    v.dn = kInfinite;
+                    for (size_t i = 0; i < children.size(); ++i)
+                    {
+                        const Value& c = children[i].value;
+                        v.pn = add(v.pn, c.pn);
+                        if (c.dn < v.dn) { second = v.dn; v.dn = c.dn; best = i; }
+                        else if (c.dn < second) second = c.dn;
+                    }
+                }
+                if (v.pn >= thpn || v.dn >= thdn || nodes >= budget) break;
+                Child& c = children[best];
+                uint32_t cthpn, cthdn;
+                if (attacker)
+                {
+                    cthpn = std::min(thpn, add(second, 1));
+                    cthdn = add(thdn - v.dn, c.value.dn);
+                }
+                else
+                {
+                    cthdn = std::min(thdn, add(second, 1));
+                    cthpn = add(thpn - v.pn, c.value.pn);
+                }
+                ChessEngine2::Snapshot save = ctx.snapshot();
+                ctx.makeMove(c.move);
+                c.value = mid(plies - 1, height + 1, cthpn, cthdn);
+                ctx.restore(save);
+            }
+            ctx.keys.pop_back();
+
+            if (v.pn == 0)
+            {
+                // The attacker takes the quickest proven mate; the defender the slowest.
+                int length = attacker ? 1 << 30 : -1;
+                for (size_t i = 0; i < children.size(); ++i)
+                {
+                    const Value& c = children[i].value;
+                    if (c.pn == 0 && (attacker ? c.length < length : c.length > length))
+                    {
+                        length = c.length;
+                        best = i;
+                    }
+                }
+                v.length = length + 1;
+            }
+            store(key, v, nodes - start + 1, Context::ttMove(children[best].move));
+            return v;
+        }
+
+        // The proven line, followed through the table from the root.
+        std::vector<std::string> pv(int plies)
+        {
+            std::vector<std::string> out;
+            ChessEngine2::Snapshot save = ctx.snapshot();
+            std::vector<Move> legal;
+            for (; plies > 0; --plies)
+            {
+                uint64_t key = node_key(ctx.position_key(), plies);
+                Value v;
+                uint16_t want = stored_move(key);
+                if (!probe(key, v) || v.pn != 0 || v.length == 0 || !want) break;
+                legal.clear();
+                ctx.generateLegalMoves(1, legal);
+                auto it = std::find_if(legal.begin(), legal.end(), [&](const Move& m) { return Context::ttMove(m) == want; });
+                if (it == legal.end()) break;
+                out.push_back(Context::moveToUci(*it));
+                ctx.makeMove(*it);
+            }
+            ctx.restore(save);
+            return out;
+        }
+    };
+
+    MateEngine::MateEngine()
+    {
+        add_option(EngineOption::spin("MateMoves", 3, 0, 32, "choose_move first looks for a forced mate in this many moves; 0 to skip"));
+        add_option(EngineOption::spin("MateNodes", 50, 1, 1000000, "Mate solver node budget per call, in thousands"));
+        add_option(EngineOption::spin("MateHash", 64, 1, 65536, "Mate solver table limit in MB"));
+    }
+
+    std::string MateEngine::choose_move(const std::string& fen, int depth)
+    {
+        int moves = option_value("MateMoves");
+        if (moves > 0)
+        {
+            MateResult mate = solve_mate(fen, moves);
+            if (mate.status == MateResult::Status::Mate && !mate.pv.empty()) return mate.pv[0];
+        }
+        return ChessEngine2::choose_move(fen, depth);
+    }
+
+    MateResult MateEngine::solve_mate(const std::string& fen, int maxMoves)
+    {
+        MateResult result;
+        Context ctx;
+        begin_search(ctx, 2 * std::max(maxMoves, 1) - 1);
+        ctx.loadFEN(fen);
+        {
+            ENGINE_STAT_TIMER(searchTimer, ctx.stats.search_ns);
+            Solver solver(ctx, (size_t)option_value("MateHash") << 20, (uint64_t)option_value("MateNodes") * 1000);
+            result.status = MateResult::Status::NoMate;
+            for (int n = 1; n <= maxMoves; ++n)
+            {
+                ctx.stats.depth = 2 * n - 1;
+                Solver::Value v = solver.mid(2 * n - 1, 0, kInfinite, kInfinite);
+                if (v.pn == 0)
+                {
+                    result.status = MateResult::Status::Mate;
+                    result.moves = n;
+                    result.pv = solver.pv(2 * n - 1);
+                    break;
+                }
+                if (v.dn != 0)
+                {
+                    result.status = MateResult::Status::Unknown;
+                    break;
+                }
+            }
+            result.nodes = solver.nodes;
+        }
+        end_search(ctx);
+        return result;
+    }
+} // namespace engine
@@ -0,0 +1,49 @@
+#pragma once
+#include "ChessEngine2.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    // Answer of a mate search for the side to move.
+    struct MateResult
+    {
+        enum class Status
+        {
+            Mate,   // a forced mate in `moves` moves, and none shorter
+            NoMate, // every line within the move limit was refuted
+            Unknown // the node budget ran out first
+        };
+        Status status = Status::Unknown;
+        int moves = 0;               // Mate only
+        std::vector<std::string> pv; // UCI, attacker's moves and the longest-resisting replies
+        uint64_t nodes = 0;
+    };
+
+    // ChessEngine2 with a df-pn (depth-first proof-number) mate solver in front of it. Proof-number
+    // search expands the node with the fewest moves left to prove or disprove the mate, so forcing
+    // lines (checks, few replies) are followed first and quiet side lines are left alone; alpha-beta
+    // at 2N-1 plies searches every line to the same depth. The solver keeps its own table of proof
+    // and disproof numbers, sized by MateHash and built per call, and stops at MateNodes nodes.
+    //
+    // choose_move plays a mate the solver proves within MateMoves moves and otherwise searches as
+    // ChessEngine2; root_search_scores and multipv are ChessEngine2's. A position repeated from the
+    // game history or the line counts as refuting the mate.
+    class MateEngine : public ChessEngine2
+    {
+    public:
+        // Adds the MateMoves, MateNodes and MateHash options.
+        MateEngine();
+
+        std::string choose_move(const std::string& fen, int depth) override;
+        // The solver is not suspended: the whole search runs in the first slice.
+        std::unique_ptr<SlicedSearch> start_search(const std::string& fen, int depth) override { return EngineBase::start_search(fen, depth); }
+        // Shortest forced mate for the side to move in at most maxMoves moves, found by proving mate
+        // in 1, 2, ... maxMoves in turn. Publishes its node count through last_search_stats.
+        MateResult solve_mate(const std::string& fen, int maxMoves);
+
+    private:
+        struct Solver;
+    };
+} // namespace engine
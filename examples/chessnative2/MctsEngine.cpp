@@ -0,0 +1,432 @@
+#include "MctsEngine.hpp"
+#include "Color.h"
+#include "EngineOptions.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace engine
+{
+    namespace
+    {
+        // Results are win probabilities in 1/kScale, fixed point so that playouts can sum them atomically.
+        const uint32_t kScale = 1u << 16;
+        const uint32_t kNone = 0xffffffffu;
+        // Centipawns per factor e between two children's priors.
+        const double kPolicyTemperature = 100.0;
+        // An unvisited child is taken to be this much worse than its parent's average.
+        const double kFirstPlayReduction = 0.1;
+
+        uint32_t win_probability(int cp)
+        {
+            cp = std::max(-4000, std::min(cp, 4000));
+            return (uint32_t)std::lround(kScale / (1.0 + std::pow(10.0, -cp / 400.0)));
+        }
+
+        int centipawns(double p)
+        {
+            p = std::max(1e-6, std::min(p, 1 - 1e-6));
+            return (int)std::lround(400.0 * std::log10(p / (1 - p)));
+        }
+    } // namespace
+
+    struct MctsEngine::Node
+    {
+        enum State : uint8_t { Fresh, Expanding, Expanded, Terminal };
+
+        Move move{}; // from the parent
+        float prior = 0;
+        // Written by the expanding thread before state turns Expanded or Terminal.
+        uint32_t first = kNone; // children are first .. first + count - 1
+        uint16_t count = 0;
+        uint32_t result = 0; // Terminal: the result for the side to move here
+        std::atomic<uint8_t> state{ Fresh };
+        std::atomic<uint32_t> visits{ 0 };
+        std::atomic<uint32_t> pending{ 0 }; // playouts below this node not yet backed up: the virtual losses
+        std::atomic<uint64_t> wins{ 0 };    // summed results for the side that played move
+
+        void reset(const Move& m, float p, uint32_t v = 0, uint64_t w = 0)
+        {
+            move = m;
+            prior = p;
+            first = kNone;
+            count = 0;
+            result = 0;
+            state.store(Fresh, std::memory_order_relaxed);
+            visits.store(v, std::memory_order_relaxed);
+            pending.store(0, std::memory_order_relaxed);
+            wins.store(w, std::memory_order_relaxed);
+        }
+    };
+
+    // Nodes handed out in runs from the front; a search never frees one, the next search starts over.
+    struct MctsEngine::Arena
+    {
+        std::unique_ptr<Node[]> nodes;
+        size_t capacity = 0;
+        std::atomic<size_t> used{ 0 };
+
+        // Empties the arena, growing it to at least n nodes.
+        void reset(size_t n)
+        {
+            if (capacity < n)
+            {
+                nodes.reset(new Node[n]);
+                capacity = n;
+            }
+            used.store(0, std::memory_order_relaxed);
+        }
+        // First of n consecutive nodes, or kNone once the arena is full.
+        uint32_t allocate(size_t n)
+        {
+            size_t at = used.fetch_add(n, std::memory_order_relaxed);
+            return at + n <= capacity ? (uint32_t)at : kNone;
+        }
+        Node& operator[](uint32_t i) { return nodes[i]; }
+    };
+
+    struct MctsEngine::Tree
+    {
+        Arena spaces[2];
+        int active = 0;
+        bool valid = false;
+        BoardState root;               // node 0 of the active arena
+        std::vector<uint64_t> history; // the game keys before it
+
+        Arena& nodes() { return spaces[active]; }
+
+        void clear(size_t capacity)
+        {
+            Arena& a = spaces[active];
+            a.reset(capacity);
+            a[a.allocate(1)].reset(Move{}, 1);
+        }
+
+        // The node, at most two plies below the root, reached by the moves that took the game from the
+        // root to position; kNone when there is none. A caller that keeps no game history (both
+        // searches without one) is taken to be playing on from the last root.
+        uint32_t find(const BoardState& position, const std::vector<uint64_t>& keys)
+        {
+            if (!valid) return kNone;
+            const uint64_t target = position.position_key();
+            auto reached = [&](const BoardState& b, const std::vector<uint64_t>& path) {
+                if (b.position_key() != target) return false;
+                if (keys.empty() && history.empty()) return true;
+                return keys.size() == history.size() + path.size() && std::equal(history.begin(), history.end(), keys.begin()) &&
+                       std::equal(path.begin(), path.end(), keys.begin() + history.size());
+            };
+            Context walk;
+            static_cast<BoardState&>(walk) = root;
+            std::vector<uint64_t> path;
+            if (reached(walk, path)) return 0;
+            Arena& a = spaces[active];
+            if (a[0].state.load(std::memory_order_relaxed) != Node::Expanded) return kNone;
+            path.push_back(walk.position_key());
+            Snapshot top = walk.snapshot();
+            for (uint32_t i = a[0].first; i < a[0].first + a[0].count; ++i)
+            {
+                walk.restore(top);
+                walk.makeMove(a[i].move);
+                if (reached(walk, path)) return i;
+                if (a[i].state.load(std::memory_order_relaxed) != Node::Expanded) continue;
+                path.push_back(walk.position_key());
+                Snapshot below = walk.snapshot();
+                for (uint32_t j = a[i].first; j < a[i].first + a[i].count; ++j)
+                {
+                    walk.restore(below);
+                    walk.makeMove(a[j].move);
+                    if (reached(walk, path)) return j;
+                }
+                path.pop_back();
+            }
+            return kNone;
+        }
+
+        // Copies the subtree at `from`, breadth first, into the other arena as its root and switches to
+        // that arena. Whatever does not fit stays unexpanded.
+        void promote(uint32_t from, size_t capacity)
+        {
+            Arena& src = spaces[active];
+            Arena& dst = spaces[active ^ 1];
+            dst.reset(capacity);
+            dst.allocate(1);
+            std::vector<std::pair<uint32_t, uint32_t>> queue(1, std::make_pair(from, 0u));
+            for (size_t q = 0; q < queue.size(); ++q)
+            {
+                Node& s = src[queue[q].first];
+                Node& d = dst[queue[q].second];
+                d.reset(s.move, s.prior, s.visits.load(std::memory_order_relaxed), s.wins.load(std::memory_order_relaxed));
+                uint8_t state = s.state.load(std::memory_order_relaxed);
+                if (state == Node::Terminal)
+                {
+                    d.result = s.result;
+                    d.state.store(Node::Terminal, std::memory_order_relaxed);
+                }
+                else if (state == Node::Expanded)
+                {
+                    uint32_t at = dst.allocate(s.count);
+                    if (at == kNone) continue;
+                    d.first = at;
+                    d.count = s.count;
+                    d.state.store(Node::Expanded, std::memory_order_relaxed);
+                    for (uint32_t k = 0; k < s.count; ++k) queue.emplace_back(s.first + k, at + k);
+                }
+            }
+            active ^= 1;
+        }
+    };
+
+    // What the threads of one choose_move share. Each thread has its own Context on the root position.
+    struct MctsEngine::Search
+    {
+        Arena& nodes;
+        double cpuct;
+        double virtual_loss;
+        int leaf_depth;
+        Snapshot root;
+        size_t root_keys; // ctx.keys at the root: the game history
+        std::atomic<int64_t> remaining{ 0 };
+
+        Search(Arena& a) : nodes(a) {}
+
+        void work(Context& ctx)
+        {
+            std::vector<uint32_t> path;
+            while (remaining.fetch_sub(1, std::memory_order_relaxed) > 0) playout(ctx, path);
+        }
+
+        void playout(Context& ctx, std::vector<uint32_t>& path)
+        {
+            ENGINE_STAT(++ctx.stats.playouts);
+            path.assign(1, 0);
+            uint32_t at = 0;
+            uint8_t state;
+            while ((state = nodes[at].state.load(std::memory_order_acquire)) == Node::Expanded)
+            {
+                at = select(nodes[at]);
+                nodes[at].pending.fetch_add(1, std::memory_order_relaxed);
+                ctx.keys.push_back(ctx.position_key());
+                ctx.makeMove(nodes[at].move);
+                path.push_back(at);
+            }
+
+            Node& leaf = nodes[at];
+            uint32_t result;
+            if (state == Node::Terminal) result = leaf.result;
+            else if (path.size() > 1 && ctx.cfg.draw_detection && (ctx.halfmove_clock >= 100 || ctx.isRepetition(ctx.position_key())))
+            {
+                result = kScale / 2;
+                if (claim(leaf))
+                {
+                    leaf.result = result;
+                    leaf.state.store(Node::Terminal, std::memory_order_release);
+                }
+            }
+            else result = expand(ctx, leaf, claim(leaf));
+
+            // Each node is credited from the side that moved into it, the opposite of the side to move there.
+            for (size_t i = path.size(); i-- > 0;)
+            {
+                Node& n = nodes[path[i]];
+                n.wins.fetch_add(kScale - result, std::memory_order_relaxed);
+                n.visits.fetch_add(1, std::memory_order_relaxed);
+                if (i) n.pending.fetch_sub(1, std::memory_order_relaxed);
+                result = kScale - result;
+            }
+            ctx.restore(root);
+            ctx.keys.resize(root_keys);
+        }
+
+        static bool claim(Node& n)
+        {
+            uint8_t fresh = Node::Fresh;
+            return n.state.compare_exchange_strong(fresh, Node::Expanding, std::memory_order_acquire);
+        }
+
+        // PUCT over the children; the playouts still below a child count as VirtualLoss lost visits each.
+        uint32_t select(Node& node)
+        {
+            uint32_t visits = node.visits.load(std::memory_order_relaxed);
+            double parent = visits ? 1.0 - (double)node.wins.load(std::memory_order_relaxed) / kScale / visits : 0.5;
+            double unvisited = std::max(0.0, parent - kFirstPlayReduction);
+            double explore = cpuct * std::sqrt((double)std::max(1u, visits + node.pending.load(std::memory_order_relaxed)));
+            uint32_t best = node.first;
+            double bestScore = -1;
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                Node& c = nodes[i];
+                double n = c.visits.load(std::memory_order_relaxed) + virtual_loss * c.pending.load(std::memory_order_relaxed);
+                double q = n > 0 ? (double)c.wins.load(std::memory_order_relaxed) / kScale / n : unvisited;
+                double score = q + explore * c.prior / (1 + n);
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = i;
+                }
+            }
+            return best;
+        }
+
+        // Scores the leaf's children and returns the leaf's value for its side to move. The owner (the
+        // thread that claimed the leaf) also adds the children to the tree; when the arena is full the
+        // leaf goes back to Fresh and stays a leaf.
+        uint32_t expand(Context& ctx, Node& leaf, bool owner)
+        {
+            ENGINE_STAT(ctx.stats.enter_node(0));
+            std::vector<Move> moves;
+            {
+                ENGINE_STAT_TIMER(genTimer, ctx.stats.movegen_ns);
+                ctx.generateLegalMoves(leaf_depth, moves);
+            }
+            if (moves.empty())
+            {
+                uint64_t king = ctx.pieces[(ctx.side_to_move == White ? 0 : 6) + 5];
+                uint32_t result = king && ctx.isSquareAttacked(Context::ctz64(king)) ? 0 : kScale / 2;
+                if (owner)
+                {
+                    leaf.result = result;
+                    leaf.state.store(Node::Terminal, std::memory_order_release);
+                }
+                return result;
+            }
+
+            std::vector<int> scores(moves.size());
+            int best = -INF;
+            ctx.keys.push_back(ctx.position_key());
+            for (size_t i = 0; i < moves.size(); ++i)
+            {
+                Snapshot save = ctx.snapshot();
+                ctx.makeMove(moves[i]);
+                int d = leaf_depth - 1;
+                scores[i] = -(ctx.side_to_move == White ? ctx.alphaBeta<White>(d, -INF, INF, d) : ctx.alphaBeta<Black>(d, -INF, INF, d));
+                ctx.restore(save);
+                best = std::max(best, scores[i]);
+            }
+            ctx.keys.pop_back();
+            if (!owner) return win_probability(best);
+
+            uint32_t first = nodes.allocate(moves.size());
+            if (first == kNone)
+            {
+                leaf.state.store(Node::Fresh, std::memory_order_release);
+                return win_probability(best);
+            }
+            double sum = 0;
+            for (int s : scores) sum += std::exp((s - best) / kPolicyTemperature);
+            for (size_t i = 0; i < moves.size(); ++i) nodes[first + (uint32_t)i].reset(moves[i], (float)(std::exp((scores[i] - best) / kPolicyTemperature) / sum));
+            leaf.first = first;
+            leaf.count = (uint16_t)moves.size();
+            leaf.state.store(Node::Expanded, std::memory_order_release);
+            return win_probability(best);
+        }
+    };
+
+    MctsEngine::MctsEngine()
+    {
+        add_option(EngineOption::spin("Threads", 1, 0, 256, "Threads running playouts on the one tree; 0 for one per CPU"));
+        add_option(EngineOption::spin("Playouts", 500, 1, 1000000, "Playouts per ply of requested depth"));
+        add_option(EngineOption::spin("CPuct", 150, 1, 1000, "PUCT exploration constant, in hundredths"));
+        add_option(EngineOption::spin("VirtualLoss", 3, 0, 100, "Lost visits a running playout adds to each node on its path"));
+        add_option(EngineOption::spin("LeafDepth", 1, 1, 8, "Depth of the alpha-beta search that scores a new node's children"));
+        add_option(EngineOption::spin("TreeMemory", 256, 1, 65536, "Limit of the two node arenas together, in MB"));
+    }
+
+    MctsEngine::~MctsEngine() = default;
+
+    void MctsEngine::new_game()
+    {
+        EngineBase::new_game();
+        std::lock_guard<std::mutex> lock(tree_mutex);
+        if (kept_tree) kept_tree->valid = false;
+    }
+
+    std::string MctsEngine::choose_move(const std::string& fen, int depth)
+    {
+        std::string stored;
+        if (recall_move(fen, depth, stored)) return stored;
+        Context ctx;
+        begin_search(ctx, depth);
+        ctx.loadFEN(fen);
+
+        const uint64_t budget = (uint64_t)option_value("Playouts") * std::max(depth, 1);
+        // About 40 children per expansion; the limit covers the worst case.
+        const size_t limit = std::max<size_t>(((size_t)option_value("TreeMemory") << 20) / (2 * sizeof(Node)), 256);
+        const size_t capacity = (size_t)std::min<uint64_t>(std::min<uint64_t>(limit, kNone), budget * 64 + 256);
+        std::unique_ptr<Tree> tree;
+        {
+            std::lock_guard<std::mutex> lock(tree_mutex);
+            tree = std::move(kept_tree);
+        }
+        if (!tree) tree.reset(new Tree());
+        uint32_t reuse = option_value("KeepAnalysis") ? tree->find(ctx, ctx.keys) : kNone;
+        if (reuse == kNone) tree->clear(capacity);
+        else tree->promote(reuse, capacity);
+
+        Search search(tree->nodes());
+        search.cpuct = option_value("CPuct") / 100.0;
+        search.virtual_loss = option_value("VirtualLoss");
+        search.leaf_depth = option_value("LeafDepth");
+        search.root = ctx.snapshot();
+        search.root_keys = ctx.keys.size();
+        Node& root = search.nodes[0];
+        {
+            ENGINE_STAT_TIMER(searchTimer, ctx.stats.search_ns);
+            // Leaf searches number their plies from the node being expanded.
+            ctx.root_depth = ctx.stats.depth = search.leaf_depth;
+            int threads = option_value("Threads");
+            if (threads == 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+            // A kept subtree's visits count towards the budget; the first playout expands the root.
+            uint64_t visits = root.visits.load(std::memory_order_relaxed);
+            search.remaining = (int64_t)std::max<uint64_t>(budget > visits ? budget - visits : 0, 1);
+            search.remaining.fetch_sub(1);
+            std::vector<uint32_t> path;
+            search.playout(ctx, path);
+            std::vector<Context> helpers(threads - 1, ctx);
+            std::vector<std::thread> pool;
+            for (Context& h : helpers)
+            {
+                h.stats.reset();
+                h.stats.depth = search.leaf_depth;
+                h.pin.reset();
+                h.pin_slot = -1;
+                pool.emplace_back([&search, &h] { search.work(h); });
+            }
+            search.work(ctx);
+            for (auto& t : pool) t.join();
+            for (const Context& h : helpers) ctx.stats.merge(h.stats);
+            ctx.stats.depth = depth;
+        }
+
+        Move best{};
+        uint32_t bestVisits = 0;
+        double bestValue = 0.5;
+        if (root.state.load(std::memory_order_acquire) == Node::Expanded)
+            for (uint32_t i = root.first; i < root.first + root.count; ++i)
+            {
+                Node& c = search.nodes[i];
+                uint32_t n = c.visits.load(std::memory_order_relaxed);
+                double value = n ? (double)c.wins.load(std::memory_order_relaxed) / kScale / n : 0;
+                if (i == root.first || n > bestVisits || (n == bestVisits && value > bestValue))
+                {
+                    best = c.move;
+                    bestVisits = n;
+                    bestValue = value;
+                }
+            }
+        bool played = root.state.load(std::memory_order_relaxed) == Node::Expanded;
+        end_search(ctx);
+
+        tree->root = ctx;
+        tree->history.assign(ctx.keys.begin(), ctx.keys.begin() + search.root_keys);
+        tree->valid = true;
+        {
+            std::lock_guard<std::mutex> lock(tree_mutex);
+            if (!kept_tree) kept_tree = std::move(tree);
+        }
+        if (played) record_move(fen, depth, centipawns(bestValue), Context::moveToUci(best));
+        return Context::moveToUci(best);
+    }
+} // namespace engine
@@ -0,0 +1,53 @@
+#pragma once
+#include "ChessEngine2.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace engine
+{
+    // Monte Carlo tree search on ChessEngine2's board. A playout descends from the root by PUCT,
+    //   Q(child) + CPuct * prior * sqrt(N(node)) / (1 + N(child)),
+    // expands the leaf it reaches and backs its value up the path. Expanding a node scores each child
+    // with a LeafDepth-ply alpha-beta search on Engine2's evaluation: the child scores give the priors
+    // (a softmax over centipawns) and the best of them, as a win probability, is the leaf's value.
+    // choose_move runs Playouts * depth playouts and plays the root move visited most.
+    //
+    // Threads playouts run at once on one tree without locks. A thread passing through a node adds a
+    // virtual loss to it (VirtualLoss lost visits each) until its result is backed up, which steers
+    // the others into different lines; the one thread that wins a node's expansion publishes its
+    // children with a release store, and any other thread arriving meanwhile evaluates the node as a
+    // leaf. Threads=1 is deterministic.
+    //
+    // The tree lives in an arena of fixed-size nodes, children of a node contiguous. When the next
+    // search starts from a position one or two plies below the last root, with the game history
+    // extended by those moves (or no history at either search), and KeepAnalysis is on, that subtree
+    // is copied into the second arena and its visits count towards the new budget; the rest is
+    // dropped wholesale. The arenas themselves are kept from move to move, new_game included, so
+    // nodes are recycled rather than allocated.
+    //
+    // root_search_scores and multipv are ChessEngine2's alpha-beta.
+    class MctsEngine : public ChessEngine2
+    {
+    public:
+        // Adds the Threads, Playouts, CPuct, VirtualLoss, LeafDepth and TreeMemory options.
+        MctsEngine();
+        ~MctsEngine() override;
+
+        std::string choose_move(const std::string& fen, int depth) override;
+        // Playouts are not suspended: the whole search runs in the first slice.
+        std::unique_ptr<SlicedSearch> start_search(const std::string& fen, int depth) override { return EngineBase::start_search(fen, depth); }
+        // Also drops the kept tree.
+        void new_game() override;
+
+    private:
+        struct Node;
+        struct Arena;
+        struct Tree;
+        struct Search;
+
+        // The last search's tree; a search takes it and puts it back, concurrent searches build their own.
+        std::mutex tree_mutex;
+        std::unique_ptr<Tree> kept_tree;
+    };
+} // namespace engine
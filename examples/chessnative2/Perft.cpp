@@ -0,0 +1,199 @@
+#include "Perft.h"
+#include "ChessEngine1.hpp"
+#include "ChessEngine2.hpp"
+#include "Color.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace engine
+{
+    namespace
+    {
+        // Shared subtree cache. Each slot holds (key ^ data, data) with data = count << 8 | depth, so a
+        // slot torn by two threads writing at once fails the key check instead of returning a wrong count
+        // (the lockless XOR scheme). Always-replace; perft trees revisit transpositions close together.
+        class PerftTable
+        {
+        public:
+            explicit PerftTable(size_t mb)
+            {
+                size_t n = 1;
+                while (n * 2 * sizeof(Slot) <= mb * 1024 * 1024) n *= 2;
+                slots.reset(new Slot[n]);
+                mask = n - 1;
+            }
+            bool probe(uint64_t key, int depth, uint64_t& count) const
+            {
+                const Slot& s = slots[key & mask];
+                uint64_t data = s.data.load(std::memory_order_relaxed);
+                if ((s.check.load(std::memory_order_relaxed) ^ data) != key || (int)(data & 0xFF) != depth) return false;
+                count = data >> 8;
+                return true;
+            }
+            void store(uint64_t key, int depth, uint64_t count)
+            {
+                Slot& s = slots[key & mask];
+                uint64_t data = (count << 8) | (uint64_t)depth;
+                s.data.store(data, std::memory_order_relaxed);
+                s.check.store(key ^ data, std::memory_order_relaxed);
+            }
+
+        private:
+            struct Slot { std::atomic<uint64_t> check{ 0 }; std::atomic<uint64_t> data{ 0 }; };
+            std::unique_ptr<Slot[]> slots;
+            size_t mask = 0;
+        };
+    } // namespace
+
+    struct PerftRunner
+    {
+        using Move2 = ChessEngine2::Move;
+
+        // One worker's state: its own engine copy and a move list per remaining depth.
+        struct Worker
+        {
+            ChessEngine2::Context eng;
+            std::vector<std::vector<Move2>> moves;
+            PerftTable* table = nullptr;
+            bool bulk = true;
+            uint64_t hits = 0;
+        };
+
+        template <int Us>
+        static uint64_t count(Worker& w, int depth)
+        {
+            if (depth == 0) return 1;
+            uint64_t key = 0, n = 0;
+            if (w.table && depth >= 2)
+            {
+                key = w.eng.position_key();
+                if (w.table->probe(key, depth, n)) { ++w.hits; return n; }
+            }
+            std::vector<Move2>& moves = w.moves[depth];
+            moves.clear();
+            w.eng.generateLegalMoves<Us>(depth, moves);
+            if (depth == 1 && w.bulk) return moves.size();
+            for (const Move2& m : moves)
+            {
+                ChessEngine2::Snapshot save = w.eng.snapshot();
+                w.eng.makeMove<Us>(m);
+                n += count<ColorTraits<Us>::them>(w, depth - 1);
+                w.eng.restore(save);
+            }
+            if (w.table && depth >= 2) w.table->store(key, depth, n);
+            return n;
+        }
+        static uint64_t count(Worker& w, int depth)
+        {
+            return w.eng.side_to_move == White ? count<White>(w, depth) : count<Black>(w, depth);
+        }
+
+        // Root split: workers take the next unclaimed root move until none are left.
+        static PerftResult run(const std::string& fen, int depth, const PerftOptions& opt, std::vector<std::pair<std::string, uint64_t>>* divide)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            PerftResult r;
+            ChessEngine2::Context root;
+            root.loadFEN(fen);
+            std::vector<Move2> rootMoves;
+            root.generateLegalMoves(depth, rootMoves);
+            std::vector<uint64_t> counts(rootMoves.size(), 0);
+            std::unique_ptr<PerftTable> table(opt.hash_mb ? new PerftTable(opt.hash_mb) : nullptr);
+            int nthreads = depth <= 1 ? 1 : std::max(1, std::min(opt.threads, (int)rootMoves.size()));
+            std::vector<Worker> workers(nthreads);
+            std::atomic<size_t> next{ 0 };
+            auto work = [&](Worker& w) {
+                ThreadPin pin(affinity_cpu(opt.affinity, (int)(&w - workers.data())));
+                for (size_t i; (i = next.fetch_add(1)) < rootMoves.size(); )
+                {
+                    if (depth <= 1) { counts[i] = 1; continue; }
+                    ChessEngine2::Snapshot save = w.eng.snapshot();
+                    w.eng.makeMove(rootMoves[i]);
+                    counts[i] = count(w, depth - 1);
+                    w.eng.restore(save);
+                }
+            };
+            for (Worker& w : workers)
+            {
+                w.eng = root;
+                w.moves.resize(depth + 1);
+                w.table = table.get();
+                w.bulk = opt.bulk;
+            }
+            if (depth > 0)
+            {
+                std::vector<std::thread> threads;
+                for (size_t t = 1; t < workers.size(); ++t) threads.emplace_back(work, std::ref(workers[t]));
+                work(workers[0]);
+                for (auto& th : threads) th.join();
+            }
+            r.nodes = depth == 0 ? 1 : 0;
+            for (size_t i = 0; i < rootMoves.size(); ++i)
+            {
+                r.nodes += counts[i];
+                if (divide) divide->emplace_back(root.moveToUci(rootMoves[i]), counts[i]);
+            }
+            for (const Worker& w : workers) r.hash_hits += w.hits;
+            r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            return r;
+        }
+
+        static uint64_t reference(const ChessEngine1::Position& pos, int depth)
+        {
+            if (depth == 0) return 1;
+            std::vector<ChessEngine1::Move> pseudo, legal;
+            ChessEngine1::generate_pseudo_moves(pos, pseudo);
+            ChessEngine1::filter_legal(pos, pseudo, legal);
+            if (depth == 1) return legal.size();
+            uint64_t n = 0;
+            for (const auto& m : legal)
+            {
+                ChessEngine1::Position next;
+                ChessEngine1::apply_move(pos, m, next);
+                n += reference(next, depth - 1);
+            }
+            return n;
+        }
+        static uint64_t reference(const std::string& fen, int depth)
+        {
+            ChessEngine1::Position pos;
+            if (!ChessEngine1::parse_fen(fen, pos)) return 0;
+            return reference(pos, depth);
+        }
+    };
+
+    PerftResult perft(const std::string& fen, int depth, const PerftOptions& opt)
+    {
+        return PerftRunner::run(fen, depth, opt, nullptr);
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> perft_divide(const std::string& fen, int depth, const PerftOptions& opt)
+    {
+        std::vector<std::pair<std::string, uint64_t>> out;
+        PerftRunner::run(fen, depth, opt, &out);
+        return out;
+    }
+
+    uint64_t perft_reference(const std::string& fen, int depth)
+    {
+        return PerftRunner::reference(fen, depth);
+    }
+
+    const std::vector<PerftCase>& perft_corpus()
+    {
+        static const std::vector<PerftCase> corpus = {
+            { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", { 20, 400, 8902, 197281, 4865609, 119060324 } },
+            { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", { 48, 2039, 97862, 4085603, 193690690, 0 } },
+            { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", { 14, 191, 2812, 43238, 674624, 11030083 } },
+            { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", { 6, 264, 9467, 422333, 15833292, 0 } },
+            { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", { 44, 1486, 62379, 2103487, 89941194, 0 } },
+            { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { 46, 2079, 89890, 3894594, 164075551, 0 } },
+            { "bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w HFhf - 2 9", { 21, 528, 12189, 326672, 8146062, 227689589 } },
+            { "2nnrbkr/p1qppppp/8/1ppb4/6PP/3PP3/PPP2P2/BQNNRBKR w HEhe - 1 9", { 21, 807, 18002, 667366, 16253601, 590751109 } },
+        };
+        return corpus;
+    }
+} // namespace engine
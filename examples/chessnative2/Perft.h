@@ -0,0 +1,43 @@
+#pragma once
+#include "Platform.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace engine
+{
+    // Perft: the number of leaf nodes of the legal move tree, the correctness gate for move generation.
+    // perft() runs on ChessEngine2's generator; perft_reference() walks ChessEngine1's generator with
+    // no cache or threads, so comparing the two checks one engine against the other.
+    struct PerftOptions
+    {
+        int threads = 1;      // root moves are shared out between this many workers
+        size_t hash_mb = 16;  // subtree count cache, keyed by Zobrist key and depth; 0 disables it
+        bool bulk = true;     // at the last ply count the legal moves instead of making them
+        Affinity affinity = Affinity::None; // worker t runs on affinity_cpu(affinity, t)
+    };
+
+    struct PerftResult
+    {
+        uint64_t nodes = 0;
+        uint64_t hash_hits = 0;
+        double seconds = 0;
+        double nps() const { return seconds > 0 ? double(nodes) / seconds : 0.0; }
+    };
+
+    PerftResult perft(const std::string& fen, int depth, const PerftOptions& opt = PerftOptions());
+    // Leaf count under each root move (UCI), in generation order; narrows down a mismatch.
+    std::vector<std::pair<std::string, uint64_t>> perft_divide(const std::string& fen, int depth, const PerftOptions& opt = PerftOptions());
+    uint64_t perft_reference(const std::string& fen, int depth);
+
+    // Positions with published perft counts (standard suite plus Chess960), shared by the tests and
+    // the PerftTool cross-check. nodes[d - 1] is the count at depth d, 0 where not listed.
+    struct PerftCase
+    {
+        const char* fen;
+        uint64_t nodes[6];
+    };
+    const std::vector<PerftCase>& perft_corpus();
+} // namespace engine
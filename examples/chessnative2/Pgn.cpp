@@ -0,0 +1,444 @@
+#include "Pgn.h"
+#include "ChessEngine2.hpp"
+#include "Castling.h"
+#include "SearchTables.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine
+{
+    namespace
+    {
+        const char* const kStandardStart = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+        bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+        bool line_starts_with(const char* p, const char* begin, char c) { return *p == c && (p == begin || p[-1] == '\n'); }
+    } // namespace
+
+    bool PgnText::operator==(const char* s) const
+    {
+        return std::strlen(s) == size && std::memcmp(data, s, size) == 0;
+    }
+
+    PgnText PgnGame::tag(const char* name) const
+    {
+        for (const auto& t : tags)
+            if (t.first == name) return t.second;
+        return PgnText();
+    }
+
+    // SAN in both directions on a ChessEngine2 context, plus the per-range game parser.
+    struct PgnCodec
+    {
+        using Ctx = ChessEngine2::Context;
+        using Move = ChessEngine2::Move;
+
+        static int uci_target(const Move& m) { return (m.is_castling && !is_standard_castle(m.from % 8, m.rook_from % 8)) ? m.rook_from : m.to; }
+        static uint16_t encode(const Move& m) { return encode_move(m.from, uci_target(m), m.prom_piece); }
+
+        // The FEN loader expects all six fields; PGN FEN tags sometimes stop after four.
+        static bool complete_fen(std::string& fen)
+        {
+            size_t fields = 0;
+            for (size_t i = 0; i < fen.size(); ++i)
+                if (!is_space(fen[i]) && (i == 0 || is_space(fen[i - 1]))) ++fields;
+            if (fields < 4 || fen.find('K') == std::string::npos || fen.find('k') == std::string::npos) return false;
+            if (fields == 4) fen += " 0 1";
+            else if (fields == 5) fen += " 1";
+            return true;
+        }
+
+        static bool load(Ctx& ctx, std::string fen)
+        {
+            if (!complete_fen(fen)) return false;
+            ctx.loadFEN(fen);
+            return true;
+        }
+
+        static std::string san(Ctx& ctx, const Move& m, const std::vector<Move>& legal)
+        {
+            std::string s;
+            int us = ctx.side_to_move;
+            if (m.is_castling) s = m.rook_from % 8 > m.from % 8 ? "O-O" : "O-O-O";
+            else
+            {
+                int piece = ctx.getPieceType(m.from, us);
+                bool capture = ctx.getPieceType(m.to, us ^ 1) >= 0 || (piece == 0 && m.to == ctx.ep_square);
+                if (piece == 0)
+                {
+                    if (capture) { s += char('a' + m.from % 8); s += 'x'; }
+                    s += Ctx::squareToAlg(m.to);
+                    if (m.prom_piece) { s += '='; s += "NBRQ"[m.prom_piece - 1]; }
+                }
+                else
+                {
+                    s += "PNBRQK"[piece];
+                    // Another piece of the same kind reaching the same square: file if that tells them
+                    // apart, else rank, else both.
+                    bool other = false, sameFile = false, sameRank = false;
+                    for (const Move& o : legal)
+                    {
+                        if (o.to != m.to || o.from == m.from || o.is_castling || ctx.getPieceType(o.from, us) != piece) continue;
+                        other = true;
+                        sameFile |= o.from % 8 == m.from % 8;
+                        sameRank |= o.from / 8 == m.from / 8;
+                    }
+                    if (other && (!sameFile || sameRank)) s += char('a' + m.from % 8);
+                    if (other && sameFile) s += char('1' + m.from / 8);
+                    if (capture) s += 'x';
+                    s += Ctx::squareToAlg(m.to);
+                }
+            }
+            ChessEngine2::Snapshot save = ctx.snapshot();
+            ctx.makeMove(m);
+            uint64_t king = ctx.pieces[6 * ctx.side_to_move + 5];
+            if (king && ctx.isSquareAttacked(Ctx::ctz64(king)))
+            {
+                std::vector<Move> replies;
+                ctx.generateLegalMoves(1, replies);
+                s += replies.empty() ? '#' : '+';
+            }
+            ctx.restore(save);
+            return s;
+        }
+
+        // Index into legal of the move san names, -1 if none or ambiguous.
+        static int parse_san(Ctx& ctx, const char* p, size_t n, const std::vector<Move>& legal)
+        {
+            while (n && std::strchr("+#!?", p[n - 1])) --n;
+            if (!n) return -1;
+            int castle = 0;
+            if (n == 3 && (std::memcmp(p, "O-O", 3) == 0 || std::memcmp(p, "0-0", 3) == 0)) castle = 1;
+            if (n == 5 && (std::memcmp(p, "O-O-O", 5) == 0 || std::memcmp(p, "0-0-0", 5) == 0)) castle = 2;
+            int us = ctx.side_to_move;
+            int found = -1;
+            if (castle)
+            {
+                for (size_t i = 0; i < legal.size(); ++i)
+                    if (legal[i].is_castling && (legal[i].rook_from % 8 > legal[i].from % 8) == (castle == 1)) { if (found >= 0) return -1; found = (int)i; }
+                return found;
+            }
+            int piece = 0;
+            if (std::strchr("NBRQK", p[0])) { piece = int(std::strchr("PNBRQK", p[0]) - "PNBRQK"); ++p; --n; }
+            int promo = 0;
+            if (n >= 2 && std::strchr("NBRQ", p[n - 1]) && (p[n - 2] == '=' || (p[n - 2] >= '1' && p[n - 2] <= '8')))
+            {
+                promo = int(std::strchr("NBRQ", p[n - 1]) - "NBRQ") + 1;
+                n -= p[n - 2] == '=' ? 2 : 1;
+            }
+            if (n < 2 || p[n - 2] < 'a' || p[n - 2] > 'h' || p[n - 1] < '1' || p[n - 1] > '8') return -1;
+            int to = (p[n - 2] - 'a') + 8 * (p[n - 1] - '1');
+            int fromFile = -1, fromRank = -1;
+            for (size_t i = 0; i + 2 < n; ++i)
+            {
+                if (p[i] >= 'a' && p[i] <= 'h') fromFile = p[i] - 'a';
+                else if (p[i] >= '1' && p[i] <= '8') fromRank = p[i] - '1';
+                else if (p[i] != 'x' && p[i] != '-' && p[i] != ':') return -1;
+            }
+            for (size_t i = 0; i < legal.size(); ++i)
+            {
+                const Move& m = legal[i];
+                if (m.is_castling || m.to != to || m.prom_piece != promo) continue;
+                if ((fromFile >= 0 && m.from % 8 != fromFile) || (fromRank >= 0 && m.from / 8 != fromRank)) continue;
+                if (ctx.getPieceType(m.from, us) != piece) continue;
+                if (found >= 0) return -1;
+                found = (int)i;
+            }
+            return found;
+        }
+
+        // Parses the games that start in [p, end) into game, calling fn after each. The last game may
+        // run past end: ranges are cut at game starts, so it ends before the next range begins.
+        static size_t parse_range(const char* begin, const char* p, const char* end, const char* limit, PgnGame& game, Ctx& ctx, std::vector<Move>& legal, const std::function<void(const PgnGame&)>& fn)
+        {
+            size_t games = 0;
+            while (true)
+            {
+                while (p < limit && is_space(*p)) ++p;
+                if (p >= end) break;
+                game.offset = size_t(p - begin);
+                game.tags.clear();
+                game.moves.clear();
+                game.result = PgnText();
+                game.error_ply = -1;
+                // Tag pairs: [Name "value"], one per line.
+                while (p < limit && *p == '[')
+                {
+                    const char* q = p + 1;
+                    while (q < limit && is_space(*q)) ++q;
+                    const char* name = q;
+                    while (q < limit && !is_space(*q) && *q != '"' && *q != ']') ++q;
+                    PgnText key{ name, size_t(q - name) };
+                    while (q < limit && *q != '"' && *q != ']' && *q != '\n') ++q;
+                    PgnText value;
+                    if (q < limit && *q == '"')
+                    {
+                        const char* v = ++q;
+                        while (q < limit && *q != '"' && *q != '\n') q += (*q == '\\' && q + 1 < limit) ? 2 : 1;
+                        value = PgnText{ v, size_t(q - v) };
+                    }
+                    game.tags.emplace_back(key, value);
+                    while (q < limit && *q != '\n') ++q;
+                    p = q;
+                    while (p < limit && is_space(*p)) ++p;
+                }
+                PgnText fenTag = game.tag("FEN");
+                if (fenTag.size) game.fen.assign(fenTag.data, fenTag.size);
+                else game.fen.assign(kStandardStart);
+                bool live = complete_fen(game.fen);
+                if (live) ctx.loadFEN(game.fen);
+                if (!live) game.error_ply = 0;
+                // Movetext up to the result, the next tag section or the end of the input.
+                int depth = 0;
+                while (p < limit)
+                {
+                    char c = *p;
+                    if (is_space(c)) { ++p; continue; }
+                    if (c == '{') { const char* q = (const char*)std::memchr(p, '}', size_t(limit - p)); p = q ? q + 1 : limit; continue; }
+                    if (c == ';' || (c == '%' && line_starts_with(p, begin, '%'))) { const char* q = (const char*)std::memchr(p, '\n', size_t(limit - p)); p = q ? q + 1 : limit; continue; }
+                    if (c == '(') { ++depth; ++p; continue; }
+                    if (c == ')') { if (depth) --depth; ++p; continue; }
+                    if (c == '[' && line_starts_with(p, begin, '[')) break;
+                    const char* t = p;
+                    while (p < limit && !is_space(*p) && !std::strchr("{}();[", *p)) ++p;
+                    if (p == t) { ++p; continue; }
+                    PgnText token{ t, size_t(p - t) };
+                    if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*")
+                    {
+                        if (depth) continue;
+                        game.result = token;
+                        break;
+                    }
+                    if (depth || *t == '$') continue;
+                    // Move numbers, also glued to the move ("12.e4", "12...Nf6"). Digits are a number only
+                    // when dots or the token's end follow them: "0-0" is castling.
+                    const char* digits = t;
+                    while (digits < p && *digits >= '0' && *digits <= '9') ++digits;
+                    if (digits == p || *digits == '.') t = digits;
+                    while (t < p && *t == '.') ++t;
+                    if (t == p || !live) continue;
+                    legal.clear();
+                    ctx.generateLegalMoves(1, legal);
+                    int i = parse_san(ctx, t, size_t(p - t), legal);
+                    if (i < 0)
+                    {
+                        game.error_ply = (int)game.moves.size();
+                        live = false;
+                        continue;
+                    }
+                    game.moves.push_back(encode(legal[i]));
+                    ctx.makeMove(legal[i]);
+                }
+                ++games;
+                fn(game);
+            }
+            return games;
+        }
+
+        // Runs the ranges [cuts[i], cuts[i + 1]) on n workers, each with its own game, board and move list.
+        static size_t run(const char* text, const char* end, const std::vector<const char*>& cuts, int n, const std::function<void(const PgnGame&)>& fn)
+        {
+            std::atomic<size_t> next{ 0 }, games{ 0 };
+            auto work = [&]() {
+                PgnGame game;
+                Ctx ctx;
+                std::vector<Move> legal;
+                for (size_t i; (i = next.fetch_add(1)) + 1 < cuts.size(); )
+                    games += parse_range(text, cuts[i], cuts[i + 1], end, game, ctx, legal, fn);
+            };
+            std::vector<std::thread> pool;
+            for (int t = 1; t < n; ++t) pool.emplace_back(work);
+            work();
+            for (auto& t : pool) t.join();
+            return games;
+        }
+
+        // The legal move a UCI string names; castling is also accepted king-takes-rook (e1h1).
+        static const Move* find_uci(const std::vector<Move>& legal, const std::string& uci)
+        {
+            if (uci.size() < 4) return nullptr;
+            int target = (uci[2] - 'a') + 8 * (uci[3] - '1');
+            for (const Move& m : legal)
+            {
+                std::string mv = Ctx::moveToUci(m);
+                if (mv == uci || (m.is_castling && uci.compare(0, 2, mv, 0, 2) == 0 && (target == m.to || target == m.rook_from))) return &m;
+            }
+            return nullptr;
+        }
+
+        static std::string to_san(const std::string& fen, const std::string& uci)
+        {
+            Ctx ctx;
+            if (!load(ctx, fen)) return {};
+            std::vector<Move> legal;
+            ctx.generateLegalMoves(1, legal);
+            const Move* m = find_uci(legal, uci);
+            return m ? san(ctx, *m, legal) : std::string();
+        }
+
+        static std::string from_san(const std::string& fen, const std::string& text)
+        {
+            Ctx ctx;
+            if (!load(ctx, fen)) return {};
+            std::vector<Move> legal;
+            ctx.generateLegalMoves(1, legal);
+            int i = parse_san(ctx, text.data(), text.size(), legal);
+            return i < 0 ? std::string() : Ctx::moveToUci(legal[i]);
+        }
+
+        // Movetext from the start position, stopping at the first move that is not legal.
+        static void movetext(const std::string& fen, const std::vector<std::string>& uci_moves, const std::function<void(const std::string&)>& word)
+        {
+            Ctx ctx;
+            load(ctx, fen);
+            std::vector<Move> legal;
+            for (size_t i = 0; i < uci_moves.size(); ++i)
+            {
+                legal.clear();
+                ctx.generateLegalMoves(1, legal);
+                const Move* m = find_uci(legal, uci_moves[i]);
+                if (!m) break;
+                if (ctx.side_to_move == 0) word(std::to_string(ctx.fullmove_number) + '.');
+                else if (i == 0) word(std::to_string(ctx.fullmove_number) + "...");
+                word(san(ctx, *m, legal));
+                ctx.makeMove(*m);
+            }
+        }
+    };
+
+    PgnReader::PgnReader(const char* t, size_t size) : text(t), length(size)
+    {
+    }
+
+    PgnReader::PgnReader(const std::string& path)
+    {
+#if defined(_WIN32)
+        HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size;
+        if (f == INVALID_HANDLE_VALUE || !GetFileSizeEx(f, &size)) { if (f != INVALID_HANDLE_VALUE) CloseHandle(f); failed = true; return; }
+        file = f;
+        length = (size_t)size.QuadPart;
+        if (!length) return;
+        HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m) { failed = true; return; }
+        mapping = m;
+        text = (const char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+        failed = text == nullptr;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) { if (fd >= 0) close(fd); failed = true; return; }
+        length = (size_t)st.st_size;
+        if (length)
+        {
+            void* m = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED) failed = true;
+            else
+            {
+                madvise(m, length, MADV_SEQUENTIAL);
+                text = (const char*)m;
+                mapping = m;
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    PgnReader::~PgnReader()
+    {
+#if defined(_WIN32)
+        if (text && mapping) UnmapViewOfFile(text);
+        if (mapping) CloseHandle((HANDLE)mapping);
+        if (file) CloseHandle((HANDLE)file);
+#else
+        if (mapping) munmap(mapping, length);
+#endif
+    }
+
+    size_t PgnReader::for_each(const std::function<void(const PgnGame&)>& fn, int threads) const
+    {
+        if (!text || !length) return 0;
+        const char* end = text + length;
+        // Cut points: aim for several ranges per thread so uneven games even out, then move each cut
+        // forward to the next game start, a '[' line that does not follow another tag line.
+        size_t ranges = threads > 1 ? size_t(threads) * 8 : 1;
+        std::vector<const char*> cuts(1, text);
+        for (size_t r = 1; r < ranges; ++r)
+        {
+            const char* p = std::max(cuts.back(), text + length / ranges * r);
+            while (p < end)
+            {
+                const char* nl = (const char*)std::memchr(p, '\n', size_t(end - p));
+                if (!nl || nl + 1 >= end) { p = end; break; }
+                p = nl + 1;
+                if (*p != '[') continue;
+                const char* prev = nl;
+                while (prev > text && (prev[-1] == '\r' || prev[-1] == ' ' || prev[-1] == '\t')) --prev;
+                const char* line = prev;
+                while (line > text && line[-1] != '\n') --line;
+                if (line == prev || *line != '[') break;
+            }
+            if (p >= end) break;
+            if (p > cuts.back()) cuts.push_back(p);
+        }
+        cuts.push_back(end);
+        return PgnCodec::run(text, end, cuts, std::max(1, std::min(threads, (int)cuts.size() - 1)), fn);
+    }
+
+    std::string move_uci(uint16_t move)
+    {
+        int from = move & 63, to = (move >> 6) & 63, promo = (move >> 12) & 7;
+        std::string s;
+        s += char('a' + from % 8); s += char('1' + from / 8); s += char('a' + to % 8); s += char('1' + to / 8);
+        if (promo >= 1 && promo <= 4) s += "nbrq"[promo - 1];
+        return s;
+    }
+
+    std::string to_san(const std::string& fen, const std::string& uci)
+    {
+        return PgnCodec::to_san(fen, uci);
+    }
+
+    std::string from_san(const std::string& fen, const std::string& san)
+    {
+        return PgnCodec::from_san(fen, san);
+    }
+
+    std::string write_pgn(const std::vector<std::pair<std::string, std::string>>& tags, const std::string& start_fen, const std::vector<std::string>& uci_moves, const std::string& result)
+    {
+        std::string out;
+        auto tag = [&](const std::string& name, const std::string& value) {
+            out += '[' + name + " \"";
+            for (char c : value) { if (c == '"' || c == '\\') out += '\\'; out += c; }
+            out += "\"]\n";
+        };
+        bool custom = !start_fen.empty() && start_fen != kStandardStart;
+        bool hasFen = false;
+        for (const auto& t : tags) { tag(t.first, t.second); hasFen |= t.first == "FEN"; }
+        if (custom && !hasFen) { tag("SetUp", "1"); tag("FEN", start_fen); }
+        if (!tags.empty() || custom) out += '\n';
+
+        size_t column = 0;
+        auto word = [&](const std::string& w) {
+            if (column && column + 1 + w.size() >= 80) { out += '\n'; column = 0; }
+            else if (column) { out += ' '; ++column; }
+            out += w;
+            column += w.size();
+        };
+        PgnCodec::movetext(custom ? start_fen : kStandardStart, uci_moves, word);
+        word(result.empty() ? "*" : result);
+        out += "\n\n";
+        return out;
+    }
+} // namespace engine
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace engine
+{
+    // PGN import and export on ChessEngine2's move generator. Moves are kept as encode_move()
+    // (SearchTables.h) of their UCI form, the 16-bit layout GameRecord uses as well.
+
+    // A slice of the input text; valid while the PgnReader that produced it is alive.
+    struct PgnText
+    {
+        const char* data = nullptr;
+        size_t size = 0;
+        std::string str() const { return std::string(data, size); }
+        bool operator==(const char* s) const;
+    };
+
+    // One parsed game. A worker reuses the same object for every game it reads, so the vectors keep
+    // their capacity and reading a game allocates nothing once they have grown.
+    struct PgnGame
+    {
+        size_t offset = 0;                              // byte offset of the game in the input
+        std::vector<std::pair<PgnText, PgnText>> tags;  // in file order, values still escaped
+        std::string fen;                                // the FEN tag (completed to six fields), else the standard start
+        std::vector<uint16_t> moves;                    // main line only; variations are skipped
+        PgnText result;                                 // "1-0", "0-1", "1/2-1/2", "*" or empty
+        int error_ply = -1;                             // ply of the first move that is not legal SAN; moves stop there
+        bool ok() const { return error_ply < 0; }
+        PgnText tag(const char* name) const;
+    };
+
+    // Reads a PGN file through a read-only memory mapping, so multi-gigabyte databases are never
+    // copied. for_each() cuts the text into ranges at game boundaries (a tag line after a line that
+    // is not one) and parses the ranges on worker threads.
+    class PgnReader
+    {
+    public:
+        explicit PgnReader(const std::string& path);
+        // Text already in memory (not copied; must outlive the reader).
+        PgnReader(const char* text, size_t size);
+        ~PgnReader();
+        PgnReader(const PgnReader&) = delete;
+        PgnReader& operator=(const PgnReader&) = delete;
+
+        bool is_open() const { return !failed; }
+        size_t size() const { return length; }
+
+        // Calls fn for every game and returns the number of games. With threads > 1, fn runs on the
+        // worker threads, concurrently for games of different ranges and in file order within one.
+        size_t for_each(const std::function<void(const PgnGame&)>& fn, int threads = 1) const;
+
+    private:
+        const char* text = nullptr;
+        size_t length = 0;
+        bool failed = false;
+        void* mapping = nullptr; // platform mapping handle(s); null for text handed in
+        void* file = nullptr;
+    };
+
+    // UCI text of an encode_move() value, as stored in PgnGame::moves.
+    std::string move_uci(uint16_t move);
+
+    // Standard algebraic notation of a legal UCI move: disambiguation by file, rank or both, 'x' on
+    // captures (en passant included), =Q style promotion, O-O / O-O-O (Chess960 too) and +/# from the
+    // position after the move. Empty if the move is not legal.
+    std::string to_san(const std::string& fen, const std::string& uci);
+    // The UCI move a SAN string names; tolerates check marks, annotations (!?), "0-0" and a missing '='.
+    // Empty if it names no legal move or more than one.
+    std::string from_san(const std::string& fen, const std::string& san);
+    // A complete game in export format: tag pairs (escaped here), movetext wrapped before 80 columns,
+    // the result. A FEN tag (and SetUp) is added when start_fen is not the standard start.
+    std::string write_pgn(const std::vector<std::pair<std::string, std::string>>& tags, const std::string& start_fen, const std::vector<std::string>& uci_moves, const std::string& result);
+} // namespace engine
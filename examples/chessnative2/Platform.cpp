@@ -0,0 +1,290 @@
+#include "Platform.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace engine
+{
+    namespace
+    {
+        const size_t kHugePage = 2 << 20;
+
+        size_t round_up(size_t n, size_t unit) { return (n + unit - 1) / unit * unit; }
+
+        // NUMA node ids with the allowed CPUs of each, in node order.
+        struct NodeLayout
+        {
+            std::vector<int> ids;
+            std::vector<std::vector<int>> cpus;
+        };
+
+#if defined(__linux__)
+        // "0-3,8,10-11" as in /sys/devices/system/node.
+        std::vector<int> parse_cpu_list(const std::string& text)
+        {
+            std::vector<int> out;
+            size_t i = 0;
+            while (i < text.size())
+            {
+                char* end = nullptr;
+                long a = std::strtol(text.c_str() + i, &end, 10);
+                if (end == text.c_str() + i) break;
+                long b = a;
+                i = end - text.c_str();
+                if (i < text.size() && text[i] == '-')
+                {
+                    b = std::strtol(text.c_str() + i + 1, &end, 10);
+                    i = end - text.c_str();
+                }
+                for (long c = a; c <= b; ++c) out.push_back((int)c);
+                if (i < text.size() && text[i] == ',') ++i;
+                else break;
+            }
+            return out;
+        }
+
+        std::string read_line(const std::string& path)
+        {
+            std::ifstream in(path);
+            std::string line;
+            std::getline(in, line);
+            return line;
+        }
+#endif
+
+        NodeLayout read_layout()
+        {
+            NodeLayout layout;
+            std::vector<int> allowed;
+#if defined(_WIN32)
+            DWORD_PTR process = 0, system = 0;
+            GetProcessAffinityMask(GetCurrentProcess(), &process, &system);
+            for (int c = 0; c < (int)sizeof(DWORD_PTR) * 8; ++c)
+                if (process >> c & 1) allowed.push_back(c);
+            ULONG highest = 0;
+            if (GetNumaHighestNodeNumber(&highest))
+                for (ULONG node = 0; node <= highest; ++node)
+                {
+                    ULONGLONG mask = 0;
+                    if (!GetNumaNodeProcessorMask((UCHAR)node, &mask)) continue;
+                    std::vector<int> cpus;
+                    for (int c : allowed)
+                        if (mask >> c & 1) cpus.push_back(c);
+                    layout.ids.push_back((int)node);
+                    layout.cpus.push_back(cpus);
+                }
+#elif defined(__linux__)
+            cpu_set_t set;
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+                for (int c = 0; c < CPU_SETSIZE; ++c)
+                    if (CPU_ISSET(c, &set)) allowed.push_back(c);
+            for (int node : parse_cpu_list(read_line("/sys/devices/system/node/online")))
+            {
+                std::vector<int> cpus;
+                for (int c : parse_cpu_list(read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+                    if (std::find(allowed.begin(), allowed.end(), c) != allowed.end()) cpus.push_back(c);
+                layout.ids.push_back(node);
+                layout.cpus.push_back(cpus);
+            }
+#endif
+            if (allowed.empty())
+                for (int c = 0; c < (int)std::max(1u, std::thread::hardware_concurrency()); ++c) allowed.push_back(c);
+            if (layout.ids.empty())
+            {
+                layout.ids.push_back(0);
+                layout.cpus.push_back(allowed);
+            }
+            return layout;
+        }
+
+        const NodeLayout& layout()
+        {
+            static const NodeLayout nodes = read_layout();
+            return nodes;
+        }
+
+#if defined(_WIN32)
+        // Large pages need SeLockMemoryPrivilege ("Lock pages in memory") held and enabled.
+        bool enable_lock_memory_privilege()
+        {
+            HANDLE token;
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+            TOKEN_PRIVILEGES tp = {};
+            tp.PrivilegeCount = 1;
+            tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid) &&
+                      AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+            CloseHandle(token);
+            return ok;
+        }
+#endif
+    } // namespace
+
+    LargeMemory::LargeMemory(size_t n, bool hugePages, bool interleave) : bytes(n)
+    {
+        if (!n) return;
+#if defined(_WIN32)
+        (void)interleave;
+        size_t large = GetLargePageMinimum();
+        if (hugePages && large && enable_lock_memory_privilege())
+        {
+            mapped = round_up(n, large);
+            base = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (base) kind = Pages::Huge;
+        }
+        if (!base)
+        {
+            mapped = n;
+            base = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        }
+        ptr = base;
+#elif defined(__linux__)
+        if (hugePages)
+        {
+            mapped = round_up(n, kHugePage);
+            base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base == MAP_FAILED) base = nullptr;
+            else
+            {
+                ptr = base;
+                kind = Pages::Huge;
+            }
+        }
+        if (!base)
+        {
+            // Without a huge page pool: ordinary pages from a 2 MB boundary, so the kernel can merge them.
+            mapped = round_up(n, kHugePage) + kHugePage;
+            base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED)
+                base = nullptr;
+            else
+            {
+                ptr = (char*)base + (kHugePage - (uintptr_t)base % kHugePage) % kHugePage;
+                if (hugePages && madvise(ptr, round_up(n, kHugePage), MADV_HUGEPAGE) == 0) kind = Pages::Transparent;
+            }
+        }
+#if defined(SYS_mbind)
+        const NodeLayout& nodes = layout();
+        if (ptr && interleave && nodes.ids.size() > 1)
+        {
+            const int kInterleave = 3; // MPOL_INTERLEAVE from <numaif.h>, which needs libnuma's headers
+            const int kBits = 8 * sizeof(unsigned long);
+            unsigned long mask[16] = {};
+            for (int id : nodes.ids)
+                if (id < 16 * kBits) mask[id / kBits] |= 1UL << (id % kBits);
+            spread = syscall(SYS_mbind, base, mapped, kInterleave, mask, 16 * kBits + 1, 0) == 0;
+        }
+#else
+        (void)interleave;
+#endif
+#else
+        (void)hugePages;
+        (void)interleave;
+        mapped = n + 4096;
+        base = std::calloc(mapped, 1);
+        ptr = base ? (char*)base + (4096 - (uintptr_t)base % 4096) % 4096 : nullptr;
+#endif
+        if (!ptr) bytes = 0;
+    }
+
+    LargeMemory::~LargeMemory()
+    {
+        if (!base) return;
+#if defined(_WIN32)
+        VirtualFree(base, 0, MEM_RELEASE);
+#elif defined(__linux__)
+        munmap(base, mapped);
+#else
+        std::free(base);
+#endif
+    }
+
+    const char* page_kind_name(LargeMemory::Pages pages)
+    {
+        switch (pages)
+        {
+        case LargeMemory::Pages::Huge: return "huge";
+        case LargeMemory::Pages::Transparent: return "transparent huge";
+        default: return "small";
+        }
+    }
+
+    const std::vector<std::vector<int>>& cpu_nodes()
+    {
+        return layout().cpus;
+    }
+
+    bool parse_affinity(const std::string& text, Affinity& out)
+    {
+        std::string t;
+        for (char c : text) t.push_back((char)std::tolower((unsigned char)c));
+        if (t == "none") out = Affinity::None;
+        else if (t == "compact") out = Affinity::Compact;
+        else if (t == "scatter") out = Affinity::Scatter;
+        else return false;
+        return true;
+    }
+
+    int affinity_cpu(Affinity policy, int slot)
+    {
+        const std::vector<std::vector<int>>& nodes = cpu_nodes();
+        std::vector<int> order;
+        if (policy == Affinity::Compact)
+            for (const auto& cpus : nodes) order.insert(order.end(), cpus.begin(), cpus.end());
+        else if (policy == Affinity::Scatter)
+        {
+            size_t widest = 0;
+            for (const auto& cpus : nodes) widest = std::max(widest, cpus.size());
+            for (size_t i = 0; i < widest; ++i)
+                for (const auto& cpus : nodes)
+                    if (i < cpus.size()) order.push_back(cpus[i]);
+        }
+        if (order.empty() || slot < 0) return -1;
+        return order[slot % order.size()];
+    }
+
+    ThreadPin::ThreadPin(int cpu)
+    {
+        if (cpu < 0) return;
+#if defined(_WIN32)
+        if (cpu >= (int)sizeof(DWORD_PTR) * 8) return;
+        DWORD_PTR old = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+        if (old) saved.assign((const unsigned char*)&old, (const unsigned char*)&old + sizeof(old));
+#elif defined(__linux__)
+        cpu_set_t old, set;
+        if (cpu >= CPU_SETSIZE || pthread_getaffinity_np(pthread_self(), sizeof(old), &old) != 0) return;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+            saved.assign((const unsigned char*)&old, (const unsigned char*)&old + sizeof(old));
+#endif
+    }
+
+    ThreadPin::~ThreadPin()
+    {
+        if (saved.empty()) return;
+#if defined(_WIN32)
+        DWORD_PTR old;
+        std::memcpy(&old, saved.data(), sizeof(old));
+        SetThreadAffinityMask(GetCurrentThread(), old);
+#elif defined(__linux__)
+        cpu_set_t old;
+        std::memcpy(&old, saved.data(), sizeof(old));
+        pthread_setaffinity_np(pthread_self(), sizeof(old), &old);
+#endif
+    }
+} // namespace engine
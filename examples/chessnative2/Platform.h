@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    // Operating-system services for multi-gigabyte tables and worker threads: large-page memory,
+    // the NUMA node layout and CPU affinity. Where a platform lacks one the call falls back
+    // (ordinary pages, a single node, no pinning) instead of failing.
+
+    // Zeroed, page-aligned memory straight from the OS. Random probes into a table of several
+    // gigabytes miss the TLB on nearly every access with 4 KB pages; 2 MB pages cut the page count
+    // by 512, so the page walks of a probe mostly hit the cache.
+    class LargeMemory
+    {
+    public:
+        enum class Pages { Small, Transparent, Huge }; // 4 KB; 2 MB merged by the kernel (Linux THP); 2 MB reserved
+
+        LargeMemory() = default;
+        // hugePages tries reserved 2 MB pages (MAP_HUGETLB, or MEM_LARGE_PAGES on Windows), then on
+        // Linux ordinary memory marked for transparent huge pages. interleave spreads the pages
+        // round-robin over the NUMA nodes before they are touched (Linux only, ignored elsewhere).
+        LargeMemory(size_t bytes, bool hugePages, bool interleave);
+        ~LargeMemory();
+        LargeMemory(const LargeMemory&) = delete;
+        LargeMemory& operator=(const LargeMemory&) = delete;
+
+        void* data() const { return ptr; }
+        size_t size() const { return bytes; }
+        Pages pages() const { return kind; }
+        bool interleaved() const { return spread; }
+
+    private:
+        void* ptr = nullptr;
+        void* base = nullptr; // what was obtained from the OS (ptr may sit above it for alignment)
+        size_t bytes = 0;
+        size_t mapped = 0;    // length of the block at base
+        Pages kind = Pages::Small;
+        bool spread = false;
+    };
+
+    const char* page_kind_name(LargeMemory::Pages pages);
+
+    // The CPUs this process may run on, grouped by NUMA node; a single group where the layout is unknown.
+    const std::vector<std::vector<int>>& cpu_nodes();
+
+    // How worker threads are placed. Compact fills one node's CPUs before moving to the next, keeping
+    // threads near each other's caches; Scatter takes the nodes in turn, sharing out memory bandwidth.
+    enum class Affinity { None, Compact, Scatter };
+
+    // Case-insensitive "none", "compact" or "scatter"; false for anything else.
+    bool parse_affinity(const std::string& text, Affinity& out);
+    // The CPU for the slot-th pinned thread under policy (slots wrap around the CPUs), -1 for None.
+    int affinity_cpu(Affinity policy, int slot);
+
+    // Pins the calling thread to one CPU while alive, then gives the thread back its previous mask.
+    // Nothing happens for cpu < 0 or where the platform cannot pin.
+    class ThreadPin
+    {
+    public:
+        explicit ThreadPin(int cpu);
+        ~ThreadPin();
+        ThreadPin(const ThreadPin&) = delete;
+        ThreadPin& operator=(const ThreadPin&) = delete;
+
+        bool pinned() const { return !saved.empty(); }
+
+    private:
+        std::vector<unsigned char> saved; // the previous affinity mask in the platform's form
+    };
+} // namespace engine
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+
+// Search instrumentation. Counters and timers are compiled in by default;
+// define ENGINE_NO_SEARCH_STATS for release builds that must not pay for them.
+// The SearchStats struct itself always exists so callers (GUI, tools) build
+// either way - it simply stays zeroed when stats are compiled out.
+#if defined(ENGINE_NO_SEARCH_STATS)
+#define ENGINE_SEARCH_STATS 0
+#else
+#define ENGINE_SEARCH_STATS 1
+#endif
+
+#if ENGINE_SEARCH_STATS
+#define ENGINE_STAT(expr) do { expr; } while (0)
+#define ENGINE_STAT_TIMER(var, counter) ::engine::StatTimer var(counter)
+#else
+#define ENGINE_STAT(expr) do { } while (0)
+#define ENGINE_STAT_TIMER(var, counter) do { } while (0)
+#endif
+
+namespace engine
+{
+    struct SearchStats
+    {
+        enum { kMaxPly = 64, kCutoffSlots = 8 };
+
+        uint64_t nodes = 0;      // nodes entered by the main search (root included)
+        uint64_t qnodes = 0;     // quiescence nodes
+        uint64_t tt_probes = 0;
+        uint64_t tt_hits = 0;
+        uint64_t tt_cutoffs = 0;
+        uint64_t pawn_probes = 0; // pawn-structure cache (ChessEngine1's PawnHash option)
+        uint64_t pawn_hits = 0;
+        uint64_t eval_probes = 0; // full-evaluation cache (EvalCache option)
+        uint64_t eval_hits = 0;
+        uint64_t draw_cutoffs = 0; // repetition / fifty-move draws returned without searching
+        uint64_t beta_cutoffs = 0;
+        uint64_t playouts = 0;     // Monte Carlo tree search (MctsEngine): descents from the root
+        // Index of the move that failed high; the last slot collects everything later.
+        uint64_t cutoff_at[kCutoffSlots] = {};
+        uint64_t movegen_ns = 0; // pseudo-legal generation + legality filtering
+        uint64_t eval_ns = 0;
+        uint64_t search_ns = 0;  // wall time of the whole search call
+        // Nodes entered at each ply from the root; ratios give the branching factor.
+        uint64_t nodes_at_ply[kMaxPly] = {};
+        int depth = 0;
+
+        void reset() { *this = SearchStats(); }
+        void enter_node(int ply)
+        {
+            ++nodes;
+            ++nodes_at_ply[ply < kMaxPly ? ply : kMaxPly - 1];
+        }
+        // Adds the counters of another thread working on the same search; depth and search_ns describe
+        // the search as a whole and are left alone.
+        void merge(const SearchStats& o)
+        {
+            nodes += o.nodes; qnodes += o.qnodes;
+            tt_probes += o.tt_probes; tt_hits += o.tt_hits; tt_cutoffs += o.tt_cutoffs;
+            pawn_probes += o.pawn_probes; pawn_hits += o.pawn_hits; eval_probes += o.eval_probes; eval_hits += o.eval_hits;
+            draw_cutoffs += o.draw_cutoffs; beta_cutoffs += o.beta_cutoffs; playouts += o.playouts;
+            for (int i = 0; i < kCutoffSlots; ++i) cutoff_at[i] += o.cutoff_at[i];
+            movegen_ns += o.movegen_ns; eval_ns += o.eval_ns;
+            for (int i = 0; i < kMaxPly; ++i) nodes_at_ply[i] += o.nodes_at_ply[i];
+        }
+        void record_cutoff(int moveIndex)
+        {
+            ++beta_cutoffs;
+            ++cutoff_at[moveIndex < kCutoffSlots ? moveIndex : kCutoffSlots - 1];
+        }
+        double first_move_cutoff_rate() const { return beta_cutoffs ? double(cutoff_at[0]) / double(beta_cutoffs) : 0.0; }
+        double tt_hit_rate() const { return tt_probes ? double(tt_hits) / double(tt_probes) : 0.0; }
+        double pawn_hit_rate() const { return pawn_probes ? double(pawn_hits) / double(pawn_probes) : 0.0; }
+        double eval_hit_rate() const { return eval_probes ? double(eval_hits) / double(eval_probes) : 0.0; }
+        // Effective branching factor between ply and ply+1 (0 when ply+1 was never reached).
+        double branching_factor(int ply) const
+        {
+            if (ply < 0 || ply + 1 >= kMaxPly || !nodes_at_ply[ply]) return 0.0;
+            return double(nodes_at_ply[ply + 1]) / double(nodes_at_ply[ply]);
+        }
+        double nps() const { return search_ns ? double(nodes + qnodes) * 1e9 / double(search_ns) : 0.0; }
+    };
+
+    // Adds the lifetime of the scope to a nanosecond counter.
+    class StatTimer
+    {
+    public:
+        explicit StatTimer(uint64_t& counter) : target(counter), start(std::chrono::steady_clock::now()) {}
+        ~StatTimer() { target += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(); }
+        StatTimer(const StatTimer&) = delete;
+        StatTimer& operator=(const StatTimer&) = delete;
+
+    private:
+        uint64_t& target;
+        std::chrono::steady_clock::time_point start;
+    };
+} // namespace engine
@@ -0,0 +1,141 @@
+#include "SearchTables.h"
+#include <algorithm>
+#include <new>
+#include <thread>
+
+namespace engine
+{
+    // Largest power of two of entries of this size that fits in kb kilobytes (at least one).
+    static size_t entries_for(size_t kb, size_t entrySize)
+    {
+        size_t n = 1;
+        while (n * 2 * entrySize <= kb * 1024) n *= 2;
+        return n;
+    }
+
+    PawnHashTable::PawnHashTable(size_t kb) : entries(entries_for(kb, sizeof(PawnEntry))), kilobytes(kb)
+    {
+        mask = entries.size() - 1;
+    }
+
+    EvalCache::EvalCache(size_t kb) : entries(entries_for(kb, sizeof(uint64_t))), kilobytes(kb)
+    {
+        mask = entries.size() - 1;
+    }
+
+    // data layout: score (32, two's complement) | move << 32 | depth << 48 | bound << 56 | generation << 58
+    uint64_t TranspositionTable::pack(int depth, int score, Bound bound, uint16_t move, uint8_t gen)
+    {
+        return (uint64_t)(uint32_t)score | ((uint64_t)move << 32) | ((uint64_t)(uint8_t)depth << 48) | ((uint64_t)bound << 56) | ((uint64_t)gen << 58);
+    }
+
+    template<class Fn>
+    void TranspositionTable::for_bucket_ranges(Fn fn)
+    {
+        size_t n = mask + 1;
+        size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), megabytes / 64));
+        if (threads == 1) { fn(0, n); return; }
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < threads; ++t) pool.emplace_back(fn, n * t / threads, n * (t + 1) / threads);
+        for (auto& th : pool) th.join();
+    }
+
+    TranspositionTable::TranspositionTable(size_t mb, bool hugePages, bool interleave)
+        : memory(entries_for(mb * 1024, sizeof(Bucket)) * sizeof(Bucket), hugePages, interleave), megabytes(mb), huge_requested(hugePages),
+          interleave_requested(interleave)
+    {
+        if (!memory.data()) throw std::bad_alloc();
+        buckets = static_cast<Bucket*>(memory.data()); // page-aligned, so every bucket fills one cache line
+        mask = memory.size() / sizeof(Bucket) - 1;
+        for_bucket_ranges([this](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) new (&buckets[i]) Bucket();
+        });
+    }
+
+    void TranspositionTable::clear()
+    {
+        for_bucket_ranges([this](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+                for (Slot& s : buckets[i].slots) { s.check.store(0, std::memory_order_relaxed); s.data.store(0, std::memory_order_relaxed); }
+        });
+        generation.store(0, std::memory_order_relaxed);
+    }
+
+    int TranspositionTable::age_of(uint64_t data) const
+    {
+        return (generation.load(std::memory_order_relaxed) - (int)(data >> 58)) & kGenerationMask;
+    }
+
+    bool TranspositionTable::probe(uint64_t key, TTEntry& out)
+    {
+        Bucket& b = buckets[key & mask];
+        for (Slot& s : b.slots)
+        {
+            uint64_t data = s.data.load(std::memory_order_relaxed);
+            if ((s.check.load(std::memory_order_relaxed) ^ data) != key || !data) continue;
+            out.score = (int32_t)(uint32_t)data;
+            out.move = (uint16_t)(data >> 32);
+            out.depth = (int)(uint8_t)(data >> 48);
+            out.bound = (Bound)((data >> 56) & 3);
+            if (age_of(data))
+            {
+                // Touch: the entry is in use again, so it ranks as written by this search.
+                uint64_t fresh = pack(out.depth, out.score, out.bound, out.move, generation.load(std::memory_order_relaxed));
+                s.data.store(fresh, std::memory_order_relaxed);
+                s.check.store(key ^ fresh, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void TranspositionTable::store(uint64_t key, int depth, int score, Bound bound, uint16_t move)
+    {
+        Bucket& b = buckets[key & mask];
+        Slot* victim = &b.slots[0];
+        int victimWorth = 1 << 30;
+        for (Slot& s : b.slots)
+        {
+            uint64_t data = s.data.load(std::memory_order_relaxed);
+            if ((s.check.load(std::memory_order_relaxed) ^ data) == key && data)
+            {
+                // Same position: the newest result replaces it (search only takes cutoffs from an entry
+                // of its own depth), keeping the old move if the new result has none.
+                if (!move) move = (uint16_t)(data >> 32);
+                victim = &s;
+                break;
+            }
+            int worth = data ? (int)(uint8_t)(data >> 48) - 8 * age_of(data) : -(1 << 30);
+            if (worth < victimWorth) { victimWorth = worth; victim = &s; }
+        }
+        uint64_t data = pack(depth, score, bound, move, generation.load(std::memory_order_relaxed));
+        victim->data.store(data, std::memory_order_relaxed);
+        victim->check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    void PvTable::update(int h, uint16_t move)
+    {
+        if ((unsigned)h >= kMaxHeight) return;
+        int n = h + 1 < kMaxHeight ? std::min(length[h + 1], kMaxHeight - 1) : 0;
+        moves[h][0] = move;
+        std::copy(moves[h + 1], moves[h + 1] + n, moves[h] + 1);
+        length[h] = n + 1;
+    }
+
+    void HistoryTable::reward(int side, int from, int to, int depth)
+    {
+        int& s = scores[(side * 64 + from) * 64 + to];
+        s += depth * depth;
+        if (s > kMax) age();
+    }
+
+    void HistoryTable::age()
+    {
+        for (int& s : scores) s /= 2;
+    }
+
+    void HistoryTable::clear()
+    {
+        std::fill(scores.begin(), scores.end(), 0);
+    }
+} // namespace engine
@@ -0,0 +1,154 @@
+#pragma once
+#include "Platform.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Search memory an engine keeps between calls: the transposition table and the history heuristic.
+// Both survive from one search to the next in the same game and are cleared by EngineBase::new_game().
+namespace engine
+{
+    enum class Bound : uint8_t { None, Upper, Lower, Exact };
+
+    struct TTEntry
+    {
+        int score = 0;
+        uint16_t move = 0; // engine-specific encoding, 0 = none (see encode_move)
+        int depth = 0;
+        Bound bound = Bound::None;
+    };
+
+    // from | to << 6 | promotion << 12, promotion 0 = none, 1..4 = n b r q. Never 0 for a real move
+    // because from != to.
+    inline uint16_t encode_move(int from, int to, int promotion) { return (uint16_t)(from | (to << 6) | (promotion << 12)); }
+
+    // Shared by all searches running on one engine, so entries are written lock-free: each slot holds
+    // (key ^ data, data) and a slot torn by two writers fails the key check on probe. Buckets of four
+    // slots fill one cache line. Within a bucket, a new position evicts the slot with the least depth, counting every
+    // search since the slot was last used as eight plies lost; a probe hit refreshes the slot's age, so
+    // entries still being reached across moves stay while the rest age out (an approximate LRU).
+    // The table sits in LargeMemory (2 MB pages where the OS grants them, optionally interleaved over
+    // the NUMA nodes), and tables from 64 MB up are written through by several threads when they are
+    // built or cleared, so the page faults are taken in parallel before the search starts.
+    class TranspositionTable
+    {
+    public:
+        explicit TranspositionTable(size_t mb, bool hugePages = true, bool interleave = false);
+
+        size_t size_mb() const { return megabytes; }
+        // True if the table was built with these settings (so it need not be rebuilt).
+        bool built_for(size_t mb, bool hugePages, bool interleave) const { return mb == megabytes && hugePages == huge_requested && interleave == interleave_requested; }
+        LargeMemory::Pages pages() const { return memory.pages(); }
+        bool interleaved() const { return memory.interleaved(); }
+        // Starts a search: entries written before now count as one search older.
+        void new_search() { generation.store((uint8_t)((generation.load(std::memory_order_relaxed) + 1) & kGenerationMask), std::memory_order_relaxed); }
+        void clear();
+
+        bool probe(uint64_t key, TTEntry& out);
+        void store(uint64_t key, int depth, int score, Bound bound, uint16_t move);
+
+    private:
+        static constexpr uint8_t kGenerationMask = 0x3F;
+        struct Slot { std::atomic<uint64_t> check{ 0 }; std::atomic<uint64_t> data{ 0 }; };
+        struct alignas(64) Bucket { Slot slots[4]; };
+
+        LargeMemory memory;
+        Bucket* buckets = nullptr;
+        size_t mask = 0;
+        size_t megabytes = 0;
+        bool huge_requested = true;
+        bool interleave_requested = false;
+        std::atomic<uint8_t> generation{ 0 };
+
+        static uint64_t pack(int depth, int score, Bound bound, uint16_t move, uint8_t gen);
+        // Runs fn(first, last) over bucket ranges on enough threads to write the table quickly.
+        template<class Fn> void for_bucket_ranges(Fn fn);
+        int age_of(uint64_t data) const;
+    };
+
+    // Triangular principal-variation table in encode_move() form: line(h) is the best line found so
+    // far from height h (plies from the root) of the current search. A node clears its line when it is
+    // entered and, when a move raises alpha, sets it to that move followed by the line its child left.
+    class PvTable
+    {
+    public:
+        enum { kMaxHeight = 64 };
+        void clear(int h) { if ((unsigned)h < kMaxHeight) length[h] = 0; }
+        void update(int h, uint16_t move);
+        int size(int h) const { return (unsigned)h < kMaxHeight ? length[h] : 0; }
+        const uint16_t* line(int h) const { return moves[h]; }
+
+    private:
+        uint16_t moves[kMaxHeight][kMaxHeight];
+        int length[kMaxHeight] = {};
+    };
+
+    // Pawn-structure cache, keyed by the Zobrist key of the pawns alone. Pawns move in few of the
+    // moves searched, so nearly every probe hits and the structure is analysed once per pawn
+    // configuration instead of at every leaf. The engine fills the slot on a miss. A zeroed slot is
+    // the correct entry for a board without pawns, whose pawn key is 0.
+    struct PawnEntry
+    {
+        uint64_t key = 0;
+        uint64_t passed[2] = {};   // white, black: no enemy pawn ahead on its own or an adjacent file
+        uint64_t isolated[2] = {}; // no pawn of its side on an adjacent file
+        uint64_t doubled[2] = {};  // a pawn of its side further ahead on the same file
+        int score = 0;             // white's view
+    };
+
+    class PawnHashTable
+    {
+    public:
+        explicit PawnHashTable(size_t kb);
+        size_t size_kb() const { return kilobytes; }
+        // A hit when the slot's key matches, else the caller overwrites it.
+        PawnEntry& slot(uint64_t key) { return entries[key & mask]; }
+
+    private:
+        std::vector<PawnEntry> entries;
+        size_t mask = 0;
+        size_t kilobytes = 0;
+    };
+
+    // Full-evaluation cache: a word per position, the score beside the key's upper 32 bits. The
+    // stored check always has its low bit set, so an empty (zero) slot never matches.
+    class EvalCache
+    {
+    public:
+        explicit EvalCache(size_t kb);
+        size_t size_kb() const { return kilobytes; }
+        bool probe(uint64_t key, int& score) const
+        {
+            uint64_t e = entries[key & mask];
+            if ((uint32_t)(e >> 32) != check_of(key)) return false;
+            score = (int)(int32_t)(uint32_t)e;
+            return true;
+        }
+        void store(uint64_t key, int score) { entries[key & mask] = ((uint64_t)check_of(key) << 32) | (uint32_t)score; }
+
+    private:
+        static uint32_t check_of(uint64_t key) { return (uint32_t)(key >> 32) | 1; }
+        std::vector<uint64_t> entries;
+        size_t mask = 0;
+        size_t kilobytes = 0;
+    };
+
+    // Butterfly history: how often a quiet move (side, from, to) caused a beta cutoff, weighted by
+    // depth squared. Each search works on its own copy; the engine keeps the copy of the last search
+    // to finish and halves it when the next one starts, so old results fade.
+    class HistoryTable
+    {
+    public:
+        HistoryTable() : scores(2 * 64 * 64, 0) {}
+        int get(int side, int from, int to) const { return scores[(side * 64 + from) * 64 + to]; }
+        void reward(int side, int from, int to, int depth);
+        void age();
+        void clear();
+
+    private:
+        static constexpr int kMax = 1 << 20;
+        std::vector<int> scores;
+    };
+} // namespace engine
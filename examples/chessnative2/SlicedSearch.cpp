@@ -0,0 +1,261 @@
+#include "ChessEngine2.hpp"
+#include "Color.h"
+#include <algorithm>
+#include <chrono>
+
+namespace engine
+{
+    namespace
+    {
+        // Nodes between clock reads when a slice has a time budget.
+        const uint64_t kClockInterval = 64;
+    } // namespace
+
+    // Context::rootScores and alphaBeta turned inside out: each node that has children is a Frame on
+    // an explicit stack, the root at the bottom, so a slice can stop between any two nodes and the
+    // next one carries on from the same board. Node for node the same search as the recursion, with
+    // the frontier's batched leaves scored one at a time, so it finds the same scores and move.
+    struct ChessEngine2::Slicer : SlicedSearch
+    {
+        enum class Phase { Root, Singular, Search };
+        struct Frame
+        {
+            Phase phase;
+            int depth, alpha, beta, ply; // alphaBeta's arguments
+            int alpha_in, best = -1, height;
+            uint64_t key;
+            uint16_t tt_move = 0;
+            bool singular = false;
+            int bound = 0; // Singular: the score the other moves must not reach
+            std::vector<Move> moves;
+            size_t next = 0;
+            // The child being searched, undone when its score comes back.
+            Snapshot save;
+            int ext = 0, saved_recapture = -1;
+            bool quiet = false;
+        };
+
+        ChessEngine2& engine;
+        std::string fen;
+        int depth;
+        Context ctx;
+        std::vector<Frame> stack;
+        std::vector<std::pair<Move, int>> root;
+        uint64_t nodes = 0;
+
+        Slicer(ChessEngine2& e, const std::string& position, int d) : engine(e), fen(position), depth(d)
+        {
+            if (engine.recall_move(fen, depth, move)) { done = true; return; }
+            engine.begin_search(ctx, depth);
+            ctx.loadFEN(fen);
+            ENGINE_STAT(ctx.stats.enter_node(0));
+            ctx.keys.push_back(ctx.position_key());
+            ctx.root_depth = depth;
+            Frame f;
+            f.phase = Phase::Root;
+            f.depth = depth;
+            f.alpha = -INF; f.beta = INF; f.ply = depth;
+            f.alpha_in = -INF; f.height = 0; f.key = 0;
+            ctx.generateLegalMoves(depth, f.moves);
+            stack.push_back(std::move(f));
+        }
+
+        // An abandoned search still hands its tables back.
+        ~Slicer() override
+        {
+            if (!done) engine.end_search(ctx);
+        }
+
+        bool advance(uint64_t max_nodes, uint64_t max_us) override
+        {
+            if (done) return true;
+            ENGINE_STAT_TIMER(searchTimer, ctx.stats.search_ns);
+            auto start = std::chrono::steady_clock::now();
+            uint64_t first = nodes;
+            while (!stack.empty())
+            {
+                uint64_t spent = nodes - first;
+                if (spent && max_nodes && spent >= max_nodes) return false;
+                if (spent && max_us && spent % kClockInterval == 0 &&
+                    (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() >= max_us)
+                    return false;
+                step();
+            }
+            finish();
+            return true;
+        }
+
+        // Starts the next child of the top frame, or closes the frame when it has none left.
+        void step()
+        {
+            size_t top = stack.size() - 1;
+            Frame& f = stack[top];
+            if (f.phase == Phase::Singular && f.next < f.moves.size() && Context::ttMove(f.moves[f.next]) == f.tt_move) ++f.next;
+            if (f.next == f.moves.size())
+            {
+                if (f.phase == Phase::Singular)
+                {
+                    // No other move reached the bound: the table move is singular.
+                    f.singular = true;
+                    f.phase = Phase::Search;
+                    f.next = 0;
+                    return;
+                }
+                close();
+                return;
+            }
+            const Move& m = f.moves[f.next];
+            f.quiet = ctx.isQuiet(m);
+            int captured = ctx.capturedSquare(m);
+            f.save = ctx.snapshot();
+            ctx.makeMove(m);
+            int ext = f.phase == Phase::Singular ? 0 : ctx.extension(captured, f.singular && Context::ttMove(m) == f.tt_move);
+            // Windows as searchRoot, isSingular and alphaBeta pass them to searchChild.
+            int d, alpha, beta;
+            if (f.phase == Phase::Root) { d = f.depth - 1 + ext; alpha = -INF; beta = INF; }
+            else if (f.phase == Phase::Singular) { d = (f.depth - 1) / 2; alpha = f.bound - 1; beta = f.bound; }
+            else { d = f.depth - 1 + ext; alpha = f.alpha; beta = f.beta; }
+            f.ext = ext;
+            f.saved_recapture = ctx.recapture_square;
+            ctx.recapture_square = captured;
+            ctx.extensions += ext;
+            int ply = f.phase == Phase::Singular ? d : f.ply - 1 + ext;
+            int value;
+            if (enter(d, -beta, -alpha, ply, value)) returned(top, -value);
+        }
+
+        // alphaBeta up to its loop over the children. True with value when the node ends there;
+        // otherwise its frame is pushed.
+        bool enter(int depth, int alpha, int beta, int ply, int& value)
+        {
+            ++nodes;
+            ENGINE_STAT(ctx.stats.enter_node(ctx.stats.depth - depth + ctx.extensions));
+            int height = ctx.root_depth - depth + ctx.extensions;
+            ctx.pv.clear(height);
+            uint64_t key = ctx.position_key();
+            if (ctx.cfg.draw_detection && (ctx.halfmove_clock >= 100 || ctx.isRepetition(key)))
+            {
+                ENGINE_STAT(++ctx.stats.draw_cutoffs);
+                value = 0;
+                return true;
+            }
+            if (depth == 0)
+            {
+                ENGINE_STAT_TIMER(evalTimer, ctx.stats.eval_ns);
+                value = ctx.evaluate();
+                return true;
+            }
+            uint16_t tt_move = 0;
+            TTEntry e;
+            bool hit = false;
+            if (ctx.tt)
+            {
+                ENGINE_STAT(++ctx.stats.tt_probes);
+                if ((hit = ctx.tt->probe(ctx.table_key(key), e)))
+                {
+                    ENGINE_STAT(++ctx.stats.tt_hits);
+                    tt_move = e.move;
+                    if (e.depth == depth)
+                    {
+                        int v = e.bound == Bound::Exact ? std::max(alpha, std::min(e.score, beta)) : e.bound == Bound::Lower && e.score >= beta ? beta : e.bound == Bound::Upper && e.score <= alpha ? alpha : INF;
+                        if (v != INF) { ENGINE_STAT(++ctx.stats.tt_cutoffs); value = v; return true; }
+                    }
+                }
+            }
+            Frame f;
+            {
+                ENGINE_STAT_TIMER(genTimer, ctx.stats.movegen_ns);
+                ctx.generateLegalMoves(ply, f.moves);
+            }
+            if (f.moves.empty())
+            {
+                uint64_t king = ctx.pieces[(ctx.side_to_move == White ? 0 : 6) + 5];
+                value = king && ctx.isSquareAttacked(Context::ctz64(king)) ? -10000 - (4 - depth) : 0;
+                return true;
+            }
+            ctx.orderMoves(f.moves, tt_move);
+            f.phase = Phase::Search;
+            f.depth = depth; f.alpha = alpha; f.beta = beta; f.ply = ply;
+            f.alpha_in = alpha; f.height = height; f.key = key; f.tt_move = tt_move;
+            ctx.keys.push_back(key);
+            if (ctx.cfg.singular_extension && depth >= kSingularDepth && hit && tt_move && e.bound != Bound::Upper && e.depth >= depth - 3 &&
+                e.score > -kMateBound && e.score < kMateBound && ctx.extensions < ctx.cfg.extension_budget)
+            {
+                f.phase = Phase::Singular;
+                f.bound = e.score - kSingularMargin;
+            }
+            stack.push_back(std::move(f));
+            return false;
+        }
+
+        // The child of stack[at] came back with score, from the frame's side.
+        void returned(size_t at, int score)
+        {
+            Frame& f = stack[at];
+            ctx.extensions -= f.ext;
+            ctx.recapture_square = f.saved_recapture;
+            ctx.restore(f.save);
+            const Move& m = f.moves[f.next];
+            switch (f.phase)
+            {
+            case Phase::Root:
+                root.emplace_back(m, score);
+                ++f.next;
+                break;
+            case Phase::Singular:
+                if (score >= f.bound) { f.phase = Phase::Search; f.next = 0; }
+                else ++f.next;
+                break;
+            case Phase::Search:
+                if (score >= f.beta)
+                {
+                    ENGINE_STAT(ctx.stats.record_cutoff((int)f.next));
+                    if (f.quiet) ctx.history.reward(ctx.side_to_move, m.from, m.to, f.depth);
+                    f.alpha = f.beta;
+                    f.best = (int)f.next;
+                    f.next = f.moves.size();
+                    break;
+                }
+                if (score > f.alpha) { f.alpha = score; f.best = (int)f.next; ctx.pv.update(f.height, Context::ttMove(m)); }
+                ++f.next;
+                break;
+            }
+        }
+
+        // alphaBeta after its loop: stores the node and hands its score to the frame below.
+        void close()
+        {
+            Frame& f = stack.back();
+            if (f.phase == Phase::Root) { stack.pop_back(); return; }
+            ctx.keys.pop_back();
+            if (ctx.tt)
+            {
+                Bound bound = f.alpha >= f.beta ? Bound::Lower : f.alpha > f.alpha_in ? Bound::Exact : Bound::Upper;
+                ctx.tt->store(ctx.table_key(f.key), f.depth, f.alpha, bound, f.best >= 0 ? Context::ttMove(f.moves[f.best]) : 0);
+            }
+            int value = f.alpha;
+            stack.pop_back();
+            returned(stack.size() - 1, -value);
+        }
+
+        // choose_move's choice from the root scores.
+        void finish()
+        {
+            engine.end_search(ctx);
+            done = true;
+            Move best{}; int best_score = -INF;
+            for (auto& s : root)
+            {
+                scores.emplace_back(Context::moveToUci(s.first), s.second);
+                if (s.second > best_score) { best_score = s.second; best = s.first; }
+            }
+            if (!root.empty()) engine.record_move(fen, depth, best_score, Context::moveToUci(best));
+            move = Context::moveToUci(best);
+        }
+    };
+
+    std::unique_ptr<SlicedSearch> ChessEngine2::start_search(const std::string& fen, int depth)
+    {
+        return std::unique_ptr<SlicedSearch>(new Slicer(*this, fen, depth));
+    }
+} // namespace engine
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace engine
+{
+    // A choose_move run a slice at a time on the caller's thread, for frame loops with no thread to
+    // search on (the Emscripten build): each advance() searches until its node or time budget is
+    // spent and returns, keeping the search's stack for the next call. Made by EngineBase::start_search.
+    // The engine must outlive the search, and its options and game history stay as they were when
+    // the search started until it finishes; destroying an unfinished search abandons it.
+    class SlicedSearch
+    {
+    public:
+        virtual ~SlicedSearch() = default;
+        // Searches at most max_nodes more nodes for at most max_us microseconds, 0 meaning no limit,
+        // and at least one node. True once the search has finished.
+        virtual bool advance(uint64_t max_nodes, uint64_t max_us) = 0;
+        bool finished() const { return done; }
+        // The move choose_move would have played, in UCI; empty until finished.
+        const std::string& best_move() const { return move; }
+        // Every root move with the score root_search_scores would give it, when the engine's search
+        // scores them all on the way; otherwise empty.
+        const std::vector<std::pair<std::string, int>>& root_scores() const { return scores; }
+
+    protected:
+        bool done = false;
+        std::string move;
+        std::vector<std::pair<std::string, int>> scores;
+    };
+} // namespace engine
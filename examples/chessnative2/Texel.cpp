@@ -0,0 +1,490 @@
+#include "Texel.h"
+#include "ChessEngine2.hpp"
+#include "Castling.h"
+#include "Color.h"
+#include "Geometry.h"
+#include "Pgn.h"
+#include "SearchTables.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace engine
+{
+    namespace
+    {
+        const char kMagic[4] = { 'C', 'T', 'P', '1' };
+        const int kFeatures = 6 + 6 * 64; // material, then one table per piece type
+
+        // Calls fn(piece 0-11, square) for every piece of p.
+        template <class F> void for_each_piece(const PackedPosition& p, F fn)
+        {
+            int j = 0;
+            for (uint64_t b = p.occupied; b; b &= b - 1, ++j)
+                fn((p.pieces[j >> 1] >> ((j & 1) * 4)) & 15, bit_scan_forward(b));
+        }
+
+        void pack_record(const PackedPosition& p, uint8_t* out)
+        {
+            for (int i = 0; i < 8; ++i) out[i] = uint8_t(p.occupied >> (8 * i));
+            for (int i = 0; i < 16; ++i) out[8 + i] = p.pieces[i];
+            out[24] = p.side;
+            out[25] = p.result;
+            out[26] = uint8_t(uint16_t(p.score)); out[27] = uint8_t(uint16_t(p.score) >> 8);
+            out[28] = uint8_t(p.ply); out[29] = uint8_t(p.ply >> 8);
+            out[30] = uint8_t(p.reserved); out[31] = uint8_t(p.reserved >> 8);
+        }
+
+        PackedPosition unpack_record(const uint8_t* in)
+        {
+            PackedPosition p;
+            for (int i = 0; i < 8; ++i) p.occupied |= uint64_t(in[i]) << (8 * i);
+            for (int i = 0; i < 16; ++i) p.pieces[i] = in[8 + i];
+            p.side = in[24];
+            p.result = in[25];
+            p.score = int16_t(uint16_t(in[26] | in[27] << 8));
+            p.ply = uint16_t(in[28] | in[29] << 8);
+            p.reserved = uint16_t(in[30] | in[31] << 8);
+            return p;
+        }
+
+        PackedPosition pack(const uint64_t pieces[12], int side)
+        {
+            PackedPosition p;
+            p.side = uint8_t(side);
+            for (int i = 0; i < 12; ++i) p.occupied |= pieces[i];
+            int j = 0;
+            for (uint64_t b = p.occupied; b; b &= b - 1, ++j)
+            {
+                uint64_t bit = b & (0 - b);
+                int piece = 0;
+                while (!(pieces[piece] & bit)) ++piece;
+                p.pieces[j >> 1] |= uint8_t(piece << ((j & 1) * 4));
+            }
+            return p;
+        }
+
+        // The weights as one vector of doubles while tuning: material[t] at t, pst[t][sq] at 6 + 64 t + sq.
+        struct Model
+        {
+            double w[kFeatures];
+
+            explicit Model(const EvalWeights& e)
+            {
+                for (int t = 0; t < 6; ++t)
+                {
+                    w[t] = e.material[t];
+                    for (int sq = 0; sq < 64; ++sq) w[6 + 64 * t + sq] = e.pst[t][sq];
+                }
+            }
+
+            double evaluate(const PackedPosition& p) const
+            {
+                double score = 0;
+                for_each_piece(p, [&](int piece, int sq) {
+                    int t = piece % 6;
+                    if (piece < 6) score += w[t] + w[6 + 64 * t + sq];
+                    else score -= w[t] + w[6 + 64 * t + (sq ^ 56)];
+                });
+                return score;
+            }
+        };
+
+        double sigmoid(double k, double eval) { return 1.0 / (1.0 + std::pow(10.0, -k * eval / 400.0)); }
+
+        // Mean squared error of the model over all positions and, if grad is set, its gradient, with
+        // the positions split evenly over the threads.
+        double error_pass(const std::vector<PackedPosition>& positions, const Model& m, double k, double lambda, int threads, double* grad)
+        {
+            size_t n = positions.size();
+            if (n == 0) { if (grad) std::fill(grad, grad + kFeatures, 0.0); return 0; }
+            int workers = (int)std::max<size_t>(1, std::min<size_t>((size_t)std::max(threads, 1), n / 4096 + 1));
+            std::vector<double> errors(workers, 0.0);
+            std::vector<std::vector<double>> grads(workers, std::vector<double>(grad ? kFeatures : 0, 0.0));
+            auto work = [&](int id) {
+                double err = 0;
+                double* g = grad ? grads[id].data() : nullptr;
+                for (size_t i = n * id / workers, end = n * (id + 1) / workers; i < end; ++i)
+                {
+                    const PackedPosition& p = positions[i];
+                    double predicted = sigmoid(k, m.evaluate(p));
+                    double target = (1 - lambda) * p.result / 2.0 + (lambda ? lambda * sigmoid(k, p.score) : 0.0);
+                    double diff = target - predicted;
+                    err += diff * diff;
+                    if (!g) continue;
+                    double c = diff * predicted * (1 - predicted);
+                    for_each_piece(p, [&](int piece, int sq) {
+                        int t = piece % 6;
+                        if (piece < 6) { g[t] += c; g[6 + 64 * t + sq] += c; }
+                        else { g[t] -= c; g[6 + 64 * t + (sq ^ 56)] -= c; }
+                    });
+                }
+                errors[id] = err;
+            };
+            std::vector<std::thread> pool;
+            for (int t = 1; t < workers; ++t) pool.emplace_back(work, t);
+            work(0);
+            for (auto& t : pool) t.join();
+
+            double err = 0;
+            for (double e : errors) err += e;
+            if (grad)
+            {
+                // d(diff^2)/dw = -2 diff * predicted (1 - predicted) * k ln10 / 400 * feature.
+                double scale = -2.0 * k * std::log(10.0) / 400.0 / double(n);
+                for (int f = 0; f < kFeatures; ++f)
+                {
+                    double sum = 0;
+                    for (const auto& g : grads) sum += g[f];
+                    grad[f] = sum * scale;
+                }
+            }
+            return err / double(n);
+        }
+    } // namespace
+
+    PackedPosition pack_position(const std::string& fen, int result, int score)
+    {
+        BoardState b;
+        b.loadFEN(fen);
+        PackedPosition p = pack(b.pieces, b.side_to_move);
+        p.result = uint8_t(result);
+        p.score = int16_t(score);
+        return p;
+    }
+
+    void unpack_pieces(const PackedPosition& p, uint64_t pieces[12])
+    {
+        std::fill(pieces, pieces + 12, 0);
+        for_each_piece(p, [&](int piece, int sq) { pieces[piece] |= 1ULL << sq; });
+    }
+
+    PositionWriter::PositionWriter(const std::string& path)
+    {
+        bool fresh = true;
+        {
+            std::ifstream existing(path, std::ios::binary | std::ios::ate);
+            fresh = !existing.is_open() || existing.tellg() <= 0;
+        }
+        file.open(path, std::ios::binary | std::ios::app);
+        if (file.is_open() && fresh) file.write(kMagic, sizeof(kMagic));
+    }
+
+    void PositionWriter::write(const PackedPosition* positions, size_t n)
+    {
+        if (!file.is_open()) return;
+        uint8_t buffer[32 * 256];
+        for (size_t done = 0; done < n; )
+        {
+            size_t chunk = std::min<size_t>(n - done, 256);
+            for (size_t i = 0; i < chunk; ++i) pack_record(positions[done + i], buffer + 32 * i);
+            file.write((const char*)buffer, std::streamsize(32 * chunk));
+            done += chunk;
+        }
+        count += n;
+    }
+
+    bool read_positions(const std::string& path, std::vector<PackedPosition>& out)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        std::streamoff size = in.tellg();
+        in.seekg(0);
+        char magic[4];
+        if (!in.read(magic, 4) || !std::equal(magic, magic + 4, kMagic)) return false;
+        out.clear();
+        out.reserve(size > 4 ? size_t(size - 4) / 32 : 0);
+        uint8_t buffer[32 * 256];
+        while (in.read((char*)buffer, sizeof(buffer)) || in.gcount() > 0)
+        {
+            size_t got = size_t(in.gcount()) / 32;
+            for (size_t i = 0; i < got; ++i) out.push_back(unpack_record(buffer + 32 * i));
+        }
+        return true;
+    }
+
+    // Replays games on a ChessEngine2 context and runs the quiescence filter there.
+    struct CorpusBuilder
+    {
+        using Ctx = ChessEngine2::Context;
+        using Move = ChessEngine2::Move;
+        enum { kMaxPly = 64 };
+
+        static const int* piece_values() { return ChessEngine2::PIECE_VALUES; }
+
+        // One PGN worker's board and buffers, kept between games.
+        struct Worker
+        {
+            Ctx ctx;
+            std::vector<Move> legal;
+            std::vector<Move> lists[kMaxPly];
+            std::vector<std::pair<int, Move>> captures[kMaxPly];
+            std::vector<PackedPosition> out;
+        };
+
+        struct Counters
+        {
+            std::atomic<size_t> games{ 0 }, skipped_games{ 0 }, positions{ 0 }, in_check{ 0 }, not_quiet{ 0 }, written{ 0 };
+        };
+
+        // Piece type captured by m (pawn for en passant), -1 for a quiet move.
+        template <int Us> static int victim(Ctx& ctx, const Move& m)
+        {
+            if (m.is_castling) return -1;
+            int t = ctx.getPieceType(m.to, ColorTraits<Us>::them);
+            if (t < 0 && m.to == ctx.ep_square && ctx.getPieceType(m.from, Us) == 0) t = 0;
+            return t;
+        }
+
+        // Fail-soft captures-and-promotions search with stand pat; checks are not extended. The score
+        // is material only, so a capture can gain at most its victim (plus the promotion): moves that
+        // cannot lift alpha even unanswered are skipped, and so is move generation when there is
+        // nothing to capture or promote at all. Both cuts leave the result unchanged.
+        template <int Us> static int quiesce(Worker& w, int alpha, int beta, int ply)
+        {
+            using C = ColorTraits<Us>;
+            Ctx& ctx = w.ctx;
+            const int stand = ctx.evaluate<Us>();
+            int best = stand;
+            if (best >= beta || ply + 1 >= kMaxPly) return best;
+            alpha = std::max(alpha, best);
+            const uint64_t* own = ctx.pieces + C::piece_offset;
+            const uint64_t* their = ctx.pieces + ColorTraits<C::them>::piece_offset;
+            uint64_t theirs = their[0] | their[1] | their[2] | their[3] | their[4];
+            uint64_t seventh = Us == White ? 0x00FF000000000000ULL : 0x000000000000FF00ULL;
+            if (ctx.ep_square < 0 && !(own[0] & seventh) && !(ctx.attacksBy<Us>(ctx.occupancy()) & theirs)) return best;
+
+            std::vector<Move>& moves = w.lists[ply];
+            std::vector<std::pair<int, Move>>& captures = w.captures[ply];
+            moves.clear();
+            captures.clear();
+            ctx.generateLegalMoves<Us>(1, moves);
+            // Most valuable victim first, promotions with the captures.
+            for (const Move& m : moves)
+            {
+                int t = victim<Us>(ctx, m);
+                if (t < 0 && !m.prom_piece) continue;
+                int gain = (t >= 0 ? piece_values()[t] : 0) + (m.prom_piece ? piece_values()[m.prom_piece] - piece_values()[0] : 0);
+                if (stand + gain > alpha) captures.emplace_back(gain, m);
+            }
+            std::stable_sort(captures.begin(), captures.end(), [](const std::pair<int, Move>& a, const std::pair<int, Move>& b) { return a.first > b.first; });
+            for (const auto& c : captures)
+            {
+                if (stand + c.first <= alpha) continue;
+                ChessEngine2::Snapshot save = ctx.snapshot();
+                ctx.makeMove<Us>(c.second);
+                int score = -quiesce<C::them>(w, -beta, -alpha, ply + 1);
+                ctx.restore(save);
+                if (score > best) best = score;
+                if (score >= beta) break;
+                alpha = std::max(alpha, score);
+            }
+            return best;
+        }
+
+        // Score of the side to move for a quiet position, or false if it is not one.
+        template <int Us> static bool quiet_score(Worker& w, int depth, Counters& c, int& score)
+        {
+            Ctx& ctx = w.ctx;
+            if (ctx.isSquareAttacked(Ctx::ctz64(ctx.pieces[ColorTraits<Us>::piece_offset + 5]))) { ++c.in_check; return false; }
+            int stand = ctx.evaluate<Us>();
+            if (quiesce<Us>(w, -ChessEngine2::INF, ChessEngine2::INF, 0) != stand) { ++c.not_quiet; return false; }
+            if (depth <= 0) { score = stand; return true; }
+            ctx.keys.clear();
+            ctx.root_depth = depth;
+            ChessEngine2::Snapshot save = ctx.snapshot();
+            score = ctx.alphaBeta<Us>(depth, -ChessEngine2::INF, ChessEngine2::INF, depth);
+            ctx.restore(save);
+            return true;
+        }
+
+        static void game(Worker& w, const PgnGame& g, const ExtractOptions& opt, Counters& c, std::mutex& lock, const std::function<void(const PackedPosition*, size_t)>& sink)
+        {
+            ++c.games;
+            int result = g.result == "1-0" ? 2 : g.result == "0-1" ? 0 : g.result == "1/2-1/2" ? 1 : -1;
+            if (result < 0 || !g.ok()) { ++c.skipped_games; return; }
+            Ctx& ctx = w.ctx;
+            ctx.loadFEN(g.fen);
+            w.out.clear();
+            uint64_t every = (uint64_t)std::max(opt.sample_every, 1);
+            for (size_t ply = 0; ; ++ply)
+            {
+                // The position before moves[ply]; the last one is the final position.
+                if ((int)ply >= opt.skip_plies && (ctx.position_key() * 0x9E3779B97F4A7C15ULL >> 32) % every == 0)
+                {
+                    ++c.positions;
+                    int score = 0;
+                    bool white = ctx.side_to_move == White;
+                    if (white ? quiet_score<White>(w, opt.search_depth, c, score) : quiet_score<Black>(w, opt.search_depth, c, score))
+                    {
+                        PackedPosition p = pack(ctx.pieces, ctx.side_to_move);
+                        p.result = uint8_t(result);
+                        p.score = int16_t(std::max(-32000, std::min(white ? score : -score, 32000)));
+                        p.ply = uint16_t(std::min<size_t>(ply, 65535));
+                        w.out.push_back(p);
+                    }
+                }
+                if (ply == g.moves.size()) break;
+                // Same 16-bit form as the PGN reader: castling by its UCI target square.
+                uint16_t want = g.moves[ply];
+                w.legal.clear();
+                ctx.generateLegalMoves(1, w.legal);
+                const Move* m = nullptr;
+                for (const Move& l : w.legal)
+                {
+                    int to = (l.is_castling && !is_standard_castle(l.from % 8, l.rook_from % 8)) ? l.rook_from : l.to;
+                    if (encode_move(l.from, to, l.prom_piece) == want) { m = &l; break; }
+                }
+                if (!m) break;
+                ctx.makeMove(*m);
+            }
+            if (w.out.empty()) return;
+            c.written += w.out.size();
+            std::lock_guard<std::mutex> hold(lock);
+            sink(w.out.data(), w.out.size());
+        }
+    };
+
+    ExtractStats extract_positions(const PgnReader& reader, const ExtractOptions& opt, const std::function<void(const PackedPosition*, size_t)>& sink)
+    {
+        CorpusBuilder::Counters c;
+        std::mutex lock, workers_lock;
+        // One Worker per reader thread, handed out by thread id on its first game.
+        std::vector<std::pair<std::thread::id, std::unique_ptr<CorpusBuilder::Worker>>> workers;
+        reader.for_each([&](const PgnGame& g) {
+            CorpusBuilder::Worker* w = nullptr;
+            {
+                std::lock_guard<std::mutex> hold(workers_lock);
+                std::thread::id id = std::this_thread::get_id();
+                for (auto& x : workers)
+                    if (x.first == id) w = x.second.get();
+                if (!w)
+                {
+                    workers.emplace_back(id, std::unique_ptr<CorpusBuilder::Worker>(new CorpusBuilder::Worker));
+                    w = workers.back().second.get();
+                }
+            }
+            CorpusBuilder::game(*w, g, opt, c, lock, sink);
+        }, opt.threads);
+        ExtractStats s;
+        s.games = c.games; s.skipped_games = c.skipped_games; s.positions = c.positions;
+        s.in_check = c.in_check; s.not_quiet = c.not_quiet; s.written = c.written;
+        return s;
+    }
+
+    EvalWeights EvalWeights::engine_default()
+    {
+        EvalWeights w;
+        for (int t = 0; t < 6; ++t)
+        {
+            w.material[t] = CorpusBuilder::piece_values()[t];
+            std::fill(w.pst[t], w.pst[t] + 64, 0);
+        }
+        return w;
+    }
+
+    int EvalWeights::evaluate(const PackedPosition& p) const
+    {
+        int score = 0;
+        for_each_piece(p, [&](int piece, int sq) {
+            int t = piece % 6;
+            if (piece < 6) score += material[t] + pst[t][sq];
+            else score -= material[t] + pst[t][sq ^ 56];
+        });
+        return score;
+    }
+
+    double texel_error(const std::vector<PackedPosition>& positions, const EvalWeights& w, double k, double lambda, int threads)
+    {
+        return error_pass(positions, Model(w), k, lambda, threads, nullptr);
+    }
+
+    double fit_scale(const std::vector<PackedPosition>& positions, const EvalWeights& w, double lambda, int threads)
+    {
+        Model m(w);
+        const double phi = (std::sqrt(5.0) - 1) / 2;
+        double a = 0.05, b = 5.0;
+        double x1 = b - phi * (b - a), x2 = a + phi * (b - a);
+        double f1 = error_pass(positions, m, x1, lambda, threads, nullptr), f2 = error_pass(positions, m, x2, lambda, threads, nullptr);
+        while (b - a > 1e-3)
+        {
+            if (f1 < f2) { b = x2; x2 = x1; f2 = f1; x1 = b - phi * (b - a); f1 = error_pass(positions, m, x1, lambda, threads, nullptr); }
+            else { a = x1; x1 = x2; f1 = f2; x2 = a + phi * (b - a); f2 = error_pass(positions, m, x2, lambda, threads, nullptr); }
+        }
+        return (a + b) / 2;
+    }
+
+    TuneResult tune_weights(const std::vector<PackedPosition>& positions, const EvalWeights& start, const TuneOptions& opt, const std::function<void(int, double)>& progress)
+    {
+        TuneResult r;
+        r.k = opt.k > 0 ? opt.k : fit_scale(positions, start, opt.lambda, opt.threads);
+        r.initial_error = texel_error(positions, start, r.k, opt.lambda, opt.threads);
+
+        // Adam on the full set; the king's material term never changes the score and stays fixed.
+        Model m(start);
+        std::vector<double> grad(kFeatures), mean(kFeatures, 0.0), var(kFeatures, 0.0);
+        const double beta1 = 0.9, beta2 = 0.999;
+        for (int epoch = 1; epoch <= opt.epochs; ++epoch)
+        {
+            double err = error_pass(positions, m, r.k, opt.lambda, opt.threads, grad.data());
+            for (int f = 0; f < kFeatures; ++f)
+            {
+                if (f < 6 ? (!opt.tune_material || f == 5) : !opt.tune_pst) continue;
+                mean[f] = beta1 * mean[f] + (1 - beta1) * grad[f];
+                var[f] = beta2 * var[f] + (1 - beta2) * grad[f] * grad[f];
+                double mh = mean[f] / (1 - std::pow(beta1, epoch)), vh = var[f] / (1 - std::pow(beta2, epoch));
+                m.w[f] -= opt.learning_rate * mh / (std::sqrt(vh) + 1e-12);
+            }
+            if (progress) progress(epoch, err);
+        }
+
+        // Both sides have one table per piece type, so a constant added to a table scores exactly as
+        // the same constant added to the material value; move each table's mean there. Pawns only
+        // count the squares they can stand on.
+        for (int t = 0; t < 6; ++t)
+        {
+            int lo = t == 0 ? 8 : 0, hi = t == 0 ? 56 : 64;
+            double sum = 0;
+            for (int sq = lo; sq < hi; ++sq) sum += m.w[6 + 64 * t + sq];
+            int shift = (int)std::lround(sum / (hi - lo));
+            r.weights.material[t] = (int)std::lround(m.w[t]) + (t == 5 ? 0 : shift);
+            for (int sq = 0; sq < 64; ++sq)
+                r.weights.pst[t][sq] = sq >= lo && sq < hi ? (int)std::lround(m.w[6 + 64 * t + sq]) - shift : 0;
+        }
+        r.final_error = texel_error(positions, r.weights, r.k, opt.lambda, opt.threads);
+        return r;
+    }
+
+    std::string format_weights(const EvalWeights& w)
+    {
+        std::ostringstream out;
+        out << "const int PIECE_VALUES[6] = { ";
+        for (int t = 0; t < 6; ++t) out << w.material[t] << (t < 5 ? ", " : " };\n");
+        out << "// a1 ... h8, white's view; black mirrors the square (sq ^ 56).\n";
+        out << "const int PIECE_SQUARE[6][64] = {\n";
+        for (int t = 0; t < 6; ++t)
+        {
+            out << "    { // " << "PNBRQK"[t] << "\n";
+            for (int rank = 0; rank < 8; ++rank)
+            {
+                out << "       ";
+                for (int file = 0; file < 8; ++file)
+                {
+                    char cell[8];
+                    std::snprintf(cell, sizeof(cell), " %4d,", w.pst[t][rank * 8 + file]);
+                    out << cell;
+                }
+                out << "\n";
+            }
+            out << (t < 5 ? "    },\n" : "    }\n");
+        }
+        out << "};\n";
+        return out.str();
+    }
+} // namespace engine
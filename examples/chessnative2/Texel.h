@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    class PgnReader;
+
+    // Offline evaluation tuning by Texel's method: positions sampled from finished games are scored
+    // by a material + piece-square evaluation, and the weights are fitted so that a logistic function
+    // of that score predicts the game results (optionally blended with a stored search score).
+
+    // A training position in 32 bytes, so tens of millions fit in memory at once.
+    struct PackedPosition
+    {
+        uint64_t occupied = 0;   // squares holding a piece, a1 = bit 0
+        uint8_t pieces[16] = {}; // a nibble per set bit of occupied, lowest square first: 0-5 white PNBRQK, 6-11 black
+        uint8_t side = 0;        // side to move, 0 = white
+        uint8_t result = 1;      // game result for white: 0 loss, 1 draw, 2 win
+        int16_t score = 0;       // search score in centipawns from white's point of view
+        uint16_t ply = 0;        // plies played from the game's start position
+        uint16_t reserved = 0;
+    };
+    static_assert(sizeof(PackedPosition) == 32, "PackedPosition is a 32-byte record");
+
+    // Position of a FEN (board and side only). result and score as in PackedPosition.
+    PackedPosition pack_position(const std::string& fen, int result, int score);
+    // Bitboards in the Zobrist piece order (white PNBRQK, then black).
+    void unpack_pieces(const PackedPosition& p, uint64_t pieces[12]);
+
+    // Positions file: "CTP1", then one 32-byte little-endian record per position, in any order.
+    // PositionWriter appends to it (writing the header if the file is new); read_positions loads it whole.
+    class PositionWriter
+    {
+    public:
+        explicit PositionWriter(const std::string& path);
+        PositionWriter(const PositionWriter&) = delete;
+        PositionWriter& operator=(const PositionWriter&) = delete;
+
+        bool is_open() const { return file.is_open(); }
+        void write(const PackedPosition* positions, size_t n);
+        size_t written() const { return count; }
+
+    private:
+        std::ofstream file;
+        size_t count = 0;
+    };
+    bool read_positions(const std::string& path, std::vector<PackedPosition>& out);
+
+    struct ExtractOptions
+    {
+        int threads = 1;
+        int skip_plies = 8;   // opening plies left out; they come from books more than from evaluation
+        int sample_every = 1; // keep one position in this many, picked by Zobrist key so repeats agree
+        int search_depth = 0; // 0 stores the quiescence score, else an alpha-beta score of this depth
+    };
+
+    struct ExtractStats
+    {
+        size_t games = 0;         // games read
+        size_t skipped_games = 0; // no result, or a move that is not legal SAN
+        size_t positions = 0;     // positions past skip_plies and picked by sampling
+        size_t in_check = 0;      // dropped: side to move in check
+        size_t not_quiet = 0;     // dropped: a capture sequence changes the static score
+        size_t written = 0;
+    };
+
+    // Replays every game with a result, keeping quiet positions: side to move not in check and a
+    // captures-only quiescence search that ends where it started, so the static evaluation is the
+    // score. sink gets the positions of one game at a time, never from two threads at once.
+    ExtractStats extract_positions(const PgnReader& reader, const ExtractOptions& opt, const std::function<void(const PackedPosition*, size_t)>& sink);
+
+    struct EvalWeights
+    {
+        int material[6];
+        int pst[6][64]; // white's view, a1 = 0; a black piece reads its square mirrored (sq ^ 56)
+
+        // ChessEngine2's material values with empty tables: the evaluation it searches with today.
+        static EvalWeights engine_default();
+        // White minus black.
+        int evaluate(const PackedPosition& p) const;
+    };
+
+    struct TuneOptions
+    {
+        int threads = 1;
+        int epochs = 300;           // full passes, one Adam step each
+        double learning_rate = 2.0; // centipawns per step at the start
+        double k = 0;               // logistic scale, predicted = 1 / (1 + 10^(-k * eval / 400)); 0 fits it first
+        double lambda = 0;          // weight of the stored search score in the target, against the result
+        bool tune_material = true;
+        bool tune_pst = true;
+    };
+
+    struct TuneResult
+    {
+        EvalWeights weights;
+        double k = 0;
+        double initial_error = 0;
+        double final_error = 0;
+    };
+
+    // Mean squared difference between target and predicted result.
+    double texel_error(const std::vector<PackedPosition>& positions, const EvalWeights& w, double k, double lambda, int threads = 1);
+    // The k that minimises texel_error for fixed weights (golden-section search).
+    double fit_scale(const std::vector<PackedPosition>& positions, const EvalWeights& w, double lambda, int threads = 1);
+    // Gradient descent from start. progress, if set, is called after every epoch with its error. The
+    // tables are returned with their mean moved into the material value (an identical evaluation).
+    TuneResult tune_weights(const std::vector<PackedPosition>& positions, const EvalWeights& start, const TuneOptions& opt,
+                            const std::function<void(int, double)>& progress = std::function<void(int, double)>());
+    // C++ initialisers for the weights, tables in square order (a1 ... h8).
+    std::string format_weights(const EvalWeights& w);
+} // namespace engine
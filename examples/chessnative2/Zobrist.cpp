@@ -0,0 +1,107 @@
+#include "Zobrist.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace engine
+{
+    namespace
+    {
+        constexpr uint64_t splitmix64(uint64_t& state)
+        {
+            state += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        // Fixed seed: keys must not change between runs, stored hashes depend on them.
+        constexpr ZobristKeys make_keys()
+        {
+            ZobristKeys k{};
+            uint64_t state = 0x2545F4914F6CDD1DULL;
+            for (int p = 0; p < 12; ++p)
+                for (int sq = 0; sq < 64; ++sq)
+                    k.piece[p][sq] = splitmix64(state);
+            k.side = splitmix64(state);
+            uint64_t rights[4] = { splitmix64(state), splitmix64(state), splitmix64(state), splitmix64(state) };
+            for (int mask = 0; mask < 16; ++mask)
+            {
+                k.castling[mask] = 0;
+                for (int b = 0; b < 4; ++b)
+                    if (mask & (1 << b)) k.castling[mask] ^= rights[b];
+            }
+            for (int f = 0; f < 8; ++f)
+                k.ep_file[f] = splitmix64(state);
+            return k;
+        }
+    } // namespace
+
+    // make_keys() is a constant expression, so the table is built at compile time.
+    const ZobristKeys kZobrist = make_keys();
+
+    uint64_t zobrist_hash(const uint64_t pieces[12], int sideToMove, int castleMask, int epSquare)
+    {
+        uint64_t key = 0;
+        for (int p = 0; p < 12; ++p)
+        {
+            uint64_t bb = pieces[p];
+            while (bb)
+            {
+#if defined(_MSC_VER)
+                unsigned long sq; _BitScanForward64(&sq, bb);
+#else
+                int sq = __builtin_ctzll(bb);
+#endif
+                key ^= kZobrist.piece[p][sq];
+                bb &= bb - 1;
+            }
+        }
+        if (sideToMove) key ^= kZobrist.side;
+        key ^= kZobrist.castling[castleMask & 15];
+        if (epSquare >= 0) key ^= kZobrist.ep_file[epSquare & 7];
+        return key;
+    }
+
+    uint64_t zobrist_hash_fen(const std::string& fen)
+    {
+        uint64_t pieces[12] = {};
+        size_t i = 0;
+        int sq = 56;
+        for (; i < fen.size() && fen[i] != ' '; ++i)
+        {
+            char c = fen[i];
+            if (c == '/') { sq -= 16; continue; }
+            if (c >= '1' && c <= '8') { sq += c - '0'; continue; }
+            const char* order = "PNBRQKpnbrqk";
+            int p = 0;
+            while (order[p] && order[p] != c) ++p;
+            if (!order[p] || sq < 0 || sq >= 64) return 0;
+            pieces[p] |= 1ULL << sq++;
+        }
+        if (++i >= fen.size()) return 0;
+        int side = (fen[i] == 'b') ? 1 : 0;
+        i += 2;
+        int castle = 0, ep = -1;
+        if (i < fen.size())
+        {
+            auto kingFile = [&](int p) { for (int s = 0; s < 64; ++s) if (pieces[p] & (1ULL << s)) return s & 7; return 4; };
+            for (; i < fen.size() && fen[i] != ' '; ++i)
+            {
+                char c = fen[i];
+                if (c == 'K') castle |= 1;
+                else if (c == 'Q') castle |= 2;
+                else if (c == 'k') castle |= 4;
+                else if (c == 'q') castle |= 8;
+                // Shredder/X-FEN rook files: side is decided relative to the king.
+                else if (c >= 'A' && c <= 'H') castle |= (c - 'A' > kingFile(5)) ? 1 : 2;
+                else if (c >= 'a' && c <= 'h') castle |= (c - 'a' > kingFile(11)) ? 4 : 8;
+            }
+            ++i;
+            if (i + 1 < fen.size() && fen[i] >= 'a' && fen[i] <= 'h' && fen[i + 1] >= '1' && fen[i + 1] <= '8')
+                ep = (fen[i] - 'a') + (fen[i + 1] - '1') * 8;
+        }
+        return zobrist_hash(pieces, side, castle, ep);
+    }
+} // namespace engine
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace engine
+{
+    // Zobrist keys shared by both engines and the controller, so a key computed from a FEN
+    // string matches the key an engine computes for the same position during search.
+    // Piece index order matches EngineBase::pieces (PNBRQK white, then black).
+    // Castling masks use bit 1 = K, 2 = Q, 4 = k, 8 = q.
+    struct ZobristKeys
+    {
+        uint64_t piece[12][64];
+        uint64_t side;         // XORed in when black is to move
+        uint64_t castling[16]; // per rights mask; castling[a ^ b] == castling[a] ^ castling[b]
+        uint64_t ep_file[8];
+    };
+
+    extern const ZobristKeys kZobrist;
+
+    // Full key from bitboards. epSquare < 0 means no en-passant square.
+    uint64_t zobrist_hash(const uint64_t pieces[12], int sideToMove, int castleMask, int epSquare);
+    // Key of the position described by a FEN (move counters are ignored); 0 if malformed.
+    uint64_t zobrist_hash_fen(const std::string& fen);
+} // namespace engine
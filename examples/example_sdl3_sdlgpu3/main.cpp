@@ -23,18 +23,18 @@
 #include <cmath>
 #include <stdio.h>
 #include "../chessnative2/EngineBase.h"
-#include "../chessnative2/ChessEngine1.hpp"
-#include "../chessnative2/ChessEngine2.hpp"
+#include "../chessnative2/EngineRegistry.h"
 #include <unordered_map>
 #include <cstring>
 #include <cctype>
 #include <algorithm>
 #include <sstream>
+#include <memory>
 #include "../Controller/Control.hpp"
 
 namespace {
-    engine::ChessEngine1 engine1;
-    engine::ChessEngine2 engine2;
+    // One instance per registered engine, so switching engines keeps each one's option values.
+    std::vector<std::unique_ptr<engine::EngineBase>> engines;
 }
 
 // #ifdef _DEBUG
@@ -164,8 +164,17 @@ static std::string BuildFEN(const char board[64], bool whiteToMove, int fullmove
     std::string s; for (int rank = 7; rank >= 0; --rank) { int empty = 0; for (int file = 0; file < 8; ++file) { int idx = rank * 8 + file; char pc = board[idx]; if (pc == '.') { empty++; } else { if (empty) { s.push_back(char('0' + empty)); empty = 0; } s.push_back(pc); } } if (empty) s.push_back(char('0' + empty)); if (rank) s.push_back('/'); }
     s += whiteToMove ? " w " : " b "; s += "KQkq - 0 "; s += std::to_string(fullmove); return s;
 }
+// Activity log line for a turn: the side's legal moves, each with its root score when the search gave one.
+static std::string LegalMovesLine(int fullmove, const char* side, const std::vector<std::string>& moves, const std::vector<std::pair<std::string, int>>& scored) {
+    std::string line = std::string("Turn ") + std::to_string(fullmove) + ' ' + side + " legal:";
+    std::unordered_map<std::string, int> sm; for (auto& pr : scored) sm[pr.first.substr(0, 4)] = pr.second;
+    for (auto& mv : moves) { line += ' ' + mv; auto it = sm.find(mv.substr(0, 4)); if (it != sm.end()) line += '(' + std::to_string(it->second) + ')'; }
+    return line;
+}
 // Selection state
 struct PendingMove { int from = -1; };
+// Engine search per frame while it thinks, well inside a 60 Hz frame.
+static const uint64_t kEngineSliceMicros = 8000;
 
 int main(int, char**)
 {
@@ -282,7 +291,8 @@ int main(int, char**)
     bool show_chess_board = true;
 
     // Engine selection state
-    int selectedEngine = 1; engine::EngineBase* activeEngine = &engine2; controller::GameController game(*activeEngine);
+    std::vector<const char*> engineNames; for (const auto& info : engine::engine_registry()) { engines.push_back(info.create()); engineNames.push_back(info.name); }
+    int selectedEngine = (int)(&engine::default_engine() - engine::engine_registry().data()); engine::EngineBase* activeEngine = engines[selectedEngine].get(); controller::GameController game(*activeEngine);
 
     int ply_depth = 4;
     bool engineWhite = true;
@@ -343,10 +353,22 @@ int main(int, char**)
             {
                 ImGui::Text("Engine (White) vs Human (Black)");
                 // Engine dropdown and depth control
-                const char* engineNames[] = { "Engine1", "Engine2" };
-                ImGui::Combo("Engine", &selectedEngine, engineNames, IM_ARRAYSIZE(engineNames));
-                engine::EngineBase* desired = (selectedEngine==0)? static_cast<engine::EngineBase*>(&engine1) : static_cast<engine::EngineBase*>(&engine2);
+                ImGui::Combo("Engine", &selectedEngine, engineNames.data(), (int)engineNames.size());
+                engine::EngineBase* desired = engines[selectedEngine].get();
                 if(desired != activeEngine){ activeEngine = desired; game.set_engine(*activeEngine); }
+                ImGui::SetItemTooltip("%s", engine::engine_registry()[selectedEngine].description);
+                // Option widgets come from the engine's schema; changes apply from the next search.
+                if (ImGui::TreeNode("Engine Options")) {
+                    for (const engine::EngineOption& o : activeEngine->options()) {
+                        int v = o.value;
+                        if (o.type == engine::EngineOption::Type::Check) { bool b = v != 0; if (ImGui::Checkbox(o.name.c_str(), &b)) activeEngine->set_option(o.name, b ? 1 : 0); }
+                        else if (o.type == engine::EngineOption::Type::Combo) { std::vector<const char*> items; for (auto& c : o.choices) items.push_back(c.c_str()); if (ImGui::Combo(o.name.c_str(), &v, items.data(), (int)items.size())) activeEngine->set_option(o.name, v); }
+                        else { if (ImGui::InputInt(o.name.c_str(), &v)) activeEngine->set_option(o.name, std::min(std::max(v, o.min), o.max)); }
+                        if (!o.help.empty()) ImGui::SetItemTooltip("%s", o.help.c_str());
+                    }
+                    if (ImGui::Button("Defaults")) activeEngine->reset_options();
+                    ImGui::TreePop();
+                }
                 ImGui::InputInt("Ply Depth", &ply_depth); if (ply_depth < 1) ply_depth = 1; if (ply_depth > 10) ply_depth = 10;
                 ImGui::SameLine(); if (ImGui::Button("New Game")) { game.reset(); pending.from = -1; activityLog.clear(); lastLoggedHumanFullmove = lastLoggedEngineFullmove = -1; status_msg = "New game"; }
                 ImGui::SameLine(); if (ImGui::Button("Undo") && game.fen_history().size() > 1) { if (game.undo()) { pending.from = -1; status_msg = "Undo"; } }
@@ -356,27 +378,35 @@ int main(int, char**)
                 ImGui::Separator();
                 { char fenBuf[128]; std::strncpy(fenBuf, game.current_fen().c_str(), sizeof(fenBuf)); fenBuf[sizeof(fenBuf) - 1] = '\0'; ImGui::InputText("##fen", fenBuf, sizeof(fenBuf), ImGuiInputTextFlags_ReadOnly); }
                 if (!status_msg.empty()) ImGui::TextWrapped("%s", status_msg.c_str());
-                // Engine move & logging
-                if (engineWhite && game.white_to_move()) {
-                    if (lastLoggedEngineFullmove != game.fullmove_number()) {
-                        auto movesList = game.legal_moves_uci(); std::string line = std::string("Turn ") + std::to_string(game.fullmove_number()) + " White legal:";
-                        if (ply_depth % 2 == 0) { auto scored = activeEngine->root_search_scores(game.current_fen(), ply_depth); std::unordered_map<std::string, int> sm; for (auto &pr : scored) sm[pr.first.substr(0,4)] = pr.second; for (auto &mv : movesList){ auto key= mv.substr(0,4); auto it= sm.find(key); if(it!=sm.end()) line += ' ' + mv + '(' + std::to_string(it->second) + ')'; else line += ' ' + mv; } }
-                        else { for (auto& mv : movesList) line += ' ' + mv; }
-                        activityLog.push_back(line); lastLoggedEngineFullmove = game.fullmove_number(); std::string chosen = game.engine_move(ply_depth); status_msg = chosen.empty() ? "Engine has no move" : std::string("Engine moves ") + chosen;
+                // Engine move & logging. The search runs a slice per frame, so the window stays live while it thinks.
+                if (engineWhite && game.white_to_move() && lastLoggedEngineFullmove != game.fullmove_number()) {
+                    static std::vector<std::string> movesList;
+                    if (!game.engine_thinking()) { movesList = game.legal_moves_uci(); game.start_engine_move(ply_depth); status_msg = "Engine thinking..."; }
+                    std::string chosen; std::vector<std::pair<std::string, int>> scored;
+                    if (game.step_engine_move(kEngineSliceMicros, chosen, &scored)) {
+                        // Scores only when the engine's sliced search produced them; engines that search in one go log the moves alone.
+                        if (ply_depth % 2 != 0) scored.clear();
+                        activityLog.push_back(LegalMovesLine(game.fullmove_number(), "White", movesList, scored)); lastLoggedEngineFullmove = game.fullmove_number(); status_msg = chosen.empty() ? "Engine has no move" : std::string("Engine moves ") + chosen;
                     }
                 }
+                // Black's legal moves are scored by a sliced root search too, a slice per frame. An undo, reload or engine
+                // change starts it over; a human move before it finishes logs the moves unscored.
+                static std::unique_ptr<engine::SlicedSearch> annotation; static engine::EngineBase* annotationEngine = nullptr; static std::string annotationFen; static std::vector<std::string> annotationMoves;
+                if (!game.white_to_move() && lastLoggedHumanFullmove != game.fullmove_number()) {
+                    if (annotation && (annotationFen != game.current_fen() || annotationEngine != activeEngine)) annotation.reset();
+                    if (!annotation) { annotationMoves = game.legal_moves_uci(); annotationFen = game.current_fen(); annotationEngine = activeEngine; if (ply_depth % 2 == 0) annotation = activeEngine->start_search(annotationFen, ply_depth); }
+                    if (!annotation || annotation->advance(0, kEngineSliceMicros)) {
+                        activityLog.push_back(LegalMovesLine(game.fullmove_number(), "Black", annotationMoves, annotation ? annotation->root_scores() : std::vector<std::pair<std::string, int>>()));
+                        annotation.reset(); lastLoggedHumanFullmove = game.fullmove_number(); }
+                }
+                else annotation.reset();
                 // Board layout sizing
                 float availW = ImGui::GetContentRegionAvail().x; float availH = ImGui::GetContentRegionAvail().y; float squareSize = floorf((availH * 0.9f) / 8.0f); if (squareSize < 36) squareSize = 36; if (squareSize > 96) squareSize = 96; float boardPixel = squareSize * 8.0f; float spacing = 8.0f; float sideW = availW - boardPixel - spacing; if (sideW < 260) sideW = 260; if (boardPixel + spacing + sideW > availW) { sideW = availW - boardPixel - spacing; if (sideW < 200) sideW = 200; } float boardHeight = squareSize * 8.0f;
 
                 ImGui::BeginGroup(); ImDrawList* dlBoard = ImGui::GetWindowDrawList(); ImVec2 boardPos = ImGui::GetCursorScreenPos();
                 // Mouse input
                 ImVec2 mouse = ImGui::GetIO().MousePos; bool mouseClicked = ImGui::IsMouseClicked(ImGuiMouseButton_Left); int hoverSq = -1; if (mouse.x >= boardPos.x && mouse.y >= boardPos.y && mouse.x < boardPos.x + boardPixel && mouse.y < boardPos.y + boardHeight) { int file = int((mouse.x - boardPos.x) / squareSize); int rInv = int((mouse.y - boardPos.y) / squareSize); int rank = 7 - rInv; hoverSq = rank * 8 + file; }
-                if (!game.white_to_move() && mouseClicked && hoverSq >= 0) { char pc = game.piece_at(hoverSq); if (pending.from < 0) { if (pc >= 'a' && pc <= 'z') { pending.from = hoverSq; status_msg = std::string("Selected ") + IndexToAlg(pending.from); } } else { if (pc >= 'a' && pc <= 'z') { pending.from = hoverSq; status_msg = std::string("Reselect ") + IndexToAlg(pending.from); } else { std::string tryUci = IndexToAlg(pending.from) + IndexToAlg(hoverSq); auto moves = game.legal_moves(); std::string legal; for (auto& m : moves) { if (m.rfind(tryUci, 0) == 0) { legal = m; break; } } if (!legal.empty()) { game.apply_human_move(legal); pending.from = -1; status_msg = std::string("Human moves ") + legal; } else { status_msg = "Illegal move"; pending.from = -1; } } } }
-                if (!game.white_to_move() && lastLoggedHumanFullmove != game.fullmove_number()) {
-                    auto movesList = game.legal_moves_uci(); std::string line = std::string("Turn ") + std::to_string(game.fullmove_number()) + " Black legal:";
-                    if (ply_depth % 2 == 0) { auto scored = activeEngine->root_search_scores(game.current_fen(), ply_depth); std::unordered_map<std::string,int> sm; for(auto &pr : scored) sm[pr.first.substr(0,4)] = pr.second; for(auto &mv : movesList){ auto key= mv.substr(0,4); auto it= sm.find(key); if(it!=sm.end()) line += ' ' + mv + '(' + std::to_string(it->second) + ')'; else line += ' ' + mv; } }
-                    else { for (auto& mv : movesList) line += ' ' + mv; }
-                    activityLog.push_back(line); lastLoggedHumanFullmove = game.fullmove_number(); }
+                if (!game.white_to_move() && mouseClicked && hoverSq >= 0) { char pc = game.piece_at(hoverSq); if (pending.from < 0) { if (pc >= 'a' && pc <= 'z') { pending.from = hoverSq; status_msg = std::string("Selected ") + IndexToAlg(pending.from); } } else { if (pc >= 'a' && pc <= 'z') { pending.from = hoverSq; status_msg = std::string("Reselect ") + IndexToAlg(pending.from); } else { std::string tryUci = IndexToAlg(pending.from) + IndexToAlg(hoverSq); auto moves = game.legal_moves(); std::string legal; for (auto& m : moves) { if (m.rfind(tryUci, 0) == 0) { legal = m; break; } } if (!legal.empty()) { if (annotation) { activityLog.push_back(LegalMovesLine(game.fullmove_number(), "Black", annotationMoves, {})); annotation.reset(); lastLoggedHumanFullmove = game.fullmove_number(); } game.apply_human_move(legal); pending.from = -1; status_msg = std::string("Human moves ") + legal; } else { status_msg = "Illegal move"; pending.from = -1; } } } }
                 const char* boardPtr = game.board();
                 // Draw squares & pieces
                 for (int rank = 7; rank >= 0; --rank) {
@@ -425,6 +455,24 @@ int main(int, char**)
                     ImGui::InputTextMultiline("##activity", logBuf.data(), logBuf.size(), ImVec2(sideW, logHeight), ImGuiInputTextFlags_ReadOnly);
                 }
                 ImGui::Separator();
+                if (ImGui::CollapsingHeader("Search Stats", ImGuiTreeNodeFlags_DefaultOpen)) {
+#if ENGINE_SEARCH_STATS
+                    const engine::SearchStats& st = activeEngine->last_search_stats();
+                    ImGui::Text("Depth %d  Nodes %llu  QNodes %llu", st.depth, (unsigned long long)st.nodes, (unsigned long long)st.qnodes);
+                    ImGui::Text("Time %.1f ms (%.0f knps)  Movegen %.1f ms  Eval %.1f ms", st.search_ns / 1e6, st.nps() / 1e3, st.movegen_ns / 1e6, st.eval_ns / 1e6);
+                    ImGui::Text("TT probes %llu  hits %llu (%.1f%%)  cutoffs %llu", (unsigned long long)st.tt_probes, (unsigned long long)st.tt_hits, st.tt_hit_rate() * 100.0, (unsigned long long)st.tt_cutoffs);
+                    if (st.pawn_probes || st.eval_probes) ImGui::Text("Pawn hash hits %.1f%%  Eval cache hits %.1f%%", st.pawn_hit_rate() * 100.0, st.eval_hit_rate() * 100.0);
+                    ImGui::Text("Beta cutoffs %llu  first move %.1f%%", (unsigned long long)st.beta_cutoffs, st.first_move_cutoff_rate() * 100.0);
+                    ImGui::Text("Draw cutoffs %llu (repetition / fifty-move)", (unsigned long long)st.draw_cutoffs);
+                    float cutoffHist[engine::SearchStats::kCutoffSlots]; for (int i = 0; i < engine::SearchStats::kCutoffSlots; ++i) cutoffHist[i] = (float)st.cutoff_at[i];
+                    ImGui::PlotHistogram("##cutoffs", cutoffHist, engine::SearchStats::kCutoffSlots, 0, "cutoff move index (1..8+)", 0.0f, FLT_MAX, ImVec2(sideW, 60));
+                    std::string bf = "Branching:"; char bfBuf[32]; for (int ply = 0; ply < st.depth && ply + 1 < engine::SearchStats::kMaxPly; ++ply) { snprintf(bfBuf, sizeof(bfBuf), " %d:%.1f", ply, st.branching_factor(ply)); bf += bfBuf; }
+                    ImGui::TextWrapped("%s", bf.c_str());
+#else
+                    ImGui::TextDisabled("Search stats compiled out (ENGINE_NO_SEARCH_STATS)");
+#endif
+                }
+                ImGui::Separator();
                 ImGui::Text("Frame dt: %.3f ms (%.1f FPS)", frame_dt * 1000.0f, frame_dt > 0 ? 1.0f / frame_dt : 0.0f);
                 ImGui::PopItemWidth();
                 ImGui::EndGroup(); // end side panel